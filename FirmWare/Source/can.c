@@ -48,6 +48,14 @@ extern osEventFlagsId_t valve_event;
                                             //состоянии электропривода, датчиков утечки
 #define CAN_ANS_FILTER          4           //Показания счетчика фильтра питьевой воды и 
                                             //давления холодной воды (датчиков утечки)
+#define CAN_ANS_FLOW            5           //Мгновенный расход холодной/горячей/питьевой воды
+#define CAN_ANS_ROLL_COLD       6           //Итоги за период: расход и мин/макс давление холодной воды
+#define CAN_ANS_ROLL_HOT        7           //Итоги за период: расход и мин/макс давление горячей воды
+#define CAN_ANS_ROLL_FILTER     8           //Итоги за период: расход питьевой воды, уровень итогов,
+                                            //результат выборки
+
+#define CAN_LOG_TIMEOUT         200         //время ожидания места в очереди передачи при выдаче 
+                                            //записей журнала за интервал дат (ms)
 
 //*************************************************************************************************
 // Переменные с внешним доступом
@@ -99,7 +107,8 @@ static char * const error_descr[] = {
     "Parameter error"                                       //0x00200000
  };
 
-static WATER_LOG wtr_log;
+static bool log_range;                      //выдача записей журнала за интервал дат
+static WATER_LOG log_day;                   //последняя интервальная запись за дату
 static uint32_t recv_total, send_total;
 static uint32_t error_cnt[SIZE_ARRAY( error_descr )]; //счетчики ошибок протокола
 
@@ -109,6 +118,9 @@ static uint32_t error_cnt[SIZE_ARRAY( error_descr )]; //счетчики оши
 static void CANErrClr( void );
 static void IncError( CANError err_ind );
 static void CommandExec( CtrlCommand cmnd );
+static bool LogSend( uint16_t ref, WATER_LOG *wtr_log );
+static bool LogLast( uint16_t ref, WATER_LOG *wtr_log );
+static void RollSend( ROLL_REQ *req );
 static void TaskCanRecv( void *argument );
 static void TaskCanSend( void *argument );
 
@@ -117,7 +129,7 @@ static void TaskCanSend( void *argument );
 //*************************************************************************************************
 static const osThreadAttr_t task1_attr = {
     .name = "CanRecv", 
-    .stack_size = 448,
+    .stack_size = 640,
     .priority = osPriorityNormal
  };
 
@@ -181,13 +193,12 @@ void CanInit( void ) {
 //*************************************************************************************************
 static void TaskCanRecv( void *argument ) {
 
-    bool find = false;
     LOG_REQ *log_req;
+    DATE_TIME from, to;
     CANCommand can_cmnd;
     osStatus_t status;
     CAN_DATA can_data;
     uint8_t *ptr, len = 0;
-    uint16_t addr, rec, cnt;
 
     for ( ;; ) {
         status = osMessageQueueGet( recv_can, &can_data, NULL, osWaitForever );
@@ -237,63 +248,154 @@ static void TaskCanRecv( void *argument ) {
                     //передача сообщения в очередь для обработки
                     status = osMessageQueuePut( send_can, &can_data, 0, 0 );
                    }
-               }
-            //запрос интервальных показаний
-            if ( can_data.rtr == CAN_RTR_DATA && can_cmnd == CAN_COMMAND_LOG ) {
-                log_req = (LOG_REQ *)&can_data.data[0];
-                cnt = MakeSort( 0 );
-                if ( cnt ) {
-                    for ( rec = 0; rec < cnt; rec++ ) {
-                        //сортировка данных
-                        addr = GetAddrSort( rec );
-                        if ( !addr )
-                            continue;
-                        memset( (uint8_t *)&wtr_log, 0x00, sizeof( wtr_log ) );
-                        if ( FramReadData( addr, (uint8_t *)&wtr_log, sizeof( wtr_log ) ) != FRAM_OK )
-                            continue;
-                        if ( wtr_log.type_event != EVENT_DATA )
-                            continue; //только интервальные данные
-                        if ( wtr_log.day == log_req->day && wtr_log.month == log_req->month && wtr_log.year == log_req->year &&
-                             !wtr_log.hour && !wtr_log.min && !wtr_log.sec ) {
-                             find = true;
-                             break; //найдена дата
-                            }
-                       } //for end
-                   } //end if ( cnt )
-               } //end if ( can_data.rtr ... )
-            if ( find == true ) {
-                //подготовка данных по холодной воде
-                ptr = GetDataLog( DATA_LOG_COLD, &wtr_log, &len );
+                //запрос мгновенного расхода воды
+                ptr = GetDataCan2( DATA_FLOW, &len );
                 if ( ptr != NULL ) {
                     can_data.data_len = len;
-                    can_data.msg_id = CAN_ANS_COLD;
+                    can_data.msg_id = CAN_ANS_FLOW;
                     memcpy( can_data.data, ptr, len );
                     //передача сообщения в очередь для обработки
                     osMessageQueuePut( send_can, &can_data, 0, 0 );
                    }
-                //подготовка данных по горячей воды
-                ptr = GetDataLog( DATA_LOG_HOT, &wtr_log, &len );
-                if ( ptr != NULL ) {
-                    can_data.data_len = len;
-                    can_data.msg_id = CAN_ANS_HOT;
-                    memcpy( can_data.data, ptr, len );
-                    //передача сообщения в очередь для обработки
-                    osMessageQueuePut( send_can, &can_data, 0, 0 );
+               }
+            //запрос интервальных показаний: за дату (4 байта) или за интервал дат (8 байт)
+            if ( can_data.rtr == CAN_RTR_DATA && can_cmnd == CAN_COMMAND_LOG ) {
+                log_req = (LOG_REQ *)&can_data.data[0];
+                memset( (uint8_t *)&from, 0x00, sizeof( from ) );
+                from.day = log_req->day;
+                from.month = log_req->month;
+                from.year = log_req->year;
+                to = from;
+                to.hour = 23;
+                to.min = 59;
+                to.sec = 59;
+                log_range = false;
+                if ( can_data.data_len >= 2 * sizeof( LOG_REQ ) ) {
+                    //интервал дат: все интервальные записи с 00:00:00 первой даты по 23:59:59 второй
+                    log_req++;
+                    to.day = log_req->day;
+                    to.month = log_req->month;
+                    to.year = log_req->year;
+                    log_range = true;
+                    LogFind( &from, &to, LOG_FIND_DATA, LogSend );
                    }
-                //подготовка данных по питьевой воде
-                ptr = GetDataLog( DATA_LOG_FILTER, &wtr_log, &len );
-                if ( ptr != NULL ) {
-                    can_data.data_len = len;
-                    can_data.msg_id = CAN_ANS_FILTER;
-                    memcpy( can_data.data, ptr, len );
-                    //передача сообщения в очередь для обработки
-                    osMessageQueuePut( send_can, &can_data, 0, 0 );
+                else {
+                    //за дату выдается последняя интервальная запись за сутки (суточная
+                    //запись выполняется в 23:59:59)
+                    if ( LogFind( &from, &to, LOG_FIND_DATA, LogLast ) )
+                        LogSend( 0, &log_day );
                    }
                }
+            //запрос итогов расхода: уровень итогов (1 байт) + дата периода (4 байта)
+            if ( can_data.rtr == CAN_RTR_DATA && can_cmnd == CAN_COMMAND_ROLLUP && can_data.data_len >= sizeof( ROLL_REQ ) )
+                RollSend( (ROLL_REQ *)&can_data.data[0] );
            }
       }
  }
 
+//*************************************************************************************************
+// Передача записи журнала в очередь CAN сообщений, функция обработки записи для LogFind().
+// При запросе за интервал дат перед данными записи передается дата/время записи.
+//-------------------------------------------------------------------------------------------------
+// uint16_t ref       - ссылка на запись журнала в FRAM
+// WATER_LOG *wtr_log - указатель на данные записи
+// return = true      - продолжить выборку записей
+//*************************************************************************************************
+static bool LogSend( uint16_t ref, WATER_LOG *wtr_log ) {
+
+    DataType type;
+    CAN_DATA can_data;
+    DATE_TIME dtime;
+    uint8_t *ptr, len = 0;
+    uint32_t timeout = log_range == true ? CAN_LOG_TIMEOUT : 0;
+    static const uint8_t msg_id[] = { CAN_ANS_COLD, CAN_ANS_HOT, CAN_ANS_FILTER };
+
+    if ( log_range == true ) {
+        //дата/время записи
+        dtime.day = wtr_log->day;
+        dtime.month = wtr_log->month;
+        dtime.year = wtr_log->year;
+        dtime.hour = wtr_log->hour;
+        dtime.min = wtr_log->min;
+        dtime.sec = wtr_log->sec;
+        can_data.rtr = CAN_RTR_DATA;
+        can_data.data_len = sizeof( dtime );
+        can_data.msg_id = CAN_ANS_DATETIME;
+        memcpy( can_data.data, (uint8_t *)&dtime, sizeof( dtime ) );
+        if ( osMessageQueuePut( send_can, &can_data, 0, timeout ) != osOK )
+            return false;
+       }
+    //данные по холодной/горячей/питьевой воде
+    for ( type = DATA_LOG_COLD; type <= DATA_LOG_FILTER; type++ ) {
+        ptr = GetDataLog( type, wtr_log, &len );
+        if ( ptr == NULL )
+            continue;
+        can_data.rtr = CAN_RTR_DATA;
+        can_data.data_len = len;
+        can_data.msg_id = msg_id[type - DATA_LOG_COLD];
+        memcpy( can_data.data, ptr, len );
+        //передача сообщения в очередь для обработки
+        if ( osMessageQueuePut( send_can, &can_data, 0, timeout ) != osOK )
+            return false;
+       }
+    return log_range;
+ }
+
+//*************************************************************************************************
+// Сохранение последней выбранной записи журнала за дату, функция обработки записи для LogFind(),
+// записи выбираются от старых к новым
+//-------------------------------------------------------------------------------------------------
+// uint16_t ref       - ссылка на запись журнала в FRAM
+// WATER_LOG *wtr_log - указатель на данные записи
+// return = true      - продолжить выборку записей
+//*************************************************************************************************
+static bool LogLast( uint16_t ref, WATER_LOG *wtr_log ) {
+
+    memcpy( (uint8_t *)&log_day, (uint8_t *)wtr_log, sizeof( log_day ) );
+    return true;
+ }
+
+//*************************************************************************************************
+// Передача итогов расхода воды за период в очередь CAN сообщений: по холодной и горячей воде -
+// расход и мин/макс давление, по питьевой воде - расход, уровень итогов и результат выборки
+//-------------------------------------------------------------------------------------------------
+// ROLL_REQ *req - указатель на запрос: уровень итогов, дата периода
+//*************************************************************************************************
+static void RollSend( ROLL_REQ *req ) {
+
+    ROLL_REQ roll_req;
+    ROLLUP rollup;
+    RollStat stat;
+    CAN_DATA can_data;
+    CAN_ROLL1 roll1;
+    CAN_ROLL3 roll3;
+    Water chnl;
+    static const uint8_t msg_id[] = { CAN_ANS_ROLL_COLD, CAN_ANS_ROLL_HOT };
+
+    //данные запроса размещены в буфере принятого сообщения
+    memcpy( (uint8_t *)&roll_req, (uint8_t *)req, sizeof( roll_req ) );
+    stat = GetDataRoll( &roll_req, &rollup );
+    can_data.rtr = CAN_RTR_DATA;
+    //итоги по холодной/горячей воде
+    for ( chnl = WATER_COLD; chnl <= WATER_HOT; chnl++ ) {
+        roll1.volume = rollup.volume[chnl == WATER_COLD ? COUNT_COLD : COUNT_HOT];
+        roll1.pressr_min = rollup.pressr_min[chnl];
+        roll1.pressr_max = rollup.pressr_max[chnl];
+        can_data.data_len = sizeof( roll1 );
+        can_data.msg_id = msg_id[chnl];
+        memcpy( can_data.data, (uint8_t *)&roll1, sizeof( roll1 ) );
+        osMessageQueuePut( send_can, &can_data, 0, CAN_LOG_TIMEOUT );
+       }
+    //итоги по питьевой воде, результат выборки
+    roll3.volume = rollup.volume[COUNT_FILTER];
+    roll3.type = roll_req.type;
+    roll3.stat = stat;
+    can_data.data_len = sizeof( roll3 );
+    can_data.msg_id = CAN_ANS_ROLL_FILTER;
+    memcpy( can_data.data, (uint8_t *)&roll3, sizeof( roll3 ) );
+    osMessageQueuePut( send_can, &can_data, 0, CAN_LOG_TIMEOUT );
+ }
+
 //*************************************************************************************************
 // Задача передачи сообщений по CAN шине
 //*************************************************************************************************
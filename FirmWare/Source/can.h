@@ -63,7 +63,8 @@ typedef enum {
 typedef enum {
     CAN_COMMAND_CTRL,                       //команда управления электроприводами см. CtrlCommand
     CAN_COMMAND_DATETIME,                   //установка значений дата/время
-    CAN_COMMAND_LOG                         //запрос интервальных данных
+    CAN_COMMAND_LOG,                        //запрос интервальных данных
+    CAN_COMMAND_ROLLUP                      //запрос итогов расхода за сутки/месяц/год
 } CANCommand;
 
 //Коды команд для CAN шины: управления электроприводами 
@@ -15,6 +15,7 @@
 #include "config.h"
 #include "command.h"
 #include "modbus.h"
+#include "rs485.h"
 #include "events.h"
 #include "can.h"
 #include "fram.h"
@@ -24,6 +25,10 @@
 #include "zigbee.h"
 #include "parse.h"
 #include "sort.h"
+#include "storage.h"
+#include "scrub.h"
+#include "rollup.h"
+#include "i2cbus.h"
 #include "message.h"
 #include "version.h"
 
@@ -34,6 +39,7 @@ extern CONFIG config;
 extern CURR_DATA curr_data;
 extern WATER_LOG water_log;
 extern uint16_t pressure_cold, pressure_hot;
+extern uint16_t flow_rate[];
 
 //*************************************************************************************************
 // Переменные с внешним доступом
@@ -49,6 +55,9 @@ typedef struct {
     void    (*func)( uint8_t cnt_par, char *param );   //указатель на функцию выполнения
 } CMD;
 
+//расшифровка состояния захвата переходных процессов давления
+static char * const hammer_stat[] = { "off", "waiting", "capturing", "ready" };
+
 //расшифровка статуса задач
 #ifdef DEBUG_TARGET
 static char * const state_name[] = {
@@ -78,6 +87,8 @@ static const osEventFlagsAttr_t evn_attr = { .name = "CmndEvents" };
 static void TaskCommand( void *argument );
 static void ExecCommand( char *buff );
 static void WaterLog( uint8_t cnt_view );
+static void WaterHammer( bool dump );
+static void WaterRoll( char *level, char *date );
 static ErrorStatus StrHexToBin( char *str, uint8_t *hex, uint8_t size );
 static ErrorStatus HexToBin( char *ptr, uint8_t *bin );
 
@@ -122,6 +133,9 @@ static const char *help = {
     #endif                           
     "zb [res/init/net/save/cfg/chk]  - ZigBee module control.\r\n"
     "water [cold/hot/filter/log [N]] - Water flow status, setting initial values.\r\n"
+    "water leak                      - Continuous flow (micro-leak) detector status.\r\n"
+    "water hammer [dump/clr]         - Pressure transient (water hammer) capture: status, samples, rearm.\r\n"
+    "water roll day/mon/year [date]  - Consumption totals for the period (date dd.mm.yyyy, current by default).\r\n"
     "config                          - Display of configuration parameters.\r\n"
     "config save                     - Save configuration settings.\r\n"
     "config {cold/hot/filter} xxxxx  - Setting incremental values for water meters.\r\n"
@@ -131,9 +145,21 @@ static const char *help = {
     "config can id 0xXXXXXXXX        - Setting the Device ID on the CAN Bus (HEX format without 0x).\r\n"
     "config can addr xxxxx           - Setting the width of the CAN bus identifier (11/29 bits).\r\n"
     "config can speed xxxxx          - Set the CAN bus speed 10,20,50,125,250,500 (kbit/s).\r\n"
+    "config cache time xxxxx         - Max interval for saving counters to FRAM (sec, 0 - off).\r\n"
+    "config cache vol xxxxx          - Max water volume not saved to FRAM (liters, 0 - off).\r\n"
     "config pres_max xxxxx           - Set the maximum pressure for the sensor.\r\n"
     "config pres_omin xxxxx          - Setting the minimum output voltage of the pressure sensor.\r\n"
     "config pres_omax xxxxx          - Setting the maximum output voltage of the pressure sensor.\r\n"
+    "config pres_time xxxxx          - Pressure update interval (100 - 10000 msec).\r\n"
+    "config pres_cal N x.xxx x.xx    - Calibration point N (1-8) of the pressure sensor: voltage, pressure.\r\n"
+    "config pres_cal clr             - Clear calibration table (linear sensor: pres_max/omin/omax).\r\n"
+    "config log xxxx                 - Log interval (minutes, divisor of 1440: 60 - hourly, 1440 - daily).\r\n"
+    "config leak idle xxxx           - Min no-flow interval for micro-leak detector (10 - 1440 minutes).\r\n"
+    "config leak time xxx            - Max continuous flow time (1 - 168 hours, 0 - off).\r\n"
+    "config hammer xxxx              - Water hammer capture trigger dP/dt (1 - 1000 atm/s, 0 - off).\r\n"
+    "config pres_low x.xx            - Low pressure alarm threshold (atm, 0 - off).\r\n"
+    "config pres_high x.xx           - High pressure alarm threshold (atm, 0 - off).\r\n"
+    "config pres_valve 0/1           - Close valve on pressure alarm (0 - no, 1 - yes).\r\n"
     "config panid 0x0000 - 0xFFFE    - Network PANID (HEX format without 0x).\r\n"
     "config netgrp 1-99              - Network group number.\r\n"
     "config netkey XXXX....          - Network key (HEX format without 0x).\r\n"
@@ -280,6 +306,7 @@ static void CmndConfig( uint8_t cnt_par, char *param ) {
 
     char *ptr;
     uint8_t error, ind, bin[sizeof( config.net_key )];
+    uint16_t volt, press;
     CANSpeed can_speed;
     UARTSpeed uart_speed;
     bool change = false;
@@ -330,6 +357,24 @@ static void CmndConfig( uint8_t cnt_par, char *param ) {
            }
         else UartSendStr( (char *)msg_err_param );
        }
+    //установка макс. интервала хранения изменений счетчиков только в RAM
+    if ( cnt_par == 4 && !strcasecmp( GetParamVal( IND_PARAM1 ), "cache" ) && !strcasecmp( GetParamVal( IND_PARAM2 ), "time" ) ) {
+        value.val_uint32 = atol( GetParamVal( IND_PARAM3 ) );
+        if ( value.val_uint32 <= 3600 ) {
+            change = true;
+            config.cache_time = value.val_uint32;
+           }
+        else UartSendStr( (char *)msg_err_param );
+       }
+    //установка макс. объема воды не сохраненного в FRAM
+    if ( cnt_par == 4 && !strcasecmp( GetParamVal( IND_PARAM1 ), "cache" ) && !strcasecmp( GetParamVal( IND_PARAM2 ), "vol" ) ) {
+        value.val_uint32 = atol( GetParamVal( IND_PARAM3 ) );
+        if ( value.val_uint32 <= 1000 ) {
+            change = true;
+            config.cache_volume = value.val_uint32;
+           }
+        else UartSendStr( (char *)msg_err_param );
+       }
     //установка скорости RS-485 порта (MODBUS)
     if ( cnt_par == 4 && !strcasecmp( GetParamVal( IND_PARAM1 ), "modbus" ) && !strcasecmp( GetParamVal( IND_PARAM2 ), "speed" ) ) {
         value.val_uint32 = atol( GetParamVal( IND_PARAM3 ) );
@@ -416,6 +461,105 @@ static void CmndConfig( uint8_t cnt_par, char *param ) {
            }
         else UartSendStr( (char *)msg_err_param );
        }
+    //установка интервала обновления значений давления
+    if ( cnt_par == 3 && !strcasecmp( GetParamVal( IND_PARAM1 ), "pres_time" ) ) {
+        value.val_uint32 = atol( GetParamVal( IND_PARAM2 ) );
+        if ( value.val_uint32 >= 100 && value.val_uint32 <= 10000 ) {
+            change = true;
+            config.press_time = value.val_uint32;
+           }
+        else UartSendStr( (char *)msg_err_param );
+       }
+    //установка интервала записи данных в журнал
+    if ( cnt_par == 3 && !strcasecmp( GetParamVal( IND_PARAM1 ), "log" ) ) {
+        value.val_uint32 = atol( GetParamVal( IND_PARAM2 ) );
+        if ( value.val_uint32 && value.val_uint32 <= 1440 && !( 1440 % value.val_uint32 ) ) {
+            change = true;
+            config.log_period = value.val_uint32;
+           }
+        else UartSendStr( (char *)msg_err_param );
+       }
+    //установка мин. интервала "покоя" для контроля непрерывного расхода воды
+    if ( cnt_par == 4 && !strcasecmp( GetParamVal( IND_PARAM1 ), "leak" ) && !strcasecmp( GetParamVal( IND_PARAM2 ), "idle" ) ) {
+        value.val_uint32 = atol( GetParamVal( IND_PARAM3 ) );
+        if ( value.val_uint32 >= 10 && value.val_uint32 <= 1440 ) {
+            change = true;
+            config.leak_idle = value.val_uint32;
+           }
+        else UartSendStr( (char *)msg_err_param );
+       }
+    //установка макс. времени непрерывного расхода воды
+    if ( cnt_par == 4 && !strcasecmp( GetParamVal( IND_PARAM1 ), "leak" ) && !strcasecmp( GetParamVal( IND_PARAM2 ), "time" ) ) {
+        value.val_uint32 = atol( GetParamVal( IND_PARAM3 ) );
+        if ( value.val_uint32 <= 168 ) {
+            change = true;
+            config.leak_period = value.val_uint32;
+           }
+        else UartSendStr( (char *)msg_err_param );
+       }
+    //установка порога скорости изменения давления для захвата переходных процессов
+    if ( cnt_par == 3 && !strcasecmp( GetParamVal( IND_PARAM1 ), "hammer" ) ) {
+        value.val_uint32 = atol( GetParamVal( IND_PARAM2 ) );
+        if ( value.val_uint32 <= 1000 ) {
+            change = true;
+            config.hammer_dpdt = value.val_uint32;
+           }
+        else UartSendStr( (char *)msg_err_param );
+       }
+    //установка порога низкого давления
+    if ( cnt_par == 3 && !strcasecmp( GetParamVal( IND_PARAM1 ), "pres_low" ) ) {
+        value.val_float = atof( GetParamVal( IND_PARAM2 ) );
+        press = ( value.val_float >= 0 && value.val_float <= 15 ) ? (uint16_t)( value.val_float * 100 + 0.5 ) : 0xFFFF;
+        if ( press != 0xFFFF && ( !press || !config.press_high || press < config.press_high ) ) {
+            change = true;
+            config.press_low = press;
+           }
+        else UartSendStr( (char *)msg_err_param );
+       }
+    //установка порога высокого давления
+    if ( cnt_par == 3 && !strcasecmp( GetParamVal( IND_PARAM1 ), "pres_high" ) ) {
+        value.val_float = atof( GetParamVal( IND_PARAM2 ) );
+        press = ( value.val_float >= 0 && value.val_float <= 15 ) ? (uint16_t)( value.val_float * 100 + 0.5 ) : 0xFFFF;
+        if ( press != 0xFFFF && ( !press || press > config.press_low ) ) {
+            change = true;
+            config.press_high = press;
+           }
+        else UartSendStr( (char *)msg_err_param );
+       }
+    //закрытие крана при выходе давления за пороги
+    if ( cnt_par == 3 && !strcasecmp( GetParamVal( IND_PARAM1 ), "pres_valve" ) ) {
+        value.val_uint32 = atol( GetParamVal( IND_PARAM2 ) );
+        if ( value.val_uint32 <= 1 ) {
+            change = true;
+            config.press_valve = value.val_uint32;
+           }
+        else UartSendStr( (char *)msg_err_param );
+       }
+    //очистка таблицы калибровки датчиков давления
+    if ( cnt_par == 3 && !strcasecmp( GetParamVal( IND_PARAM1 ), "pres_cal" ) && !strcasecmp( GetParamVal( IND_PARAM2 ), "clr" ) ) {
+        change = true;
+        config.press_points = 0;
+        memset( config.press_cal, 0x00, sizeof( config.press_cal ) );
+       }
+    //установка точки таблицы калибровки датчиков давления
+    if ( cnt_par == 5 && !strcasecmp( GetParamVal( IND_PARAM1 ), "pres_cal" ) ) {
+        ind = atoi( GetParamVal( IND_PARAM2 ) );
+        value.val_float = atof( GetParamVal( IND_PARAM3 ) );
+        volt = ( value.val_float >= 0 && value.val_float <= 5 ) ? (uint16_t)( value.val_float * 1000 + 0.5 ) : 0xFFFF;
+        value.val_float = atof( GetParamVal( IND_PARAM4 ) );
+        //точки добавляются по порядку, напряжение по возрастанию, не более 5 вольт
+        if ( ind && ind <= PRESS_CAL_POINTS && ind <= config.press_points + 1 && volt <= 5000 && 
+             value.val_float >= 0 && value.val_float <= 15 && 
+             ( ind == 1 || volt > config.press_cal[ind - 2].volt ) && 
+             ( ind >= config.press_points || volt < config.press_cal[ind].volt ) ) {
+            change = true;
+            config.press_cal[ind - 1].volt = volt;
+            config.press_cal[ind - 1].pressure = (uint16_t)( value.val_float * 100 + 0.5 );
+            if ( ind > config.press_points )
+                config.press_points = ind;
+           }
+        else UartSendStr( (char *)msg_err_param );
+       }
     //установка адреса сети в канале
     if ( cnt_par == 3 && !strcasecmp( GetParamVal( IND_PARAM1 ), "panid" ) ) {
         if ( StrHexToBin( GetParamVal( IND_PARAM2 ), (uint8_t *)&value.val_uint16, sizeof( value.val_uint16 ) ) == SUCCESS ) {
@@ -465,6 +609,11 @@ static void CmndConfig( uint8_t cnt_par, char *param ) {
            }
         else UartSendStr( (char *)msg_err_param );
        }
+    //пересчет параметров измерения давления и времени записи в журнал
+    if ( change == true ) {
+        WaterPressCfg();
+        osEventFlagsSet( water_event, EVN_WTR_SCHED );
+       }
     //сохранение параметров
     if ( cnt_par == 2 && !strcasecmp( GetParamVal( IND_PARAM1 ), "save" ) ) {
         UartSendStr( (char *)msg_save );
@@ -488,6 +637,16 @@ static void CmndConfig( uint8_t cnt_par, char *param ) {
     UartSendStr( buffer );
     sprintf( buffer, "Increment of drinking water meter: .. %u liters/imp\r\n", config.inc_cnt_filter );
     UartSendStr( buffer );
+    sprintf( buffer, "Max interval of saving counters: .... %u sec\r\n", config.cache_time );
+    UartSendStr( buffer );
+    sprintf( buffer, "Max volume not saved to FRAM: ....... %u liters\r\n", config.cache_volume );
+    UartSendStr( buffer );
+    sprintf( buffer, "Log interval: ....................... %u min\r\n", config.log_period ? config.log_period : 1440 );
+    UartSendStr( buffer );
+    sprintf( buffer, "Micro-leak no-flow interval: ........ %u min\r\n", config.leak_idle ? config.leak_idle : 120 );
+    UartSendStr( buffer );
+    sprintf( buffer, "Micro-leak max continuous flow: ..... %u hours\r\n", config.leak_period );
+    UartSendStr( buffer );
     //параметры датчика давления
     UartSendStr( (char *)msg_str_delim );
     sprintf( buffer, "Maximum measured value of\r\n the pressure sensor: ............... %2.2f atm\r\n", config.pressure_max );
@@ -496,6 +655,35 @@ static void CmndConfig( uint8_t cnt_par, char *param ) {
     UartSendStr( buffer );
     sprintf( buffer, "Maximum voltage at\r\n the pressure sensor output: ........ %2.2f\r\n", config.press_out_max );
     UartSendStr( buffer );
+    sprintf( buffer, "Pressure update interval: ........... %u msec\r\n", config.press_time );
+    UartSendStr( buffer );
+    if ( config.press_points >= 2 && config.press_points <= PRESS_CAL_POINTS ) {
+        sprintf( buffer, "Calibration points of\r\n the pressure sensor: ............... %u\r\n", config.press_points );
+        UartSendStr( buffer );
+        for ( ind = 0; ind < config.press_points; ind++ ) {
+            sprintf( buffer, " #%u: %u.%03u V - %u.%02u atm\r\n", ind + 1, config.press_cal[ind].volt / 1000, config.press_cal[ind].volt % 1000,
+                     config.press_cal[ind].pressure / 100, config.press_cal[ind].pressure % 100 );
+            UartSendStr( buffer );
+           }
+       }
+    else UartSendStr( "Pressure sensor characteristic: ..... linear\r\n" );
+    if ( config.hammer_dpdt ) {
+        sprintf( buffer, "Water hammer trigger (dP/dt): ....... %u atm/s\r\n", config.hammer_dpdt );
+        UartSendStr( buffer );
+       }
+    else UartSendStr( "Water hammer trigger (dP/dt): ....... off\r\n" );
+    if ( config.press_low ) {
+        sprintf( buffer, "Pressure alarm low threshold: ....... %u.%02u atm\r\n", config.press_low / 100, config.press_low % 100 );
+        UartSendStr( buffer );
+       }
+    else UartSendStr( "Pressure alarm low threshold: ....... off\r\n" );
+    if ( config.press_high ) {
+        sprintf( buffer, "Pressure alarm high threshold: ...... %u.%02u atm\r\n", config.press_high / 100, config.press_high % 100 );
+        UartSendStr( buffer );
+       }
+    else UartSendStr( "Pressure alarm high threshold: ...... off\r\n" );
+    sprintf( buffer, "Close valve on pressure alarm: ...... %s\r\n", config.press_valve ? "yes" : "no" );
+    UartSendStr( buffer );
     //параметры радио CAN шины
     UartSendStr( (char *)msg_str_delim );
     if ( config.can_addr == CAN_ADDRESS_11_BIT )
@@ -545,6 +733,8 @@ static void CmndConfig( uint8_t cnt_par, char *param ) {
 //*************************************************************************************************
 static void CmndWater( uint8_t cnt_par, char *param ) {
 
+    uint8_t leak;
+    CountType type;
     FramStatus status;
     bool change = false; //признак новых данных
     
@@ -569,10 +759,40 @@ static void CmndWater( uint8_t cnt_par, char *param ) {
         WaterLog( atoi( GetParamVal( IND_PARAM2 ) ) );
         return;
        }
+    if ( cnt_par == 2 && !strcasecmp( GetParamVal( IND_PARAM1 ), "leak" ) ) {
+        //состояние детектора непрерывного расхода воды
+        for ( type = COUNT_COLD; type <= COUNT_FILTER; type++ ) {
+            FlowLeakDesc( type, buffer );
+            strcat( buffer, "\r\n" );
+            UartSendStr( buffer );
+           }
+        return;
+       }
+    if ( cnt_par == 2 && !strcasecmp( GetParamVal( IND_PARAM1 ), "hammer" ) ) {
+        //состояние захвата переходных процессов давления
+        WaterHammer( false );
+        return;
+       }
+    if ( cnt_par == 3 && !strcasecmp( GetParamVal( IND_PARAM1 ), "hammer" ) && !strcasecmp( GetParamVal( IND_PARAM2 ), "dump" ) ) {
+        //вывод выборок снимка переходного процесса давления
+        WaterHammer( true );
+        return;
+       }
+    if ( cnt_par == 3 && !strcasecmp( GetParamVal( IND_PARAM1 ), "hammer" ) && !strcasecmp( GetParamVal( IND_PARAM2 ), "clr" ) ) {
+        //сброс снимка, повторный запуск захвата
+        HammerClear();
+        WaterHammer( false );
+        return;
+       }
+    if ( ( cnt_par == 3 || cnt_par == 4 ) && !strcasecmp( GetParamVal( IND_PARAM1 ), "roll" ) ) {
+        //итоги расхода воды за сутки/месяц/год
+        WaterRoll( GetParamVal( IND_PARAM2 ), cnt_par == 4 ? GetParamVal( IND_PARAM3 ) : NULL );
+        return;
+       }
     if ( cnt_par == 3 && !strcasecmp( GetParamVal( IND_PARAM1 ), "addr" ) && atol( GetParamVal( IND_PARAM2 ) ) == 0 ) {
-        //установка значения адреса следующего блока для записи события
+        //следующая запись события в первый сегмент журнала
         change = true;
-        curr_data.next_addr = FRAM_ADDR_LOG;
+        FramLogReset();
        }
     //вывод текущих значений 
     sprintf( buffer, "Cold water meter values: ...... %u.%03u\r\n", curr_data.count_cold/1000, curr_data.count_cold%1000 );
@@ -585,13 +805,26 @@ static void CmndWater( uint8_t cnt_par, char *param ) {
     UartSendStr( buffer );
     sprintf( buffer, "Hot water pressure: ........... %u.%u atm\r\n", pressure_hot/100, pressure_hot%100 );
     UartSendStr( buffer );
+    sprintf( buffer, "Cold water flow rate: ......... %u.%02u l/min\r\n", flow_rate[COUNT_COLD]/100, flow_rate[COUNT_COLD]%100 );
+    UartSendStr( buffer );
+    sprintf( buffer, "Hot water flow rate: .......... %u.%02u l/min\r\n", flow_rate[COUNT_HOT]/100, flow_rate[COUNT_HOT]%100 );
+    UartSendStr( buffer );
+    sprintf( buffer, "Drinking water flow rate: ..... %u.%02u l/min\r\n", flow_rate[COUNT_FILTER]/100, flow_rate[COUNT_FILTER]%100 );
+    UartSendStr( buffer );
     sprintf( buffer, "Leakage sensor power check: ... %s\r\n", DC12VStatus() == DC12V_OK ? "OK" : "ALARM" );
     UartSendStr( buffer );
     sprintf( buffer, "Leak sensor status #1: ........ %s\r\n", LeakStatus( LEAK1 ) == LEAK_NO ? "OK" : "WATER LEAK" );
     UartSendStr( buffer );
     sprintf( buffer, "Leak sensor status #2: ........ %s\r\n", LeakStatus( LEAK2 ) == LEAK_NO ? "OK" : "WATER LEAK" );
     UartSendStr( buffer );
-    sprintf( buffer, "Address of the next log entry:  0x%04X\r\n", curr_data.next_addr );
+    leak = FlowLeakStatus();
+    sprintf( buffer, "Continuous flow (micro-leak): . %s%s%s%s\r\n", leak ? "" : "OK", leak & FLOW_LEAK_COLD ? "COLD " : "", 
+             leak & FLOW_LEAK_HOT ? "HOT " : "", leak & FLOW_LEAK_FILTER ? "FILTER" : "" );
+    UartSendStr( buffer );
+    UartSendStr( "Pressure alarm: ............... " );
+    UartSendStr( PressAlarmDesc( buffer ) );
+    UartSendStr( (char *)msg_crlr );
+    sprintf( buffer, "Address of the current log block: 0x%04X\r\n", curr_data.next_addr );
     UartSendStr( buffer );
     if ( change == true ) {
         //сохранение данных
@@ -785,14 +1018,49 @@ static void CmndStat( uint8_t cnt_par, char *param ) {
     sprintf( str, "Date/time of activation: %02u.%02u.%04u  %02u:%02u:%02u\r\n\r\n", 
              curr_data.day, curr_data.month, curr_data.year, curr_data.hour, curr_data.min, curr_data.sec );
     UartSendStr( str );
+    //статистика кэширования текущих значений счетчиков
+    UartSendStr( "Current data cache statistics ...\r\n" );
+    UartSendStr( (char *)msg_str_delim );
+    for ( i = 0; i < CACHE_STAT_CNT; i++ ) {
+        sprintf( buffer, "%s\r\n", WaterCacheDesc( (CacheStat)i, str ) );
+        UartSendStr( buffer );
+       }
+    //статистика очереди записи в FRAM
+    UartSendStr( "\r\nFRAM write queue statistics ...\r\n" );
+    UartSendStr( (char *)msg_str_delim );
+    for ( i = 0; i < STORE_STAT_CNT; i++ ) {
+        sprintf( buffer, "%s\r\n", StorageStatDesc( (StoreStat)i, str ) );
+        UartSendStr( buffer );
+       }
+    //статистика обмена по шине I2C
+    UartSendStr( "\r\nI2C statistics ...\r\n" );
+    UartSendStr( (char *)msg_str_delim );
+    for ( i = 0; i < I2C_STAT_CNT; i++ ) {
+        sprintf( buffer, "%s\r\n", I2CStatDesc( (I2CStat)i, str ) );
+        UartSendStr( buffer );
+       }
+    //статистика фоновой проверки FRAM
+    UartSendStr( "\r\nFRAM scrubber statistics ...\r\n" );
+    UartSendStr( (char *)msg_str_delim );
+    for ( i = 0; i < SCRUB_STAT_CNT; i++ ) {
+        sprintf( buffer, "%s\r\n", ScrubStatDesc( (ScrubStat)i, str ) );
+        UartSendStr( buffer );
+       }
     //статистика протокола MODBUS
-    UartSendStr( "Modbus statistics ...\r\n" );
+    UartSendStr( "\r\nModbus statistics ...\r\n" );
     UartSendStr( (char *)msg_str_delim );
     cnt = ModBusErrCnt( MBUS_REQUEST_OK );
     for ( i = 0; i < cnt; i++ ) {
         sprintf( buffer, "%s\r\n", ModBusErrCntDesc( (ModBusError)i, str ) );
         UartSendStr( buffer );
        }
+    //статистика приема RS-485
+    UartSendStr( "\r\nRS-485 receive statistics ...\r\n" );
+    UartSendStr( (char *)msg_str_delim );
+    for ( i = 0; i < RS485_STAT_CNT; i++ ) {
+        sprintf( buffer, "%s\r\n", RS485StatDesc( (RS485Stat)i, str ) );
+        UartSendStr( buffer );
+       }
     //статистика протокола CAN
     UartSendStr( "\r\nCAN statistics ...\r\n" );
     UartSendStr( (char *)msg_str_delim );
@@ -838,6 +1106,103 @@ static void CmndFlash( uint8_t cnt_par, char *param ) {
  }
 #endif
 
+//*************************************************************************************************
+// Вывод состояния захвата переходных процессов давления (гидроудар) и выборок снимка.
+// Время выборки в снимке указывается относительно события (мсек).
+//-------------------------------------------------------------------------------------------------
+// bool dump - вывод выборок снимка
+//*************************************************************************************************
+static void WaterHammer( bool dump ) {
+
+    uint16_t idx, cold, hot;
+    HAMMER_INFO info;
+
+    HammerInfo( &info );
+    if ( dump == false ) {
+        sprintf( buffer, "Water hammer capture: ......... %s\r\n", hammer_stat[info.stat] );
+        UartSendStr( buffer );
+        sprintf( buffer, "Sample rate: .................. %u Hz, %u samples, %u before event\r\n", 
+                 info.rate, HAMMER_SAMPLES, HAMMER_PRE_TRIG );
+        UartSendStr( buffer );
+        if ( info.stat != HAMMER_CAPTURE && info.stat != HAMMER_READY )
+            return;
+        sprintf( buffer, "Event: ........................ %02u.%02u.%04u %02u:%02u:%02u %s %u.%02u atm / %u ms\r\n",
+                 info.dtime.day, info.dtime.month, info.dtime.year, info.dtime.hour, info.dtime.min, info.dtime.sec,
+                 info.chnl == WATER_COLD ? "cold" : "hot", info.delta / 100, info.delta % 100, info.delta_ms );
+        UartSendStr( buffer );
+        return;
+       }
+    if ( info.stat != HAMMER_READY ) {
+        UartSendStr( "No water hammer snapshot.\r\n" );
+        return;
+       }
+    UartSendStr( "  #   msec   cold    hot\r\n" );
+    for ( idx = 0; idx < HAMMER_SAMPLES; idx++ ) {
+        cold = HammerValue( WATER_COLD, idx );
+        hot = HammerValue( WATER_HOT, idx );
+        sprintf( buffer, "%3u %6d %3u.%02u %3u.%02u\r\n", idx, ( (int32_t)idx - HAMMER_PRE_TRIG ) * 1000 / (int32_t)info.rate,
+                 cold / 100, cold % 100, hot / 100, hot % 100 );
+        UartSendStr( buffer );
+       }
+ }
+
+//*************************************************************************************************
+// Вывод итогов расхода воды за период: расход по счетчикам, мин/макс давление
+//-------------------------------------------------------------------------------------------------
+// char *level - уровень итогов: "day", "mon" ("month"), "year"
+// char *date  - дата периода в формате dd.mm.yyyy, NULL - текущая дата
+//*************************************************************************************************
+static void WaterRoll( char *level, char *date ) {
+
+    RollLevel type;
+    RollStat stat;
+    ROLLUP rollup;
+    DATE_TIME dtime;
+
+    if ( !strcasecmp( level, "day" ) )
+        type = ROLL_DAY;
+    else if ( !strcasecmp( level, "mon" ) || !strcasecmp( level, "month" ) )
+        type = ROLL_MONTH;
+    else if ( !strcasecmp( level, "year" ) )
+        type = ROLL_YEAR;
+    else {
+        UartSendStr( (char *)msg_err_param );
+        return;
+       }
+    GetTimeDate( &dtime );
+    if ( date != NULL ) {
+        if ( strlen( date ) != 10 ) {
+            UartSendStr( (char *)msg_err_param );
+            return;
+           }
+        dtime.day = atoi( date );
+        dtime.month = atoi( date + 3 );
+        dtime.year = atoi( date + 6 );
+       }
+    stat = RollupGet( type, &dtime, &rollup );
+    if ( type == ROLL_DAY )
+        sprintf( buffer, "Period: ....................... %02u.%02u.%04u %s\r\n", dtime.day, dtime.month, dtime.year, RollupStatDesc( stat ) );
+    if ( type == ROLL_MONTH )
+        sprintf( buffer, "Period: ....................... %02u.%04u %s\r\n", dtime.month, dtime.year, RollupStatDesc( stat ) );
+    if ( type == ROLL_YEAR )
+        sprintf( buffer, "Period: ....................... %04u %s\r\n", dtime.year, RollupStatDesc( stat ) );
+    UartSendStr( buffer );
+    if ( stat != ROLL_OK )
+        return;
+    sprintf( buffer, "Cold water: ................... %u.%03u\r\n", rollup.volume[COUNT_COLD]/1000, rollup.volume[COUNT_COLD]%1000 );
+    UartSendStr( buffer );
+    sprintf( buffer, "Hot water: .................... %u.%03u\r\n", rollup.volume[COUNT_HOT]/1000, rollup.volume[COUNT_HOT]%1000 );
+    UartSendStr( buffer );
+    sprintf( buffer, "Drinking water: ............... %u.%03u\r\n", rollup.volume[COUNT_FILTER]/1000, rollup.volume[COUNT_FILTER]%1000 );
+    UartSendStr( buffer );
+    sprintf( buffer, "Cold water pressure min/max: .. %u.%02u / %u.%02u atm\r\n", rollup.pressr_min[WATER_COLD]/100,
+             rollup.pressr_min[WATER_COLD]%100, rollup.pressr_max[WATER_COLD]/100, rollup.pressr_max[WATER_COLD]%100 );
+    UartSendStr( buffer );
+    sprintf( buffer, "Hot water pressure min/max: ... %u.%02u / %u.%02u atm\r\n", rollup.pressr_min[WATER_HOT]/100,
+             rollup.pressr_min[WATER_HOT]%100, rollup.pressr_max[WATER_HOT]/100, rollup.pressr_max[WATER_HOT]%100 );
+    UartSendStr( buffer );
+ }
+
 //*************************************************************************************************
 // Вывод протокола аварийных событий и логирования данных.
 //-------------------------------------------------------------------------------------------------
@@ -863,13 +1228,12 @@ static void WaterLog( uint8_t cnt_view ) {
         if ( !addr )
             continue;
         //чтение данных из FRAM
-        memset( (uint8_t *)&wtr_log, 0x00, sizeof( wtr_log ) );
-        if ( FramReadData( addr, (uint8_t *)&wtr_log, sizeof( wtr_log ) ) != FRAM_OK )
+        if ( FramReadLog( addr, &wtr_log ) != FRAM_OK )
             continue;
         cnt_view--;
         //дата время
-        sprintf( buffer, "%s #%02u (0x%04X): %02u.%02u.%04u %02u:%02u:%02u\r\n", wtr_log.type_event == EVENT_DATA ? "Event" : "ALARM",
-                 rec + 1, addr, wtr_log.day, wtr_log.month, wtr_log.year, wtr_log.hour, wtr_log.min, wtr_log.sec );
+        sprintf( buffer, "%s #%02u (0x%04X): %02u.%02u.%04u %02u:%02u:%02u  seq: %lu\r\n", wtr_log.type_event == EVENT_DATA ? "Event" : "ALARM",
+                 rec + 1, addr, wtr_log.day, wtr_log.month, wtr_log.year, wtr_log.hour, wtr_log.min, wtr_log.sec, (unsigned long)wtr_log.seq );
         UartSendStr( buffer );
         UartSendStr( (char *)msg_str_delim );
         //расход воды по счетчикам, давление воды
@@ -891,6 +1255,10 @@ static void WaterLog( uint8_t cnt_view ) {
         UartSendStr( buffer );
         sprintf( buffer, "Leak sensor #2: .. %s\r\n", wtr_log.leak2 == LEAK_NO ? "OK " : "ALARM" );
         UartSendStr( buffer );
+        sprintf( buffer, "Flow leak: ....... %s%s%s%s\r\n", wtr_log.flow_leak ? "" : "OK ", 
+                 wtr_log.flow_leak & FLOW_LEAK_COLD ? "COLD " : "", wtr_log.flow_leak & FLOW_LEAK_HOT ? "HOT " : "", 
+                 wtr_log.flow_leak & FLOW_LEAK_FILTER ? "FILTER" : "" );
+        UartSendStr( buffer );
         UartSendStr( (char *)msg_crlr );
        }
  }
@@ -943,7 +1311,9 @@ static void CmndZigBee( uint8_t cnt_par, char *param ) {
 #ifdef DEBUG_TARGET
 static void CmndReset( uint8_t cnt_par, char *param ) {
 
-    NVIC_SystemReset();
+    //запись текущих значений счетчиков и перезапуск выполняются в задаче "Water",
+    //кэш текущих значений изменяется только в этой задаче
+    osEventFlagsSet( water_event, EVN_WTR_RESET );
 }
 #endif
 
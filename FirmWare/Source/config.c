@@ -91,6 +91,23 @@ void ConfigInit( void ) {
         memcpy( config.net_key, key, sizeof( config.net_key ) ); //ключ шифрования
         config.dev_numb = 1;                        //адрес уст-ва в сети (логический номер уст-ва)
         config.addr_gate = 0x0000;                  //адрес шлюза с сети
+        //параметры записи текущих значений счетчиков в FRAM
+        config.cache_time = 60;                     //макс. интервал хранения изменений только в RAM (сек)
+        config.cache_volume = 10;                   //макс. объем воды не сохраненный в FRAM (литры)
+        //параметры измерения давления
+        config.press_time = 500;                    //интервал обновления значений давления (мсек)
+        config.press_points = 0;                    //линейная характеристика датчиков давления
+        //параметры записи интервальных данных в журнал
+        config.log_period = 1440;                   //интервал записи (минут)
+        //параметры контроля непрерывного расхода воды (микро-утечки)
+        config.leak_idle = 120;                     //мин. интервал без импульсов счетчика - "покой" (минут)
+        config.leak_period = 24;                    //макс. время расхода без интервалов "покоя" (часов)
+        //параметры захвата переходных процессов давления
+        config.hammer_dpdt = 20;                    //порог скорости изменения давления (атм/сек)
+        //параметры аварийного контроля давления
+        config.press_low = 0;                       //порог низкого давления (атм * 100), откл
+        config.press_high = 0;                      //порог высокого давления (атм * 100), откл
+        config.press_valve = 0;                     //без закрытия кранов при выходе давления за пороги
         flash_read = ERROR;
        }
     else {
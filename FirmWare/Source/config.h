@@ -17,8 +17,16 @@
 #define ERR_FLASH_PROGRAMM      0x40            //сохранение параметров
 #define ERR_FLASH_LOCK          0x80            //блокировка памяти
 
+#define PRESS_CAL_POINTS        8               //макс. кол-во точек таблицы калибровки датчиков давления
+
 #pragma pack( push, 1 )
 
+//точка таблицы калибровки датчиков давления
+typedef struct {
+    uint16_t    volt;                           //напряжение на выходе датчика (мВ)
+    uint16_t    pressure;                       //давление (атм * 100)
+ } PRESS_CAL;
+
 //*************************************************************************************************
 // Структура для хранения общих параметров системы
 //*************************************************************************************************
@@ -44,6 +52,25 @@ typedef struct {
     uint8_t     net_key[16];                    //ключ шифрования
     uint16_t    dev_numb;                       //номер уст-ва в сети
     uint16_t    addr_gate;                      //адрес шлюза с сети
+    //параметры записи текущих значений счетчиков в FRAM
+    uint16_t    cache_time;                     //макс. интервал хранения изменений только в RAM (сек)
+    uint16_t    cache_volume;                   //макс. объем воды не сохраненный в FRAM (литры)
+    //параметры измерения давления
+    uint16_t    press_time;                     //интервал обновления значений давления (мсек)
+    uint8_t     press_points;                   //кол-во точек калибровки, менее 2 - линейная характеристика
+                                                //по pressure_max, press_out_min, press_out_max
+    PRESS_CAL   press_cal[PRESS_CAL_POINTS];    //таблица калибровки датчиков давления, по возрастанию volt
+    //параметры записи интервальных данных в журнал
+    uint16_t    log_period;                     //интервал записи (минут), делитель 1440, "0" - сутки
+    //параметры контроля непрерывного расхода воды (микро-утечки)
+    uint16_t    leak_idle;                      //мин. интервал без импульсов счетчика - "покой" (минут)
+    uint8_t     leak_period;                    //макс. время расхода без интервалов "покоя" (часов), "0" - откл
+    //параметры захвата переходных процессов давления (гидроудар)
+    uint16_t    hammer_dpdt;                    //порог скорости изменения давления (атм/сек), "0" - откл
+    //параметры аварийного контроля давления (аналоговый сторожевой таймер АЦП)
+    uint16_t    press_low;                      //порог низкого давления (атм * 100), "0" - откл
+    uint16_t    press_high;                     //порог высокого давления (атм * 100), "0" - откл
+    uint8_t     press_valve;                    //закрытие крана при выходе давления за пороги: 0 - нет, 1 - да
  } CONFIG;
 
 //структура хранения блока параметров в FLASH памяти
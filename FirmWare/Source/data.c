@@ -15,6 +15,7 @@
 #include "water.h"
 #include "fram.h"
 #include "sort.h"
+#include "scrub.h"
 #include "events.h"
 #include "config.h"
 #include "crc16.h"
@@ -29,6 +30,7 @@ extern CONFIG config;
 extern VALVE valve_data;
 extern CURR_DATA curr_data;
 extern uint16_t pressure_cold, pressure_hot;
+extern uint16_t flow_rate[];
 extern ZB_CONFIG zb_cfg;
 
 //*************************************************************************************************
@@ -38,24 +40,40 @@ static char str[60];
 
 static DATE_TIME    data_rtc;
 static MBUS_DTIME   mbus_dtime;
+static MBUS_HAMMER  mbus_hammer;
+static uint8_t      mbus_hammer_page;       //номер страницы выборок снимка гидроудара для MODBUS
+static uint8_t      mbus_scrub_page;        //номер страницы карты поврежденных блоков FRAM для MODBUS
+static MBUS_LOG     mbus_log;
+static MBUS_DTIME   mbus_log_range[2];      //интервал дата/время выборки журнала для MODBUS
+static uint16_t     mbus_log_cnt;           //кол-во записей в выборке журнала для MODBUS
+static uint16_t     mbus_log_rec;           //номер текущей записи выборки журнала для MODBUS
+static uint16_t     mbus_log_skip;          //номер записи выборки для позиционирования LogSeekMbus()
+static uint32_t     mbus_log_seq;           //порядковый номер записи журнала перед текущей записью выборки
+static DATE_TIME    mbus_log_from, mbus_log_to; //интервал дата/время выборки журнала
+static MBUS_ROLL    mbus_roll;              //итоги расхода воды за период для MODBUS
 static DATA_LEAK    data_leak;
 static DATA_COUNT   data_cold, data_hot, data_filter;
-static uint8_t      data_modbus[26];
+static DATA_FLOW_RATE data_flow;
 
 static PACK_STATE   pack_state;
 static PACK_DATA    pack_data;
 static PACK_VALVE   pack_valve;
 static PACK_LEAKS   pack_leaks;
+static PACK_ROLL    pack_roll;
+static PACK_FLOW    pack_flow;
 
 static ZB_PACK_RTC  zb_pack_rtc;
 static ZB_PACK_REQ  zb_pack_req;
 static ZB_PACK_CTRL zb_pack_ctrl;
+static ZB_PACK_REQ_ROLL_DATA zb_pack_roll;
 
 static WATER_LOG    wtr_log;
 
 //*************************************************************************************************
 // Прототипы локальных функций
 //*************************************************************************************************
+static bool LogSeekRec( uint16_t ref, WATER_LOG *wtr_log );
+static void HammerMbus( void );
 
 //*************************************************************************************************
 // Возвращает указатель на структуру DATA_LEAK - состоянию датчиков утечки и 
@@ -71,9 +89,10 @@ uint8_t *GetDataCan1( uint8_t *size ) {
     data_leak.valve_stat.stat_valve_cold = ValveGetStatus( VALVE_COLD );
     data_leak.valve_stat.error_valve_cold = valve_data.error_cold;
     data_leak.valve_stat.stat_valve_hot = ValveGetStatus( VALVE_HOT );
-    data_leak.valve_stat.error_valve_hot = valve_data.error_cold;
+    data_leak.valve_stat.error_valve_hot = valve_data.error_hot;
     data_leak.leak1 = LeakStatus( LEAK1 );
     data_leak.leak2 = LeakStatus( LEAK2 );
+    data_leak.flow_leak = FlowLeakStatus();
     data_leak.dc12_chk = DC12VStatus();
     return (uint8_t *)&data_leak;
  }
@@ -137,6 +156,14 @@ uint8_t *GetDataCan2( DataType type, uint8_t *size ) {
         GetTimeDate( &data_rtc );
         return (uint8_t *)&data_rtc;
        }
+    if ( type == DATA_FLOW ) {
+        //мгновенный расход воды
+        *size = sizeof( data_flow );
+        data_flow.flow_cold = flow_rate[COUNT_COLD];
+        data_flow.flow_hot = flow_rate[COUNT_HOT];
+        data_flow.flow_filter = flow_rate[COUNT_FILTER];
+        return (uint8_t *)&data_flow;
+       }
     *size = 0;
     return NULL;
  }
@@ -200,104 +227,508 @@ uint8_t *GetDataLog( DataType type, WATER_LOG *wtr_log, uint8_t *size ) {
  }
 
 //*************************************************************************************************
-// Функция формирует набор данных в зависимости от номера регистра для передачи по MODBUS
+// Функции формирования значений регистров MODBUS, вызываются из таблицы описания регистров
+// reg_desc[] (modbus_reg.c) для каждого значения, регистры которого входят в запрос чтения,
+// для значений образа текущих значений (MBUS_ACC_LIVE) - при обновлении образа
 //-------------------------------------------------------------------------------------------------
-// uint16_t reg_id  - адрес регистра
-// uint16_t reg_cnt - кол-во регистров
-// uint8_t *bytes   - указатель на переменную в которой размещается кол-во сформированных байт данных
-// return           - указатель на блок данных
+// uint8_t *data - указатель для размещения значения, размер: кол-во регистров значения * 2 байта
 //*************************************************************************************************
-uint8_t *GetDataMbus( uint16_t reg_id, uint16_t reg_cnt, uint8_t *bytes ) {
 
-    uint16_t data16;
+//*************************************************************************************************
+// Состояния датчиков утечки и состояния электроприводов (MBUS_REG_CTRL)
+//*************************************************************************************************
+void MbusGetCtrl( uint8_t *data ) {
+
+    DATA_LEAK leak;
+
+    //вызывается задачами обновления образа текущих значений - используется локальная структура
+    memset( (uint8_t *)&leak, 0x00, sizeof( leak ) );
+    leak.valve_stat.stat_valve_cold = ValveGetStatus( VALVE_COLD );
+    leak.valve_stat.error_valve_cold = valve_data.error_cold;
+    leak.valve_stat.stat_valve_hot = ValveGetStatus( VALVE_HOT );
+    leak.valve_stat.error_valve_hot = valve_data.error_hot;
+    leak.leak1 = LeakStatus( LEAK1 );
+    leak.leak2 = LeakStatus( LEAK2 );
+    leak.flow_leak = FlowLeakStatus();
+    leak.dc12_chk = DC12VStatus();
+    memcpy( data, (uint8_t *)&leak, sizeof( leak ) );
+ }
+
+//*************************************************************************************************
+// Расход холодной воды (MBUS_REG_WTR_COLD)
+//*************************************************************************************************
+void MbusGetCold( uint8_t *data ) {
+
     uint32_t data32;
-    uint8_t cnt_byte = 0;
-    
-    if ( reg_cnt && reg_id == MBUS_REG_CTRL ) {
-        //состояния датчиков утечки и состояния электроприводов
-        data_leak.valve_stat.stat_valve_cold = ValveGetStatus( VALVE_COLD );
-        data_leak.valve_stat.error_valve_cold = valve_data.error_cold;
-        data_leak.valve_stat.stat_valve_hot = ValveGetStatus( VALVE_HOT );
-        data_leak.valve_stat.error_valve_hot = valve_data.error_cold;
-        data_leak.leak1 = LeakStatus( LEAK1 );
-        data_leak.leak2 = LeakStatus( LEAK2 );
-        data_leak.dc12_chk = DC12VStatus();
-        memcpy( data_modbus, (uint8_t *)&data_leak, sizeof( data_leak ) );
-        cnt_byte += sizeof( data_leak );
-        //переход на следующий регистр
-        if ( reg_cnt ) {
-            reg_cnt--;
-            reg_id += 1;
-           }
-       }
-    if ( reg_cnt && reg_id == MBUS_REG_WTR_COLD ) {
-        //данные по холодной воде
-        data32 = curr_data.count_cold;
-        memcpy( data_modbus + cnt_byte, (uint8_t *)&data32, sizeof( data32 ) );
-        cnt_byte += sizeof( data32 );
-        //переход на следующий регистр
-        if ( reg_cnt ) {
-            reg_cnt -= 2;
-            reg_id += 2;
-           }
+
+    data32 = curr_data.count_cold;
+    memcpy( data, (uint8_t *)&data32, sizeof( data32 ) );
+ }
+
+//*************************************************************************************************
+// Давление холодной воды (MBUS_REG_COLD_PRESR)
+//*************************************************************************************************
+void MbusGetColdPressr( uint8_t *data ) {
+
+    memcpy( data, (uint8_t *)&pressure_cold, sizeof( pressure_cold ) );
+ }
+
+//*************************************************************************************************
+// Расход горячей воды (MBUS_REG_WTR_HOT)
+//*************************************************************************************************
+void MbusGetHot( uint8_t *data ) {
+
+    uint32_t data32;
+
+    data32 = curr_data.count_hot;
+    memcpy( data, (uint8_t *)&data32, sizeof( data32 ) );
+ }
+
+//*************************************************************************************************
+// Давление горячей воды (MBUS_REG_HOT_PRESR)
+//*************************************************************************************************
+void MbusGetHotPressr( uint8_t *data ) {
+
+    memcpy( data, (uint8_t *)&pressure_hot, sizeof( pressure_hot ) );
+ }
+
+//*************************************************************************************************
+// Расход питьевой воды (MBUS_REG_WTR_FILTER)
+//*************************************************************************************************
+void MbusGetFilter( uint8_t *data ) {
+
+    uint32_t data32;
+
+    data32 = curr_data.count_filter;
+    memcpy( data, (uint8_t *)&data32, sizeof( data32 ) );
+ }
+
+//*************************************************************************************************
+// Дата/время внутренних часов (MBUS_REG_DAYMON ... MBUS_REG_HOURMIN)
+//*************************************************************************************************
+void MbusGetDtime( uint8_t *data ) {
+
+    GetTimeDate( &data_rtc );
+    mbus_dtime.day = data_rtc.day;
+    mbus_dtime.month = data_rtc.month;
+    mbus_dtime.year = data_rtc.year;
+    mbus_dtime.hour = data_rtc.hour;
+    mbus_dtime.min = data_rtc.min;
+    memcpy( data, (uint8_t *)&mbus_dtime, sizeof( mbus_dtime ) );
+ }
+
+//*************************************************************************************************
+// Мгновенный расход холодной/горячей/питьевой воды (MBUS_REG_FLOW_COLD ... MBUS_REG_FLOW_FILTER)
+//*************************************************************************************************
+void MbusGetFlow( uint8_t *data ) {
+
+    uint8_t idx;
+    uint16_t data16;
+
+    for ( idx = COUNT_COLD; idx <= COUNT_FILTER; idx++, data += sizeof( data16 ) ) {
+        data16 = flow_rate[idx];
+        memcpy( data, (uint8_t *)&data16, sizeof( data16 ) );
        }
-    if ( reg_cnt && reg_id == MBUS_REG_COLD_PRESR ) {
-        //давление холодной выды
-        data16 = pressure_cold;
-        memcpy( data_modbus + cnt_byte, (uint8_t *)&data16, sizeof( data16 ) );
-        cnt_byte += sizeof( data16 );
-        //переход на следующий регистр
-        if ( reg_cnt ) {
-            reg_cnt--;
-            reg_id += 1;
-           }
+ }
+
+//*************************************************************************************************
+// Состояние захвата переходных процессов давления и канал события (MBUS_REG_HAMMER_STAT)
+//*************************************************************************************************
+void MbusGetHammerStat( uint8_t *data ) {
+
+    HammerMbus();
+    memcpy( data, (uint8_t *)&mbus_hammer, sizeof( uint16_t ) );
+ }
+
+//*************************************************************************************************
+// Дата/время события гидроудара, изменение давления (MBUS_REG_HAMMER_DTIME ... MBUS_REG_HAMMER_DELTA)
+//*************************************************************************************************
+void MbusGetHammerInfo( uint8_t *data ) {
+
+    HammerMbus();
+    memcpy( data, (uint8_t *)&mbus_hammer.dtime, sizeof( mbus_hammer ) - sizeof( uint16_t ) );
+ }
+
+//*************************************************************************************************
+// Номер страницы выборок снимка гидроудара (MBUS_REG_HAMMER_PAGE)
+//*************************************************************************************************
+void MbusGetHammerPage( uint8_t *data ) {
+
+    uint16_t data16;
+
+    data16 = mbus_hammer_page;
+    memcpy( data, (uint8_t *)&data16, sizeof( data16 ) );
+ }
+
+//*************************************************************************************************
+// Выборки страницы снимка гидроудара: холодная/горячая вода (MBUS_REG_HAMMER_DATA)
+//*************************************************************************************************
+void MbusGetHammerData( uint8_t *data ) {
+
+    uint8_t idx;
+    uint16_t data16;
+
+    for ( idx = 0; idx < MBUS_HAMMER_PAGE_SIZE; idx++ ) {
+        data16 = HammerValue( WATER_COLD, mbus_hammer_page * MBUS_HAMMER_PAGE_SIZE + idx );
+        memcpy( data, (uint8_t *)&data16, sizeof( data16 ) );
+        data += sizeof( data16 );
+        data16 = HammerValue( WATER_HOT, mbus_hammer_page * MBUS_HAMMER_PAGE_SIZE + idx );
+        memcpy( data, (uint8_t *)&data16, sizeof( data16 ) );
+        data += sizeof( data16 );
        }
-    if ( reg_cnt && reg_id == MBUS_REG_WTR_HOT ) {
-        //данные по горячей воде
-        data32 = curr_data.count_hot;
-        memcpy( data_modbus + cnt_byte, (uint8_t *)&data32, sizeof( data32 ) );
-        cnt_byte += sizeof( data32 );
-        //переход на следующий регистр
-        if ( reg_cnt ) {
-            reg_cnt -= 2;
-            reg_id += 2;
+ }
+
+//*************************************************************************************************
+// Интервал дата/время выборки журнала (MBUS_REG_LOG_FROM ... MBUS_REG_LOG_TO)
+//*************************************************************************************************
+void MbusGetLogRange( uint8_t *data ) {
+
+    memcpy( data, (uint8_t *)&mbus_log_range, sizeof( mbus_log_range ) );
+ }
+
+//*************************************************************************************************
+// Кол-во записей в выборке журнала (MBUS_REG_LOG_CNT)
+//*************************************************************************************************
+void MbusGetLogCnt( uint8_t *data ) {
+
+    memcpy( data, (uint8_t *)&mbus_log_cnt, sizeof( mbus_log_cnt ) );
+ }
+
+//*************************************************************************************************
+// Номер текущей записи выборки журнала (MBUS_REG_LOG_REC)
+//*************************************************************************************************
+void MbusGetLogRec( uint8_t *data ) {
+
+    memcpy( data, (uint8_t *)&mbus_log_rec, sizeof( mbus_log_rec ) );
+ }
+
+//*************************************************************************************************
+// Данные текущей записи выборки журнала, при отсутствии записи - нулевые значения. После чтения
+// выполняется переход к следующей записи выборки (MBUS_REG_LOG_DATA)
+//*************************************************************************************************
+void MbusGetLogData( uint8_t *data ) {
+
+    memset( (uint8_t *)&mbus_log, 0x00, sizeof( mbus_log ) );
+    if ( mbus_log_rec < mbus_log_cnt ) {
+        if ( LogNext( &mbus_log_from, &mbus_log_to, LOG_FIND_ALL, &mbus_log_seq, &wtr_log ) == true ) {
+            mbus_log.dtime.day = wtr_log.day;
+            mbus_log.dtime.month = wtr_log.month;
+            mbus_log.dtime.year = wtr_log.year;
+            mbus_log.dtime.hour = wtr_log.hour;
+            mbus_log.dtime.min = wtr_log.min;
+            mbus_log.count_cold = wtr_log.count_cold;
+            mbus_log.count_hot = wtr_log.count_hot;
+            mbus_log.count_filter = wtr_log.count_filter;
+            mbus_log.pressr_cold = wtr_log.pressr_cold;
+            mbus_log.pressr_hot = wtr_log.pressr_hot;
+            mbus_log.valve_stat.stat_valve_cold = wtr_log.stat_valve_cold;
+            mbus_log.valve_stat.error_valve_cold = wtr_log.error_valve_cold;
+            mbus_log.valve_stat.stat_valve_hot = wtr_log.stat_valve_hot;
+            mbus_log.valve_stat.error_valve_hot = wtr_log.error_valve_hot;
+            mbus_log.type_event = wtr_log.type_event;
+            mbus_log.leak1 = wtr_log.leak1;
+            mbus_log.leak2 = wtr_log.leak2;
+            mbus_log.flow_leak = wtr_log.flow_leak;
+            mbus_log.dc12_chk = wtr_log.dc12_chk;
            }
+        mbus_log_rec++; //переход к следующей записи выборки
        }
-    if ( reg_cnt && reg_id == MBUS_REG_HOT_PRESR ) {
-        //давление горячей воды
-        data16 = pressure_hot;
-        memcpy( data_modbus + cnt_byte, (uint8_t *)&data16, sizeof( data16 ) );
-        cnt_byte += sizeof( data16 );
-        //переход на следующий регистр
-        if ( reg_cnt ) {
-            reg_cnt--;
-            reg_id += 1;
-           }
+    memcpy( data, (uint8_t *)&mbus_log, sizeof( mbus_log ) );
+ }
+
+//*************************************************************************************************
+// Уровень и дата периода выборки итогов расхода (MBUS_REG_ROLL_TYPE ... MBUS_REG_ROLL_YEAR)
+//*************************************************************************************************
+void MbusGetRollType( uint8_t *data ) {
+
+    memcpy( data, (uint8_t *)&mbus_roll, 3 * sizeof( uint16_t ) );
+ }
+
+//*************************************************************************************************
+// Результат выборки итогов расхода (MBUS_REG_ROLL_STAT)
+//*************************************************************************************************
+void MbusGetRollStat( uint8_t *data ) {
+
+    memcpy( data, (uint8_t *)&mbus_roll.stat, sizeof( mbus_roll.stat ) );
+ }
+
+//*************************************************************************************************
+// Итоги расхода за период: расход, мин/макс давление (MBUS_REG_ROLL_DATA)
+//*************************************************************************************************
+void MbusGetRollData( uint8_t *data ) {
+
+    memcpy( data, (uint8_t *)&mbus_roll.volume, sizeof( mbus_roll ) - 4 * sizeof( uint16_t ) );
+ }
+
+//*************************************************************************************************
+// Кол-во завершенных циклов проверки FRAM (MBUS_REG_SCRUB_PASS)
+//*************************************************************************************************
+void MbusGetScrubPass( uint8_t *data ) {
+
+    uint32_t data32;
+
+    data32 = ScrubStatValue( SCRUB_STAT_PASS );
+    memcpy( data, (uint8_t *)&data32, sizeof( data32 ) );
+ }
+
+//*************************************************************************************************
+// Текущее кол-во поврежденных блоков FRAM (MBUS_REG_SCRUB_BAD)
+//*************************************************************************************************
+void MbusGetScrubBad( uint8_t *data ) {
+
+    uint16_t data16;
+
+    data16 = ScrubStatValue( SCRUB_STAT_BAD );
+    memcpy( data, (uint8_t *)&data16, sizeof( data16 ) );
+ }
+
+//*************************************************************************************************
+// Кол-во восстановленных/очищенных блоков FRAM (MBUS_REG_SCRUB_FIXED)
+//*************************************************************************************************
+void MbusGetScrubFixed( uint8_t *data ) {
+
+    uint16_t data16;
+
+    data16 = ScrubStatValue( SCRUB_STAT_REPAIRED ) + ScrubStatValue( SCRUB_STAT_CLEARED );
+    memcpy( data, (uint8_t *)&data16, sizeof( data16 ) );
+ }
+
+//*************************************************************************************************
+// Номер страницы карты поврежденных блоков FRAM (MBUS_REG_SCRUB_PAGE)
+//*************************************************************************************************
+void MbusGetScrubPage( uint8_t *data ) {
+
+    uint16_t data16;
+
+    data16 = mbus_scrub_page;
+    memcpy( data, (uint8_t *)&data16, sizeof( data16 ) );
+ }
+
+//*************************************************************************************************
+// Карта поврежденных блоков FRAM текущей страницы, бит на блок (MBUS_REG_SCRUB_MAP)
+//*************************************************************************************************
+void MbusGetScrubMap( uint8_t *data ) {
+
+    uint8_t idx, bit;
+    uint16_t data16;
+
+    for ( idx = 0; idx < MBUS_SCRUB_PAGE_SIZE / 16; idx++, data += sizeof( data16 ) ) {
+        data16 = 0;
+        for ( bit = 0; bit < 16; bit++ )
+            if ( ScrubBlockBad( mbus_scrub_page * MBUS_SCRUB_PAGE_SIZE + idx * 16 + bit ) == true )
+                data16 |= 1 << bit;
+        memcpy( data, (uint8_t *)&data16, sizeof( data16 ) );
        }
-    if ( reg_cnt && reg_id == MBUS_REG_WTR_FILTER ) {
-        //данные по питьевой воде
-        data32 = curr_data.count_filter;
-        memcpy( data_modbus + cnt_byte, (uint8_t *)&data32, sizeof( data32 ) );
-        cnt_byte += sizeof( data32 );
-        //переход на следующий регистр
-        if ( reg_cnt ) {
-            reg_cnt -= 2;
-            reg_id += 2;
-           }
+ }
+
+//*************************************************************************************************
+// Функции записи значений регистров MODBUS, вызываются из таблицы описания регистров reg_desc[]
+// (modbus_reg.c) для каждого значения запроса записи. Значения регистров проверены на
+// допустимые диапазоны до вызова.
+//-------------------------------------------------------------------------------------------------
+// uint8_t *data    - указатель на значение, размер: кол-во регистров значения * 2 байта
+// return = SUCCESS - значение записано
+//        = ERROR   - ошибка записи значения
+//*************************************************************************************************
+
+//*************************************************************************************************
+// Команды управления электроприводами (MBUS_REG_CTRL)
+//*************************************************************************************************
+ErrorStatus MbusSetCtrl( uint8_t *data ) {
+
+    uint16_t write;
+
+    memcpy( (uint8_t *)&write, data, sizeof( write ) );
+    //проверка на закрытие горячей и холодной воды
+    if ( write == MBUS_CMD_ALL_CLOSE ) {
+        osEventFlagsSet( valve_event, EVN_VALVE_COLD_CLS | EVN_VALVE_HOT_CLS );
+        return SUCCESS; //высокий приоритет, дальше команды не проверяем
        }
-    if ( reg_cnt && reg_id == MBUS_REG_DAYMON ) {
-        //дата время
-        GetTimeDate( &data_rtc );
-        mbus_dtime.day = data_rtc.day;
-        mbus_dtime.month = data_rtc.month;
-        mbus_dtime.year = data_rtc.year;
-        mbus_dtime.hour = data_rtc.hour;
-        mbus_dtime.min = data_rtc.min;
-        memcpy( data_modbus + cnt_byte, (uint8_t *)&mbus_dtime, sizeof( mbus_dtime ) );
-        cnt_byte += sizeof( mbus_dtime );
+    if ( write == MBUS_CMD_ALL_OPEN ) {
+        osEventFlagsSet( valve_event, EVN_VALVE_COLD_OPN | EVN_VALVE_HOT_OPN );
+        return SUCCESS; //высокий приоритет, дальше команды не проверяем
        }
-    *bytes = cnt_byte;
-    return data_modbus;
+    //проверка на взаимоисключающие команды
+    if ( write & MBUS_CMD_COLD_OPEN && write & MBUS_CMD_COLD_CLOSE )
+        return ERROR;
+    if ( write & MBUS_CMD_HOT_OPEN && write & MBUS_CMD_HOT_CLOSE )
+        return ERROR;
+    //выполнение команды
+    if ( write & MBUS_CMD_COLD_OPEN )
+        osEventFlagsSet( valve_event, EVN_VALVE_COLD_OPN );
+    if ( write & MBUS_CMD_COLD_CLOSE )
+        osEventFlagsSet( valve_event, EVN_VALVE_COLD_CLS );
+    if ( write & MBUS_CMD_HOT_OPEN )
+        osEventFlagsSet( valve_event, EVN_VALVE_HOT_OPN );
+    if ( write & MBUS_CMD_HOT_CLOSE )
+        osEventFlagsSet( valve_event, EVN_VALVE_HOT_CLS );
+    return SUCCESS;
+ }
+
+//*************************************************************************************************
+// Установка даты - времени (MBUS_REG_DAYMON ... MBUS_REG_HOURMIN)
+//*************************************************************************************************
+ErrorStatus MbusSetDtime( uint8_t *data ) {
+
+    MBUS_DTIME dtime;
+    DATE_TIME rtc;
+
+    memcpy( (uint8_t *)&dtime, data, sizeof( dtime ) );
+    rtc.day = dtime.day;
+    rtc.month = dtime.month;
+    rtc.year = dtime.year;
+    rtc.hour = dtime.hour;
+    rtc.min = dtime.min;
+    rtc.sec = 0;
+    return SetTimeDate( &rtc );
+ }
+
+//*************************************************************************************************
+// Сброс снимка, повторный запуск захвата переходных процессов давления (MBUS_REG_HAMMER_STAT)
+//*************************************************************************************************
+ErrorStatus MbusSetHammerStat( uint8_t *data ) {
+
+    HammerClear();
+    return SUCCESS;
+ }
+
+//*************************************************************************************************
+// Номер страницы выборок снимка гидроудара (MBUS_REG_HAMMER_PAGE)
+//*************************************************************************************************
+ErrorStatus MbusSetHammerPage( uint8_t *data ) {
+
+    uint16_t page;
+
+    memcpy( (uint8_t *)&page, data, sizeof( page ) );
+    mbus_hammer_page = page;
+    return SUCCESS;
+ }
+
+//*************************************************************************************************
+// Выборка записей журнала за интервал дата/время, номер текущей записи выборки сбрасывается
+// (MBUS_REG_LOG_FROM ... MBUS_REG_LOG_TO)
+//*************************************************************************************************
+ErrorStatus MbusSetLogRange( uint8_t *data ) {
+
+    MBUS_DTIME *range;
+
+    memcpy( (uint8_t *)&mbus_log_range, data, sizeof( mbus_log_range ) );
+    range = mbus_log_range;
+    mbus_log_from.day = range[0].day;
+    mbus_log_from.month = range[0].month;
+    mbus_log_from.year = range[0].year;
+    mbus_log_from.hour = range[0].hour;
+    mbus_log_from.min = range[0].min;
+    mbus_log_from.sec = 0;
+    mbus_log_to.day = range[1].day;
+    mbus_log_to.month = range[1].month;
+    mbus_log_to.year = range[1].year;
+    mbus_log_to.hour = range[1].hour;
+    mbus_log_to.min = range[1].min;
+    mbus_log_to.sec = 59;
+    mbus_log_rec = 0;
+    mbus_log_seq = 0;
+    mbus_log_cnt = LogFind( &mbus_log_from, &mbus_log_to, LOG_FIND_ALL, NULL );
+    return SUCCESS;
+ }
+
+//*************************************************************************************************
+// Установка номера текущей записи выборки журнала, записи выборки перед указанной пропускаются
+// (чтение сегментов журнала) (MBUS_REG_LOG_REC)
+//*************************************************************************************************
+ErrorStatus MbusSetLogRec( uint8_t *data ) {
+
+    uint16_t rec;
+
+    memcpy( (uint8_t *)&rec, data, sizeof( rec ) );
+    mbus_log_rec = 0;
+    mbus_log_seq = 0;
+    mbus_log_skip = rec;
+    if ( rec && rec <= mbus_log_cnt )
+        LogFind( &mbus_log_from, &mbus_log_to, LOG_FIND_ALL, LogSeekRec );
+    else mbus_log_rec = rec;
+    return SUCCESS;
+ }
+
+//*************************************************************************************************
+// Выборка итогов расхода воды по уровню и дате периода (MBUS_REG_ROLL_TYPE ... MBUS_REG_ROLL_YEAR)
+//*************************************************************************************************
+ErrorStatus MbusSetRollType( uint8_t *data ) {
+
+    ROLL_REQ roll_req;
+    ROLLUP rollup;
+
+    memset( (uint8_t *)&mbus_roll, 0x00, sizeof( mbus_roll ) );
+    memcpy( (uint8_t *)&mbus_roll, data, 3 * sizeof( uint16_t ) );
+    roll_req.type = mbus_roll.type;
+    roll_req.date.day = mbus_roll.day;
+    roll_req.date.month = mbus_roll.month;
+    roll_req.date.year = mbus_roll.year;
+    mbus_roll.stat = GetDataRoll( &roll_req, &rollup );
+    memcpy( (uint8_t *)&mbus_roll.volume, (uint8_t *)&rollup.volume, sizeof( mbus_roll.volume ) );
+    memcpy( (uint8_t *)&mbus_roll.pressr_min, (uint8_t *)&rollup.pressr_min, sizeof( mbus_roll.pressr_min ) );
+    memcpy( (uint8_t *)&mbus_roll.pressr_max, (uint8_t *)&rollup.pressr_max, sizeof( mbus_roll.pressr_max ) );
+    return SUCCESS;
+ }
+
+//*************************************************************************************************
+// Номер страницы карты поврежденных блоков FRAM (MBUS_REG_SCRUB_PAGE)
+//*************************************************************************************************
+ErrorStatus MbusSetScrubPage( uint8_t *data ) {
+
+    uint16_t page;
+
+    memcpy( (uint8_t *)&page, data, sizeof( page ) );
+    mbus_scrub_page = page;
+    return SUCCESS;
+ }
+
+//*************************************************************************************************
+// Заполнение структуры MBUS_HAMMER состоянием захвата переходных процессов давления
+//*************************************************************************************************
+static void HammerMbus( void ) {
+
+    HAMMER_INFO hammer;
+
+    mbus_hammer.stat = HammerInfo( &hammer );
+    mbus_hammer.chnl = ( hammer.stat == HAMMER_CAPTURE || hammer.stat == HAMMER_READY ) ? hammer.chnl + 1 : 0;
+    mbus_hammer.dtime.day = hammer.dtime.day;
+    mbus_hammer.dtime.month = hammer.dtime.month;
+    mbus_hammer.dtime.year = hammer.dtime.year;
+    mbus_hammer.dtime.hour = hammer.dtime.hour;
+    mbus_hammer.dtime.min = hammer.dtime.min;
+    mbus_hammer.delta = hammer.delta;
+ }
+
+//*************************************************************************************************
+// Выборка итогов расхода воды за период по запросу MODBUS/CAN/ZigBee
+//-------------------------------------------------------------------------------------------------
+// ROLL_REQ *req   - указатель на запрос: уровень итогов (1 - сутки, 2 - месяц, 3 - год), дата
+// ROLLUP *rollup  - указатель на структуру для размещения итогов, при отсутствии данных
+//                   заполняется нулями
+// return RollStat - результат выборки
+//*************************************************************************************************
+RollStat GetDataRoll( ROLL_REQ *req, ROLLUP *rollup ) {
+
+    DATE_TIME date;
+
+    memset( (uint8_t *)rollup, 0x00, sizeof( ROLLUP ) );
+    if ( !req->type || req->type > ROLL_LEVELS )
+        return ROLL_ERROR_PARAM;
+    memset( (uint8_t *)&date, 0x00, sizeof( date ) );
+    date.day = req->date.day;
+    date.month = req->date.month;
+    date.year = req->date.year;
+    return RollupGet( (RollLevel)( req->type - 1 ), &date, rollup );
+ }
+
+//*************************************************************************************************
+// Пропуск записи выборки журнала, функция обработки записи для LogFind()
+//*************************************************************************************************
+static bool LogSeekRec( uint16_t ref, WATER_LOG *wtr_log ) {
+
+    mbus_log_seq = wtr_log->seq;
+    return ++mbus_log_rec < mbus_log_skip;
  }
 
 //*************************************************************************************************
@@ -311,6 +742,9 @@ uint8_t *GetDataMbus( uint16_t reg_id, uint16_t reg_cnt, uint8_t *bytes ) {
 //*************************************************************************************************
 uint8_t *CreatePack( ZBTypePack type, uint8_t *len, uint16_t addr ) {
 
+    ROLL_REQ roll_req;
+    ROLLUP rollup;
+
     *len = 0;
     if ( type == ZB_PACK_STATE ) {
         //данные состояния контроллера
@@ -346,6 +780,7 @@ uint8_t *CreatePack( ZBTypePack type, uint8_t *len, uint16_t addr ) {
         //состояние датчиков учета
         pack_data.leak1 = LeakStatus( LEAK1 );                              //состояние датчика утечки #1
         pack_data.leak2 = LeakStatus( LEAK2 );                              //состояние датчика утечки #2
+        pack_data.flow_leak = FlowLeakStatus();                             //непрерывный расход (микро-утечка)
         pack_data.reserv = 0;                                               //резерв
         pack_data.type_event = EVENT_DATA;                                  //признак данных: данные/событие
         pack_data.dc12_chk = DC12VStatus();                                 //контроль напряжения 12VDc для питания датчиков утечки
@@ -361,8 +796,7 @@ uint8_t *CreatePack( ZBTypePack type, uint8_t *len, uint16_t addr ) {
        }
     if ( type == ZB_PACK_WLOG && addr != NULL ) {
         //чтение данных из FRAM
-        memset( (uint8_t *)&wtr_log, 0x00, sizeof( wtr_log ) );
-        if ( FramReadData( addr, (uint8_t *)&wtr_log, sizeof( wtr_log ) ) != FRAM_OK )
+        if ( FramReadLog( addr, &wtr_log ) != FRAM_OK )
             return NULL;
         //журнальные данные расхода/давления/утечки воды
         pack_data.type_pack = type;                                         //тип пакета
@@ -384,6 +818,7 @@ uint8_t *CreatePack( ZBTypePack type, uint8_t *len, uint16_t addr ) {
         //состояние датчиков учета
         pack_data.leak1 = wtr_log.leak1;                                    //состояние датчика утечки #1
         pack_data.leak2 = wtr_log.leak2;                                    //состояние датчика утечки #2
+        pack_data.flow_leak = wtr_log.flow_leak;                            //непрерывный расход (микро-утечка)
         pack_data.reserv = 0;                                               //резерв
         pack_data.type_event = wtr_log.type_event;                          //признак данных: данные/событие
         pack_data.dc12_chk = wtr_log.dc12_chk;                              //контроль напряжения 12VDc для питания датчиков утечки
@@ -420,6 +855,7 @@ uint8_t *CreatePack( ZBTypePack type, uint8_t *len, uint16_t addr ) {
         //состояния электроприводов      
         pack_leaks.leak1 = LeakStatus( LEAK1 );                             //состояние датчика утечки #1
         pack_leaks.leak2 = LeakStatus( LEAK2 );                             //состояние датчика утечки #2
+        pack_leaks.flow_leak = FlowLeakStatus();                            //непрерывный расход (микро-утечка)
         pack_leaks.reserv = 0;                                              //резерв
         pack_leaks.dc12_chk = DC12VStatus();                                //контроль напряжения 12VDc для питания датчиков утечки
         //контрольная сумма
@@ -427,6 +863,37 @@ uint8_t *CreatePack( ZBTypePack type, uint8_t *len, uint16_t addr ) {
         *len = sizeof( pack_leaks );
         return (uint8_t *)&pack_leaks;
        }
+    if ( type == ZB_PACK_ROLL ) {
+        //итоги расхода воды за период по последнему запросу ZB_PACK_REQ_ROLL
+        pack_roll.type_pack = type;                                         //тип пакета
+        pack_roll.dev_numb = config.dev_numb;                               //номер уст-ва
+        pack_roll.addr_dev = __REVSH( *((uint16_t *)&zb_cfg.short_addr) );  //адрес уст-ва в сети
+        pack_roll.type = zb_pack_roll.type;                                 //уровень итогов
+        pack_roll.date = zb_pack_roll.date;                                 //дата периода
+        roll_req.type = zb_pack_roll.type;
+        roll_req.date = zb_pack_roll.date;
+        pack_roll.stat = GetDataRoll( &roll_req, &rollup );                 //результат выборки
+        memcpy( (uint8_t *)&pack_roll.volume, (uint8_t *)&rollup.volume, sizeof( pack_roll.volume ) );
+        memcpy( (uint8_t *)&pack_roll.pressr_min, (uint8_t *)&rollup.pressr_min, sizeof( pack_roll.pressr_min ) );
+        memcpy( (uint8_t *)&pack_roll.pressr_max, (uint8_t *)&rollup.pressr_max, sizeof( pack_roll.pressr_max ) );
+        //контрольная сумма
+        pack_roll.crc = CalcCRC16( (uint8_t *)&pack_roll, sizeof( pack_roll ) - sizeof( pack_roll.crc ) );
+        *len = sizeof( pack_roll );
+        return (uint8_t *)&pack_roll;
+       }
+    if ( type == ZB_PACK_FLOW ) {
+        //мгновенный расход воды
+        pack_flow.type_pack = type;                                         //тип пакета
+        pack_flow.dev_numb = config.dev_numb;                               //номер уст-ва
+        pack_flow.addr_dev = __REVSH( *((uint16_t *)&zb_cfg.short_addr) );  //адрес уст-ва в сети
+        pack_flow.flow_cold = flow_rate[COUNT_COLD];                        //мгновенный расход холодной воды
+        pack_flow.flow_hot = flow_rate[COUNT_HOT];                          //мгновенный расход горячей воды
+        pack_flow.flow_filter = flow_rate[COUNT_FILTER];                    //мгновенный расход питьевой воды
+        //контрольная сумма
+        pack_flow.crc = CalcCRC16( (uint8_t *)&pack_flow, sizeof( pack_flow ) - sizeof( pack_flow.crc ) );
+        *len = sizeof( pack_flow );
+        return (uint8_t *)&pack_flow;
+       }
     return NULL;
  }
 
@@ -533,6 +1000,22 @@ ZBTypePack CheckPack( uint8_t *data, uint8_t len ) {
            }
         return type;
        }
+    if ( type == ZB_PACK_REQ_ROLL && len == sizeof( ZB_PACK_REQ_ROLL_DATA ) ) {
+        //запрос итогов расхода воды за период
+        memcpy( (uint8_t *)&zb_pack_roll, data, sizeof( ZB_PACK_REQ_ROLL_DATA ) );
+        //КС считаем без полученной КС и net_addr (gate_addr не входит в подсчет КС)
+        crc = CalcCRC16( (uint8_t *)&zb_pack_roll, sizeof( zb_pack_roll ) - ( sizeof( uint16_t ) * 2 ) );
+        if ( zb_pack_roll.crc != crc ) {
+            ZBIncError( ZB_ERROR_CRC );
+            return ZB_PACK_UNDEF;
+           }
+        if ( zb_pack_roll.dev_numb != config.dev_numb || zb_pack_roll.dev_addr != addr_dev ) {
+            ZBIncError( ZB_ERROR_NUMB );
+            return ZB_PACK_UNDEF;
+           }
+        osEventFlagsSet( zb_ctrl, EVN_ZC_SEND_ROLL );
+        return type;
+       }
     if ( type == ZB_PACK_ACK && len == sizeof( ZB_PACK_ACK_DATA ) ) {
         //пакет подтверждения
         memcpy( (uint8_t *)&ack, data, sizeof( ack ) );
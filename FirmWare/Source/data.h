@@ -10,6 +10,7 @@
 #include "xtime.h"
 #include "valve.h"
 #include "fram.h"
+#include "rollup.h"
 
 //Тип передаваемых данных, CAN шина
 typedef enum {
@@ -18,6 +19,7 @@ typedef enum {
     DATA_HOT,                               //текущие данные по горячей воде
     DATA_FILTER,                            //текущие данные по питьевой воде
     DATA_DATE,                              //текущие данные RTC
+    DATA_FLOW,                              //мгновенный расход воды
     DATA_LOG_COLD,                          //данные из журнала событий за указанную дату по холодной воде
     DATA_LOG_HOT,                           //данные из журнала событий за указанную дату по горячей воде
     DATA_LOG_FILTER                         //данные из журнала событий за указанную дату по питьевой воде
@@ -38,7 +40,12 @@ typedef enum {
     ZB_PACK_REQ_VALVE,                      //состояние электроприводов подачи воды
     ZB_PACK_REQ_DATA,                       //запрос журнальных/текущих данных расхода/давления/утечки воды
     ZB_PACK_CTRL_VALVE,                     //управление электроприводами подачи воды
-    ZB_PACK_ACK                             //подтверждение получение пакета с журнальными данными
+    ZB_PACK_ACK,                            //подтверждение получение пакета с журнальными данными
+    //итоги расхода воды
+    ZB_PACK_REQ_ROLL,                       //запрос итогов расхода за сутки/месяц/год (входящий)
+    ZB_PACK_ROLL,                           //итоги расхода за сутки/месяц/год (исходящий)
+    //мгновенный расход воды
+    ZB_PACK_FLOW                            //мгновенный расход воды (исходящий, после ZB_PACK_DATA)
  } ZBTypePack;
 
 #pragma pack( push, 1 )
@@ -62,10 +69,19 @@ typedef struct {
     VALVE_STAT_ERR  valve_stat;             //состояния электроприводов
     LeakStat        leak1 : 1;              //состояние датчика утечки #1
     LeakStat        leak2 : 1;              //состояние датчика утечки #2
-    unsigned        reserv : 5;             //выравнивание до 1 байта
+    unsigned        flow_leak : 3;          //непрерывный расход (микро-утечка), маска FLOW_LEAK_*
+    unsigned        reserv : 2;             //выравнивание до 1 байта
     DC12VStat       dc12_chk : 1;           //контроль напряжения 12VDc для питания датчиков утечки
  } DATA_LEAK;
 
+//Передача по CAN шине, данные передаются по запросу
+//структура для передачи мгновенного расхода воды (л/мин * 100)
+typedef struct {
+    uint16_t        flow_cold;              //мгновенный расход холодной воды
+    uint16_t        flow_hot;               //мгновенный расход горячей воды
+    uint16_t        flow_filter;            //мгновенный расход питьевой воды
+ } DATA_FLOW_RATE;
+
 //Структура данных для запроса архивных событий
 typedef struct {
     uint8_t         day;                    //день
@@ -73,6 +89,12 @@ typedef struct {
     uint16_t        year;                   //год
 } LOG_REQ;
 
+//Структура данных для запроса итогов расхода воды
+typedef struct {
+    uint8_t         type;                   //уровень итогов: 1 - сутки, 2 - месяц, 3 - год
+    LOG_REQ         date;                   //дата периода
+} ROLL_REQ;
+
 //Структура для передачи по MODBUS значений дата-время внутренних часов
 typedef struct {
     uint8_t         month;                  //месяц
@@ -82,6 +104,43 @@ typedef struct {
     uint8_t         hour;                   //часы
  } MBUS_DTIME;
 
+//Структура для передачи по MODBUS состояния захвата переходных процессов давления
+typedef struct {
+    uint8_t         stat;                   //состояние захвата HammerStat
+    uint8_t         chnl;                   //канал события: 1 - холодная, 2 - горячая вода, 0 - нет
+    MBUS_DTIME      dtime;                  //дата/время события
+    uint16_t        delta;                  //изменение давления в момент события (атм * 100)
+ } MBUS_HAMMER;
+
+//Структура для передачи по MODBUS записи журнала из выборки за интервал дата/время
+typedef struct {
+    MBUS_DTIME      dtime;                  //дата/время записи
+    uint32_t        count_cold;             //значения счетчика холодной воды
+    uint32_t        count_hot;              //значения счетчика горячей воды
+    uint32_t        count_filter;           //значения счетчика питьевой воды
+    uint16_t        pressr_cold;            //давление холодной воды
+    uint16_t        pressr_hot;             //давление горячей воды
+    VALVE_STAT_ERR  valve_stat;             //состояния электроприводов
+    EventType       type_event : 1;         //признак данных: данные/событие
+    LeakStat        leak1 : 1;              //состояние датчика утечки #1
+    LeakStat        leak2 : 1;              //состояние датчика утечки #2
+    unsigned        flow_leak : 3;          //непрерывный расход (микро-утечка), маска FLOW_LEAK_*
+    unsigned        reserv : 1;             //выравнивание до 1 байта
+    DC12VStat       dc12_chk : 1;           //контроль напряжения 12VDc для питания датчиков утечки
+ } MBUS_LOG;
+
+//Структура для передачи по MODBUS итогов расхода воды за период
+typedef struct {
+    uint16_t        type;                   //уровень итогов: 1 - сутки, 2 - месяц, 3 - год
+    uint8_t         month;                  //месяц
+    uint8_t         day;                    //день
+    uint16_t        year;                   //год
+    uint16_t        stat;                   //результат выборки RollStat
+    uint32_t        volume[COUNT_FILTER+1]; //расход холодной/горячей/питьевой воды (литры)
+    uint16_t        pressr_min[WATER_HOT+1]; //мин. давление холодной/горячей воды (атм * 100)
+    uint16_t        pressr_max[WATER_HOT+1]; //макс. давление холодной/горячей воды (атм * 100)
+ } MBUS_ROLL;
+
 //Передача по CAN шине, информация события: расход и давления воды,
 //состояние электропривода, для холодной и горячей воды
 typedef struct {
@@ -101,6 +160,21 @@ typedef struct {
     uint32_t        count;                  //значение расхода воды (литры)
  } DATA_LOG3;
 
+//Передача по CAN шине, итоги расхода воды за период: расход, мин/макс давление,
+//для холодной и горячей воды
+typedef struct {
+    uint32_t        volume;                 //расход воды за период (литры)
+    uint16_t        pressr_min;             //мин. давление воды (атм * 100)
+    uint16_t        pressr_max;             //макс. давление воды (атм * 100)
+ } CAN_ROLL1;
+
+//Передача по CAN шине, итоги расхода воды за период: расход питьевой воды, результат выборки
+typedef struct {
+    uint32_t        volume;                 //расход воды за период (литры)
+    uint8_t         type;                   //уровень итогов: 1 - сутки, 2 - месяц, 3 - год
+    uint8_t         stat;                   //результат выборки RollStat
+ } CAN_ROLL3;
+
 //*************************************************************************************************
 // Исходящие пакеты для радио модуля
 //*************************************************************************************************
@@ -129,13 +203,25 @@ typedef struct {
     uint16_t        pressr_hot;             //давление горячей воды
     LeakStat        leak1 : 1;              //состояние датчика утечки #1
     LeakStat        leak2 : 1;              //состояние датчика утечки #2
-    unsigned        reserv : 4;             //выравнивание до 1 байта
+    unsigned        flow_leak : 3;          //непрерывный расход (микро-утечка), маска FLOW_LEAK_*
+    unsigned        reserv : 1;             //выравнивание до 1 байта
     EventType       type_event : 1;         //признак данных: данные/событие
     DC12VStat       dc12_chk : 1;           //контроль напряжения 12VDc для питания датчиков утечки
     VALVE_STAT_ERR  valve_stat;             //состояния электроприводов
     uint16_t        crc;                    //контрольная сумма
  } PACK_DATA;
 
+//Мгновенный расход воды
+typedef struct {
+    ZBTypePack      type_pack;              //тип пакета
+    uint16_t        dev_numb;               //номер уст-ва в сети
+    uint16_t        addr_dev;               //адрес уст-ва в сети
+    uint16_t        flow_cold;              //мгновенный расход холодной воды (л/мин * 100)
+    uint16_t        flow_hot;               //мгновенный расход горячей воды (л/мин * 100)
+    uint16_t        flow_filter;            //мгновенный расход питьевой воды (л/мин * 100)
+    uint16_t        crc;                    //контрольная сумма
+ } PACK_FLOW;
+
 //Состояния электроприводов
 typedef struct {
     ZBTypePack      type_pack;              //тип пакета
@@ -152,11 +238,26 @@ typedef struct {
     uint16_t        addr_dev;               //адрес уст-ва в сети
     LeakStat        leak1 : 1;              //состояние датчика утечки #1
     LeakStat        leak2 : 1;              //состояние датчика утечки #2
-    unsigned        reserv : 5;             //выравнивание до 1 байта
+    unsigned        flow_leak : 3;          //непрерывный расход (микро-утечка), маска FLOW_LEAK_*
+    unsigned        reserv : 2;             //выравнивание до 1 байта
     DC12VStat       dc12_chk : 1;           //контроль напряжения 12VDc для питания датчиков утечки
     uint16_t        crc;                    //контрольная сумма
  } PACK_LEAKS;
 
+//Итоги расхода воды за сутки/месяц/год
+typedef struct {
+    ZBTypePack      type_pack;              //тип пакета
+    uint16_t        dev_numb;               //номер уст-ва в сети
+    uint16_t        addr_dev;               //адрес уст-ва в сети
+    uint8_t         type;                   //уровень итогов: 1 - сутки, 2 - месяц, 3 - год
+    LOG_REQ         date;                   //дата периода
+    uint8_t         stat;                   //результат выборки RollStat
+    uint32_t        volume[COUNT_FILTER+1]; //расход холодной/горячей/питьевой воды (литры)
+    uint16_t        pressr_min[WATER_HOT+1]; //мин. давление холодной/горячей воды (атм * 100)
+    uint16_t        pressr_max[WATER_HOT+1]; //макс. давление холодной/горячей воды (атм * 100)
+    uint16_t        crc;                    //контрольная сумма
+ } PACK_ROLL;
+
 //*************************************************************************************************
 // Входящие пакеты от радио модуля
 // для корректного значения net_addr необходимо выполнить перестановку байт: __REVSH( net_addr )
@@ -190,6 +291,17 @@ typedef struct {
     uint16_t        gate_addr;              //адрес отправителя
  } ZB_PACK_CTRL;
 
+//Запрос итогов расхода воды за сутки/месяц/год
+typedef struct {
+    ZBTypePack      type_pack;              //тип пакета
+    uint16_t        dev_numb;               //номер уст-ва в сети
+    uint16_t        dev_addr;               //адрес уст-ва в сети
+    uint8_t         type;                   //уровень итогов: 1 - сутки, 2 - месяц, 3 - год
+    LOG_REQ         date;                   //дата периода
+    uint16_t        crc;                    //контрольная сумма
+    uint16_t        gate_addr;              //адрес отправителя
+ } ZB_PACK_REQ_ROLL_DATA;
+
 //Подтверждение получение данных PACK_DATA 
 typedef struct {
     ZBTypePack      type_pack;              //тип пакета
@@ -206,11 +318,48 @@ typedef struct {
 //*************************************************************************************************
 uint8_t *GetDataCan1( uint8_t *size );
 uint8_t *GetDataCan2( DataType type, uint8_t *size );
-uint8_t *GetDataMbus( uint16_t reg_id, uint16_t reg_cnt, uint8_t *bytes );
 uint8_t *GetDataLog( DataType type, WATER_LOG *wtr_log, uint8_t *size );
+RollStat GetDataRoll( ROLL_REQ *req, ROLLUP *rollup );
 
 DATE_TIME *GetAddrDtime( void );
 uint8_t *CreatePack( ZBTypePack type, uint8_t *len, uint16_t addr );
 ZBTypePack CheckPack( uint8_t *data, uint8_t len );
 
+//*************************************************************************************************
+// Функции чтения/записи значений регистров MODBUS (таблица reg_desc[] в modbus_reg.c)
+//*************************************************************************************************
+void MbusGetCtrl( uint8_t *data );
+void MbusGetCold( uint8_t *data );
+void MbusGetColdPressr( uint8_t *data );
+void MbusGetHot( uint8_t *data );
+void MbusGetHotPressr( uint8_t *data );
+void MbusGetFilter( uint8_t *data );
+void MbusGetDtime( uint8_t *data );
+void MbusGetFlow( uint8_t *data );
+void MbusGetHammerStat( uint8_t *data );
+void MbusGetHammerInfo( uint8_t *data );
+void MbusGetHammerPage( uint8_t *data );
+void MbusGetHammerData( uint8_t *data );
+void MbusGetLogRange( uint8_t *data );
+void MbusGetLogCnt( uint8_t *data );
+void MbusGetLogRec( uint8_t *data );
+void MbusGetLogData( uint8_t *data );
+void MbusGetRollType( uint8_t *data );
+void MbusGetRollStat( uint8_t *data );
+void MbusGetRollData( uint8_t *data );
+void MbusGetScrubPass( uint8_t *data );
+void MbusGetScrubBad( uint8_t *data );
+void MbusGetScrubFixed( uint8_t *data );
+void MbusGetScrubPage( uint8_t *data );
+void MbusGetScrubMap( uint8_t *data );
+
+ErrorStatus MbusSetCtrl( uint8_t *data );
+ErrorStatus MbusSetDtime( uint8_t *data );
+ErrorStatus MbusSetHammerStat( uint8_t *data );
+ErrorStatus MbusSetHammerPage( uint8_t *data );
+ErrorStatus MbusSetLogRange( uint8_t *data );
+ErrorStatus MbusSetLogRec( uint8_t *data );
+ErrorStatus MbusSetRollType( uint8_t *data );
+ErrorStatus MbusSetScrubPage( uint8_t *data );
+
 #endif 
@@ -13,6 +13,7 @@
 #include "uart.h"
 #include "events.h"
 #include "xtime.h"
+#include "water.h"
 #include "zigbee.h"
 #include "rs485.h"
 
@@ -20,7 +21,6 @@
 // Внешние переменные
 //*************************************************************************************************
 extern IWDG_HandleTypeDef hiwdg;
-extern ADC_HandleTypeDef hadc1;
 extern DMA_HandleTypeDef hdma_i2c1_tx;
 extern UART_HandleTypeDef huart1, huart2, huart3;
 
@@ -44,11 +44,11 @@ void HAL_GPIO_EXTI_Callback( uint16_t pin ) {
        }
     //прерывания от счетчиков расхода воды
     if ( pin == COUNT_COLD_Pin ) 
-        osEventFlagsSet( water_event, EVN_WTR_CNT_COLD );
+        WaterPulse( COUNT_COLD );
     if ( pin == COUNT_HOT_Pin ) 
-        osEventFlagsSet( water_event, EVN_WTR_CNT_HOT );
+        WaterPulse( COUNT_HOT );
     if ( pin == COUNT_FILTER_Pin ) 
-        osEventFlagsSet( water_event, EVN_WTR_CNT_FILTER );
+        WaterPulse( COUNT_FILTER );
  }
 
 //*************************************************************************************************
@@ -60,8 +60,6 @@ void HAL_UART_RxCpltCallback( UART_HandleTypeDef *huart ) {
         UartRecvComplt();
     if ( huart == &huart2 )
         ZBRecvComplt();
-    if ( huart == &huart3 )
-        RS485RecvComplt();
 }
 
 //*************************************************************************************************
@@ -78,14 +76,39 @@ void HAL_UART_TxCpltCallback( UART_HandleTypeDef *huart ) {
  }
 
 //*************************************************************************************************
-// CallBack функция, вызывается при завершении преобразования в АЦП по обоим каналам
+// CallBack функция, вызывается при ошибке приема/передачи UART
 //*************************************************************************************************
-void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc) {
+void HAL_UART_ErrorCallback( UART_HandleTypeDef *huart ) {
 
-    if( hadc->Instance == ADC1 ) {
-        HAL_ADC_Stop_DMA( &hadc1 );
-        osEventFlagsSet( water_event, EVN_WTR_PRESSURE_END );
-       }
+    if ( huart == &huart3 )
+        RS485RecvError();
+ }
+
+//*************************************************************************************************
+// CallBack функция, вызывается при заполнении первой половины буфера DMA АЦП
+//*************************************************************************************************
+void HAL_ADC_ConvHalfCpltCallback( ADC_HandleTypeDef* hadc ) {
+
+    if( hadc->Instance == ADC1 )
+        WaterAdcComplt( 0 );
+ }
+
+//*************************************************************************************************
+// CallBack функция, вызывается при заполнении второй половины буфера DMA АЦП
+//*************************************************************************************************
+void HAL_ADC_ConvCpltCallback( ADC_HandleTypeDef* hadc ) {
+
+    if( hadc->Instance == ADC1 )
+        WaterAdcComplt( 1 );
+ }
+
+//*************************************************************************************************
+// CallBack функция, вызывается при выходе значения АЦП за пороги аналогового сторожевого таймера
+//*************************************************************************************************
+void HAL_ADC_LevelOutOfWindowCallback( ADC_HandleTypeDef* hadc ) {
+
+    if( hadc->Instance == ADC1 )
+        WaterAdcAlarm();
  }
 
 //*************************************************************************************************
@@ -93,16 +116,21 @@ void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc) {
 //*************************************************************************************************
 void HAL_RTCEx_RTCEventCallback( RTC_HandleTypeDef *hrtc ) {
 
-    DATE_TIME date_time;
-    
-    GetTimeDate( &date_time );
-    //отправка события "запись в журнал суточных данных"
-    osEventFlagsSet( water_event, EVN_WTR_LOG );
+    //секундный интервал для расчета расхода и контроля кэширования текущих данных
+    osEventFlagsSet( water_event, EVN_WTR_SECOND );
     //отправка состояние контроллера координатору сети каждую минуту
-    if ( !date_time.sec /*&& date_time.min % 2 == 0*/ )
+    if ( !( GetTimeSec() % 60 ) )
         osEventFlagsSet( zb_ctrl, EVN_ZC_IM_HERE );
  }
 
+//*************************************************************************************************
+// CallBack функция, прерывание от будильника RTC: время записи интервальных данных в журнал
+//*************************************************************************************************
+void HAL_RTC_AlarmAEventCallback( RTC_HandleTypeDef *hrtc ) {
+
+    osEventFlagsSet( water_event, EVN_WTR_LOG );
+ }
+
 //*************************************************************************************************
 // CallBack функция, простой планировщика
 //*************************************************************************************************
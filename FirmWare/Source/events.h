@@ -9,7 +9,7 @@
 //*************************************************************************************************
 extern osMessageQueueId_t recv_can, send_can;
 extern osEventFlagsId_t led_event, valve_event, water_event, cmnd_event;
-extern osEventFlagsId_t uart_event, fram_event, zb_flow, zb_ctrl;
+extern osEventFlagsId_t uart_event, fram_event, zb_flow, zb_ctrl, store_event;
 
 //*************************************************************************************************
 // Флаги событий при обмене данными по UART
@@ -39,18 +39,36 @@ extern osEventFlagsId_t uart_event, fram_event, zb_flow, zb_ctrl;
 #define EVN_WTR_LEAK1               0x00000010  //датчик утечки воды #1
 #define EVN_WTR_LEAK2               0x00000020  //датчик утечки воды #2
 
-#define EVN_WTR_LOG                 0x00000100  //сохранение суточных данных
+#define EVN_WTR_SECOND              0x00000100  //секундный интервал: расчет расхода, кэширование
 
-#define EVN_WTR_PRESSURE_START      0x00000200  //запуск измерения давления воды
-#define EVN_WTR_PRESSURE_END        0x00000400  //измерение давление воды завершено
+#define EVN_WTR_PRESSURE            0x00000200  //обновление значений давления воды
+
+#define EVN_WTR_LOG                 0x00000400  //наступило время записи интервальных данных в журнал
+#define EVN_WTR_SCHED               0x00000800  //пересчет времени следующей записи в журнал
 
 #define EVN_WTR_VALUE               0x00001000  //вывод результата чтения данных из FRAM при включении
 
 #define EVN_WTR_DATA                0x00002000  //передача текущих данных по расходу воды
 
+#define EVN_WTR_PRESS_ALARM         0x00004000  //выход давления за пороги, сторожевой таймер АЦП
+
+#define EVN_WTR_FLUSH_OK            0x00008000  //текущие значения счетчиков записаны в FRAM
+#define EVN_WTR_FLUSH_ERR           0x00010000  //ошибка записи текущих значений счетчиков в FRAM
+
+#define EVN_WTR_RESET               0x00020000  //перезапуск контроллера после записи текущих значений
+
 #define EVN_WTR_MASK                ( EVN_WTR_CNT_COLD | EVN_WTR_CNT_HOT | EVN_WTR_CNT_FILTER | \
-                                    EVN_WTR_LEAK1 | EVN_WTR_LEAK2 | EVN_WTR_LOG | EVN_WTR_VALUE |\
-                                    EVN_WTR_PRESSURE_START | EVN_WTR_PRESSURE_END | EVN_WTR_DATA )
+                                    EVN_WTR_LEAK1 | EVN_WTR_LEAK2 | EVN_WTR_SECOND | EVN_WTR_VALUE |\
+                                    EVN_WTR_PRESSURE | EVN_WTR_LOG | EVN_WTR_SCHED | EVN_WTR_DATA |\
+                                    EVN_WTR_PRESS_ALARM | EVN_WTR_FLUSH_OK | EVN_WTR_FLUSH_ERR |\
+                                    EVN_WTR_RESET )
+
+//*************************************************************************************************
+// Флаги событий очереди записи в FRAM
+//*************************************************************************************************
+#define EVN_STORE_REQ               0x00000001  //в очередь добавлен запрос записи
+
+#define EVN_STORE_MASK              ( EVN_STORE_REQ )
 
 //*************************************************************************************************
 // Флаги событий управления индикацией состояния электроприводов
@@ -130,10 +148,12 @@ extern osEventFlagsId_t uart_event, fram_event, zb_flow, zb_ctrl;
 
 #define EVN_ZC_SYNC_DTIME           0x00000200  //синхронизация даты/времени
 #define EVN_ZC_IM_HERE              0x00000400  //отправка состояние контроллера координатору
+#define EVN_ZC_SEND_ROLL            0x00000800  //передача итогов расхода воды за период
 
 #define EVN_ZC_MASK                 ( EVN_ZC_CONFIG_CHECK | EVN_ZC_NET_LOST | EVN_ZC_NET_RESTORE | \
                                     EVN_ZC_SEND_VALVE | EVN_ZC_SEND_STATE | EVN_ZC_SEND_DATA | \
-                                    EVN_ZC_SEND_WLOG | EVN_ZC_SYNC_DTIME | EVN_ZC_SEND_LEAKS | EVN_ZC_IM_HERE )
+                                    EVN_ZC_SEND_WLOG | EVN_ZC_SYNC_DTIME | EVN_ZC_SEND_LEAKS | EVN_ZC_IM_HERE | \
+                                    EVN_ZC_SEND_ROLL )
 
 #define EVN_ZB_RECV_CHECK           0x00000001  //прием пакета завершен
 
@@ -144,6 +164,8 @@ extern osEventFlagsId_t uart_event, fram_event, zb_flow, zb_ctrl;
 //*************************************************************************************************
 #define EVN_MODBUS_START            0x00001000  //запуск приема
 #define EVN_MODBUS_RECV             0x00002000  //принят фрейм данных
+#define EVN_MODBUS_SENT             0x00004000  //передача ответа завершена, ожидается отдельно
+                                                //после запуска передачи, в маску не входит
 
 #define EVN_MODBUS_MASK             ( EVN_MODBUS_START | EVN_MODBUS_RECV )
 
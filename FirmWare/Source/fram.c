@@ -14,6 +14,9 @@
 #include "cmsis_os2.h"
 
 #include "fram.h"
+#include "sort.h"
+#include "logpack.h"
+#include "i2cbus.h"
 #include "crc16.h"
 #include "uart.h"
 #include "message.h"
@@ -31,33 +34,16 @@
 #define FRAM_TIMEOUT            100             //время ожидания выполнения операции чтения/записи
                                                 //в FRAM без использования DMA-IT
 
-//Индексы ошибок обмена данными по I2C
-typedef enum {
-    ERROR_I2C_OK,
-    ERROR_I2C_BERR,
-    ERROR_I2C_ARLO,
-    ERROR_I2C_AF,
-    ERROR_I2C_OVR,
-    ERROR_I2C_DMA_TRANFER,
-    ERROR_I2C_TIMEOUT,
-    ERROR_I2C_SIZE,
-    ERROR_I2C_DMA_PARAM,
-    ERROR_I2C_START
- } ERROR_I2C;
-
-//Расшифровка ошибок функций обмена данными по I2C
-static char * const error_dma[] = {
-    "OK",
-    "BERR error ",
-    "ARLO error ",
-    "AF error ",
-    "OVR error ",
-    "DMA transfer error ",
-    "Timeout Error ",
-    "Size Management error ",
-    "DMA Parameter Error ",
-    "Wrong start Error "
- };
+//Заголовок блока сегмента журнала: признак формата + номер блока в сегменте, кол-во записей
+#define LOG_BLK_MAGIC           0xA0            //признак блока журнала (старшие 4 бита)
+#define LOG_BLK_HDR             2               //размер заголовка блока
+
+//Журнал старого формата: одна запись WATER_LOG в блоке, кольцо блоков от FRAM_ADDR_LOG до 2 кбайт
+#define LOG_LEGACY_BLOCKS       ( ( FRAM_SIZE_MIN - FRAM_ADDR_LOG ) / FRAM_BLOCK_SIZE )
+
+//Адрес проверки повторения адресов FRAM: последний байт 2 кбайт - область журнала (для 2 кбайт
+//не используется сегментами), не текущие параметры, которые еще не проверены при определении размера
+#define FRAM_PROBE_ADDR         ( FRAM_SIZE_MIN - 1 )
 
 //Расшифровка ошибок при вызове функций чтения/записи по I2C
 static char * const error_fram[] = {
@@ -88,7 +74,6 @@ osEventFlagsId_t fram_event = NULL;
 static FramStatus fram_error_rd, fram_error_wr;
 static char buffer1[160], buffer2[32];
 static osMutexId_t fram_mutex = NULL;
-static osSemaphoreId_t sem_save = NULL, sem_read = NULL;
 
 #pragma pack( push, 1 )
 
@@ -102,44 +87,99 @@ typedef struct {
 
 static FRAM_DATA fram_read, fram_save;     //буфер хранения одного блока данных FRAM
 
-static const osSemaphoreAttr_t sem_attr = { .name = "FramSem" };
-static const osMutexAttr_t mutex_attr = { .name = "FramMut", .attr_bits = osMutexPrioInherit };
+//размер FRAM памяти и размещение журнала определяются при включении
+static uint32_t fram_size;                  //общий размер FRAM памяти (байт)
+static uint32_t fram_dev_size;              //размер одной микросхемы FRAM (байт)
+static uint8_t fram_devices;                //кол-во микросхем FRAM на шине
+static uint8_t fram_dev_shift;              //сдвиг номера микросхемы в адресе микросхемы
+static uint8_t log_segments;                //кол-во сегментов журнала
+static uint32_t roll_addr;                  //адрес области итогов расхода, "0" - область не выделена
+
+//текущие параметры хранятся в двух чередующихся блоках, запись всегда выполняется
+//в блок, не содержащий последнюю достоверную копию данных
+static uint8_t data_slot;                   //номер блока для следующей записи текущих параметров
+static uint16_t data_seq;                   //порядковый номер последней записи текущих параметров
+//при ошибке чтения блоков при включении запись текущих параметров запрещена до успешного
+//повторного чтения, последняя достоверная копия в FRAM не перезаписывается
+static bool data_hold;
+
+//записи журнала нумеруются по возрастанию, порядок записей не зависит от даты/времени RTC
+static uint32_t log_seq;                    //порядковый номер последней записи журнала
+//записи добавляются в последний блок текущего сегмента журнала, состояние сегмента
+//восстанавливается из FRAM перед первой записью после включения
+static bool log_open;                       //состояние текущего сегмента восстановлено
+static uint8_t log_seg;                     //номер текущего сегмента
+static uint8_t log_blk;                     //номер текущего блока в сегменте
+static uint8_t log_pos;                     //кол-во занятых байт в текущем блоке
+static uint8_t log_slot;                    //кол-во записей в сегменте, "0" - следующая 
+                                            //запись начинает новый сегмент
+static LOG_PACK log_last;                   //последняя запись сегмента (база разностной записи)
+static FRAM_DATA log_data;                  //текущий блок сегмента
+
+//мьютекс рекурсивный: LogSave() восстанавливает сегмент журнала чтением FramReadBlocks()
+//при установленной блокировке
+static const osMutexAttr_t mutex_attr = { .name = "FramMut", .attr_bits = osMutexRecursive | osMutexPrioInherit };
  
 //*************************************************************************************************
 // Прототипы локальные функций
 //*************************************************************************************************
-static FramStatus FRAMSave( uint16_t mem_addr, uint8_t *ptr_data, uint16_t len );
-static FramStatus FRAMRead( uint16_t mem_addr, uint8_t *ptr_data, uint16_t len );
+static FramStatus FRAMSave( uint32_t mem_addr, uint8_t *ptr_data, uint16_t len );
+static FramStatus FRAMRead( uint32_t mem_addr, uint8_t *ptr_data, uint16_t len );
+static uint16_t FramDevAddr( uint32_t mem_addr, uint16_t *dev_mem, uint32_t *span );
+static void FramProbe( void );
+static bool FramAlias( uint32_t size );
+static int8_t DataSlotSelect( FRAM_DATA *slot );
+static void DataSlotInit( FRAM_DATA *slots, int8_t slot, CURR_DATA *data );
+static uint32_t LogSeqRead( uint8_t seg );
+static void LogHeadFind( void );
+static void LogMigrate( void );
+static uint8_t LogMigrateRun( uint8_t head, uint8_t skip, uint64_t ring, uint8_t *size, uint32_t seq, bool save );
+static bool LogMigrateBlk( uint8_t head, uint8_t pos, uint64_t ring, uint8_t seg, uint8_t blk, FRAM_DATA *data, bool save );
+static FramStatus LogLegacyRead( uint8_t blk, LOG_PACK *rec );
+static FramStatus LogOpen( void );
+static FramStatus LogSave( WATER_LOG *wtr_log );
+static bool LogCopy( uint16_t ref, WATER_LOG *wtr_log, void *arg );
 
 //*************************************************************************************************
 // Инициализация объектов RTOS, чтение текущих параметров
+// Чтение повторяется по правилам I2CTransfer() (I2C_RETRY_MAX повторов с удвоением паузы и 
+// восстановлением шины), планировщик еще не запущен - чтение и паузы без IT/DMA. Если блоки 
+// прочитать не удалось, текущие параметры в FRAM не записываются до успешного повторного 
+// чтения (FramDataRecover()), счетчики в RAM начинаются с "0".
 //*************************************************************************************************
 void FramInit( void ) {
 
-    uint16_t crc;
+    int8_t slot = -1;
+    uint8_t retry;
     DATE_TIME dtime;
+    FRAM_DATA data_slots[FRAM_DATA_SLOTS];
     
-    //семафор ожидания завершения цикла DMA
-    sem_read = osSemaphoreNew( 1, 0, &sem_attr );
-    sem_save = osSemaphoreNew( 1, 0, &sem_attr );
+    //обмен по шине I2C, восстановление шины при удержании SDA
+    I2CBusInit();
     //мьютекс блокировки работы с FRAM
     fram_mutex = osMutexNew( &mutex_attr );
-    //читаем блок из FRAM без IT/DMA
-    fram_error_rd = (FramStatus)HAL_I2C_Mem_Read( &hi2c1, FRAM_ID_ADDR, FRAM_ADDR_DATA, I2C_MEMADD_SIZE_16BIT, (uint8_t *)&fram_read, sizeof( fram_read ), FRAM_TIMEOUT );
-    if ( fram_error_rd != FRAM_OK )
-        memset( (uint8_t *)&curr_data, 0x00, sizeof( curr_data ) ); //ошибка чтения данных
-    else {
-        //проверка CRC прочитанного блока
-        crc = CalcCRC16( (uint8_t *)&fram_read, sizeof( fram_read.data ) );
-        if ( crc != fram_read.crc ) {
-            //КС не совпала, сформируем блок с нулевыми данными
-            fram_error_rd = FRAM_ERROR_CRC;
-            memset( (uint8_t *)&curr_data, 0x00, sizeof( curr_data ) );
-            curr_data.next_addr = FRAM_ADDR_LOG;
-           }
+    //определение размера FRAM памяти, размещение журнала
+    FramProbe();
+    //читаем оба блока текущих параметров одной операцией без IT/DMA, ошибка КС в обоих блоках 
+    //подтверждается повторным чтением
+    for ( retry = 0; ; retry++ ) {
+        memset( (uint8_t *)&data_slots, 0x00, sizeof( data_slots ) );
+        fram_error_rd = (FramStatus)HAL_I2C_Mem_Read( &hi2c1, FRAM_ID_ADDR, FRAM_ADDR_DATA, I2C_MEMADD_SIZE_16BIT, (uint8_t *)&data_slots, sizeof( data_slots ), FRAM_TIMEOUT );
+        if ( fram_error_rd == FRAM_OK )
+            slot = DataSlotSelect( data_slots );
+        if ( ( fram_error_rd == FRAM_OK && slot >= 0 ) || retry >= I2C_RETRY_MAX )
+            break;
+        if ( fram_error_rd != FRAM_OK )
+            I2CBusClear();
+        I2CDelay( ( I2C_BACKOFF << retry ) * 1000 );
        }
-    if ( fram_error_rd == FRAM_OK )
-        memcpy( (uint8_t *)&curr_data, (uint8_t *)&fram_read, sizeof( curr_data ) ); //прочитанный блок сохраним в WATER
+    data_hold = ( fram_error_rd != FRAM_OK );
+    DataSlotInit( data_slots, slot, &curr_data );
+    //поиск последней записи журнала по порядковым номерам
+    LogHeadFind();
+    //журнал без сегментов - однократный перенос записей старого формата в сегменты
+    if ( !log_seq && data_hold == false )
+        LogMigrate();
     //обновим источник сброса и дата/время включения контроллера
     GetTimeDate( &dtime );
     curr_data.res_src = ResetSrc(); //источник сброса
@@ -149,13 +189,358 @@ void FramInit( void ) {
     curr_data.hour = dtime.hour;    //часы
     curr_data.min = dtime.min;      //минуты
     curr_data.sec = dtime.sec;      //секунды
+    if ( data_hold == true )
+        return; //оба блока в FRAM остаются без изменений
+    curr_data.seq = ++data_seq;     //порядковый номер записи
     //сохраним блок с новыми данными в FRAM
     memset( (uint8_t *)&fram_save, 0x00, sizeof( fram_save ) );
     memcpy( (uint8_t *)&fram_save, (uint8_t *)&curr_data, sizeof( curr_data ) );
     fram_save.crc = CalcCRC16( (uint8_t *)&fram_save, sizeof( fram_save.data ) );
-    fram_error_wr = (FramStatus)HAL_I2C_Mem_Write( &hi2c1, FRAM_ID_ADDR, FRAM_ADDR_DATA, I2C_MEMADD_SIZE_16BIT, (uint8_t *)&fram_save, sizeof( fram_save ), FRAM_TIMEOUT );
+    fram_error_wr = (FramStatus)HAL_I2C_Mem_Write( &hi2c1, FRAM_ID_ADDR, FRAM_ADDR_DATA + data_slot * FRAM_BLOCK_SIZE, I2C_MEMADD_SIZE_16BIT, (uint8_t *)&fram_save, sizeof( fram_save ), FRAM_TIMEOUT );
+    if ( fram_error_wr == FRAM_OK )
+        data_slot ^= 1;
+ }
+
+//*************************************************************************************************
+// Загрузка текущих параметров из прочитанного блока, выбор блока для следующей записи
+//-------------------------------------------------------------------------------------------------
+// FRAM_DATA *slots - указатель на массив прочитанных блоков текущих параметров
+// int8_t slot      - номер актуального блока, < 0 - нет блока с правильной КС или ошибка чтения
+// CURR_DATA *data  - указатель для размещения текущих параметров
+//*************************************************************************************************
+static void DataSlotInit( FRAM_DATA *slots, int8_t slot, CURR_DATA *data ) {
+
+    if ( slot < 0 ) {
+        //КС не совпала в обоих блоках или ошибка чтения, данные с нулевыми значениями
+        if ( fram_error_rd == FRAM_OK )
+            fram_error_rd = FRAM_ERROR_CRC;
+        memset( (uint8_t *)data, 0x00, sizeof( CURR_DATA ) );
+        data->next_addr = FRAM_ADDR_LOG;
+       }
+    else {
+        memcpy( (uint8_t *)data, (uint8_t *)&slots[slot], sizeof( CURR_DATA ) ); //прочитанный блок
+        if ( data->next_addr < FRAM_ADDR_LOG )
+            data->next_addr = FRAM_ADDR_LOG; //адрес из области текущих параметров
+       }
+    //следующая запись выполняется в блок, не содержащий актуальные данные
+    data_seq = data->seq;
+    data_slot = ( slot == 0 ? 1 : 0 );
+ }
+
+//*************************************************************************************************
+// Выбор блока текущих параметров с правильной КС и последним порядковым номером записи
+//-------------------------------------------------------------------------------------------------
+// FRAM_DATA *slot - указатель на массив прочитанных блоков текущих параметров
+// return >= 0     - номер актуального блока
+//        < 0      - нет ни одного блока с правильной КС
+//*************************************************************************************************
+static int8_t DataSlotSelect( FRAM_DATA *slot ) {
+
+    uint8_t i;
+    int8_t last = -1;
+    uint16_t next_addr;
+    bool valid[FRAM_DATA_SLOTS];
+    
+    for ( i = 0; i < FRAM_DATA_SLOTS; i++ ) {
+        //кроме КС проверяется адрес следующей записи журнала, что исключает выбор блока
+        //журнала, размещенного по адресу второго блока до перехода на два блока
+        next_addr = ((CURR_DATA *)slot[i].data)->next_addr;
+        valid[i] = ( CalcCRC16( (uint8_t *)&slot[i], sizeof( slot[i].data ) ) == slot[i].crc ) && 
+                   next_addr >= FRAM_BLOCK_SIZE && next_addr < fram_size && !( next_addr % FRAM_BLOCK_SIZE );
+       }
+    if ( valid[0] == true && valid[1] == true ) {
+        //оба блока достоверны, сравнение номеров с учетом переполнения счетчика
+        if ( (int16_t)( ((CURR_DATA *)slot[1].data)->seq - ((CURR_DATA *)slot[0].data)->seq ) > 0 )
+            last = 1;
+        else last = 0;
+       }
+    else {
+        if ( valid[0] == true )
+            last = 0;
+        if ( valid[1] == true )
+            last = 1;
+       }
+    return last;
  }
  
+//*************************************************************************************************
+// Поиск последнего сегмента журнала при включении: номера опорных записей возрастают от первого
+// сегмента журнала до последнего записанного, далее - сегменты предыдущего цикла с меньшими
+// номерами или пустые сегменты. Граница находится бинарным поиском (не более 5 чтений). Если
+// первый сегмент не содержит опорной записи выполняется чтение всех сегментов журнала.
+// При найденном сегменте обновляется адрес записи журнала curr_data.next_addr.
+//*************************************************************************************************
+static void LogHeadFind( void ) {
+
+    uint8_t lo, hi, mid, head = 0;
+    uint32_t first, seq;
+
+    log_seq = 0;
+    first = LogSeqRead( 0 );
+    if ( first ) {
+        //бинарный поиск последнего сегмента с номером не меньше номера первого сегмента
+        lo = 0;
+        hi = log_segments - 1;
+        log_seq = first;
+        while ( lo < hi ) {
+            mid = ( lo + hi + 1 ) / 2;
+            seq = LogSeqRead( mid );
+            if ( seq >= first ) {
+                lo = mid;
+                log_seq = seq;
+               }
+            else hi = mid - 1;
+           }
+        head = lo;
+       }
+    else {
+        //поиск максимального номера по всем сегментам
+        for ( mid = 1; mid < log_segments; mid++ ) {
+            seq = LogSeqRead( mid );
+            if ( seq > log_seq ) {
+                log_seq = seq;
+                head = mid;
+               }
+           }
+       }
+    //записи сегмента восстанавливаются перед первой записью в журнал
+    log_open = false;
+    log_seg = head;
+    if ( log_seq )
+        curr_data.next_addr = FRAM_ADDR_LOG + head * LOG_SEG_SIZE;
+ }
+
+//*************************************************************************************************
+// Чтение номера опорной записи сегмента журнала без IT/DMA (только в режиме инициализации)
+//-------------------------------------------------------------------------------------------------
+// uint8_t seg - номер сегмента журнала
+// return      - порядковый номер опорной записи, "0" - нет записи, ошибка чтения или КС
+//*************************************************************************************************
+static uint32_t LogSeqRead( uint8_t seg ) {
+
+    uint32_t span;
+    FRAM_DATA data;
+    uint16_t dev_addr, dev_mem;
+
+    dev_addr = FramDevAddr( FRAM_ADDR_LOG + seg * LOG_SEG_SIZE, &dev_mem, &span );
+    if ( HAL_I2C_Mem_Read( &hi2c1, dev_addr, dev_mem, I2C_MEMADD_SIZE_16BIT, 
+                           (uint8_t *)&data, sizeof( data ), FRAM_TIMEOUT ) != HAL_OK )
+        return 0;
+    if ( CalcCRC16( (uint8_t *)&data, sizeof( data.data ) ) != data.crc )
+        return 0;
+    if ( data.data[0] != LOG_BLK_MAGIC || !data.data[1] )
+        return 0;
+    return ((LOG_PACK *)&data.data[LOG_BLK_HDR])->seq;
+ }
+
+//*************************************************************************************************
+// Перенос записей журнала старого формата (одна запись WATER_LOG в блоке) в сегменты журнала без
+// IT/DMA (только в режиме инициализации). Выполняется однократно: после переноса журнал содержит
+// сегменты и при следующих включениях перенос не выполняется. Порядок записей в кольце старого
+// формата определяется по последней записи (максимальный номер, для записей без номера - 
+// дата/время). Сегменты записываются по месту записей старого формата от самой старой записи,
+// сегмент начинается с первой записи, размещенной в начале сегмента: не более 3 самых старых
+// записей отбрасываются. Записи, не помещающиеся в журнал без перезаписи еще не перенесенных 
+// записей, отбрасываются начиная с самых старых. Записи нумеруются подряд с сохранением номера
+// последней записи. Блок по адресу 0x0020 (журнал до перехода на два блока текущих параметров)
+// занят вторым блоком текущих параметров и не переносится.
+//*************************************************************************************************
+static void LogMigrate( void ) {
+
+    LOG_PACK prev, rec;
+    FramStatus status;
+    uint64_t valid = 0, ring = 0;
+    uint32_t seq = 0, time = 0;
+    uint8_t blk, pos, head = 0, cnt = 0, buff[LOG_PACK_MAX_SIZE], size[LOG_LEGACY_BLOCKS];
+
+    //поиск последней записи старого формата
+    for ( blk = 0; blk < LOG_LEGACY_BLOCKS; blk++ ) {
+        status = LogLegacyRead( blk, &rec );
+        if ( status == FRAM_ERROR || status == FRAM_ERROR_PARAM )
+            return; //ошибка чтения или журнал уже содержит сегменты
+        if ( status != FRAM_OK )
+            continue;
+        valid |= (uint64_t)1 << blk;
+        if ( rec.seq > seq || ( !rec.seq && !seq && rec.time >= time ) ) {
+            head = blk;
+            seq = rec.seq;
+            time = rec.time;
+           }
+       }
+    if ( !valid )
+        return;
+    //размеры разностных записей в порядке записи, позиция "0" - блок после последней записи
+    for ( pos = 0; pos < LOG_LEGACY_BLOCKS; pos++ ) {
+        blk = ( head + 1 + pos ) % LOG_LEGACY_BLOCKS;
+        if ( !( valid & ( (uint64_t)1 << blk ) ) )
+            continue;
+        if ( LogLegacyRead( blk, &rec ) != FRAM_OK )
+            return;
+        size[pos] = cnt ? LogPackDelta( &prev, &rec, buff ) : LOG_PACK_KEY_SIZE;
+        ring |= (uint64_t)1 << pos;
+        prev = rec;
+        cnt = 1;
+       }
+    //поиск первой переносимой записи: перенос без перезаписи еще не перенесенных записей
+    for ( pos = 0; pos < LOG_LEGACY_BLOCKS; pos++ ) {
+        cnt = LogMigrateRun( head, pos, ring, size, 0, false );
+        if ( cnt )
+            break;
+       }
+    if ( !cnt )
+        return;
+    LogMigrateRun( head, pos, ring, size, seq >= cnt ? seq - cnt + 1 : 1, true );
+    //поиск последнего сегмента перенесенного журнала
+    LogHeadFind();
+ }
+
+//*************************************************************************************************
+// Размещение записей старого формата в сегментах журнала по правилам LogSave()
+//-------------------------------------------------------------------------------------------------
+// uint8_t head    - номер блока последней записи старого формата
+// uint8_t skip    - позиция в кольце первой переносимой записи (от самой старой записи)
+// uint64_t ring   - карта записей старого формата по позициям в кольце
+// uint8_t *size   - размеры разностных записей по позициям в кольце
+// uint32_t seq    - номер первой переносимой записи
+// bool save       - false - проверка размещения, true - запись сегментов в FRAM
+// return          - кол-во перенесенных записей, "0" - записи с позиции skip не переносятся
+//*************************************************************************************************
+static uint8_t LogMigrateRun( uint8_t head, uint8_t skip, uint64_t ring, uint8_t *size, uint32_t seq, bool save ) {
+
+    FRAM_DATA data;
+    LOG_PACK prev, rec;
+    uint8_t pos, seg, blk, segs = 1, len, cnt = 0, slot = 0, fill = LOG_BLK_HDR, buff[LOG_PACK_MAX_SIZE];
+
+    //первая запись размещается в начале сегмента
+    blk = ( head + 1 + skip ) % LOG_LEGACY_BLOCKS;
+    if ( blk % LOG_SEG_BLOCKS || blk / LOG_SEG_BLOCKS >= log_segments )
+        return 0;
+    seg = blk / LOG_SEG_BLOCKS;
+    blk = 0;
+    memset( (uint8_t *)&data, 0x00, sizeof( data ) );
+    for ( pos = skip; pos < LOG_LEGACY_BLOCKS; pos++ ) {
+        if ( !( ring & ( (uint64_t)1 << pos ) ) )
+            continue;
+        if ( save == true ) {
+            if ( LogLegacyRead( ( head + 1 + pos ) % LOG_LEGACY_BLOCKS, &rec ) != FRAM_OK )
+                return 0;
+            rec.seq = seq + cnt;
+           }
+        len = LOG_PACK_KEY_SIZE;
+        if ( slot )
+            len = save == true ? LogPackDelta( &prev, &rec, buff ) : size[pos];
+        if ( slot && slot < LOG_SEG_RECORDS && fill + len > sizeof( data.data ) && blk + 1 < LOG_SEG_BLOCKS ) {
+            //запись не помещается в текущий блок, переход на следующий блок сегмента
+            if ( LogMigrateBlk( head, pos, ring, seg, blk, &data, save ) == false )
+                return 0;
+            blk++;
+            fill = LOG_BLK_HDR;
+           }
+        if ( !slot || slot >= LOG_SEG_RECORDS || fill + len > sizeof( data.data ) ) {
+            if ( slot ) {
+                //сегмент заполнен: запись текущего блока, очистка оставшихся блоков
+                for ( ; blk < LOG_SEG_BLOCKS; blk++ ) {
+                    if ( LogMigrateBlk( head, pos, ring, seg, blk, &data, save ) == false )
+                        return 0;
+                   }
+                //сегменты не должны перекрывать первый сегмент
+                seg = ( seg + 1 ) % log_segments;
+                if ( ++segs > log_segments )
+                    return 0;
+               }
+            //опорная запись в начале сегмента
+            blk = 0;
+            slot = 0;
+            fill = LOG_BLK_HDR;
+            len = LOG_PACK_KEY_SIZE;
+            if ( save == true )
+                memcpy( buff, (uint8_t *)&rec, len );
+           }
+        if ( save == true ) {
+            memcpy( data.data + fill, buff, len );
+            data.data[0] = LOG_BLK_MAGIC | blk;
+            data.data[1]++;
+            prev = rec;
+           }
+        fill += len;
+        slot++;
+        cnt++;
+       }
+    if ( !cnt )
+        return 0;
+    //последний сегмент: запись текущего блока, очистка оставшихся блоков
+    for ( ; blk < LOG_SEG_BLOCKS; blk++ ) {
+        if ( LogMigrateBlk( head, LOG_LEGACY_BLOCKS, ring, seg, blk, &data, save ) == false )
+            return 0;
+       }
+    return cnt;
+ }
+
+//*************************************************************************************************
+// Запись блока сегмента при переносе журнала старого формата, после записи буфер блока очищается
+//-------------------------------------------------------------------------------------------------
+// uint8_t head     - номер блока последней записи старого формата
+// uint8_t pos      - позиция в кольце последней прочитанной записи старого формата
+// uint64_t ring    - карта записей старого формата по позициям в кольце
+// uint8_t seg      - номер сегмента журнала
+// uint8_t blk      - номер блока в сегменте
+// FRAM_DATA *data  - буфер блока
+// bool save        - false - только проверка, true - запись блока в FRAM
+// return = true    - блок не содержит еще не прочитанной записи старого формата, блок записан
+//*************************************************************************************************
+static bool LogMigrateBlk( uint8_t head, uint8_t pos, uint64_t ring, uint8_t seg, uint8_t blk, FRAM_DATA *data, bool save ) {
+
+    uint32_t span;
+    uint16_t dev_addr, dev_mem, idx;
+
+    idx = seg * LOG_SEG_BLOCKS + blk;
+    if ( idx < LOG_LEGACY_BLOCKS ) {
+        idx = ( idx + LOG_LEGACY_BLOCKS - head - 1 ) % LOG_LEGACY_BLOCKS;
+        if ( idx > pos && ( ring & ( (uint64_t)1 << idx ) ) )
+            return false;
+       }
+    if ( save == true ) {
+        data->crc = CalcCRC16( (uint8_t *)data, sizeof( data->data ) );
+        dev_addr = FramDevAddr( FRAM_ADDR_LOG + seg * LOG_SEG_SIZE + blk * FRAM_BLOCK_SIZE, &dev_mem, &span );
+        if ( HAL_I2C_Mem_Write( &hi2c1, dev_addr, dev_mem, I2C_MEMADD_SIZE_16BIT, 
+                                (uint8_t *)data, sizeof( FRAM_DATA ), FRAM_TIMEOUT ) != HAL_OK )
+            return false;
+       }
+    memset( (uint8_t *)data, 0x00, sizeof( FRAM_DATA ) );
+    return true;
+ }
+
+//*************************************************************************************************
+// Чтение записи журнала старого формата без IT/DMA (только в режиме инициализации)
+//-------------------------------------------------------------------------------------------------
+// uint8_t blk       - номер блока от начала области журнала
+// LOG_PACK *rec     - указатель для размещения записи в упакованном формате
+// return FramStatus - FRAM_OK - запись прочитана, FRAM_ERROR - ошибка чтения, 
+//                     FRAM_ERROR_CRC - блок не содержит записи, FRAM_ERROR_PARAM - блок сегмента
+//*************************************************************************************************
+static FramStatus LogLegacyRead( uint8_t blk, LOG_PACK *rec ) {
+
+    uint32_t span;
+    FRAM_DATA data;
+    WATER_LOG *wtr_log = (WATER_LOG *)data.data;
+    uint16_t dev_addr, dev_mem;
+
+    dev_addr = FramDevAddr( FRAM_ADDR_LOG + blk * FRAM_BLOCK_SIZE, &dev_mem, &span );
+    if ( HAL_I2C_Mem_Read( &hi2c1, dev_addr, dev_mem, I2C_MEMADD_SIZE_16BIT, 
+                           (uint8_t *)&data, sizeof( data ), FRAM_TIMEOUT ) != HAL_OK )
+        return FRAM_ERROR;
+    if ( CalcCRC16( (uint8_t *)&data, sizeof( data.data ) ) != data.crc )
+        return FRAM_ERROR_CRC;
+    //первый байт записи старого формата (секунды) не совпадает с заголовком блока сегмента
+    if ( ( data.data[0] & 0xF0 ) == LOG_BLK_MAGIC )
+        return FRAM_ERROR_PARAM;
+    if ( wtr_log->sec > 59 || wtr_log->min > 59 || wtr_log->hour > 23 || !wtr_log->day || 
+         wtr_log->day > 31 || !wtr_log->month || wtr_log->month > 12 || wtr_log->year < 2000 )
+        return FRAM_ERROR_CRC;
+    LogPackGet( wtr_log, rec );
+    return FRAM_OK;
+ }
+
 //*************************************************************************************************
 // Чтение блока данных из FRAM памяти
 //-------------------------------------------------------------------------------------------------
@@ -193,10 +578,101 @@ FramStatus FramReadData( uint16_t addr, uint8_t *ptr_data, uint16_t len ) {
     return FRAM_OK;
  }
 
+//*************************************************************************************************
+// Чтение нескольких последовательных блоков данных из FRAM памяти одной операцией чтения,
+// КС каждого блока проверяется в буфере назначения (блок: данные + КС, FRAM_BLOCK_SIZE байт)
+//-------------------------------------------------------------------------------------------------
+// uint32_t addr          - адрес первого блока в FRAM памяти (кратен FRAM_BLOCK_SIZE)
+// uint8_t cnt            - кол-во блоков
+// uint8_t *data          - буфер для размещения блоков, размер cnt * FRAM_BLOCK_SIZE
+// FramStatus *crc_status - массив результатов проверки КС блоков (cnt элементов): FRAM_OK,
+//                          FRAM_ERROR_CRC, при ошибке чтения - ошибка чтения, NULL - не заполняется
+// return FramStatus      - результат чтения данных (без учета КС)
+//*************************************************************************************************
+FramStatus FramReadBlocks( uint32_t addr, uint8_t cnt, uint8_t *data, FramStatus *crc_status ) {
+
+    uint8_t blk;
+    FramStatus status;
+    FRAM_DATA *block;
+
+    if ( !cnt || data == NULL || addr % FRAM_BLOCK_SIZE )
+        return FRAM_ERROR_PARAM;
+    osMutexAcquire( fram_mutex, osWaitForever ); //устанавливаем блокировку
+    status = FRAMRead( addr, data, cnt * FRAM_BLOCK_SIZE );
+    osMutexRelease( fram_mutex ); //снимаем блокировку
+    if ( crc_status == NULL )
+        return status;
+    for ( blk = 0; blk < cnt; blk++ ) {
+        block = (FRAM_DATA *)( data + blk * FRAM_BLOCK_SIZE );
+        if ( status != FRAM_OK )
+            crc_status[blk] = status;
+        else crc_status[blk] = CalcCRC16( block->data, sizeof( block->data ) ) == block->crc ? FRAM_OK : FRAM_ERROR_CRC;
+       }
+    return status;
+ }
+
+//*************************************************************************************************
+// Проверка КС одного блока FRAM и восстановление поврежденного блока (фоновая проверка).
+// Ошибка КС подтверждается повторным чтением. Поврежденный блок текущих параметров выбирается
+// для следующей записи текущих параметров, текущий блок журнала перезаписывается копией из RAM,
+// поврежденный блок итогов расхода очищается (итоги периода не могут быть восстановлены,
+// очищенный блок используется для следующего периода). Блокировка FRAM устанавливается
+// только на время проверки одного блока.
+//-------------------------------------------------------------------------------------------------
+// uint32_t addr    - адрес блока в FRAM памяти (кратен FRAM_BLOCK_SIZE)
+// return FramScrub - результат проверки
+//*************************************************************************************************
+FramScrub FramScrubBlock( uint32_t addr ) {
+
+    bool valid;
+    FramScrub result;
+    FramStatus status;
+
+    if ( addr % FRAM_BLOCK_SIZE || addr + FRAM_BLOCK_SIZE > fram_size )
+        return FRAM_SCRUB_ERROR;
+    //устанавливаем блокировку
+    osMutexAcquire( fram_mutex, osWaitForever );
+    status = FRAMRead( addr, (uint8_t *)&fram_read, sizeof( fram_read ) );
+    valid = ( CalcCRC16( (uint8_t *)&fram_read, sizeof( fram_read.data ) ) == fram_read.crc );
+    result = FRAM_SCRUB_OK;
+    if ( status == FRAM_OK && valid == false ) {
+        //повторное чтение, ошибка обмена не должна приводить к перезаписи блока
+        status = FRAMRead( addr, (uint8_t *)&fram_read, sizeof( fram_read ) );
+        valid = ( CalcCRC16( (uint8_t *)&fram_read, sizeof( fram_read.data ) ) == fram_read.crc );
+        result = FRAM_SCRUB_TRANSIENT;
+       }
+    if ( status != FRAM_OK )
+        result = FRAM_SCRUB_ERROR;
+    else if ( valid == false ) {
+        if ( fram_read.crc == 0x0000 || fram_read.crc == 0xFFFF )
+            result = FRAM_SCRUB_FREE;
+        else if ( addr < FRAM_ADDR_LOG ) {
+            //блок текущих параметров: следующая запись выполняется в поврежденный блок,
+            //последняя достоверная копия остается во втором блоке
+            data_slot = ( addr - FRAM_ADDR_DATA ) / FRAM_BLOCK_SIZE;
+            result = FRAM_SCRUB_SLOT;
+           }
+        else if ( log_open == true && log_slot && addr == FRAM_ADDR_LOG + log_seg * LOG_SEG_SIZE + log_blk * FRAM_BLOCK_SIZE ) {
+            //текущий блок журнала, копия блока хранится в RAM
+            status = FRAMSave( addr, (uint8_t *)&log_data, sizeof( log_data ) );
+            result = status == FRAM_OK ? FRAM_SCRUB_REPAIRED : FRAM_SCRUB_ERROR;
+           }
+        else if ( roll_addr && addr >= roll_addr ) {
+            //блок итогов расхода
+            memset( (uint8_t *)&fram_save, 0x00, sizeof( fram_save ) );
+            status = FRAMSave( addr, (uint8_t *)&fram_save, sizeof( fram_save ) );
+            result = status == FRAM_OK ? FRAM_SCRUB_CLEARED : FRAM_SCRUB_ERROR;
+           }
+        else result = FRAM_SCRUB_BAD;
+       }
+    //снимаем блокировку
+    osMutexRelease( fram_mutex );
+    return result;
+ }
+
 //*************************************************************************************************
 // Запись блока данных в FRAM память, перед записью вычисляется КС блока данных
-// Для данных типа WATER_DATA_LOG выполняется расчет следующего адреса для размещения 
-// следующего блока данных
+// Данные типа WATER_DATA_LOG (WATER_LOG) упаковываются и добавляются в текущий сегмент журнала
 //-------------------------------------------------------------------------------------------------
 // FramData type - тип блока данных
 // uint8_t *ptr  - указатель на записываемый блок данных
@@ -209,12 +685,15 @@ FramStatus FramSaveData( TypeData type, uint8_t *ptr_data, uint16_t len ) {
     
     if ( len > sizeof( fram_save.data ) || ptr_data == NULL )
         return FRAM_ERROR_PARAM;
+    if ( data_hold == true )
+        return FRAM_ERROR; //текущие параметры не прочитаны при включении, значения счетчиков 
+                           //в RAM отсчитываются от "0" и не записываются в том числе в журнал
+    if ( type == WATER_DATA_LOG )
+        return LogSave( (WATER_LOG *)ptr_data );
     //устанавливаем блокировку
     osMutexAcquire( fram_mutex, osWaitForever );
     //адрес размещения блока данных в памяти
-    if ( type == CURRENT_DATA )
-        addr = FRAM_ADDR_DATA;
-    else addr = curr_data.next_addr;
+    addr = FRAM_ADDR_DATA + data_slot * FRAM_BLOCK_SIZE;
     #if defined( DEBUG_FRAM ) && defined( DEBUG_TARGET )
     sprintf( buffer1, "Record current data at: 0x%04X ", addr );
     UartSendStr( buffer1 );
@@ -223,6 +702,8 @@ FramStatus FramSaveData( TypeData type, uint8_t *ptr_data, uint16_t len ) {
     memset( (uint8_t *)&fram_save, 0x00, sizeof( fram_save ) );
     //копируем блок даннных в промежуточный буфер
     memcpy( (uint8_t *)&fram_save, ptr_data, len );
+    //порядковый номер записи текущих параметров
+    ((CURR_DATA *)fram_save.data)->seq = data_seq + 1;
     //расчет КС блока данных
     fram_save.crc = CalcCRC16( (uint8_t *)&fram_save, sizeof( fram_save.data ) );
     //запись блока
@@ -234,15 +715,283 @@ FramStatus FramSaveData( TypeData type, uint8_t *ptr_data, uint16_t len ) {
         UartSendStr( buffer1 );
         return status;                  
        }
-    if ( type == WATER_DATA_LOG ) {
-        curr_data.next_addr += sizeof( fram_save );
-        if ( curr_data.next_addr >= FRAM_SIZE )
-            curr_data.next_addr = FRAM_ADDR_LOG;
+    //следующая запись в другой блок
+    data_seq++;
+    data_slot ^= 1;
+    osMutexRelease( fram_mutex ); //снимаем блокировку
+    return FRAM_OK;
+ }
+
+//*************************************************************************************************
+// Запись блока данных вне журнала и текущих параметров (область итогов расхода), перед записью
+// вычисляется КС блока данных, данные дополняются нулями до размера блока
+//-------------------------------------------------------------------------------------------------
+// uint32_t addr     - адрес блока в FRAM памяти (кратен FRAM_BLOCK_SIZE)
+// uint8_t *ptr_data - указатель на записываемые данные
+// uint16_t len      - размер данных, не более FRAM_BLOCK_SIZE - 2
+// return FramStatus - результат записи
+//*************************************************************************************************
+FramStatus FramSaveBlock( uint32_t addr, uint8_t *ptr_data, uint16_t len ) {
+
+    FramStatus status;
+
+    if ( ptr_data == NULL || len > sizeof( fram_save.data ) || addr % FRAM_BLOCK_SIZE ||
+         addr < FRAM_ADDR_LOG + log_segments * LOG_SEG_SIZE || addr + FRAM_BLOCK_SIZE > fram_size )
+        return FRAM_ERROR_PARAM;
+    //устанавливаем блокировку
+    osMutexAcquire( fram_mutex, osWaitForever );
+    memset( (uint8_t *)&fram_save, 0x00, sizeof( fram_save ) );
+    memcpy( (uint8_t *)&fram_save.data, ptr_data, len );
+    fram_save.crc = CalcCRC16( (uint8_t *)&fram_save.data, sizeof( fram_save.data ) );
+    status = FRAMSave( addr, (uint8_t *)&fram_save, sizeof( fram_save ) );
+    //снимаем блокировку
+    osMutexRelease( fram_mutex );
+    return status;
+ }
+
+//*************************************************************************************************
+// Добавление записи в журнал: запись упаковывается (разностная запись относительно предыдущей)
+// и добавляется в текущий блок сегмента, блок записывается в FRAM полностью. Если запись не
+// помещается в блок - используется следующий блок сегмента, при заполнении сегмента запись
+// сохраняется как опорная в начале следующего сегмента. Перед записью опорной записи блоки
+// нового сегмента, содержащие данные предыдущего цикла, очищаются.
+//-------------------------------------------------------------------------------------------------
+// WATER_LOG *wtr_log - указатель на запись журнала, заполняется порядковый номер записи
+// return FramStatus  - результат записи
+//*************************************************************************************************
+static FramStatus LogSave( WATER_LOG *wtr_log ) {
+
+    bool new_seg;
+    LOG_PACK rec;
+    FramStatus status;
+    uint16_t addr;
+    uint8_t seg, blk, pos, len = 0, buff[LOG_PACK_MAX_SIZE];
+
+    //устанавливаем блокировку до восстановления сегмента и присвоения номера записи:
+    //при нескольких источниках записи номера не повторяются
+    osMutexAcquire( fram_mutex, osWaitForever );
+    if ( log_open == false ) {
+        status = LogOpen();
+        if ( status != FRAM_OK ) {
+            osMutexRelease( fram_mutex ); //снимаем блокировку
+            return status;
+           }
+       }
+    LogPackGet( wtr_log, &rec );
+    rec.seq = log_seq + 1;
+    //новый блок формируется в буфере fram_save, состояние сегмента обновляется после записи
+    memcpy( (uint8_t *)&fram_save, (uint8_t *)&log_data, sizeof( fram_save ) );
+    seg = log_seg;
+    blk = log_blk;
+    pos = log_pos;
+    new_seg = ( !log_slot || log_slot >= LOG_SEG_RECORDS );
+    if ( new_seg == false ) {
+        len = LogPackDelta( &log_last, &rec, buff );
+        if ( pos + len > sizeof( fram_save.data ) && blk + 1 < LOG_SEG_BLOCKS ) {
+            //запись не помещается в текущий блок, переход на следующий блок сегмента
+            blk++;
+            pos = LOG_BLK_HDR;
+            memset( (uint8_t *)&fram_save, 0x00, sizeof( fram_save ) );
+           }
+        if ( pos + len > sizeof( fram_save.data ) )
+            new_seg = true;
+       }
+    if ( new_seg == true ) {
+        //опорная запись в начале следующего сегмента
+        seg = ( log_seg + 1 ) % log_segments;
+        blk = 0;
+        pos = LOG_BLK_HDR;
+        len = LOG_PACK_KEY_SIZE;
+        memcpy( buff, (uint8_t *)&rec, len );
+        memset( (uint8_t *)&fram_save, 0x00, sizeof( fram_save ) );
+        //очистка блоков сегмента, кроме первого
+        for ( addr = FRAM_ADDR_LOG + seg * LOG_SEG_SIZE + FRAM_BLOCK_SIZE; addr < FRAM_ADDR_LOG + ( seg + 1 ) * LOG_SEG_SIZE; addr += FRAM_BLOCK_SIZE ) {
+            status = FRAMSave( addr, (uint8_t *)&fram_save, sizeof( fram_save ) );
+            if ( status != FRAM_OK ) {
+                osMutexRelease( fram_mutex ); //снимаем блокировку
+                sprintf( buffer1, "Error write to FRAM: 0x%04X %s\r\n", addr, FramErrorDesc( status ) );
+                UartSendStr( buffer1 );
+                return status;
+               }
+           }
+       }
+    //добавление записи в блок
+    memcpy( fram_save.data + pos, buff, len );
+    fram_save.data[0] = LOG_BLK_MAGIC | blk;
+    fram_save.data[1]++;
+    fram_save.crc = CalcCRC16( (uint8_t *)&fram_save, sizeof( fram_save.data ) );
+    addr = FRAM_ADDR_LOG + seg * LOG_SEG_SIZE + blk * FRAM_BLOCK_SIZE;
+    #if defined( DEBUG_FRAM ) && defined( DEBUG_TARGET )
+    sprintf( buffer1, "Record log data at: 0x%04X size: %u ", addr, len );
+    UartSendStr( buffer1 );
+    #endif
+    status = FRAMSave( addr, (uint8_t *)&fram_save, sizeof( fram_save ) );
+    if ( status != FRAM_OK ) {
+        osMutexRelease( fram_mutex ); //снимаем блокировку
+        sprintf( buffer1, "Error write to FRAM: 0x%04X %s\r\n", addr, FramErrorDesc( status ) );
+        UartSendStr( buffer1 );
+        return status;
        }
+    //запись выполнена, обновление состояния сегмента
+    memcpy( (uint8_t *)&log_data, (uint8_t *)&fram_save, sizeof( log_data ) );
+    log_slot = ( new_seg == true ? 1 : log_slot + 1 );
+    log_seg = seg;
+    log_blk = blk;
+    log_pos = pos + len;
+    log_last = rec;
+    log_seq = rec.seq;
+    curr_data.next_addr = addr;
+    //обновление индекса журнала
+    wtr_log->seq = rec.seq;
+    SortAdd( LOG_REF( seg, log_slot - 1 ), wtr_log );
     osMutexRelease( fram_mutex ); //снимаем блокировку
     return FRAM_OK;
  }
 
+//*************************************************************************************************
+// Восстановление состояния текущего сегмента журнала: чтение блоков сегмента, найденного при
+// включении, до первого блока без записей. Если записи сегмента прочитать не удалось, следующая
+// запись начинает новый сегмент. При ошибке обмена с FRAM (кроме КС) состояние не восстанавливается.
+//-------------------------------------------------------------------------------------------------
+// return FramStatus - результат чтения
+//*************************************************************************************************
+static FramStatus LogOpen( void ) {
+
+    LOG_PACK rec;
+    uint8_t *data;
+    FramStatus status, crc[LOG_SEG_BLOCKS];
+    FRAM_DATA seg_data[LOG_SEG_BLOCKS];
+    uint8_t blk, cnt, pos, size, slot = 0;
+
+    if ( !log_seq ) {
+        //журнал не содержит записей, запись с первого сегмента
+        log_seg = log_segments - 1;
+        log_slot = 0;
+        log_open = true;
+        return FRAM_OK;
+       }
+    memset( (uint8_t *)&rec, 0x00, sizeof( rec ) );
+    //все блоки сегмента читаются одной операцией
+    status = FramReadBlocks( FRAM_ADDR_LOG + log_seg * LOG_SEG_SIZE, LOG_SEG_BLOCKS, (uint8_t *)seg_data, crc );
+    if ( status != FRAM_OK )
+        return status;
+    for ( blk = 0; blk < LOG_SEG_BLOCKS; blk++ ) {
+        data = seg_data[blk].data;
+        if ( crc[blk] != FRAM_OK || data[0] != ( LOG_BLK_MAGIC | blk ) || !data[1] )
+            break;
+        for ( cnt = 0, pos = LOG_BLK_HDR; cnt < data[1]; cnt++, pos += size ) {
+            size = LogUnpack( data + pos, sizeof( seg_data[blk].data ) - pos, !blk && !cnt, &rec );
+            if ( !size )
+                break;
+            slot++;
+           }
+        if ( cnt < data[1] ) {
+            //ошибка формата записи, сегмент закрывается
+            slot = LOG_SEG_RECORDS;
+            break;
+           }
+        memcpy( (uint8_t *)&log_data, (uint8_t *)&seg_data[blk], sizeof( log_data ) );
+        log_blk = blk;
+        log_pos = pos;
+       }
+    log_slot = slot;
+    if ( slot ) {
+        log_last = rec;
+        log_seq = rec.seq;
+       }
+    log_open = true;
+    return FRAM_OK;
+ }
+
+//*************************************************************************************************
+// Чтение записей сегмента журнала: блоки сегмента читаются последовательно, записи распаковываются
+// от опорной записи, для записей начиная с номера slot вызывается функция обработки.
+//-------------------------------------------------------------------------------------------------
+// uint8_t seg       - номер сегмента журнала
+// uint8_t slot      - номер записи в сегменте, с которой вызывается функция обработки
+// LogReadCb cb      - функция обработки записи, возврат "false" - прекращение чтения
+// void *arg         - параметр функции обработки
+// return FramStatus - результат чтения, FRAM_ERROR_CRC - сегмент не содержит записей
+//*************************************************************************************************
+FramStatus FramReadSeg( uint8_t seg, uint8_t slot, LogReadCb cb, void *arg ) {
+
+    LOG_PACK rec;
+    uint8_t *data;
+    WATER_LOG wtr_log;
+    FramStatus status, crc[LOG_SEG_BLOCKS];
+    FRAM_DATA seg_data[LOG_SEG_BLOCKS];
+    uint8_t blk, cnt, pos, size, idx = 0;
+
+    if ( seg >= log_segments )
+        return FRAM_ERROR_PARAM;
+    memset( (uint8_t *)&rec, 0x00, sizeof( rec ) );
+    //все блоки сегмента читаются одной операцией
+    status = FramReadBlocks( FRAM_ADDR_LOG + seg * LOG_SEG_SIZE, LOG_SEG_BLOCKS, (uint8_t *)seg_data, crc );
+    if ( status != FRAM_OK )
+        return status;
+    for ( blk = 0; blk < LOG_SEG_BLOCKS; blk++ ) {
+        data = seg_data[blk].data;
+        status = crc[blk];
+        if ( status == FRAM_OK && ( data[0] != ( LOG_BLK_MAGIC | blk ) || !data[1] ) )
+            status = FRAM_ERROR_CRC; //блок не содержит записей сегмента
+        if ( status != FRAM_OK )
+            return blk ? FRAM_OK : status;
+        for ( cnt = 0, pos = LOG_BLK_HDR; cnt < data[1]; cnt++, pos += size, idx++ ) {
+            size = LogUnpack( data + pos, sizeof( seg_data[blk].data ) - pos, !blk && !cnt, &rec );
+            if ( !size || idx >= LOG_SEG_RECORDS )
+                return FRAM_OK;
+            if ( idx < slot )
+                continue;
+            LogPackPut( &rec, &wtr_log );
+            if ( cb( LOG_REF( seg, idx ), &wtr_log, arg ) == false )
+                return FRAM_OK;
+           }
+       }
+    return FRAM_OK;
+ }
+
+//*************************************************************************************************
+// Чтение записи журнала по ссылке
+//-------------------------------------------------------------------------------------------------
+// uint16_t ref       - ссылка на запись журнала (см. LOG_REF)
+// WATER_LOG *wtr_log - указатель для размещения записи
+// return FramStatus  - результат чтения, FRAM_ERROR_CRC - запись не найдена
+//*************************************************************************************************
+FramStatus FramReadLog( uint16_t ref, WATER_LOG *wtr_log ) {
+
+    FramStatus status;
+
+    if ( ref < FRAM_ADDR_LOG )
+        return FRAM_ERROR_PARAM;
+    wtr_log->seq = 0;
+    status = FramReadSeg( LOG_REF_SEG( ref ), LOG_REF_SLOT( ref ), LogCopy, wtr_log );
+    if ( status == FRAM_OK && !wtr_log->seq )
+        return FRAM_ERROR_CRC;
+    return status;
+ }
+
+//*************************************************************************************************
+// Копирование первой прочитанной записи, функция обработки записи для FramReadLog()
+//*************************************************************************************************
+static bool LogCopy( uint16_t ref, WATER_LOG *wtr_log, void *arg ) {
+
+    memcpy( (uint8_t *)arg, (uint8_t *)wtr_log, sizeof( WATER_LOG ) );
+    return false;
+ }
+
+//*************************************************************************************************
+// Закрытие текущего сегмента журнала: следующая запись выполняется в первый сегмент журнала
+//*************************************************************************************************
+void FramLogReset( void ) {
+
+    osMutexAcquire( fram_mutex, osWaitForever );
+    log_seg = log_segments - 1;
+    log_slot = 0;
+    log_open = true;
+    curr_data.next_addr = FRAM_ADDR_LOG;
+    osMutexRelease( fram_mutex );
+ }
+
 //*************************************************************************************************
 // Очистка FRAM памяти только в области хранения данных логирования
 //*************************************************************************************************
@@ -254,7 +1003,7 @@ void FramClear( void ) {
     //устанавливаем блокировку FRAM
     osMutexAcquire( fram_mutex, osWaitForever );
     memset( (uint8_t *)&fram_save, 0x00, sizeof( fram_save ) );
-    for ( mem_addr = FRAM_ADDR_LOG; mem_addr < FRAM_SIZE; mem_addr += sizeof( fram_save ) ) {
+    for ( mem_addr = FRAM_ADDR_LOG; mem_addr < FRAM_ADDR_LOG + log_segments * LOG_SEG_SIZE; mem_addr += sizeof( fram_save ) ) {
         status = FRAMSave( mem_addr, (uint8_t *)&fram_save, sizeof( fram_save ) );
         if ( status != FRAM_OK ) {
             sprintf( buffer1, "Error write to FRAM: 0x%04X %s\r\n", mem_addr, FramErrorDesc( status ) );
@@ -263,6 +1012,9 @@ void FramClear( void ) {
        }
     //снимаем блокировку FRAM
     osMutexRelease( fram_mutex );
+    //журнал очищен, запись с первого сегмента, очистка индекса
+    FramLogReset();
+    SortClear();
  }
 
 //*************************************************************************************************
@@ -271,34 +1023,33 @@ void FramClear( void ) {
 //*************************************************************************************************
 void FramHexDump( uint8_t blocks ) {
 
-    uint16_t addr;
+    uint32_t addr;
     FramStatus status;
-    uint8_t data_hex[16], block, cnt_blk;
+    uint16_t cnt_blk, line;
+    uint8_t data_hex[LOG_SEG_SIZE], block;
 
-    //устанавливаем блокировку FRAM
-    osMutexAcquire( fram_mutex, osWaitForever );
     if ( blocks )
         cnt_blk = blocks; //указано кол-во блоков
-    else cnt_blk = FRAM_SIZE/256;
-    //чтение - вывод данных
-    for ( addr = 0, block = 0; addr < FRAM_SIZE && cnt_blk; addr += sizeof( data_hex ) ) {
+    else cnt_blk = fram_size/256;
+    //чтение - вывод данных, чтение выполняется по LOG_SEG_SIZE байт одной операцией
+    for ( addr = 0, block = 0; addr < fram_size && cnt_blk; addr += sizeof( data_hex ) ) {
         memset( (uint8_t *)&data_hex, 0x00, sizeof( data_hex ) );
-        status = (FramStatus)FRAMRead( addr, data_hex, sizeof( data_hex ) );
+        status = FramReadBlocks( addr, sizeof( data_hex ) / FRAM_BLOCK_SIZE, data_hex, NULL );
         if ( status != FRAM_OK ) {
-            sprintf( buffer1, "Error read from FRAM: 0x%04X %s\r\n", addr, FramErrorDesc( status ) );
+            sprintf( buffer1, "Error read from FRAM: 0x%05lX %s\r\n", (unsigned long)addr, FramErrorDesc( status ) );
             UartSendStr( buffer1 );
            }
-        //вывод строки HEX дампа
-        DataHexDump( data_hex, HEX_16BIT_ADDR, addr, buffer1 );
-        UartSendStr( buffer1 );
-        if ( block++ >= 15 ) {
-            cnt_blk--;
-            block = 0; //выделение следующего блока 16*16
-            UartSendStr( (char *)msg_crlr );
+        for ( line = 0; line < sizeof( data_hex ) && cnt_blk; line += 16 ) {
+            //вывод строки HEX дампа
+            DataHexDump( data_hex + line, fram_size > 0x10000 ? HEX_32BIT_ADDR : HEX_16BIT_ADDR, addr + line, buffer1 );
+            UartSendStr( buffer1 );
+            if ( block++ >= 15 ) {
+                cnt_blk--;
+                block = 0; //выделение следующего блока 16*16
+                UartSendStr( (char *)msg_crlr );
+               }
            }
        }
-    //снимаем блокировку FRAM
-    osMutexRelease( fram_mutex );
  }
 
 //*************************************************************************************************
@@ -306,173 +1057,322 @@ void FramHexDump( uint8_t blocks ) {
 //*************************************************************************************************
 void FramCheck( void ) {
 
-    uint16_t addr;
-    FramStatus status;
+    uint8_t blk, cnt;
+    uint16_t addr, end;
+    uint32_t tick, scan = 0;
+    FramStatus crc[LOG_SEG_BLOCKS];
+    FRAM_DATA data[LOG_SEG_BLOCKS];
 
     //проверка интервальных данных
+    sprintf( buffer1, "FRAM size: %lu bytes, devices: %u, log segments: %u\r\n", (unsigned long)fram_size, fram_devices, log_segments );
+    UartSendStr( buffer1 );
     UartSendStr( "Checking FRAM data ...\r\n" );
-    for ( addr = FRAM_ADDR_DATA; addr < FRAM_SIZE; addr += sizeof( fram_read ) ) {
-        //чтение блока данных, проверка
-        status = FramReadData( addr, (uint8_t *)&fram_read, sizeof( fram_read ) );
-        if ( status == FRAM_OK )
-            sprintf( buffer1, "Address: 0x%04X ... OK\r\n", addr );
-        else {
-            if ( status == FRAM_ERROR_CRC && ( fram_read.crc == 0x0000 || fram_read.crc == 0xFFFF ) )
-                sprintf( buffer1, "Address: 0x%04X ... Block free\r\n", addr );
-            else sprintf( buffer1, "Address: 0x%04X ... %s\r\n", addr, FramErrorDesc( status ) );
+    end = FramAreaEnd();
+    for ( addr = FRAM_ADDR_DATA; addr < end; addr += cnt * FRAM_BLOCK_SIZE ) {
+        //чтение нескольких блоков данных одной операцией, проверка
+        cnt = ( end - addr ) / FRAM_BLOCK_SIZE;
+        if ( cnt > LOG_SEG_BLOCKS )
+            cnt = LOG_SEG_BLOCKS;
+        memset( (uint8_t *)&data, 0x00, sizeof( data ) );
+        tick = osKernelGetTickCount();
+        FramReadBlocks( addr, cnt, (uint8_t *)&data, crc );
+        scan += osKernelGetTickCount() - tick;
+        for ( blk = 0; blk < cnt; blk++ ) {
+            if ( crc[blk] == FRAM_OK )
+                sprintf( buffer1, "Address: 0x%04X ... OK\r\n", addr + blk * FRAM_BLOCK_SIZE );
+            else {
+                if ( crc[blk] == FRAM_ERROR_CRC && ( data[blk].crc == 0x0000 || data[blk].crc == 0xFFFF ) )
+                    sprintf( buffer1, "Address: 0x%04X ... Block free\r\n", addr + blk * FRAM_BLOCK_SIZE );
+                else sprintf( buffer1, "Address: 0x%04X ... %s\r\n", addr + blk * FRAM_BLOCK_SIZE, FramErrorDesc( crc[blk] ) );
+               }
+            UartSendStr( buffer1 );
            }
-        UartSendStr( buffer1 );
        }
+    sprintf( buffer1, "Scan time: %lu ms\r\n", (unsigned long)scan );
+    UartSendStr( buffer1 );
  } 
 
 //*************************************************************************************************
 // Полный тест FRAM памяти
-// Проверка выполняется блоками по 16 байт
+// Проверка выполняется блоками по 16 байт: в блок записываются и проверяются тестовые значения,
+// затем восстанавливается исходное содержимое блока. Блокировка FRAM устанавливается только
+// на время проверки одного блока, запись данных другими задачами во время теста не ожидает
+// завершения всего теста.
 //*************************************************************************************************
 void FramTest( void ) {
 
-    uint16_t addr, error_cnt;
+    uint32_t addr;
     FramStatus status;
-    static uint8_t i, save[16], read[16];
+    uint16_t error_cnt[4];
+    static uint8_t i, orig[16], save[16], read[16];
     uint8_t value[] = { 0xFF, 0x55, 0xAA, 0x00 }; //значения для тестирования
     
-    //устанавливаем блокировку FRAM
-    osMutexAcquire( fram_mutex, osWaitForever );
+    memset( (uint8_t *)&error_cnt, 0x00, sizeof( error_cnt ) );
+    for ( addr = 0; addr < fram_size; addr += sizeof( save ) ) {
+        //устанавливаем блокировку FRAM на время проверки блока
+        osMutexAcquire( fram_mutex, osWaitForever );
+        status = FRAMRead( addr, (uint8_t *)&orig, sizeof( orig ) );
+        if ( status != FRAM_OK ) {
+            osMutexRelease( fram_mutex );
+            sprintf( buffer1, "Error read: 0x%05lX\r\n", (unsigned long)addr );
+            UartSendStr( buffer1 );
+            continue; //без исходного содержимого блок не проверяется
+           }
+        for ( i = 0; i < sizeof( value ); i++ ) {
+            //запись - чтение - сравнение тестового значения
+            memset( save, value[i], sizeof( save ) );
+            memset( read, ~value[i], sizeof( read ) );
+            if ( FRAMSave( addr, (uint8_t *)&save, sizeof( save ) ) != FRAM_OK ||
+                 FRAMRead( addr, (uint8_t *)&read, sizeof( read ) ) != FRAM_OK ||
+                 memcmp( (uint8_t *)&save, (uint8_t *)&read, sizeof( save ) ) != 0 )
+                error_cnt[i]++;
+           }
+        //восстановление исходного содержимого блока
+        status = FRAMSave( addr, (uint8_t *)&orig, sizeof( orig ) );
+        //снимаем блокировку FRAM
+        osMutexRelease( fram_mutex );
+        if ( status != FRAM_OK ) {
+            sprintf( buffer1, "Error restore: 0x%05lX\r\n", (unsigned long)addr );
+            UartSendStr( buffer1 );
+           }
+       }
     for ( i = 0; i < sizeof( value ); i++ ) {
-        memset( save, value[i], sizeof( save ) );
-        sprintf( buffer1, "Write: 0x%02X  ", value[i] );
+        if ( error_cnt[i] )
+            sprintf( buffer1, "Write: 0x%02X  Compare: %u errors\r\n", value[i], error_cnt[i] );
+        else sprintf( buffer1, "Write: 0x%02X  Compare: OK\r\n", value[i] );
         UartSendStr( buffer1 );
-        //запись одного значения по всем адресам
-        for ( addr = 0; addr < FRAM_SIZE; addr += sizeof( save ) ) {
-            status = FRAMSave( addr, (uint8_t *)&save, sizeof( save ) );
-            if ( status != FRAM_OK ) {
-                //сообщим об ошибке
-                sprintf( buffer1, "Error save: 0x%04X\r\n", addr );
-                UartSendStr( buffer1 );
-               }
+       }
+    UartSendStr( (char *)msg_crlr );
+ }
+
+//*************************************************************************************************
+// Размер FRAM памяти (всех микросхем), определяется при включении
+//*************************************************************************************************
+uint32_t FramSize( void ) {
+
+    return fram_size;
+ }
+
+//*************************************************************************************************
+// Кол-во микросхем FRAM памяти на шине
+//*************************************************************************************************
+uint8_t FramDevices( void ) {
+
+    return fram_devices;
+ }
+
+//*************************************************************************************************
+// Кол-во сегментов журнала, зависит от размера FRAM памяти
+//*************************************************************************************************
+uint8_t FramLogSegments( void ) {
+
+    return log_segments;
+ }
+
+//*************************************************************************************************
+// Адрес области хранения итогов расхода, "0" - область не выделена (недостаточный размер FRAM)
+//*************************************************************************************************
+uint32_t FramRollAddr( void ) {
+
+    return roll_addr;
+ }
+
+//*************************************************************************************************
+// Адрес окончания используемой области FRAM: текущие параметры, журнал, итоги расхода
+//*************************************************************************************************
+uint32_t FramAreaEnd( void ) {
+
+    if ( roll_addr )
+        return roll_addr + ROLL_BLOCKS * FRAM_BLOCK_SIZE;
+    return FRAM_ADDR_LOG + log_segments * LOG_SEG_SIZE;
+ }
+
+//*************************************************************************************************
+// Определение размера FRAM памяти без IT/DMA (только в режиме инициализации): размер микросхемы
+// определяется по повторению адресов (старшие биты адреса не используются микросхемой), далее
+// проверяется наличие следующих микросхем на шине. При отсутствии ответа FRAM памяти 
+// используется минимальный размер.
+//*************************************************************************************************
+static void FramProbe( void ) {
+
+    uint8_t dev;
+    uint32_t size;
+
+    fram_dev_size = FRAM_SIZE_MIN;
+    fram_dev_shift = 1;
+    fram_devices = 1;
+    if ( HAL_I2C_IsDeviceReady( &hi2c1, FRAM_ID_ADDR, 3, FRAM_TIMEOUT ) == HAL_OK ) {
+        for ( size = FRAM_SIZE_MIN; size < FRAM_SIZE_MAX; size <<= 1 ) {
+            if ( FramAlias( size ) == true )
+                break;
            }
-        //чтение - проверка
-        error_cnt = 0;
-        for ( addr = 0; addr < FRAM_SIZE; addr += sizeof( save ) ) {
-            memset( read, 0x00, sizeof( read ) );
-            status = FRAMRead( addr, (uint8_t *)&read, sizeof( read ) );
-            if ( status != FRAM_OK ) {
-                //сообщим об ошибке
-                sprintf( buffer1, "Error read: 0x%04X\r\n", addr );
-                UartSendStr( buffer1 );
-               }
-            //сравнение записанных/прочитанных данных
-            if ( memcmp( (uint8_t *)&save, (uint8_t *)&read, sizeof( save ) ) != 0 ) {
-                error_cnt++;
-                sprintf( buffer1, "Error compare: 0x%04X\r\n", addr );
-                UartSendStr( buffer1 );
-               }
+        fram_dev_size = size;
+        //для микросхем более 64 кбайт бит 1 адреса микросхемы - старший бит адреса памяти
+        if ( size > 0x10000 )
+            fram_dev_shift = 2;
+        for ( dev = 1; dev < FRAM_DEVICES_MAX; dev++ ) {
+            if ( HAL_I2C_IsDeviceReady( &hi2c1, FRAM_ID_ADDR | ( dev << fram_dev_shift ), 3, FRAM_TIMEOUT ) != HAL_OK )
+                break;
            }
-        if ( !error_cnt )
-            UartSendStr( "Compare: OK\r\n" );
+        fram_devices = dev;
        }
-    UartSendStr( (char *)msg_crlr );
-    //снимаем блокировку FRAM
-    osMutexRelease( fram_mutex );
+    fram_size = fram_dev_size * fram_devices;
+    //размещение журнала, при достаточном размере FRAM после журнала размещается область итогов
+    size = fram_size - FRAM_ADDR_LOG;
+    if ( fram_size >= FRAM_ROLL_MIN )
+        size -= ROLL_BLOCKS * FRAM_BLOCK_SIZE;
+    size /= LOG_SEG_SIZE;
+    log_segments = size > LOG_SEGMENTS_MAX ? LOG_SEGMENTS_MAX : size;
+    roll_addr = fram_size >= FRAM_ROLL_MIN ? FRAM_ADDR_LOG + log_segments * LOG_SEG_SIZE : 0;
+ }
+
+//*************************************************************************************************
+// Проверка повторения адресов FRAM памяти: байт по адресу size + FRAM_PROBE_ADDR инвертируется
+// и сравнивается с байтом по адресу FRAM_PROBE_ADDR, после проверки значение восстанавливается.
+// При повторении адресов временно изменяется байт области журнала, а не текущих параметров.
+// Выполняется без IT/DMA.
+//-------------------------------------------------------------------------------------------------
+// uint32_t size - проверяемый размер микросхемы
+// return = true - адреса повторяются (или нет ответа), размер микросхемы = size
+//*************************************************************************************************
+static bool FramAlias( uint32_t size ) {
+
+    uint16_t dev_addr, mem_addr;
+    uint8_t base, check, value, test;
+
+    //адрес микросхемы со старшим битом адреса памяти (для 17-бит адреса)
+    dev_addr = FRAM_ID_ADDR | ( ( ( ( size + FRAM_PROBE_ADDR ) >> 16 ) & 0x01 ) << 1 );
+    mem_addr = ( size + FRAM_PROBE_ADDR ) & 0xFFFF;
+    if ( HAL_I2C_Mem_Read( &hi2c1, FRAM_ID_ADDR, FRAM_PROBE_ADDR, I2C_MEMADD_SIZE_16BIT, &base, 1, FRAM_TIMEOUT ) != HAL_OK ||
+         HAL_I2C_Mem_Read( &hi2c1, dev_addr, mem_addr, I2C_MEMADD_SIZE_16BIT, &value, 1, FRAM_TIMEOUT ) != HAL_OK )
+        return true;
+    test = value ^ 0xFF;
+    if ( HAL_I2C_Mem_Write( &hi2c1, dev_addr, mem_addr, I2C_MEMADD_SIZE_16BIT, &test, 1, FRAM_TIMEOUT ) != HAL_OK )
+        return true;
+    check = base;
+    HAL_I2C_Mem_Read( &hi2c1, FRAM_ID_ADDR, FRAM_PROBE_ADDR, I2C_MEMADD_SIZE_16BIT, &check, 1, FRAM_TIMEOUT );
+    //восстановление значения, при повторении адресов восстанавливается и адрес FRAM_PROBE_ADDR
+    HAL_I2C_Mem_Write( &hi2c1, dev_addr, mem_addr, I2C_MEMADD_SIZE_16BIT, &value, 1, FRAM_TIMEOUT );
+    return check != base;
+ }
+
+//*************************************************************************************************
+// Адрес микросхемы FRAM и адрес в памяти микросхемы по адресу в общем адресном пространстве
+//-------------------------------------------------------------------------------------------------
+// uint32_t mem_addr - адрес FRAM памяти
+// uint16_t *dev_mem - адрес в памяти микросхемы (младшие 16 бит)
+// uint32_t *span    - кол-во байт до границы микросхемы (страницы 64 кбайт) для одной операции
+// return            - адрес микросхемы на шине I2C
+//*************************************************************************************************
+static uint16_t FramDevAddr( uint32_t mem_addr, uint16_t *dev_mem, uint32_t *span ) {
+
+    uint32_t local, window;
+
+    local = mem_addr % fram_dev_size;
+    window = fram_dev_size < 0x10000 ? fram_dev_size : 0x10000;
+    *dev_mem = local & 0xFFFF;
+    *span = window - local % window;
+    return FRAM_ID_ADDR | ( ( mem_addr / fram_dev_size ) << fram_dev_shift ) | ( ( local >> 16 ) << 1 );
  }
 
 //*************************************************************************************************
 // Чтение блока данных из FRAM памяти с использованием DMA
 //-------------------------------------------------------------------------------------------------
-// uint16_t mem_addr - адрес чтения из FRAM
+// uint32_t mem_addr - адрес чтения из FRAM
 // uint8_t *ptr_dta  - указатель на адрес размещения прочитанного блока данных
 // uint16_t len      - размер читаемого блока данных
 // return FramStatus - результат выполнения
 //*************************************************************************************************
-static FramStatus FRAMRead( uint16_t mem_addr, uint8_t *ptr_data, uint16_t len ) {
+static FramStatus FRAMRead( uint32_t mem_addr, uint8_t *ptr_data, uint16_t len ) {
 
-    FramStatus status;
+    uint32_t span;
+    FramStatus status = FRAM_OK;
+    uint16_t dev_addr, dev_mem, part;
     
-    status = (FramStatus)HAL_I2C_Mem_Read_DMA( &hi2c1, FRAM_ID_ADDR, mem_addr, I2C_MEMADD_SIZE_16BIT, ptr_data, len );
-    if ( status == FRAM_OK )
-        osSemaphoreAcquire( sem_read, osWaitForever ); //ждем завершения чтения
+    //последовательное чтение, на границе микросхемы чтение продолжается следующей операцией
+    while ( len && status == FRAM_OK ) {
+        dev_addr = FramDevAddr( mem_addr, &dev_mem, &span );
+        part = span < len ? span : len;
+        status = I2CRead( dev_addr, dev_mem, ptr_data, part );
+        mem_addr += part;
+        ptr_data += part;
+        len -= part;
+       }
     return status;
  }
 
 //*************************************************************************************************
 // Запись данных в FRAM память с использованием DMA
 //-------------------------------------------------------------------------------------------------
-// uint16_t mem_addr - адрес записи в FRAM
+// uint32_t mem_addr - адрес записи в FRAM
 // uint8_t *ptr_dta  - указатель на адрес размещения прочитанного блока данных
 // uint16_t len      - размер записываемого блока данных
 // return FramStatus - результат выполнения
 //*************************************************************************************************
-static FramStatus FRAMSave( uint16_t mem_addr, uint8_t *ptr_data, uint16_t len ) {
+static FramStatus FRAMSave( uint32_t mem_addr, uint8_t *ptr_data, uint16_t len ) {
 
-    FramStatus status;
+    uint32_t span;
+    FramStatus status = FRAM_OK;
+    uint16_t dev_addr, dev_mem, part;
     
-    status = (FramStatus)HAL_I2C_Mem_Write_DMA( &hi2c1, FRAM_ID_ADDR, mem_addr, I2C_MEMADD_SIZE_16BIT, ptr_data, len );
-    if ( status == FRAM_OK )
-        osSemaphoreAcquire( sem_save, osWaitForever ); //ждем завершения записи
+    while ( len && status == FRAM_OK ) {
+        dev_addr = FramDevAddr( mem_addr, &dev_mem, &span );
+        part = span < len ? span : len;
+        status = I2CWrite( dev_addr, dev_mem, ptr_data, part );
+        mem_addr += part;
+        ptr_data += part;
+        len -= part;
+       }
     return status;
  }
 
 //*************************************************************************************************
-// CallBack функция завершения записи данных в FRAM через DMA
+// Функция возвращает код ошибки при чтения/записи по I2C при инициализации контроллера
+//-------------------------------------------------------------------------------------------------
+// FramErrorType type - тип ошибки (чтения/запись)
+// return FramStatus  - код ошибки
 //*************************************************************************************************
-void HAL_I2C_MemTxCpltCallback( I2C_HandleTypeDef *hi2c ) {
-
-    osSemaphoreRelease( sem_save );
- }
+FramStatus FramError( FramErrorType type ) {
 
-//*************************************************************************************************
-// CallBack функция завершения чтения данных из FRAM через DMA
-//*************************************************************************************************
-void HAL_I2C_MemRxCpltCallback( I2C_HandleTypeDef *hi2c ) {
-    
-    osSemaphoreRelease( sem_read );
+    if ( type == FRAM_ERR_READ )
+        return fram_error_rd;
+    else return fram_error_wr;
  }
 
 //*************************************************************************************************
-// CallBack функция ошибки обмена по I2C
+// Возвращает признак запрета записи текущих параметров после ошибки чтения при включении
 //*************************************************************************************************
-void HAL_I2C_ErrorCallback( I2C_HandleTypeDef *hi2c ) {
+bool FramDataHold( void ) {
 
-    uint32_t code;
-    
-    code = hi2c->ErrorCode;
-    memset( buffer1, 0x00, sizeof( buffer1 ) );
-    strcat( buffer1, "ErrorCallback: " );
-    if ( code & HAL_I2C_ERROR_NONE )
-        strcat( buffer1, error_dma[ERROR_I2C_OK] );
-    if ( code & HAL_I2C_ERROR_BERR )
-        strcat( buffer1, error_dma[ERROR_I2C_BERR] );
-    if ( code & HAL_I2C_ERROR_ARLO )
-        strcat( buffer1, error_dma[ERROR_I2C_ARLO] );
-    if ( code & HAL_I2C_ERROR_AF )
-        strcat( buffer1, error_dma[ERROR_I2C_AF] );
-    if ( code & HAL_I2C_ERROR_OVR )
-        strcat( buffer1, error_dma[ERROR_I2C_OVR] );
-    if ( code & HAL_I2C_ERROR_DMA )
-        strcat( buffer1, error_dma[ERROR_I2C_DMA_TRANFER] );
-    if ( code & HAL_I2C_ERROR_TIMEOUT )
-        strcat( buffer1, error_dma[ERROR_I2C_TIMEOUT] );
-    if ( code & HAL_I2C_ERROR_SIZE )
-        strcat( buffer1, error_dma[ERROR_I2C_SIZE] );
-    if ( code & HAL_I2C_ERROR_DMA_PARAM )
-        strcat( buffer1, error_dma[ERROR_I2C_DMA_PARAM] );
-    if ( code & HAL_I2C_WRONG_START )
-        strcat( buffer1, error_dma[ERROR_I2C_START] );
-    strcat( buffer1, "\r\n" );
-    UartSendStr( buffer1 );
+    return data_hold;
  }
 
 //*************************************************************************************************
-// Функция возвращает код ошибки при чтения/записи по I2C при инициализации контроллера
+// Повторное чтение блоков текущих параметров после ошибки чтения при включении, при успешном
+// чтении запись текущих параметров разрешается
 //-------------------------------------------------------------------------------------------------
-// FramErrorType type - тип ошибки (чтения/запись)
-// return FramStatus  - код ошибки
+// CURR_DATA *data   - указатель для размещения прочитанных значений (значения сохраненные
+//                     до включения или нулевые значения при ошибке КС в обоих блоках)
+// return FramStatus - результат чтения, FRAM_OK - данные прочитаны, запись разрешена
 //*************************************************************************************************
-FramStatus FramError( FramErrorType type ) {
+FramStatus FramDataRecover( CURR_DATA *data ) {
 
-    if ( type == FRAM_ERR_READ )
-        return fram_error_rd;
-    else return fram_error_wr;
+    int8_t slot;
+    FramStatus status;
+    FRAM_DATA data_slots[FRAM_DATA_SLOTS];
+
+    if ( data_hold == false )
+        return FRAM_ERROR_PARAM;
+    osMutexAcquire( fram_mutex, osWaitForever ); //устанавливаем блокировку
+    status = FRAMRead( FRAM_ADDR_DATA, (uint8_t *)&data_slots, sizeof( data_slots ) );
+    if ( status == FRAM_OK ) {
+        slot = DataSlotSelect( data_slots );
+        fram_error_rd = FRAM_OK;
+        DataSlotInit( data_slots, slot, data );
+        data_hold = false;
+       }
+    osMutexRelease( fram_mutex ); //снимаем блокировку
+    return status;
  }
 
 //*************************************************************************************************
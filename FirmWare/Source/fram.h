@@ -5,14 +5,41 @@
 #include "config.h"
 #include "water.h"
 
-#define FRAM_SIZE           2048                        //размер FRAM памяти (байт)
+//Размер FRAM памяти определяется при включении FramInit(): FM24CL16 ... FM24V10 (17-бит адрес,
+//старший бит адреса передается в адресе микросхемы), несколько одинаковых микросхем на шине
+//образуют одно адресное пространство
+#define FRAM_SIZE_MIN       2048                        //минимальный размер FRAM памяти (байт)
+#define FRAM_SIZE_MAX       0x20000                     //максимальный размер одной микросхемы (байт)
+#define FRAM_DEVICES_MAX    4                           //макс. кол-во микросхем FRAM на шине
 
 #define FRAM_ADDR_DATA      0x0000                      //адрес хранения текущих параметров расхода воды
-#define FRAM_ADDR_LOG       0x0020                      //адрес хранения событий и интервальных данных расхода воды
+#define FRAM_ADDR_LOG       0x0040                      //адрес хранения событий и интервальных данных расхода воды
 
 #define FRAM_BLOCK_SIZE     32                          //размер логического блока данных (байт)
+#define FRAM_DATA_SLOTS     2                           //кол-во чередующихся блоков текущих параметров
 
-#define FRAM_BLOCKS         (FRAM_SIZE/FRAM_BLOCK_SIZE) //кол-во доступных блоков в FRAM, в т.ч. для текущих данных
+//Журнал хранится сегментами из нескольких блоков: первая запись сегмента - опорная (полные
+//значения), остальные - разностные записи переменной длины относительно предыдущей записи.
+//Кол-во сегментов зависит от размера FRAM (FramLogSegments()), ограничено размером индекса в RAM
+#define LOG_SEG_BLOCKS      4                           //кол-во блоков в сегменте журнала
+#define LOG_SEG_SIZE        (LOG_SEG_BLOCKS*FRAM_BLOCK_SIZE) //размер сегмента журнала (байт)
+#define LOG_SEGMENTS_MAX    64                          //макс. кол-во сегментов журнала (15 байт RAM на сегмент)
+#define LOG_SEG_RECORDS     32                          //макс. кол-во записей в сегменте
+#define LOG_RECORDS_MAX     (LOG_SEGMENTS_MAX*LOG_SEG_RECORDS) //макс. кол-во записей журнала
+
+//Ссылка на запись журнала: адрес первого блока сегмента + номер записи в сегменте
+#define LOG_REF( seg, slot )    ( FRAM_ADDR_LOG + (seg) * LOG_SEG_SIZE + (slot) )
+#define LOG_REF_SEG( ref )      ( ( (ref) - FRAM_ADDR_LOG ) / LOG_SEG_SIZE )
+#define LOG_REF_SLOT( ref )     ( (ref) & ( LOG_SEG_RECORDS - 1 ) )
+
+//Итоги расхода по дням/месяцам/годам хранятся в отдельной области сразу после журнала: блок
+//состояния + кольцевые таблицы итогов (по одному блоку на период), адрес области - FramRollAddr(),
+//при размере FRAM менее FRAM_ROLL_MIN область не выделяется
+#define ROLL_DAYS           62                          //кол-во хранимых итогов за сутки
+#define ROLL_MONTHS         24                          //кол-во хранимых итогов за месяц
+#define ROLL_YEARS          9                           //кол-во хранимых итогов за год
+#define ROLL_BLOCKS         ( 1 + ROLL_DAYS + ROLL_MONTHS + ROLL_YEARS ) //кол-во блоков области итогов
+#define FRAM_ROLL_MIN       8192                        //мин. размер FRAM для хранения итогов (байт)
 
 //Результат выполнения операций с FRAM памятью
 typedef enum {
@@ -36,6 +63,22 @@ typedef enum {
     WATER_DATA_LOG                                      //аварийные события, журнал текущих данных
 } TypeData;
 
+//Результат проверки блока FRAM фоновой проверкой FramScrubBlock()
+typedef enum {
+    FRAM_SCRUB_OK,                                      //КС блока совпадает
+    FRAM_SCRUB_FREE,                                    //блок свободен (очищен)
+    FRAM_SCRUB_TRANSIENT,                               //ошибка КС не подтверждена повторным чтением
+    FRAM_SCRUB_REPAIRED,                                //блок восстановлен из копии в RAM
+    FRAM_SCRUB_SLOT,                                    //блок текущих параметров поврежден, блок
+                                                        //выбран для следующей записи текущих параметров
+    FRAM_SCRUB_CLEARED,                                 //поврежденный блок итогов расхода очищен
+    FRAM_SCRUB_BAD,                                     //блок поврежден, восстановление невозможно
+    FRAM_SCRUB_ERROR                                    //ошибка чтения/записи FRAM
+} FramScrub;
+
+//Функция обработки записи журнала при чтении сегмента, возврат "false" - прекращение чтения
+typedef bool (*LogReadCb)( uint16_t ref, WATER_LOG *wtr_log, void *arg );
+
 //*************************************************************************************************
 // Функции управления
 //*************************************************************************************************
@@ -46,8 +89,21 @@ void FramTest( void );
 void FramHexDump( uint8_t blocks );
 char *FramErrorDesc( FramStatus error );
 FramStatus FramError( FramErrorType type );
+bool FramDataHold( void );
+FramStatus FramDataRecover( CURR_DATA *data );
 FramStatus FramReadData( uint16_t addr, uint8_t *ptr_data, uint16_t len );
+FramStatus FramReadBlocks( uint32_t addr, uint8_t cnt, uint8_t *data, FramStatus *crc_status );
 FramStatus FramSaveData( TypeData type, uint8_t *ptr_data, uint16_t len );
+FramStatus FramSaveBlock( uint32_t addr, uint8_t *ptr_data, uint16_t len );
+FramScrub FramScrubBlock( uint32_t addr );
+FramStatus FramReadLog( uint16_t ref, WATER_LOG *wtr_log );
+FramStatus FramReadSeg( uint8_t seg, uint8_t slot, LogReadCb cb, void *arg );
+void FramLogReset( void );
+uint32_t FramSize( void );
+uint8_t FramDevices( void );
+uint8_t FramLogSegments( void );
+uint32_t FramRollAddr( void );
+uint32_t FramAreaEnd( void );
 
 #endif
 
@@ -0,0 +1,371 @@
+//*************************************************************************************************
+//
+// Обмен данными с FRAM памятью по шине I2C: операции DMA с ограниченным временем ожидания,
+// повтор операций с увеличением паузы, восстановление "зависшей" шины
+//
+//*************************************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "cmsis_os2.h"
+
+#include "main.h"
+#include "i2cbus.h"
+#include "uart.h"
+#include "parse.h"
+#include "message.h"
+
+//*************************************************************************************************
+// Внешние переменные
+//*************************************************************************************************
+extern I2C_HandleTypeDef hi2c1;
+
+//*************************************************************************************************
+// Локальные константы
+//*************************************************************************************************
+#define I2C_PORT                GPIOB       //порт выводов шины I2C1
+#define I2C_SCL_PIN             GPIO_PIN_6  //вывод SCL
+#define I2C_SDA_PIN             GPIO_PIN_7  //вывод SDA
+
+#define I2C_WAIT_MIN            5           //мин. время ожидания завершения операции (ms)
+#define I2C_CLEAR_CLOCKS        9           //кол-во тактов SCL для освобождения шины
+#define I2C_CLEAR_DELAY         5           //полупериод SCL при восстановлении шины (мкс)
+
+//ошибки шины, после которых выполняется восстановление шины
+#define I2C_ERROR_BUS           ( HAL_I2C_ERROR_BERR | HAL_I2C_ERROR_ARLO | HAL_I2C_ERROR_OVR | \
+                                  HAL_I2C_ERROR_DMA | HAL_I2C_ERROR_TIMEOUT )
+
+//Тип операции
+typedef enum {
+    I2C_OPER_READ,                          //чтение
+    I2C_OPER_WRITE                          //запись
+ } I2COper;
+
+//Индексы ошибок обмена данными по I2C
+typedef enum {
+    ERROR_I2C_BERR,
+    ERROR_I2C_ARLO,
+    ERROR_I2C_AF,
+    ERROR_I2C_OVR,
+    ERROR_I2C_DMA_TRANFER,
+    ERROR_I2C_TIMEOUT,
+    ERROR_I2C_SIZE,
+    ERROR_I2C_DMA_PARAM,
+    ERROR_I2C_START
+ } ERROR_I2C;
+
+//Расшифровка ошибок функций обмена данными по I2C
+static char * const error_dma[] = {
+    "BERR error ",
+    "ARLO error ",
+    "AF error ",
+    "OVR error ",
+    "DMA transfer error ",
+    "Timeout Error ",
+    "Size Management error ",
+    "DMA Parameter Error ",
+    "Wrong start Error "
+ };
+
+//Коды ошибок HAL в порядке индексов ERROR_I2C
+static const uint32_t error_code[] = {
+    HAL_I2C_ERROR_BERR,
+    HAL_I2C_ERROR_ARLO,
+    HAL_I2C_ERROR_AF,
+    HAL_I2C_ERROR_OVR,
+    HAL_I2C_ERROR_DMA,
+    HAL_I2C_ERROR_TIMEOUT,
+    HAL_I2C_ERROR_SIZE,
+    HAL_I2C_ERROR_DMA_PARAM,
+    HAL_I2C_WRONG_START
+ };
+
+static char * const stat_desc[] = {
+    "Read operations",
+    "Write operations",
+    "No acknowledge (AF)",
+    "Bus errors (BERR, ARLO, OVR, DMA)",
+    "Operations timed out",
+    "Operations retried",
+    "Bus recoveries",
+    "Operations failed after retries",
+    "Last read time (us)",
+    "Max read time (us)",
+    "Last write time (us)",
+    "Max write time (us)"
+ };
+
+//*************************************************************************************************
+// Локальные переменные
+//*************************************************************************************************
+static char buffer[160];
+static osSemaphoreId_t sem_done = NULL;
+static volatile uint32_t bus_error;         //коды ошибок HAL последней операции
+static uint32_t i2c_stat[I2C_STAT_CNT];     //статистика обмена
+
+static const osSemaphoreAttr_t sem_attr = { .name = "I2CSem" };
+
+//*************************************************************************************************
+// Прототипы локальные функций
+//*************************************************************************************************
+static FramStatus I2CTransfer( I2COper oper, uint16_t dev_addr, uint16_t mem_addr, uint8_t *data, uint16_t len );
+static FramStatus I2CExec( I2COper oper, uint16_t dev_addr, uint16_t mem_addr, uint8_t *data, uint16_t len );
+
+//*************************************************************************************************
+// Инициализация: семафор ожидания завершения операций DMA, счетчик тактов для измерения времени
+// выполнения операций. Если SDA удерживается ведомым устройством (сброс контроллера во время
+// чтения) - выполняется восстановление шины.
+//*************************************************************************************************
+void I2CBusInit( void ) {
+
+    sem_done = osSemaphoreNew( 1, 0, &sem_attr );
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    if ( HAL_GPIO_ReadPin( I2C_PORT, I2C_SDA_PIN ) == GPIO_PIN_RESET )
+        I2CBusClear();
+ }
+
+//*************************************************************************************************
+// Чтение данных из FRAM памяти с использованием DMA
+//-------------------------------------------------------------------------------------------------
+// uint16_t dev_addr - адрес микросхемы на шине I2C
+// uint16_t mem_addr - адрес в памяти микросхемы
+// uint8_t *data     - указатель для размещения прочитанных данных
+// uint16_t len      - кол-во байт
+// return FramStatus - результат выполнения
+//*************************************************************************************************
+FramStatus I2CRead( uint16_t dev_addr, uint16_t mem_addr, uint8_t *data, uint16_t len ) {
+
+    return I2CTransfer( I2C_OPER_READ, dev_addr, mem_addr, data, len );
+ }
+
+//*************************************************************************************************
+// Запись данных в FRAM память с использованием DMA
+//-------------------------------------------------------------------------------------------------
+// uint16_t dev_addr - адрес микросхемы на шине I2C
+// uint16_t mem_addr - адрес в памяти микросхемы
+// uint8_t *data     - указатель на записываемые данные
+// uint16_t len      - кол-во байт
+// return FramStatus - результат выполнения
+//*************************************************************************************************
+FramStatus I2CWrite( uint16_t dev_addr, uint16_t mem_addr, uint8_t *data, uint16_t len ) {
+
+    return I2CTransfer( I2C_OPER_WRITE, dev_addr, mem_addr, data, len );
+ }
+
+//*************************************************************************************************
+// Выполнение операции с повторами: перед каждым повтором пауза увеличивается в 2 раза,
+// после ошибок шины выполняется восстановление шины (после превышения времени ожидания
+// шина восстанавливается в I2CExec())
+//-------------------------------------------------------------------------------------------------
+// I2COper oper      - тип операции
+// uint16_t dev_addr - адрес микросхемы на шине I2C
+// uint16_t mem_addr - адрес в памяти микросхемы
+// uint8_t *data     - указатель на данные
+// uint16_t len      - кол-во байт
+// return FramStatus - результат выполнения
+//*************************************************************************************************
+static FramStatus I2CTransfer( I2COper oper, uint16_t dev_addr, uint16_t mem_addr, uint8_t *data, uint16_t len ) {
+
+    char *ptr;
+    uint8_t i, retry;
+    uint32_t start, time;
+    FramStatus status;
+
+    start = DWT->CYCCNT;
+    i2c_stat[oper == I2C_OPER_READ ? I2C_STAT_READ : I2C_STAT_WRITE]++;
+    for ( retry = 0; ; retry++ ) {
+        status = I2CExec( oper, dev_addr, mem_addr, data, len );
+        if ( status == FRAM_OK || retry >= I2C_RETRY_MAX )
+            break;
+        i2c_stat[I2C_STAT_RETRY]++;
+        if ( status == FRAM_BUSY || ( status != FRAM_TIMEOUT && ( bus_error & I2C_ERROR_BUS ) ) )
+            I2CBusClear();
+        osDelay( I2C_BACKOFF << retry );
+       }
+    //время выполнения с учетом повторов
+    time = ( DWT->CYCCNT - start ) / ( SystemCoreClock / 1000000 );
+    if ( oper == I2C_OPER_READ ) {
+        i2c_stat[I2C_STAT_RD_LAST] = time;
+        if ( time > i2c_stat[I2C_STAT_RD_MAX] )
+            i2c_stat[I2C_STAT_RD_MAX] = time;
+       }
+    else {
+        i2c_stat[I2C_STAT_WR_LAST] = time;
+        if ( time > i2c_stat[I2C_STAT_WR_MAX] )
+            i2c_stat[I2C_STAT_WR_MAX] = time;
+       }
+    if ( status == FRAM_OK )
+        return status;
+    i2c_stat[I2C_STAT_FAIL]++;
+    //расшифровка ошибки выводится в контексте задачи
+    ptr = buffer;
+    ptr += sprintf( ptr, "I2C %s error: 0x%02X:0x%04X %s ", oper == I2C_OPER_READ ? "read" : "write",
+                    dev_addr, mem_addr, FramErrorDesc( status ) );
+    for ( i = 0; i < SIZE_ARRAY( error_code ); i++ ) {
+        if ( bus_error & error_code[i] )
+            ptr += sprintf( ptr, "%s", error_dma[i] );
+       }
+    sprintf( ptr, "\r\n" );
+    UartSendStr( buffer );
+    return status;
+ }
+
+//*************************************************************************************************
+// Однократное выполнение операции, время ожидания зависит от кол-ва байт. При превышении
+// времени ожидания операция прерывается восстановлением шины: канал DMA отключается до
+// возврата, данные в буфер вызывающей функции после возврата не передаются.
+//-------------------------------------------------------------------------------------------------
+// I2COper oper      - тип операции
+// uint16_t dev_addr - адрес микросхемы на шине I2C
+// uint16_t mem_addr - адрес в памяти микросхемы
+// uint8_t *data     - указатель на данные
+// uint16_t len      - кол-во байт
+// return FramStatus - результат выполнения
+//*************************************************************************************************
+static FramStatus I2CExec( I2COper oper, uint16_t dev_addr, uint16_t mem_addr, uint8_t *data, uint16_t len ) {
+
+    uint32_t wait;
+    HAL_StatusTypeDef status;
+
+    //сброс семафора после операции, завершенной по превышению времени ожидания
+    osSemaphoreAcquire( sem_done, 0 );
+    bus_error = HAL_I2C_ERROR_NONE;
+    if ( oper == I2C_OPER_READ )
+        status = HAL_I2C_Mem_Read_DMA( &hi2c1, dev_addr, mem_addr, I2C_MEMADD_SIZE_16BIT, data, len );
+    else status = HAL_I2C_Mem_Write_DMA( &hi2c1, dev_addr, mem_addr, I2C_MEMADD_SIZE_16BIT, data, len );
+    if ( status != HAL_OK ) {
+        bus_error = hi2c1.ErrorCode;
+        if ( bus_error & HAL_I2C_ERROR_AF )
+            i2c_stat[I2C_STAT_NACK]++;
+        else i2c_stat[I2C_STAT_BUS]++;
+        return (FramStatus)status;
+       }
+    //время передачи: адрес микросхемы, 2 байта адреса памяти, данные - по 9 тактов SCL
+    wait = I2C_WAIT_MIN + ( ( len + 4 ) * 9 * 1000 ) / I2C_SPEED;
+    if ( osSemaphoreAcquire( sem_done, wait ) != osOK ) {
+        i2c_stat[I2C_STAT_TIMEOUT]++;
+        //HAL_I2C_DeInit() отключает каналы DMA, сброс периферии I2C и условие STOP
+        I2CBusClear();
+        return FRAM_TIMEOUT;
+       }
+    if ( bus_error == HAL_I2C_ERROR_NONE )
+        return FRAM_OK;
+    if ( bus_error & HAL_I2C_ERROR_AF )
+        i2c_stat[I2C_STAT_NACK]++;
+    else i2c_stat[I2C_STAT_BUS]++;
+    return FRAM_ERROR;
+ }
+
+//*************************************************************************************************
+// Восстановление шины I2C: если ведомое устройство удерживает SDA (прерванная операция чтения),
+// формируется до 9 тактов SCL до освобождения SDA, затем условие STOP. Периферия I2C
+// сбрасывается и инициализируется повторно (ошибка STM32F10x: флаг BUSY остается установленным).
+//*************************************************************************************************
+void I2CBusClear( void ) {
+
+    uint8_t i;
+    GPIO_InitTypeDef gpio = { 0 };
+
+    i2c_stat[I2C_STAT_RECOVERY]++;
+    //выводы SCL, SDA переключаются в режим GPIO с открытым стоком
+    HAL_I2C_DeInit( &hi2c1 );
+    HAL_GPIO_WritePin( I2C_PORT, I2C_SCL_PIN | I2C_SDA_PIN, GPIO_PIN_SET );
+    gpio.Pin = I2C_SCL_PIN | I2C_SDA_PIN;
+    gpio.Mode = GPIO_MODE_OUTPUT_OD;
+    gpio.Pull = GPIO_NOPULL;
+    gpio.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_Init( I2C_PORT, &gpio );
+    I2CDelay( I2C_CLEAR_DELAY );
+    for ( i = 0; i < I2C_CLEAR_CLOCKS && HAL_GPIO_ReadPin( I2C_PORT, I2C_SDA_PIN ) == GPIO_PIN_RESET; i++ ) {
+        HAL_GPIO_WritePin( I2C_PORT, I2C_SCL_PIN, GPIO_PIN_RESET );
+        I2CDelay( I2C_CLEAR_DELAY );
+        HAL_GPIO_WritePin( I2C_PORT, I2C_SCL_PIN, GPIO_PIN_SET );
+        I2CDelay( I2C_CLEAR_DELAY );
+       }
+    //условие STOP: переход SDA из "0" в "1" при SCL = "1"
+    HAL_GPIO_WritePin( I2C_PORT, I2C_SCL_PIN, GPIO_PIN_RESET );
+    I2CDelay( I2C_CLEAR_DELAY );
+    HAL_GPIO_WritePin( I2C_PORT, I2C_SDA_PIN, GPIO_PIN_RESET );
+    I2CDelay( I2C_CLEAR_DELAY );
+    HAL_GPIO_WritePin( I2C_PORT, I2C_SCL_PIN, GPIO_PIN_SET );
+    I2CDelay( I2C_CLEAR_DELAY );
+    HAL_GPIO_WritePin( I2C_PORT, I2C_SDA_PIN, GPIO_PIN_SET );
+    I2CDelay( I2C_CLEAR_DELAY );
+    //программный сброс периферии I2C, инициализация выводов и DMA выполняется в HAL_I2C_MspInit()
+    __HAL_RCC_I2C1_CLK_ENABLE();
+    hi2c1.Instance->CR1 |= I2C_CR1_SWRST;
+    hi2c1.Instance->CR1 &= ~I2C_CR1_SWRST;
+    HAL_I2C_Init( &hi2c1 );
+ }
+
+//*************************************************************************************************
+// Пауза по счетчику тактов ядра, не требует работы планировщика и прерываний
+//-------------------------------------------------------------------------------------------------
+// uint32_t usec - длительность паузы (мкс)
+//*************************************************************************************************
+void I2CDelay( uint32_t usec ) {
+
+    uint32_t start, cycles;
+
+    start = DWT->CYCCNT;
+    cycles = usec * ( SystemCoreClock / 1000000 );
+    while ( ( DWT->CYCCNT - start ) < cycles );
+ }
+
+//*************************************************************************************************
+// CallBack функция завершения записи данных в FRAM через DMA
+//*************************************************************************************************
+void HAL_I2C_MemTxCpltCallback( I2C_HandleTypeDef *hi2c ) {
+
+    osSemaphoreRelease( sem_done );
+ }
+
+//*************************************************************************************************
+// CallBack функция завершения чтения данных из FRAM через DMA
+//*************************************************************************************************
+void HAL_I2C_MemRxCpltCallback( I2C_HandleTypeDef *hi2c ) {
+
+    osSemaphoreRelease( sem_done );
+ }
+
+//*************************************************************************************************
+// CallBack функция ошибки обмена по I2C, код ошибки обрабатывается в I2CExec()
+//*************************************************************************************************
+void HAL_I2C_ErrorCallback( I2C_HandleTypeDef *hi2c ) {
+
+    bus_error = hi2c->ErrorCode;
+    osSemaphoreRelease( sem_done );
+ }
+
+//*************************************************************************************************
+// CallBack функция завершения прерывания операции по I2C
+//*************************************************************************************************
+void HAL_I2C_AbortCpltCallback( I2C_HandleTypeDef *hi2c ) {
+
+    bus_error = hi2c->ErrorCode;
+    osSemaphoreRelease( sem_done );
+ }
+
+//*************************************************************************************************
+// Возвращает расшифровку и значения счетчиков статистики обмена по шине I2C
+//-------------------------------------------------------------------------------------------------
+// I2CStat index - индекс счетчика
+// char *str     - указатель для размещения результата
+// return        - указатель на строку с расшифровкой
+//*************************************************************************************************
+char *I2CStatDesc( I2CStat index, char *str ) {
+
+    char *ptr;
+
+    if ( index >= I2C_STAT_CNT )
+        return NULL;
+    ptr = str;
+    ptr += sprintf( ptr, "%s", stat_desc[index] );
+    //дополним расшифровку справа знаком "." до 45 символов
+    ptr += AddDot( str, 45, 0 );
+    ptr += sprintf( ptr, "%6u ", i2c_stat[index] );
+    return str;
+ }
@@ -0,0 +1,44 @@
+
+#ifndef __I2CBUS_H
+#define __I2CBUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "fram.h"
+
+#define I2C_SPEED               400000      //частота шины I2C (Гц), Fast-mode - максимальная
+                                            //для STM32F103
+
+#define I2C_RETRY_MAX           3           //кол-во повторов операции при ошибке
+#define I2C_BACKOFF             1           //пауза перед первым повтором (ms), каждый следующий
+                                            //повтор - пауза в 2 раза больше
+
+//Индексы счетчиков статистики обмена по шине I2C
+typedef enum {
+    I2C_STAT_READ,                          //кол-во операций чтения
+    I2C_STAT_WRITE,                         //кол-во операций записи
+    I2C_STAT_NACK,                          //кол-во ошибок "нет подтверждения" (AF)
+    I2C_STAT_BUS,                           //кол-во ошибок шины (BERR, ARLO, OVR, DMA)
+    I2C_STAT_TIMEOUT,                       //кол-во операций не завершенных за время ожидания
+    I2C_STAT_RETRY,                         //кол-во повторов операций
+    I2C_STAT_RECOVERY,                      //кол-во восстановлений шины
+    I2C_STAT_FAIL,                          //кол-во операций не выполненных после повторов
+    I2C_STAT_RD_LAST,                       //время выполнения последнего чтения (мкс)
+    I2C_STAT_RD_MAX,                        //макс. время выполнения чтения (мкс)
+    I2C_STAT_WR_LAST,                       //время выполнения последней записи (мкс)
+    I2C_STAT_WR_MAX,                        //макс. время выполнения записи (мкс)
+    I2C_STAT_CNT                            //кол-во счетчиков статистики
+ } I2CStat;
+
+//*************************************************************************************************
+// Функции управления
+//*************************************************************************************************
+void I2CBusInit( void );
+void I2CBusClear( void );
+void I2CDelay( uint32_t usec );
+FramStatus I2CRead( uint16_t dev_addr, uint16_t mem_addr, uint8_t *data, uint16_t len );
+FramStatus I2CWrite( uint16_t dev_addr, uint16_t mem_addr, uint8_t *data, uint16_t len );
+char *I2CStatDesc( I2CStat index, char *str );
+
+#endif
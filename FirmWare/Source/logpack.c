@@ -0,0 +1,265 @@
+//*************************************************************************************************
+//
+// Упаковка записей журнала: опорная запись с полными значениями и разностные записи
+// переменной длины относительно предыдущей записи
+//
+//*************************************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "logpack.h"
+#include "parse.h"
+#include "xtime.h"
+
+//*************************************************************************************************
+// Локальные константы
+//*************************************************************************************************
+//Признаки наличия полей в разностной записи (байт заголовка), приращение времени есть всегда
+#define LOG_DLT_COLD        0x01            //приращение счетчика холодной воды
+#define LOG_DLT_HOT         0x02            //приращение счетчика горячей воды
+#define LOG_DLT_FILTER      0x04            //приращение счетчика питьевой воды
+#define LOG_DLT_PRS_COLD    0x08            //изменение давления холодной воды
+#define LOG_DLT_PRS_HOT     0x10            //изменение давления горячей воды
+#define LOG_DLT_VALVE       0x20            //состояния электроприводов
+#define LOG_DLT_FLAGS       0x40            //состояния датчиков утечки, тип записи
+#define LOG_DLT_MIN         0x80            //приращение времени в минутах (кратно 60 сек)
+
+//*************************************************************************************************
+// Прототипы локальные функций
+//*************************************************************************************************
+static uint8_t PutVar( uint8_t *buff, uint32_t value );
+static uint8_t GetVar( uint8_t *buff, uint8_t len, uint32_t *value );
+static uint32_t ZigZag( int32_t value );
+static int32_t UnZigZag( uint32_t value );
+
+//*************************************************************************************************
+// Преобразование записи журнала в упакованный формат
+//-------------------------------------------------------------------------------------------------
+// WATER_LOG *wtr_log - указатель на запись журнала
+// LOG_PACK *pack     - указатель на запись в упакованном формате
+//*************************************************************************************************
+void LogPackGet( WATER_LOG *wtr_log, LOG_PACK *pack ) {
+
+    DATE_TIME dtime;
+
+    dtime.day = wtr_log->day;
+    dtime.month = wtr_log->month;
+    dtime.year = wtr_log->year;
+    dtime.hour = wtr_log->hour;
+    dtime.min = wtr_log->min;
+    dtime.sec = wtr_log->sec;
+    pack->seq = wtr_log->seq;
+    pack->time = DtimeToSec( &dtime );
+    pack->count[COUNT_COLD] = wtr_log->count_cold;
+    pack->count[COUNT_HOT] = wtr_log->count_hot;
+    pack->count[COUNT_FILTER] = wtr_log->count_filter;
+    pack->pressr[WATER_COLD] = wtr_log->pressr_cold;
+    pack->pressr[WATER_HOT] = wtr_log->pressr_hot;
+    pack->valve = wtr_log->stat_valve_cold | ( wtr_log->error_valve_cold << 2 ) |
+                  ( wtr_log->stat_valve_hot << 4 ) | ( wtr_log->error_valve_hot << 6 );
+    pack->flags = wtr_log->leak1 | ( wtr_log->leak2 << 1 ) | ( wtr_log->flow_leak << 2 ) |
+                  ( wtr_log->type_event << 5 ) | ( wtr_log->dc12_chk << 6 );
+ }
+
+//*************************************************************************************************
+// Преобразование записи журнала из упакованного формата
+//-------------------------------------------------------------------------------------------------
+// LOG_PACK *pack     - указатель на запись в упакованном формате
+// WATER_LOG *wtr_log - указатель на запись журнала
+//*************************************************************************************************
+void LogPackPut( LOG_PACK *pack, WATER_LOG *wtr_log ) {
+
+    DATE_TIME dtime;
+
+    memset( (uint8_t *)wtr_log, 0x00, sizeof( WATER_LOG ) );
+    SecToDtime( pack->time, &dtime );
+    wtr_log->day = dtime.day;
+    wtr_log->month = dtime.month;
+    wtr_log->year = dtime.year;
+    wtr_log->hour = dtime.hour;
+    wtr_log->min = dtime.min;
+    wtr_log->sec = dtime.sec;
+    wtr_log->seq = pack->seq;
+    wtr_log->count_cold = pack->count[COUNT_COLD];
+    wtr_log->count_hot = pack->count[COUNT_HOT];
+    wtr_log->count_filter = pack->count[COUNT_FILTER];
+    wtr_log->pressr_cold = pack->pressr[WATER_COLD];
+    wtr_log->pressr_hot = pack->pressr[WATER_HOT];
+    wtr_log->stat_valve_cold = (ValveStat)( pack->valve & 0x03 );
+    wtr_log->error_valve_cold = (ValveError)( ( pack->valve >> 2 ) & 0x03 );
+    wtr_log->stat_valve_hot = (ValveStat)( ( pack->valve >> 4 ) & 0x03 );
+    wtr_log->error_valve_hot = (ValveError)( ( pack->valve >> 6 ) & 0x03 );
+    wtr_log->leak1 = (LeakStat)( pack->flags & 0x01 );
+    wtr_log->leak2 = (LeakStat)( ( pack->flags >> 1 ) & 0x01 );
+    wtr_log->flow_leak = ( pack->flags >> 2 ) & 0x07;
+    wtr_log->type_event = (EventType)( ( pack->flags >> 5 ) & 0x01 );
+    wtr_log->dc12_chk = (DC12VStat)( ( pack->flags >> 6 ) & 0x01 );
+ }
+
+//*************************************************************************************************
+// Упаковка разностной записи: байт заголовка с признаками LOG_DLT_*, приращение времени и
+// изменившиеся значения. Приращения записываются числами переменной длины (7 бит в байте),
+// приращения со знаком предварительно преобразуются ZigZag. Порядковый номер записи не
+// сохраняется: номер разностной записи на 1 больше номера предыдущей записи.
+//-------------------------------------------------------------------------------------------------
+// LOG_PACK *prev  - предыдущая запись
+// LOG_PACK *rec   - упаковываемая запись
+// uint8_t *buff   - буфер для размещения записи, размер не менее LOG_PACK_MAX_SIZE
+// return          - размер упакованной записи
+//*************************************************************************************************
+uint8_t LogPackDelta( LOG_PACK *prev, LOG_PACK *rec, uint8_t *buff ) {
+
+    int32_t time;
+    uint8_t i, hdr = 0, len = 1;
+
+    //интервал записи журнала кратен минуте, приращение записывается в минутах
+    time = (int32_t)( rec->time - prev->time );
+    if ( !( time % 60 ) ) {
+        hdr |= LOG_DLT_MIN;
+        time /= 60;
+       }
+    len += PutVar( buff + len, ZigZag( time ) );
+    for ( i = 0; i < SIZE_ARRAY( rec->count ); i++ ) {
+        if ( rec->count[i] == prev->count[i] )
+            continue;
+        hdr |= LOG_DLT_COLD << i;
+        len += PutVar( buff + len, ZigZag( (int32_t)( rec->count[i] - prev->count[i] ) ) );
+       }
+    for ( i = 0; i < SIZE_ARRAY( rec->pressr ); i++ ) {
+        if ( rec->pressr[i] == prev->pressr[i] )
+            continue;
+        hdr |= LOG_DLT_PRS_COLD << i;
+        len += PutVar( buff + len, ZigZag( (int32_t)rec->pressr[i] - (int32_t)prev->pressr[i] ) );
+       }
+    if ( rec->valve != prev->valve ) {
+        hdr |= LOG_DLT_VALVE;
+        buff[len++] = rec->valve;
+       }
+    if ( rec->flags != prev->flags ) {
+        hdr |= LOG_DLT_FLAGS;
+        buff[len++] = rec->flags;
+       }
+    buff[0] = hdr;
+    return len;
+ }
+
+//*************************************************************************************************
+// Распаковка одной записи
+//-------------------------------------------------------------------------------------------------
+// uint8_t *buff  - указатель на упакованную запись
+// uint8_t len    - кол-во байт в буфере
+// bool key       - true - опорная запись, false - разностная запись
+// LOG_PACK *rec  - на входе предыдущая запись (для разностной записи), на выходе - распакованная
+// return         - размер упакованной записи, "0" - ошибка формата
+//*************************************************************************************************
+uint8_t LogUnpack( uint8_t *buff, uint8_t len, bool key, LOG_PACK *rec ) {
+
+    int32_t time;
+    uint8_t i, hdr, size, pos = 1;
+    uint32_t value;
+
+    if ( key == true ) {
+        if ( len < LOG_PACK_KEY_SIZE )
+            return 0;
+        memcpy( (uint8_t *)rec, buff, LOG_PACK_KEY_SIZE );
+        return LOG_PACK_KEY_SIZE;
+       }
+    if ( !len )
+        return 0;
+    hdr = buff[0];
+    //приращение времени
+    if ( !( size = GetVar( buff + pos, len - pos, &value ) ) )
+        return 0;
+    pos += size;
+    time = UnZigZag( value );
+    rec->time += ( hdr & LOG_DLT_MIN ? time * 60 : time );
+    //счетчики
+    for ( i = 0; i < SIZE_ARRAY( rec->count ); i++ ) {
+        if ( !( hdr & ( LOG_DLT_COLD << i ) ) )
+            continue;
+        if ( !( size = GetVar( buff + pos, len - pos, &value ) ) )
+            return 0;
+        pos += size;
+        rec->count[i] += UnZigZag( value );
+       }
+    //давление
+    for ( i = 0; i < SIZE_ARRAY( rec->pressr ); i++ ) {
+        if ( !( hdr & ( LOG_DLT_PRS_COLD << i ) ) )
+            continue;
+        if ( !( size = GetVar( buff + pos, len - pos, &value ) ) )
+            return 0;
+        pos += size;
+        rec->pressr[i] += UnZigZag( value );
+       }
+    //состояния
+    if ( hdr & LOG_DLT_VALVE ) {
+        if ( pos >= len )
+            return 0;
+        rec->valve = buff[pos++];
+       }
+    if ( hdr & LOG_DLT_FLAGS ) {
+        if ( pos >= len )
+            return 0;
+        rec->flags = buff[pos++];
+       }
+    rec->seq++;
+    return pos;
+ }
+
+//*************************************************************************************************
+// Запись числа переменной длины: 7 бит значения в байте, старший бит - признак продолжения
+//-------------------------------------------------------------------------------------------------
+// uint8_t *buff  - буфер для размещения значения (до 5 байт)
+// uint32_t value - значение
+// return         - кол-во записанных байт
+//*************************************************************************************************
+static uint8_t PutVar( uint8_t *buff, uint32_t value ) {
+
+    uint8_t len = 0;
+
+    while ( value >= 0x80 ) {
+        buff[len++] = (uint8_t)value | 0x80;
+        value >>= 7;
+       }
+    buff[len++] = (uint8_t)value;
+    return len;
+ }
+
+//*************************************************************************************************
+// Чтение числа переменной длины
+//-------------------------------------------------------------------------------------------------
+// uint8_t *buff   - указатель на значение
+// uint8_t len     - кол-во байт в буфере
+// uint32_t *value - указатель для размещения значения
+// return          - кол-во прочитанных байт, "0" - ошибка формата
+//*************************************************************************************************
+static uint8_t GetVar( uint8_t *buff, uint8_t len, uint32_t *value ) {
+
+    uint8_t i;
+
+    *value = 0;
+    for ( i = 0; i < len && i < 5; i++ ) {
+        *value |= (uint32_t)( buff[i] & 0x7F ) << ( 7 * i );
+        if ( !( buff[i] & 0x80 ) )
+            return i + 1;
+       }
+    return 0;
+ }
+
+//*************************************************************************************************
+// Преобразование значения со знаком для записи числом переменной длины: 0, -1, 1, -2 ... -> 0, 1, 2, 3 ...
+//*************************************************************************************************
+static uint32_t ZigZag( int32_t value ) {
+
+    return ( (uint32_t)value << 1 ) ^ (uint32_t)( value >> 31 );
+ }
+
+//*************************************************************************************************
+// Обратное преобразование ZigZag
+//*************************************************************************************************
+static int32_t UnZigZag( uint32_t value ) {
+
+    return (int32_t)( value >> 1 ) ^ -(int32_t)( value & 1 );
+ }
@@ -0,0 +1,36 @@
+
+#ifndef __LOGPACK_H
+#define __LOGPACK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "water.h"
+
+#define LOG_PACK_KEY_SIZE   sizeof( LOG_PACK )  //размер опорной записи (полные значения)
+#define LOG_PACK_MAX_SIZE   29                  //максимальный размер разностной записи
+
+#pragma pack( push, 1 )
+
+//Запись журнала в упакованном формате, используется как опорная запись сегмента журнала
+//и как состояние (предыдущая запись) при упаковке/распаковке разностных записей
+typedef struct {
+    uint32_t    seq;                        //порядковый номер записи журнала
+    uint32_t    time;                       //дата/время записи (сек от 01.01.1970)
+    uint32_t    count[3];                   //значения счетчиков холодной, горячей, питьевой воды
+    uint16_t    pressr[2];                  //давление холодной, горячей воды
+    uint8_t     valve;                      //состояния электроприводов
+    uint8_t     flags;                      //датчики утечки, микро-утечка, тип записи, контроль 12V
+ } LOG_PACK;
+
+#pragma pack( pop )
+
+//*************************************************************************************************
+// Функции управления
+//*************************************************************************************************
+void LogPackGet( WATER_LOG *wtr_log, LOG_PACK *pack );
+void LogPackPut( LOG_PACK *pack, WATER_LOG *wtr_log );
+uint8_t LogPackDelta( LOG_PACK *prev, LOG_PACK *rec, uint8_t *buff );
+uint8_t LogUnpack( uint8_t *buff, uint8_t len, bool key, LOG_PACK *rec );
+
+#endif
@@ -35,9 +35,8 @@ extern TIM_HandleTypeDef htim2;
 extern UART_HandleTypeDef huart3;
 
 extern const uint8_t func_access[];
-extern const RegsRead regs_read[];
-extern const RegsRead regs_write[];
-extern const ValueValid val_valid[];
+extern const RegDesc reg_desc[];
+extern const DevIdDesc devid_desc[];
 
 //*************************************************************************************************
 // Локальные константы
@@ -65,23 +64,78 @@ static char * const error_descr[] = {
 static char str[120];
 #endif
 static uint32_t recv_total, error_cnt[SIZE_ARRAY( error_descr )]; //счетчики ошибок протокола
+static uint8_t reg_index[MBUS_REG_CNT];     //индекс описания значения в reg_desc[] по адресу регистра
+static uint8_t reg_value[MBUS_VALUE_MAX * sizeof( uint16_t )]; //буфер формирования значения
+static uint16_t live_image[MBUS_LIVE_CNT];  //образ текущих значений в порядке передачи (HI/LO)
+static volatile uint32_t live_seq;          //версия образа, нечетное значение - идет обновление
 
 //*************************************************************************************************
 // Прототипы локальных функций
 //*************************************************************************************************
 static ModbusRequst TypeRequst( uint8_t func_id );
 static ErrorStatus ChkFuncValid( uint8_t func_id, const uint8_t *list );
-static ErrorStatus ChkRegValid( MBUS_REQ *reqst, const RegsRead *list );
-static ErrorStatus ChkRegValue( MBUS_REQ *reqst, const ValueValid *list );
+static const RegDesc *RegFind( uint16_t reg_addr );
+static ErrorStatus ChkRegValid( MBUS_REQ *reqst, uint8_t access );
+static ErrorStatus ChkRegValue( MBUS_REQ *reqst );
+static uint8_t RegRead( MBUS_REQ *reqst, uint8_t *data );
+static void LiveRead( uint16_t reg_addr, uint8_t cnt, uint8_t *data );
 static ErrorStatus RegWrite( MBUS_REQ *reqst );
 static ModbusAddrReg ModBusAddr( uint8_t func );
+static const DevIdDesc *DevIdFind( uint8_t object_id );
+static uint8_t DevIdRead( MBUS_REQ *reqst, uint8_t *data );
 
 //*************************************************************************************************
 // Инициализация протокола
 //*************************************************************************************************
 void ModBusInit( void ) {
 
+    uint8_t idx, reg;
+    uint16_t next = 0;
+
     ModBusErrClr();
+    //индекс описания значения по адресу регистра
+    memset( reg_index, REG_NONE, sizeof( reg_index ) );
+    for ( idx = 0; reg_desc[idx].id_reg != REG_END; idx++ ) {
+        //значения по возрастанию адресов без перекрытия, в пределах MBUS_REG_CNT, кол-во
+        //значений меньше REG_NONE: ошибка таблицы reg_desc[] - останов контроллера
+        if ( idx >= REG_NONE || reg_desc[idx].id_reg < next || !reg_desc[idx].width ||
+             reg_desc[idx].id_reg + reg_desc[idx].width > MBUS_REG_CNT )
+            Error_Handler();
+        next = reg_desc[idx].id_reg + reg_desc[idx].width;
+        for ( reg = 0; reg < reg_desc[idx].width; reg++ )
+            reg_index[reg_desc[idx].id_reg + reg] = idx;
+       }
+    ModBusLiveUpdate();
+ }
+
+//*************************************************************************************************
+// Обновление образа текущих значений регистров (MBUS_ACC_LIVE), вызывается задачами, 
+// формирующими значения (расход, давление, состояние электроприводов). Значения формируются
+// функциями чтения таблицы reg_desc[] и сохраняются в порядке передачи (старший байт первым).
+// Образ обновляется под счетчиком версий (seqlock): чтение образа повторяется, если во время
+// копирования образ изменился.
+//*************************************************************************************************
+void ModBusLiveUpdate( void ) {
+
+    uint8_t idx, reg;
+    uint16_t image[MBUS_LIVE_CNT];
+
+    memset( image, 0x00, sizeof( image ) );
+    for ( idx = 0; reg_desc[idx].id_reg != REG_END; idx++ ) {
+        if ( !( reg_desc[idx].access & MBUS_ACC_LIVE ) || reg_desc[idx].id_reg + reg_desc[idx].width > MBUS_LIVE_CNT )
+            continue;
+        reg_desc[idx].read( (uint8_t *)&image[reg_desc[idx].id_reg] );
+        for ( reg = reg_desc[idx].id_reg; reg < reg_desc[idx].id_reg + reg_desc[idx].width; reg++ )
+            image[reg] = __REVSH( image[reg] );
+       }
+    //обновление выполняют несколько задач - запрет переключения задач на время копирования
+    osKernelLock();
+    live_seq++;
+    __DMB();
+    memcpy( live_image, image, sizeof( live_image ) );
+    __DMB();
+    live_seq++;
+    osKernelUnlock();
  }
 
 //*************************************************************************************************
@@ -97,8 +151,10 @@ ModBusError CheckRequest( uint8_t *data, uint8_t len, MBUS_REQ *request ) {
     ModbusRequst type_req;
     MBUS_REQ_REG mbus_req;
     MBUS_WRT_REGS mbus_wrtn;
+    MBUS_RDWR_REGS mbus_rdwr;
+    MBUS_DEVID_REQ mbus_devid;
     uint8_t func, idx, cnt_word;
-    uint16_t crc_calc, crc_data, *ptr_uint16;
+    uint16_t crc_calc, crc_data, rd_addr, rd_cnt, *ptr_uint16;
 
     //проверка параметров
     if ( data == NULL || !len )
@@ -130,8 +186,11 @@ ModBusError CheckRequest( uint8_t *data, uint8_t len, MBUS_REQ *request ) {
         request->reg_addr = __REVSH( mbus_req.reg_addr );
         request->reg_cnt = __REVSH( mbus_req.reg_cntval );
         request->ptr_data = NULL;
-        //проверка первого регистра
-        if ( ChkRegValid( request, &regs_read[0] ) == ERROR )
+        //проверка окна регистров
+        if ( ChkRegValid( request, MBUS_ACC_RD ) == ERROR )
+            return MBUS_ERROR_ADDR;
+        //регистры ввода - только регистры текущих значений
+        if ( func == FUNC_RD_INP_REG && request->reg_addr + request->reg_cnt > MBUS_INP_REG_CNT )
             return MBUS_ERROR_ADDR;
        }
     if ( type_req == MBUS_REQST_WRITE1 ) {
@@ -147,10 +206,10 @@ ModBusError CheckRequest( uint8_t *data, uint8_t len, MBUS_REQ *request ) {
         ptr_uint16 = (uint16_t *)( data + MB_REQUEST_DATA1 );
         *ptr_uint16 = __REVSH( *ptr_uint16 );
         //проверка адреса регистра
-        if ( ChkRegValid( request, &regs_write[0] ) == ERROR )
+        if ( ChkRegValid( request, MBUS_ACC_WR ) == ERROR )
             return MBUS_ERROR_ADDR;
         //проверка значения регистра
-        if ( ChkRegValue( request, &val_valid[0] ) == ERROR )
+        if ( ChkRegValue( request ) == ERROR )
             return MBUS_ERROR_DATA;
         //выполняем запись ...
         if ( RegWrite( request ) == ERROR )
@@ -165,6 +224,10 @@ ModBusError CheckRequest( uint8_t *data, uint8_t len, MBUS_REQ *request ) {
         request->reg_addr = __REVSH( mbus_wrtn.reg_addr );
         request->reg_cnt = __REVSH( mbus_wrtn.reg_cnt );
         request->ptr_data = data + MB_REQUEST_DATAN;
+        //кол-во байт данных должно соответствовать кол-ву регистров и размеру фрейма
+        if ( mbus_wrtn.byte_cnt != request->reg_cnt * sizeof( uint16_t ) || 
+             MB_REQUEST_DATAN + mbus_wrtn.byte_cnt + sizeof( uint16_t ) > len )
+            return MBUS_ERROR_DATA;
         //проверка необходимости перестановки байт
         if ( ModBusAddr( request->function ) == MBUS_REG_16BIT ) {
             //для 16-битных регистров - перестановка байтов
@@ -173,16 +236,78 @@ ModBusError CheckRequest( uint8_t *data, uint8_t len, MBUS_REQ *request ) {
             for ( idx = 0; idx < cnt_word; idx++, ptr_uint16++ )
                 *ptr_uint16 = __REVSH( *ptr_uint16 );
            }
-        //проверка первого регистра
-        if ( ChkRegValid( request, &regs_write[0] ) == ERROR )
+        //проверка окна регистров
+        if ( ChkRegValid( request, MBUS_ACC_WR ) == ERROR )
             return MBUS_ERROR_ADDR;
-        //проверка значения регистра
-        if ( ChkRegValue( request, &val_valid[0] ) == ERROR )
+        //проверка значений регистров
+        if ( ChkRegValue( request ) == ERROR )
             return MBUS_ERROR_DATA;
         //выполняем запись ...
         if ( RegWrite( request ) == ERROR )
             return MBUS_ERROR_DATA;
        }
+    if ( type_req == MBUS_REQST_RDWR ) {
+        //запись в несколько регистров, затем чтение нескольких регистров
+        memcpy( (uint8_t *)&mbus_rdwr, data, sizeof( mbus_rdwr ) );
+        //заполнение общей структуры MBUS_REQ данными запроса
+        request->dev_addr = mbus_rdwr.dev_addr;
+        request->function = mbus_rdwr.function;
+        rd_addr = __REVSH( mbus_rdwr.rd_addr );
+        rd_cnt = __REVSH( mbus_rdwr.rd_cnt );
+        request->reg_addr = __REVSH( mbus_rdwr.wr_addr );
+        request->reg_cnt = __REVSH( mbus_rdwr.wr_cnt );
+        request->ptr_data = data + MB_REQUEST_DATARW;
+        //кол-во байт данных должно соответствовать кол-ву регистров и размеру фрейма
+        if ( request->reg_cnt > MBUS_REG_RDWR_MAX || mbus_rdwr.byte_cnt != request->reg_cnt * sizeof( uint16_t ) || 
+             MB_REQUEST_DATARW + mbus_rdwr.byte_cnt + sizeof( uint16_t ) > len )
+            return MBUS_ERROR_DATA;
+        //для 16-битных регистров - перестановка байтов
+        cnt_word = mbus_rdwr.byte_cnt / sizeof( uint16_t );
+        ptr_uint16 = (uint16_t *)( data + MB_REQUEST_DATARW );
+        for ( idx = 0; idx < cnt_word; idx++, ptr_uint16++ )
+            *ptr_uint16 = __REVSH( *ptr_uint16 );
+        //проверка окна записи и значений регистров
+        if ( ChkRegValid( request, MBUS_ACC_WR ) == ERROR )
+            return MBUS_ERROR_ADDR;
+        if ( ChkRegValue( request ) == ERROR )
+            return MBUS_ERROR_DATA;
+        //проверка окна чтения выполняется до записи
+        request->reg_addr = rd_addr;
+        request->reg_cnt = rd_cnt;
+        if ( ChkRegValid( request, MBUS_ACC_RD ) == ERROR )
+            return MBUS_ERROR_ADDR;
+        //выполняем запись ...
+        request->reg_addr = __REVSH( mbus_rdwr.wr_addr );
+        request->reg_cnt = __REVSH( mbus_rdwr.wr_cnt );
+        if ( RegWrite( request ) == ERROR )
+            return MBUS_ERROR_DATA;
+        //окно чтения для формирования ответа
+        request->reg_addr = rd_addr;
+        request->reg_cnt = rd_cnt;
+        request->ptr_data = NULL;
+       }
+    if ( type_req == MBUS_REQST_DEVID ) {
+        //чтение идентификации устройства
+        if ( len != sizeof( mbus_devid ) )
+            return MBUS_ERROR_DATA;
+        memcpy( (uint8_t *)&mbus_devid, data, sizeof( mbus_devid ) );
+        //заполнение общей структуры MBUS_REQ данными запроса
+        request->dev_addr = mbus_devid.dev_addr;
+        request->function = mbus_devid.function;
+        request->reg_addr = 0;
+        request->reg_cnt = 0;
+        request->ptr_data = NULL;
+        request->devid_code = mbus_devid.devid_code;
+        request->object_id = mbus_devid.object_id;
+        //поддерживается только MEI 14
+        if ( mbus_devid.mei_type != MEI_READ_DEV_ID )
+            return MBUS_ERROR_FUNC;
+        if ( mbus_devid.devid_code < DEVID_READ_BASIC || mbus_devid.devid_code > DEVID_READ_SPECIFIC )
+            return MBUS_ERROR_DATA;
+        //при чтении одного объекта объект должен существовать
+        if ( mbus_devid.devid_code == DEVID_READ_SPECIFIC && DevIdFind( mbus_devid.object_id ) == NULL )
+            return MBUS_ERROR_ADDR;
+       }
     #if defined( DEBUG_MODBUS ) && defined( DEBUG_TARGET )
     sprintf( str, "DEV: 0x%02X FUCT: 0x%02X ADDR: 0x%04X-0x%04X CNT: %d\r\n", request->dev_addr, request->function, request->reg_addr, 
             request->reg_addr + request->reg_cnt - 1, request->reg_cnt );
@@ -210,7 +335,7 @@ ModBusError CheckRequest( uint8_t *data, uint8_t len, MBUS_REQ *request ) {
 uint8_t CreateFrame( MBUS_REQ *reqst, ModBusError error ) {
 
     uint16_t *ptr16, crc;
-    uint8_t idx, data_len, *pdata, *sdata;
+    uint8_t data_len, *sdata;
     MBUS_ERROR err_reg;
     MBUS_REQ_REG mbus_req;
 
@@ -225,25 +350,19 @@ uint8_t CreateFrame( MBUS_REQ *reqst, ModBusError error ) {
         memcpy( sdata, (uint8_t *)&err_reg, sizeof( err_reg ) );
         return sizeof( err_reg );
        }
-    //только чтение регистра(ов)
-    if ( TypeRequst( reqst->function ) == MBUS_REQST_READ ) {
-        ClearSend();
+    //идентификация устройства
+    if ( TypeRequst( reqst->function ) == MBUS_REQST_DEVID )
+        return DevIdRead( reqst, sdata );
+    //чтение регистра(ов), запись с чтением регистров
+    if ( TypeRequst( reqst->function ) == MBUS_REQST_READ || TypeRequst( reqst->function ) == MBUS_REQST_RDWR ) {
+        //ответ формируется на всю длину, обнуление буфера передачи не требуется
         *( sdata + MB_ANSWER_DEV ) = reqst->dev_addr;
         *( sdata + MB_ANSWER_FUNC ) = reqst->function;
-        //формируем набор данных
-        pdata = GetDataMbus( reqst->reg_addr, reqst->reg_cnt, &data_len );
+        //формируем набор данных, значения уже в порядке передачи (старший байт первым)
+        data_len = RegRead( reqst, sdata + MB_ANSWER_DATA );
         if ( !data_len )
             return 0;
         *( sdata + MB_ANSWER_CNT ) = data_len;
-        memcpy( sdata + MB_ANSWER_DATA, pdata, data_len );
-        if ( ModBusAddr( reqst->function ) == MBUS_REG_16BIT ) {
-            //поменяем байты местами для переменных uint16_t, т.к. сначала передаем старший байт
-            //в текущей модели LITTLE-ENDIAN младший байт хранится первым
-            for ( idx = 0; idx < data_len; idx += sizeof( uint16_t ) ) {
-                ptr16 = (uint16_t *)&sdata[idx + MB_ANSWER_DATA];
-                *ptr16 = __REVSH( *ptr16 );
-               }
-           }
         //расчет контрольной суммы данных по уже переставленным байтам
         //контрольная сумма передается в фрейме младшим байтом вперед
         crc = CalcCRC16( RS485SendBuff(), data_len + MB_ANSWER_HEAD );
@@ -293,77 +412,148 @@ static ErrorStatus ChkFuncValid( uint8_t func_id, const uint8_t *list ) {
  }
 
 //*************************************************************************************************
-// Функция проверяет номер регистра в списке доступных и кол-во регистров для чтения/записи
+// Возвращает описание значения, в которое входит регистр
+//-------------------------------------------------------------------------------------------------
+// uint16_t reg_addr - адрес регистра
+// return = NULL     - регистр не используется
+//*************************************************************************************************
+static const RegDesc *RegFind( uint16_t reg_addr ) {
+
+    if ( reg_addr >= MBUS_REG_CNT || reg_index[reg_addr] == REG_NONE )
+        return NULL;
+    return &reg_desc[reg_index[reg_addr]];
+ }
+
+//*************************************************************************************************
+// Функция проверяет окно регистров запроса: все регистры окна должны входить в значения с 
+// указанными правами доступа. Запись выполняется только целыми значениями, значения с признаком
+// MBUS_ACC_WHOLE читаются только целиком.
 //-------------------------------------------------------------------------------------------------
-// MBUS_REQ *reqst      - Указатель на структуру с данными запроса MODBUS 
-// const RegsRead *list - Указатель на массив набора регистров
-// return = SUCCESS     - регистр есть в списке
-//        = ERROR       - регистра нет в списке
+// MBUS_REQ *reqst  - Указатель на структуру с данными запроса MODBUS 
+// uint8_t access   - права доступа MBUS_ACC_RD/MBUS_ACC_WR
+// return = SUCCESS - окно регистров доступно
+//        = ERROR   - окно регистров недоступно
 //*************************************************************************************************
-static ErrorStatus ChkRegValid( MBUS_REQ *reqst, const RegsRead *list ) {
+static ErrorStatus ChkRegValid( MBUS_REQ *reqst, uint8_t access ) {
 
-    uint8_t i, r;
-    ErrorStatus check = ERROR;
+    uint32_t addr, end;
+    const RegDesc *desc;
     
-    //проверка доступности регистра
-    for ( i = 0; ; i++ ) {
-        //проверка на признак окончания набора данных
-        if ( list[i].id_reg == REG_END )
-            break;
-        //поиск по номеру регистра
-        if ( list[i].id_reg == reqst->reg_addr ) {
-            //проверка кол-ва регистров
-            for ( r = 0; r < sizeof( list[i].cnt_reg ); r++ )
-                if ( list[i].cnt_reg[r] == reqst->reg_cnt )
-                    return SUCCESS;
-           }
+    if ( !reqst->reg_cnt || reqst->reg_cnt > ( access == MBUS_ACC_WR ? MBUS_REG_WR_MAX : MBUS_REG_RD_MAX ) )
+        return ERROR;
+    end = reqst->reg_addr + reqst->reg_cnt;
+    for ( addr = reqst->reg_addr; addr < end; addr = desc->id_reg + desc->width ) {
+        desc = RegFind( addr );
+        if ( desc == NULL || !( desc->access & access ) )
+            return ERROR;
+        //значение должно входить в окно целиком
+        if ( ( access == MBUS_ACC_WR || desc->access & MBUS_ACC_WHOLE ) && 
+             ( addr != desc->id_reg || desc->id_reg + desc->width > end ) )
+            return ERROR;
        }
-    return check;
+    return SUCCESS;
  }
  
 //*************************************************************************************************
 // Функция проверяет значения регистра(ов) на допустимые диапазоны 
 //-------------------------------------------------------------------------------------------------
-// MBUS_REQ *reqst        - Указатель на структуру с данными запроса MODBUS
-// const ValueValid *list - Указатель на массив допустимых значений регистров
-// return = SUCCESS       - значение находиться в допустимом диапазоне
-//        = ERROR         - значение за пределами допустимого диапазона
+// MBUS_REQ *reqst  - Указатель на структуру с данными запроса MODBUS
+// return = SUCCESS - значения находятся в допустимом диапазоне
+//        = ERROR   - значение за пределами допустимого диапазона
 //*************************************************************************************************
-static ErrorStatus ChkRegValue( MBUS_REQ *reqst, const ValueValid *list ) {
+static ErrorStatus ChkRegValue( MBUS_REQ *reqst ) {
 
-    uint16_t i, reg, cnt, *ptr16, value;
-    ErrorStatus check = ERROR;
+    uint16_t i, value, *ptr16;
+    const RegDesc *desc;
+    const RegRange *range;
     
-    reg = reqst->reg_addr;
-    cnt = reqst->reg_cnt;
     ptr16 = (uint16_t *)reqst->ptr_data;
-    //проверка доступности регистра
-    for ( i = 0; ; i++ ) {
-        //проверка на признак окончания набора данных
-        if ( list[i].id_reg == REG_END )
-            break;
-        //поиск по номеру регистра
-        if ( list[i].id_reg == reg ) {
-            //регистр найден
-            cnt--;
-            value = *ptr16;
-            if ( value >= list[i].min_value && value <= list[i].max_value ) {
-                //значения регистра находятся в допустимом диапазоне
-                check = SUCCESS;
-                if ( cnt ) {
-                    //переход на следующий регистр если cnt_reg > 1
-                    reg++;
-                    ptr16++;
-                   }
+    for ( i = 0; i < reqst->reg_cnt; i++, ptr16++ ) {
+        desc = RegFind( reqst->reg_addr + i );
+        if ( desc == NULL )
+            return ERROR;
+        if ( desc->range == NULL )
+            continue;
+        range = &desc->range[reqst->reg_addr + i - desc->id_reg];
+        value = *ptr16;
+        if ( value < range->min_value || value > range->max_value )
+            return ERROR;
+       }
+    return SUCCESS;
+ }
+
+//*************************************************************************************************
+// Формирование значений окна регистров запроса чтения в порядке передачи (старший байт первым).
+// Регистры образа текущих значений, входящие в окно подряд, копируются одним чтением образа,
+// для остальных значений функция чтения вызывается один раз для каждого значения, регистры
+// которого входят в окно.
+//-------------------------------------------------------------------------------------------------
+// MBUS_REQ *reqst  - Указатель на структуру с данными запроса MODBUS
+// uint8_t *data    - указатель для размещения значений регистров
+// return           - кол-во сформированных байт данных
+//*************************************************************************************************
+static uint8_t RegRead( MBUS_REQ *reqst, uint8_t *data ) {
+
+    uint8_t idx, offset, cnt, len = 0;
+    uint16_t *ptr16;
+    uint32_t addr, end;
+    const RegDesc *desc, *next;
+
+    end = reqst->reg_addr + reqst->reg_cnt;
+    for ( addr = reqst->reg_addr; addr < end; addr += cnt ) {
+        desc = RegFind( addr );
+        if ( desc == NULL || desc->read == NULL )
+            return 0;
+        if ( desc->access & MBUS_ACC_LIVE ) {
+            //кол-во регистров образа, входящих в окно подряд
+            for ( cnt = 1; addr + cnt < end && addr + cnt < MBUS_LIVE_CNT; cnt++ ) {
+                next = RegFind( addr + cnt );
+                if ( next == NULL || !( next->access & MBUS_ACC_LIVE ) )
+                    break;
                }
-            else return ERROR;
+            LiveRead( addr, cnt, data + len );
+            len += cnt * sizeof( uint16_t );
+            continue;
            }
+        //значение формируется целиком, в ответ копируются регистры, входящие в окно
+        offset = addr - desc->id_reg;
+        cnt = desc->width - offset;
+        if ( addr + cnt > end )
+            cnt = end - addr;
+        memset( reg_value, 0x00, sizeof( reg_value ) );
+        desc->read( reg_value );
+        //поменяем байты местами, т.к. сначала передаем старший байт
+        ptr16 = (uint16_t *)reg_value + offset;
+        for ( idx = 0; idx < cnt; idx++ )
+            ptr16[idx] = __REVSH( ptr16[idx] );
+        memcpy( data + len, (uint8_t *)ptr16, cnt * sizeof( uint16_t ) );
+        len += cnt * sizeof( uint16_t );
        }
-    return check;
+    return len;
+ }
+
+//*************************************************************************************************
+// Копирование регистров из образа текущих значений. Копирование повторяется, если во время
+// копирования образ обновлялся (версия образа изменилась или обновление не завершено).
+//-------------------------------------------------------------------------------------------------
+// uint16_t reg_addr - адрес первого регистра
+// uint8_t cnt       - кол-во регистров
+// uint8_t *data     - указатель для размещения значений регистров
+//*************************************************************************************************
+static void LiveRead( uint16_t reg_addr, uint8_t cnt, uint8_t *data ) {
+
+    uint32_t seq;
+
+    do {
+        seq = live_seq;
+        __DMB();
+        memcpy( data, (uint8_t *)&live_image[reg_addr], cnt * sizeof( uint16_t ) );
+        __DMB();
+       } while ( ( seq & 0x01 ) || seq != live_seq );
  }
 
 //*************************************************************************************************
-// Запись значения(й) в регистр(ы)
+// Запись значения(й) в регистр(ы), функция записи вызывается для каждого значения запроса
 //-------------------------------------------------------------------------------------------------
 // MBUS_REQ *reqst  - Указатель на структуру с данными запроса MODBUS
 // return = SUCCESS - значение записано
@@ -371,52 +561,19 @@ static ErrorStatus ChkRegValue( MBUS_REQ *reqst, const ValueValid *list ) {
 //*************************************************************************************************
 static ErrorStatus RegWrite( MBUS_REQ *reqst ) {
 
-    uint16_t write, *ptr16;
-    MBUS_DTIME dtime;
-    DATE_TIME  rtc;
+    uint16_t idx;
+    const RegDesc *desc;
     
-    ptr16 = (uint16_t *)reqst->ptr_data;
-    write = *ptr16;
     if ( reqst == NULL )
         return ERROR;
-    if ( reqst->reg_addr == MBUS_REG_CTRL ) {
-        //проверка на закрытие горячей и холодной воды
-        if ( write == MBUS_CMD_ALL_CLOSE ) {
-            osEventFlagsSet( valve_event, EVN_VALVE_COLD_CLS | EVN_VALVE_HOT_CLS );
-            return SUCCESS; //высокий приоритет, дальше команды не проверяем
-           }
-        if ( write == MBUS_CMD_ALL_OPEN ) {
-            osEventFlagsSet( valve_event, EVN_VALVE_COLD_OPN | EVN_VALVE_HOT_OPN );
-            return SUCCESS; //высокий приоритет, дальше команды не проверяем
-           }
-        //проверка на взаимоисключающие команды
-        if ( write & MBUS_CMD_COLD_OPEN && write & MBUS_CMD_COLD_CLOSE )
+    for ( idx = 0; idx < reqst->reg_cnt; idx += desc->width ) {
+        desc = RegFind( reqst->reg_addr + idx );
+        if ( desc == NULL || desc->write == NULL )
             return ERROR;
-        if ( write & MBUS_CMD_HOT_OPEN && write & MBUS_CMD_HOT_CLOSE )
+        if ( desc->write( reqst->ptr_data + idx * sizeof( uint16_t ) ) == ERROR )
             return ERROR;
-        //выполнение команды
-        if ( write & MBUS_CMD_COLD_OPEN )
-            osEventFlagsSet( valve_event, EVN_VALVE_COLD_OPN );
-        if ( write & MBUS_CMD_COLD_CLOSE )
-            osEventFlagsSet( valve_event, EVN_VALVE_COLD_CLS );
-        if ( write & MBUS_CMD_HOT_OPEN )
-            osEventFlagsSet( valve_event, EVN_VALVE_HOT_OPN );
-        if ( write & MBUS_CMD_HOT_CLOSE )
-            osEventFlagsSet( valve_event, EVN_VALVE_HOT_CLS );
-        return SUCCESS;
        }
-    if ( reqst->reg_addr == MBUS_REG_DAYMON && reqst->reg_cnt == 3 ) {
-        //установка даты - времени
-        memcpy( (uint8_t *)&dtime, reqst->ptr_data, sizeof( dtime ) );
-        rtc.day = dtime.day; 
-        rtc.month = dtime.month;
-        rtc.year = dtime.year;
-        rtc.hour = dtime.hour;
-        rtc.min = dtime.min;
-        rtc.sec = 0; 
-        return SetTimeDate( &rtc );
-       }
-    return ERROR;
+    return SUCCESS;
  }
 
 //*************************************************************************************************
@@ -433,7 +590,7 @@ static ModbusAddrReg ModBusAddr( uint8_t func ) {
         return MBUS_REG_8BIT;
     //функции с 16-битной адресаций
     if ( func == FUNC_RD_HOLD_REG || func == FUNC_RD_INP_REG || func == FUNC_WR_SING_REG || \
-         func == FUNC_WR_MULT_REG || func == FUNC_WR_MASK_REG || func == FUNC_RD_FIFO_QUE || \
+         func == FUNC_WR_MULT_REG || func == FUNC_WR_MASK_REG || func == FUNC_RD_FIFO_QUE || func == FUNC_RDWR_MULT_REG || \
          func == FUNC_RD_FILE_REC || func == FUNC_WR_FILE_REC || func == FUNC_RD_EVENT_CNT || \
          func == FUNC_RD_DIAGNOSTIC || func == FUNC_RD_EVENT_LOG )
         return MBUS_REG_16BIT;
@@ -455,9 +612,94 @@ static ModbusRequst TypeRequst( uint8_t func_id ) {
         return MBUS_REQST_WRITE1;
     if ( func_id == FUNC_WR_MULT_COIL || func_id == FUNC_WR_MULT_REG || func_id == FUNC_WR_FILE_REC )
         return MBUS_REQST_WRITEN;
+    if ( func_id == FUNC_RDWR_MULT_REG )
+        return MBUS_REQST_RDWR;
+    if ( func_id == FUNC_SEND_ENCP_INTF )
+        return MBUS_REQST_DEVID;
     return MBUS_REQST_UNKNOW;
  }
 
+//*************************************************************************************************
+// Поиск описания объекта идентификации устройства по ID объекта
+//-------------------------------------------------------------------------------------------------
+// uint8_t object_id - ID объекта
+// return            - указатель на описание объекта, NULL - объект не поддерживается
+//*************************************************************************************************
+static const DevIdDesc *DevIdFind( uint8_t object_id ) {
+
+    uint8_t idx;
+
+    for ( idx = 0; devid_desc[idx].value != NULL; idx++ ) {
+        if ( devid_desc[idx].id == object_id )
+            return &devid_desc[idx];
+       }
+    return NULL;
+ }
+
+//*************************************************************************************************
+// Формирование ответа на запрос идентификации устройства (2B/0E). При потоковом чтении
+// передаются объекты категории запроса (базовые, обычные, расширенные), начиная с указанного
+// объекта, если объекты не помещаются в один ответ - передается признак продолжения и ID
+// объекта для следующего запроса.
+//-------------------------------------------------------------------------------------------------
+// MBUS_REQ *reqst  - Указатель на структуру с данными запроса MODBUS
+// uint8_t *data    - указатель для размещения ответа
+// return           - размер фрейма в байтах для передачи
+//*************************************************************************************************
+static uint8_t DevIdRead( MBUS_REQ *reqst, uint8_t *data ) {
+
+    char *value;
+    uint16_t crc;
+    uint8_t idx, size, len, first, last;
+    MBUS_DEVID_ANS *answer;
+
+    //диапазон ID объектов для кода чтения
+    first = reqst->object_id;
+    if ( reqst->devid_code == DEVID_READ_SPECIFIC )
+        last = first;
+    else {
+        if ( reqst->devid_code == DEVID_READ_BASIC )
+            last = DEVID_REGULAR_FIRST - 1;
+        else if ( reqst->devid_code == DEVID_READ_REGULAR )
+            last = DEVID_EXTENDED_FIRST - 1;
+        else last = 0xFF;
+        //неизвестный объект - чтение с первого объекта
+        if ( DevIdFind( first ) == NULL || first > last )
+            first = 0;
+       }
+    answer = (MBUS_DEVID_ANS *)data;
+    answer->dev_addr = reqst->dev_addr;
+    answer->function = reqst->function;
+    answer->mei_type = MEI_READ_DEV_ID;
+    answer->devid_code = reqst->devid_code;
+    answer->conformity = DEVID_CONFORMITY;
+    answer->more = 0;
+    answer->next_id = 0;
+    answer->obj_cnt = 0;
+    len = sizeof( MBUS_DEVID_ANS );
+    for ( idx = 0; devid_desc[idx].value != NULL; idx++ ) {
+        if ( devid_desc[idx].id < first || devid_desc[idx].id > last )
+            continue;
+        value = devid_desc[idx].value();
+        size = strlen( value );
+        if ( len + 2 + size > MBUS_DEVID_MAX ) {
+            //продолжение в следующем ответе
+            answer->more = 0xFF;
+            answer->next_id = devid_desc[idx].id;
+            break;
+           }
+        data[len++] = devid_desc[idx].id;
+        data[len++] = size;
+        memcpy( data + len, value, size );
+        len += size;
+        answer->obj_cnt++;
+       }
+    //контрольная сумма передается в фрейме младшим байтом вперед
+    crc = CalcCRC16( data, len );
+    memcpy( data + len, (uint8_t *)&crc, sizeof( crc ) );
+    return len + sizeof( crc );
+ }
+
 //*************************************************************************************************
 // Обнуляет счетчики ошибок протокола MODBUS
 //*************************************************************************************************
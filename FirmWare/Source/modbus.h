@@ -26,7 +26,9 @@ typedef enum {
     MBUS_REQST_UNKNOW,                      //Структура не определена
     MBUS_REQST_READ,                        //Структура регистров для запроса чтения (01,02,03,04)
     MBUS_REQST_WRITE1,                      //Структура регистров для записи (05,06) дискретная/16-битная
-    MBUS_REQST_WRITEN                       //Структура для записи значений в несколько регистров (0F,10)
+    MBUS_REQST_WRITEN,                      //Структура для записи значений в несколько регистров (0F,10)
+    MBUS_REQST_RDWR,                        //Структура для записи и чтения нескольких регистров (17)
+    MBUS_REQST_DEVID                        //Структура запроса идентификации устройства (2B/0E)
  } ModbusRequst;
 
 //*************************************************************************************************
@@ -70,6 +72,8 @@ typedef struct {
     uint16_t reg_addr;                      //Адрес первого регистра (HI/LO байт)
     uint16_t reg_cnt;                       //Количество регистров (HI/LO байт)
     uint8_t  *ptr_data;                     //Указатель на данные регистров
+    uint8_t  devid_code;                    //Код чтения идентификации устройства (2B/0E)
+    uint8_t  object_id;                     //ID первого объекта идентификации устройства (2B/0E)
 } MBUS_REQ;
 
 #pragma pack( pop )
@@ -79,6 +83,7 @@ typedef struct {
 //*************************************************************************************************
 void ModBusInit( void );
 void ModBusErrClr( void );
+void ModBusLiveUpdate( void );
 
 //*************************************************************************************************
 // Функции статуса/состояния
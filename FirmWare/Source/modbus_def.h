@@ -16,6 +16,7 @@
 #define MB_REQUEST_FUNC         1           //индекс кода функции
 #define MB_REQUEST_DATA1        4           //индекс начала данных для FUNC_WR_SING_COIL и FUNC_WR_SING_REG
 #define MB_REQUEST_DATAN        7           //индекс начала данных для FUNC_WR_MULT_COIL и FUNC_WR_MULT_REG
+#define MB_REQUEST_DATARW       11          //индекс начала данных для FUNC_RDWR_MULT_REG
 
 //*************************************************************************************************
 // Функции протокола Modbus
@@ -42,6 +43,11 @@
 #define FUNC_WR_MULT_COIL       0x0F        //(битовая адресация) запись значений в несколько регистров флагов (Force Multiple Coils)
 #define FUNC_WR_MULT_REG        0x10        //(16-битная адресация) запись значений в несколько регистров хранения (Preset Multiple Registers)
 
+// Чтение/запись нескольких регистров. Команда состоит из адреса и количества читаемых регистров,
+// адреса и количества записываемых регистров, количества байт и значений записываемых регистров.
+// Запись выполняется до чтения, ответ формируется как ответ на чтение регистров хранения.
+#define FUNC_RDWR_MULT_REG      0x17        //(16-битная адресация) чтение/запись нескольких регистров хранения (Read/Write Multiple Registers)
+
 // Изменение регистров. Команда состоит из адреса регистра и двух 16-битных чисел, которые используются
 // как маски, с помощью которых можно индивидуально сбросить или установить отдельные биты в регистре.
 // Конечный результат определяется формулой: Результат = (Текущее_значение AND Маска_И) OR (Маска_ИЛИ AND (NOT Маска_И))
@@ -76,6 +82,17 @@
 // Стандарт определяет MEI 13 (0x0D), предназначенный для инкапсуляции протокола CANopen.
 // MEI 14 (0x0E) используется для получения информации об устройстве и MEI в диапазонах 0—12 и 15—255 зарезервированы.
 #define FUNC_SEND_ENCP_INTF     0x2B        //Encapsulated Interface Transport
+#define MEI_READ_DEV_ID         0x0E        //MEI 14: чтение идентификации устройства (Read Device Identification)
+
+// Коды чтения идентификации устройства (MEI 14)
+#define DEVID_READ_BASIC        0x01        //потоковое чтение базовых объектов (0x00 - 0x02)
+#define DEVID_READ_REGULAR      0x02        //потоковое чтение обычных объектов (0x03 - 0x7F)
+#define DEVID_READ_EXTENDED     0x03        //потоковое чтение расширенных объектов (0x80 - 0xFF)
+#define DEVID_READ_SPECIFIC     0x04        //чтение одного объекта
+#define DEVID_REGULAR_FIRST     0x03        //первый обычный объект
+#define DEVID_EXTENDED_FIRST    0x80        //первый расширенный объект
+#define DEVID_CONFORMITY        0x83        //уровень соответствия: расширенная идентификация, 
+                                            //потоковое чтение и чтение одного объекта
 
 #define FUNC_ANSWER_ERROR       0x80        //Маска наличия ошибки
 
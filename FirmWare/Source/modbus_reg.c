@@ -9,6 +9,11 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "fram.h"
+#include "data.h"
+#include "water.h"
+#include "scrub.h"
+#include "version.h"
 #include "modbus_def.h"
 #include "modbus_reg.h"
 
@@ -18,53 +23,142 @@
 const uint8_t func_access[] = { 
     FUNC_RD_HOLD_REG,       //0x03 (16-битная адресация) чтение из нескольких 
                             //регистров хранения (Read Holding Registers)
+    FUNC_RD_INP_REG,        //0x04 (16-битная адресация) чтение из нескольких 
+                            //регистров ввода (Read Input Registers)
     FUNC_WR_SING_REG,       //0x06 (16-битная адресация) запись в один регистр 
                             //хранения (Preset Single Register)
     FUNC_WR_MULT_REG,       //0x10 (16-битная адресация) запись значений в несколько 
                             //регистров хранения (Preset Multiple Registers)
+    FUNC_RDWR_MULT_REG,     //0x17 (16-битная адресация) запись и чтение нескольких
+                            //регистров хранения (Read/Write Multiple Registers)
+    FUNC_SEND_ENCP_INTF,    //0x2B/0x0E чтение идентификации устройства 
+                            //(Read Device Identification)
     FUNC_END
  };
 
 //*************************************************************************************************
-// Перечень доступных регистров для чтения (номер регистра - кол-во регистров чтения)
+// Диапазоны значений (мин - макc) для проверки перед записью в регистры значения
 //*************************************************************************************************
-const RegsRead regs_read[] = {
-    //номер регистра        кол-во регистров чтения
-    //------------------------------------------------------------
-    { MBUS_REG_CTRL,        { 1, 3, 4, 6, 7, 9, 11, 12 } },
-    { MBUS_REG_WTR_COLD,    { 2, 3, 5, 6, 8, 10, 11, }   },
-    { MBUS_REG_COLD_PRESR,  { 1, 3, 4, 6, 8, 9, }        },
-    { MBUS_REG_WTR_HOT,     { 2, 3, 5, 7, }              },
-    { MBUS_REG_HOT_PRESR,   { 1, 3, 5, }                 },
-    { MBUS_REG_WTR_FILTER,  { 2, 4, 5, }                 },
-    { MBUS_REG_DAYMON,      { 2, 3, }                    },
-    { MBUS_REG_HOURMIN,     { 1, }                       },
-    { REG_END }
+static const RegRange range_ctrl[] = {
+    { 0,                    MBUS_CMD_MASK }                         //см. MBUS_CMD_*
+ };
+
+static const RegRange range_dtime[] = {
+    { ( 1 << 8 ) | 1,       ( 12 << 8 ) | 31 },                     //месяц/день
+    { 2020,                 2999 },                                 //год
+    { ( 0 << 8 ) | 0,       ( 23 << 8 ) | 59 }                      //часы/минуты
+ };
+
+static const RegRange range_hammer_stat[] = {
+    { 0,                    0 }                                     //повторный запуск захвата
+ };
+
+static const RegRange range_hammer_page[] = {
+    { 0,                    HAMMER_SAMPLES / MBUS_HAMMER_PAGE_SIZE - 1 }
+ };
+
+static const RegRange range_log[] = {
+    { ( 1 << 8 ) | 1,       ( 12 << 8 ) | 31 },                     //начало интервала: месяц/день
+    { 2020,                 2999 },                                 //год
+    { ( 0 << 8 ) | 0,       ( 23 << 8 ) | 59 },                     //часы/минуты
+    { ( 1 << 8 ) | 1,       ( 12 << 8 ) | 31 },                     //окончание интервала: месяц/день
+    { 2020,                 2999 },                                 //год
+    { ( 0 << 8 ) | 0,       ( 23 << 8 ) | 59 }                      //часы/минуты
+ };
+
+static const RegRange range_log_rec[] = {
+    { 0,                    LOG_RECORDS_MAX - 1 }
+ };
+
+static const RegRange range_roll[] = {
+    { 1,                    3 },                                    //уровень итогов
+    { ( 1 << 8 ) | 1,       ( 12 << 8 ) | 31 },                     //дата периода: месяц/день
+    { 2020,                 2099 }                                  //год
+ };
+
+static const RegRange range_scrub_page[] = {
+    { 0,                    ( SCRUB_BLOCKS_MAX + MBUS_SCRUB_PAGE_SIZE - 1 ) / MBUS_SCRUB_PAGE_SIZE - 1 }
  };
 
 //*************************************************************************************************
-// Перечень регистров доступных для записи (номер регистра - кол-во регистров для записи)
+// Таблица описания регистров: каждое значение занимает width последовательных регистров начиная
+// с id_reg. Чтение допускается любым непрерывным окном регистров значений с доступом MBUS_ACC_RD,
+// запись - только целыми значениями с доступом MBUS_ACC_WR. Значения указываются по возрастанию
+// адресов, индекс по адресу регистра формируется при инициализации протокола.
 //*************************************************************************************************
-const RegsRead regs_write[] = {
-    //номер регистра        кол-во регистров чтения
-    //------------------------------------------------------------
-    { MBUS_REG_CTRL,        { 1, }      },
-    { MBUS_REG_DAYMON,      { 1, 3, }   },
-    //{ MBUS_REG_YEAR,        { 1, }      },
-    //{ MBUS_REG_HOURMIN,     { 1, }      },
+const RegDesc reg_desc[] = {
+    //первый регистр        кол-во  доступ          чтение              запись              диапазоны
+    //---------------------------------------------------------------------------------------------------
+    { MBUS_REG_CTRL,        1,      MBUS_ACC_RW | MBUS_ACC_LIVE, MbusGetCtrl, MbusSetCtrl,  range_ctrl },
+    { MBUS_REG_WTR_COLD,    2,      MBUS_ACC_RD | MBUS_ACC_LIVE, MbusGetCold, NULL,         NULL },
+    { MBUS_REG_COLD_PRESR,  1,      MBUS_ACC_RD | MBUS_ACC_LIVE, MbusGetColdPressr, NULL,   NULL },
+    { MBUS_REG_WTR_HOT,     2,      MBUS_ACC_RD | MBUS_ACC_LIVE, MbusGetHot, NULL,          NULL },
+    { MBUS_REG_HOT_PRESR,   1,      MBUS_ACC_RD | MBUS_ACC_LIVE, MbusGetHotPressr, NULL,    NULL },
+    { MBUS_REG_WTR_FILTER,  2,      MBUS_ACC_RD | MBUS_ACC_LIVE, MbusGetFilter, NULL,       NULL },
+    { MBUS_REG_DAYMON,      3,      MBUS_ACC_RW,    MbusGetDtime,       MbusSetDtime,       range_dtime },
+    { MBUS_REG_FLOW_COLD,   3,      MBUS_ACC_RD | MBUS_ACC_LIVE, MbusGetFlow, NULL,         NULL },
+    { MBUS_REG_HAMMER_STAT, 1,      MBUS_ACC_RW,    MbusGetHammerStat,  MbusSetHammerStat,  range_hammer_stat },
+    { MBUS_REG_HAMMER_DTIME, 4,     MBUS_ACC_RD,    MbusGetHammerInfo,  NULL,               NULL },
+    { MBUS_REG_HAMMER_PAGE, 1,      MBUS_ACC_RW,    MbusGetHammerPage,  MbusSetHammerPage,  range_hammer_page },
+    { MBUS_REG_HAMMER_DATA, 2 * MBUS_HAMMER_PAGE_SIZE, MBUS_ACC_RD, MbusGetHammerData, NULL, NULL },
+    { MBUS_REG_LOG_FROM,    6,      MBUS_ACC_RW,    MbusGetLogRange,    MbusSetLogRange,    range_log },
+    { MBUS_REG_LOG_CNT,     1,      MBUS_ACC_RD,    MbusGetLogCnt,      NULL,               NULL },
+    { MBUS_REG_LOG_REC,     1,      MBUS_ACC_RW,    MbusGetLogRec,      MbusSetLogRec,      range_log_rec },
+    { MBUS_REG_LOG_DATA,    12,     MBUS_ACC_RD | MBUS_ACC_WHOLE, MbusGetLogData, NULL,     NULL },
+    { MBUS_REG_ROLL_TYPE,   3,      MBUS_ACC_RW,    MbusGetRollType,    MbusSetRollType,    range_roll },
+    { MBUS_REG_ROLL_STAT,   1,      MBUS_ACC_RD,    MbusGetRollStat,    NULL,               NULL },
+    { MBUS_REG_ROLL_DATA,   10,     MBUS_ACC_RD,    MbusGetRollData,    NULL,               NULL },
+    { MBUS_REG_SCRUB_PASS,  2,      MBUS_ACC_RD,    MbusGetScrubPass,   NULL,               NULL },
+    { MBUS_REG_SCRUB_BAD,   1,      MBUS_ACC_RD,    MbusGetScrubBad,    NULL,               NULL },
+    { MBUS_REG_SCRUB_FIXED, 1,      MBUS_ACC_RD,    MbusGetScrubFixed,  NULL,               NULL },
+    { MBUS_REG_SCRUB_PAGE,  1,      MBUS_ACC_RW,    MbusGetScrubPage,   MbusSetScrubPage,   range_scrub_page },
+    { MBUS_REG_SCRUB_MAP,   MBUS_SCRUB_PAGE_SIZE / 16, MBUS_ACC_RD, MbusGetScrubMap, NULL,  NULL },
     { REG_END }
  };
 
 //*************************************************************************************************
-// Диапазоны значений (мин - макc) для проверки перед записью в регистр
+// Функции формирования значений объектов идентификации устройства
 //*************************************************************************************************
-const ValueValid val_valid[] = {
-    //регистр               мин. знач.          макс. знач.
-    //------------------------------------------------------------
-    { MBUS_REG_CTRL,        0,                  MBUS_CMD_MASK },    //см. MBUS_CMD_*
-    { MBUS_REG_DAYMON,      ( 1 << 8 ) | 1,     ( 12 << 8 ) | 31 }, //месяц/день
-    { MBUS_REG_YEAR,        2020,               2999 },             //год
-    { MBUS_REG_HOURMIN,     ( 0 << 8 ) | 0,     ( 23 << 8 ) | 59 }, //часы/минуты
-    { REG_END }
- };
+static char *DevIdVendor( void ) {
+
+    return "srgemb";
+ }
+
+static char *DevIdProduct( void ) {
+
+    return "WaterControl";
+ }
+
+static char *DevIdRevision( void ) {
+
+    return FWVersion( GetFwVersion() );
+ }
+
+static char *DevIdUrl( void ) {
+
+    return "https://github.com/srgemb/WaterControl";
+ }
 
+static char *DevIdDate( void ) {
+
+    return FWDate( GetFwDate() );
+ }
+
+static char *DevIdTime( void ) {
+
+    return FWTime( GetFwTime() );
+ }
+
+//*************************************************************************************************
+// Объекты идентификации устройства (функция 0x2B/0x0E), ID объектов указываются по возрастанию
+//*************************************************************************************************
+const DevIdDesc devid_desc[] = {
+    { 0x00,     DevIdVendor },          //VendorName
+    { 0x01,     DevIdProduct },         //ProductCode
+    { 0x02,     DevIdRevision },        //MajorMinorRevision - версия прошивки
+    { 0x03,     DevIdUrl },             //VendorUrl
+    { 0x04,     DevIdProduct },         //ProductName
+    { 0x80,     DevIdDate },            //дата сборки прошивки
+    { 0x81,     DevIdTime },            //время сборки прошивки
+    { 0x00,     NULL }
+ };
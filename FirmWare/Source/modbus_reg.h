@@ -6,6 +6,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "stm32f1xx.h"
+
 //Регистры протокола MODBUS
 #define MBUS_REG_CTRL           0x0000  //Состояние датчиков, состояние электроприводов
 #define MBUS_REG_WTR_COLD       0x0001  //Расход холодной воды
@@ -16,6 +18,65 @@
 #define MBUS_REG_DAYMON         0x0009  //Дата/время (месяц/день)
 #define MBUS_REG_YEAR           0x000A  //Дата/время (год)
 #define MBUS_REG_HOURMIN        0x000B  //Дата/время (часы/минуты)
+#define MBUS_REG_FLOW_COLD      0x000C  //Мгновенный расход холодной воды (л/мин * 100)
+#define MBUS_REG_FLOW_HOT       0x000D  //Мгновенный расход горячей воды (л/мин * 100)
+#define MBUS_REG_FLOW_FILTER    0x000E  //Мгновенный расход питьевой воды (л/мин * 100)
+#define MBUS_REG_HAMMER_STAT    0x0010  //Захват гидроудара: состояние/канал, запись "0" - повторный запуск
+#define MBUS_REG_HAMMER_DTIME   0x0011  //Захват гидроудара: дата/время события (3 регистра)
+#define MBUS_REG_HAMMER_DELTA   0x0014  //Захват гидроудара: изменение давления в момент события (атм * 100)
+#define MBUS_REG_HAMMER_PAGE    0x0015  //Захват гидроудара: номер страницы выборок снимка (чтение/запись)
+#define MBUS_REG_HAMMER_DATA    0x0016  //Захват гидроудара: выборки страницы снимка (атм * 100),
+                                        //MBUS_HAMMER_PAGE_SIZE пар значений холодная/горячая вода
+
+#define MBUS_REG_LOG_FROM       0x0030  //Выборка журнала: начало интервала дата/время (3 регистра),
+                                        //запись начала и окончания интервала (6 регистров) - выборка
+#define MBUS_REG_LOG_TO         0x0033  //Выборка журнала: окончание интервала дата/время (3 регистра)
+#define MBUS_REG_LOG_CNT        0x0036  //Выборка журнала: кол-во записей в интервале
+#define MBUS_REG_LOG_REC        0x0037  //Выборка журнала: номер текущей записи выборки (чтение/запись)
+#define MBUS_REG_LOG_DATA       0x0038  //Выборка журнала: данные текущей записи (12 регистров),
+                                        //после чтения номер текущей записи увеличивается на 1
+
+#define MBUS_REG_ROLL_TYPE      0x0050  //Итоги расхода: уровень 1 - сутки, 2 - месяц, 3 - год, запись
+                                        //уровня и даты периода (3 регистра) - выборка итогов
+#define MBUS_REG_ROLL_DATE      0x0051  //Итоги расхода: дата периода (месяц/день)
+#define MBUS_REG_ROLL_YEAR      0x0052  //Итоги расхода: дата периода (год)
+#define MBUS_REG_ROLL_STAT      0x0053  //Итоги расхода: результат выборки (0 - OK, 1 - нет данных,
+                                        //2 - ошибка FRAM, 3 - ошибка параметров, 4 - не хранятся)
+#define MBUS_REG_ROLL_DATA      0x0054  //Итоги расхода: расход холодной/горячей/питьевой воды (литры,
+                                        //6 регистров), мин. и макс. давление холодной/горячей воды
+                                        //(атм * 100, 4 регистра)
+
+#define MBUS_REG_SCRUB_PASS     0x0060  //Проверка FRAM: кол-во завершенных циклов проверки (2 регистра)
+#define MBUS_REG_SCRUB_BAD      0x0062  //Проверка FRAM: текущее кол-во поврежденных блоков
+#define MBUS_REG_SCRUB_FIXED    0x0063  //Проверка FRAM: кол-во восстановленных/очищенных блоков
+#define MBUS_REG_SCRUB_PAGE     0x0064  //Проверка FRAM: номер страницы карты блоков (чтение/запись)
+#define MBUS_REG_SCRUB_MAP      0x0065  //Проверка FRAM: карта поврежденных блоков страницы (8 регистров),
+                                        //бит на блок, младший бит первого регистра - первый блок
+
+#define MBUS_HAMMER_PAGE_SIZE   8       //кол-во выборок (пар значений) на странице снимка гидроудара
+#define MBUS_SCRUB_PAGE_SIZE    128     //кол-во блоков FRAM на странице карты поврежденных блоков
+
+#define MBUS_REG_CNT            ( MBUS_REG_SCRUB_MAP + MBUS_SCRUB_PAGE_SIZE / 16 ) //размер адресного
+                                        //пространства регистров (адрес последнего регистра + 1),
+                                        //значения reg_desc[] за пределами - останов в ModBusInit()
+#define MBUS_REG_RD_MAX         125     //макс. кол-во регистров в запросе чтения
+#define MBUS_REG_WR_MAX         123     //макс. кол-во регистров в запросе записи
+#define MBUS_REG_RDWR_MAX       121     //макс. кол-во регистров записи в запросе чтения/записи
+#define MBUS_INP_REG_CNT        MBUS_LIVE_CNT //регистры ввода (функция 0x04): текущие значения
+                                        //MBUS_REG_CTRL ... MBUS_REG_FLOW_FILTER
+#define MBUS_DEVID_MAX          240     //макс. размер объектов идентификации в одном ответе
+#define MBUS_VALUE_MAX          16      //макс. кол-во регистров одного значения
+#define MBUS_LIVE_CNT           ( MBUS_REG_FLOW_FILTER + 1 ) //размер образа текущих значений
+                                        //(регистры MBUS_REG_CTRL ... MBUS_REG_FLOW_FILTER)
+
+//Права доступа к значению регистров
+#define MBUS_ACC_RD             0x01    //чтение
+#define MBUS_ACC_WR             0x02    //запись, значение записывается только целиком
+#define MBUS_ACC_RW             ( MBUS_ACC_RD | MBUS_ACC_WR )
+#define MBUS_ACC_WHOLE          0x04    //значение читается только целиком (чтение с изменением
+                                        //состояния, например переход к следующей записи журнала)
+#define MBUS_ACC_LIVE           0x08    //значение читается из образа текущих значений, функция
+                                        //чтения вызывается при обновлении образа ModBusLiveUpdate()
 
 //Команды для регистра MBUS_REG_CTRL, протокол MODBUS (только запись)
 #define MBUS_CMD_ALL_CLOSE      0x0000  //закрыть все
@@ -32,6 +93,7 @@
 //Атрибуты окончания списка
 #define REG_END                 0xFFFF  //код окончания списка регистров
 #define FUNC_END                0xFF    //код окончания списка функций
+#define REG_NONE                0xFF    //адрес регистра не используется (индекс описания регистров)
 
 
 #pragma pack( push, 1 )                 //выравнивание структуры по границе 1 байта
@@ -56,6 +118,41 @@ typedef struct {
     //далее идут данные и КС
  } MBUS_WRT_REGS;
 
+//Структура для чтения/записи значений нескольких регистров (17)
+typedef struct {
+    uint8_t  dev_addr;                  //Адрес устройства
+    uint8_t  function;                  //Функциональный код
+    uint16_t rd_addr;                   //Адрес первого читаемого регистра HI/LO байт
+    uint16_t rd_cnt;                    //Количество читаемых регистров HI/LO байт
+    uint16_t wr_addr;                   //Адрес первого записываемого регистра HI/LO байт
+    uint16_t wr_cnt;                    //Количество записываемых регистров HI/LO байт
+    uint8_t  byte_cnt;                  //Количество байт данных записываемых регистров
+    //далее идут данные и КС
+ } MBUS_RDWR_REGS;
+
+//Структура запроса идентификации устройства (2B/0E)
+typedef struct {
+    uint8_t  dev_addr;                  //Адрес устройства
+    uint8_t  function;                  //Функциональный код
+    uint8_t  mei_type;                  //Тип MEI
+    uint8_t  devid_code;                //Код чтения идентификации
+    uint8_t  object_id;                 //ID объекта
+    uint16_t crc;                       //Контрольная сумма CRC
+ } MBUS_DEVID_REQ;
+
+//Заголовок ответа на запрос идентификации устройства (2B/0E)
+typedef struct {
+    uint8_t  dev_addr;                  //Адрес устройства
+    uint8_t  function;                  //Функциональный код
+    uint8_t  mei_type;                  //Тип MEI
+    uint8_t  devid_code;                //Код чтения идентификации
+    uint8_t  conformity;                //Уровень соответствия
+    uint8_t  more;                      //0xFF - есть продолжение (следующий запрос с next_id)
+    uint8_t  next_id;                   //ID объекта для следующего запроса
+    uint8_t  obj_cnt;                   //Количество объектов в ответе
+    //далее идут объекты (ID, длина, значение) и КС
+ } MBUS_DEVID_ANS;
+
 //Структура ответа на запрос с ошибкой
 typedef struct {
     uint8_t  dev_addr;                  //Адрес устройства
@@ -64,19 +161,29 @@ typedef struct {
     uint16_t crc;                       //Контрольная сумма CRC
  } MBUS_ERROR;
  
-//Структура набора регистров доступных для чтения
-typedef struct {
-    uint16_t id_reg;
-    uint8_t  cnt_reg[8];
- } RegsRead;
+#pragma pack( pop )
 
-//Структура набора регистров для записи и допустимых значений
+//Допустимые значения регистра для записи
 typedef struct {
-    uint16_t id_reg;
     uint16_t min_value;
     uint16_t max_value;
- } ValueValid;
+ } RegRange;
 
-#pragma pack( pop )
+//Описание значения, занимающего один или несколько последовательных регистров
+typedef struct {
+    uint16_t id_reg;                    //адрес первого регистра значения
+    uint8_t  width;                     //кол-во регистров значения
+    uint8_t  access;                    //права доступа MBUS_ACC_*
+    void (*read)( uint8_t *data );      //функция формирования значения (width * 2 байта)
+    ErrorStatus (*write)( uint8_t *data ); //функция записи значения
+    const RegRange *range;              //допустимые значения для записи по каждому регистру
+                                        //значения (width элементов), NULL - без проверки
+ } RegDesc;
+
+//Описание объекта идентификации устройства (функция 0x2B/0x0E)
+typedef struct {
+    uint8_t  id;                        //ID объекта
+    char *(*value)( void );             //функция формирования значения объекта (строка)
+ } DevIdDesc;
 
 #endif
@@ -0,0 +1,95 @@
+//*************************************************************************************************
+//
+// Счетчики импульсов счетчиков воды: регистрация импульсов в прерывании EXTI, выборка
+// накопленных импульсов задачей "Water", метки времени последних импульсов
+//
+//*************************************************************************************************
+
+#include <string.h>
+#include <stdbool.h>
+
+#include "cmsis_os2.h"
+
+#include "main.h"
+#include "pulse.h"
+
+//*************************************************************************************************
+// Локальные переменные
+//*************************************************************************************************
+//счетчики импульсов: pulse_isr[] - увеличивается только в прерывании EXTI,
+//pulse_done[] - только в задаче TaskWater, разность - необработанные импульсы
+static volatile uint32_t pulse_isr[COUNT_FILTER + 1];
+static uint32_t pulse_done[COUNT_FILTER + 1];
+
+//метки времени импульсов (такты счетчика DWT->CYCCNT), индекс метки = pulse_isr[] % PULSE_RING_SIZE,
+//метки тиков RTOS (мсек) тех же импульсов: по ним проверяется, что интервал меньше FLOW_TIMEOUT,
+//т.е. разность меток DWT->CYCCNT не содержит переполнения
+static volatile uint32_t pulse_time[COUNT_FILTER + 1][PULSE_RING_SIZE];
+static volatile uint32_t pulse_tick[COUNT_FILTER + 1][PULSE_RING_SIZE];
+
+//*************************************************************************************************
+// Регистрация импульса от счетчика воды, вызывается из прерывания EXTI
+//-------------------------------------------------------------------------------------------------
+// CountType type - тип счетчика
+//*************************************************************************************************
+void PulseAdd( CountType type ) {
+
+    if ( type > COUNT_FILTER )
+        return;
+    pulse_time[type][pulse_isr[type] % PULSE_RING_SIZE] = DWT->CYCCNT;
+    pulse_tick[type][pulse_isr[type] % PULSE_RING_SIZE] = osKernelGetTickCount();
+    pulse_isr[type]++;
+ }
+
+//*************************************************************************************************
+// Возвращает кол-во импульсов, накопленных в прерывании с момента предыдущего вызова, импульсы
+// отмечаются как обработанные. Вызывается только из задачи "Water".
+//-------------------------------------------------------------------------------------------------
+// CountType type - тип счетчика
+// return         - кол-во новых импульсов
+//*************************************************************************************************
+uint32_t PulseTake( CountType type ) {
+
+    uint32_t pending;
+
+    if ( type > COUNT_FILTER )
+        return 0;
+    //чтение 32-битного значения атомарно, запись выполняется только в прерывании
+    pending = pulse_isr[type] - pulse_done[type];
+    pulse_done[type] += pending;
+    return pending;
+ }
+
+//*************************************************************************************************
+// Возвращает общее кол-во обработанных импульсов счетчика
+//-------------------------------------------------------------------------------------------------
+// CountType type - тип счетчика
+//*************************************************************************************************
+uint32_t PulseDone( CountType type ) {
+
+    if ( type > COUNT_FILTER )
+        return 0;
+    return pulse_done[type];
+ }
+
+//*************************************************************************************************
+// Копия кол-ва импульсов и меток времени, согласованная между собой (прерывания запрещены
+// на время копирования)
+//-------------------------------------------------------------------------------------------------
+// CountType type   - тип счетчика
+// PULSE_SNAP *snap - указатель для размещения копии
+//*************************************************************************************************
+void PulseSnap( CountType type, PULSE_SNAP *snap ) {
+
+    if ( type > COUNT_FILTER ) {
+        memset( snap, 0x00, sizeof( PULSE_SNAP ) );
+        return;
+       }
+    __disable_irq();
+    snap->cnt = pulse_isr[type];
+    snap->now = DWT->CYCCNT;
+    snap->now_tick = osKernelGetTickCount();
+    memcpy( snap->time, (uint8_t *)pulse_time[type], sizeof( snap->time ) );
+    memcpy( snap->tick, (uint8_t *)pulse_tick[type], sizeof( snap->tick ) );
+    __enable_irq();
+ }
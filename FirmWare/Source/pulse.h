@@ -0,0 +1,29 @@
+
+#ifndef __PULSE_H
+#define __PULSE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "water.h"
+
+#define PULSE_RING_SIZE     8                   //кол-во меток времени последних импульсов
+
+//Копия счетчика и меток времени импульсов, согласованных между собой
+typedef struct {
+    uint32_t    cnt;                            //кол-во импульсов, зарегистрированных в прерывании
+    uint32_t    time[PULSE_RING_SIZE];          //метки времени импульсов (такты DWT->CYCCNT)
+    uint32_t    tick[PULSE_RING_SIZE];          //метки времени импульсов (тики RTOS)
+    uint32_t    now;                            //такты DWT->CYCCNT на момент копирования
+    uint32_t    now_tick;                       //тики RTOS на момент копирования
+ } PULSE_SNAP;
+
+//*************************************************************************************************
+// Функции управления
+//*************************************************************************************************
+void PulseAdd( CountType type );
+uint32_t PulseTake( CountType type );
+uint32_t PulseDone( CountType type );
+void PulseSnap( CountType type, PULSE_SNAP *snap );
+
+#endif
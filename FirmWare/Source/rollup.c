@@ -0,0 +1,305 @@
+
+//*************************************************************************************************
+//
+// Итоги расхода воды по суткам, месяцам и годам: расход по счетчикам, мин/макс давление.
+// Итоги хранятся в FRAM в кольцевых таблицах (блок на период), номер блока вычисляется из
+// ключа периода без перебора таблицы. Итоги текущих периодов обновляются в задаче "Storage"
+// после каждой записи в журнал.
+//
+//*************************************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "cmsis_os2.h"
+
+#include "fram.h"
+#include "water.h"
+#include "xtime.h"
+#include "rollup.h"
+
+//*************************************************************************************************
+// Локальные константы
+//*************************************************************************************************
+#define ROLL_MAGIC          0xB0            //признак блока итогов (старшие 4 бита), младшие - уровень
+#define ROLL_MAGIC_STATE    0xBF            //признак блока состояния итогов
+
+#define ROLL_PRESS_NONE     0xFFFF          //нет значения мин. давления с момента обновления
+
+//Расшифровка результата выборки итогов
+static char * const roll_desc[] = {
+    "OK",
+    "No data",
+    "FRAM error",
+    "Parameter",
+    "Disabled"
+ };
+
+#pragma pack( push, 1 )
+
+//Блок состояния итогов: значения счетчиков на момент последнего обновления итогов
+typedef struct {
+    uint8_t     type;                       //признак блока состояния ROLL_MAGIC_STATE
+    uint32_t    count[COUNT_FILTER+1];      //значения счетчиков
+ } ROLL_STATE;
+
+#pragma pack( pop )
+
+//Размещение таблиц итогов в области итогов FRAM (номер первого блока, кол-во блоков)
+typedef struct {
+    uint8_t     first;                      //номер первого блока таблицы (блок 0 - состояние)
+    uint8_t     depth;                      //кол-во периодов в таблице
+ } ROLL_TABLE;
+
+static const ROLL_TABLE roll_table[ROLL_LEVELS] = {
+    { 1, ROLL_DAYS },
+    { 1 + ROLL_DAYS, ROLL_MONTHS },
+    { 1 + ROLL_DAYS + ROLL_MONTHS, ROLL_YEARS }
+ };
+
+//*************************************************************************************************
+// Локальные переменные
+//*************************************************************************************************
+static bool roll_open;                      //блок состояния прочитан из FRAM
+static ROLL_STATE roll_state;               //значения счетчиков последнего обновления итогов
+static ROLLUP roll_curr[ROLL_LEVELS];       //итоги текущих периодов (копия блоков FRAM)
+
+//мин/макс давление с момента последнего обновления итогов, обновляется в задаче "Water"
+static uint16_t press_min[WATER_HOT+1] = { ROLL_PRESS_NONE, ROLL_PRESS_NONE };
+static uint16_t press_max[WATER_HOT+1];
+
+//*************************************************************************************************
+// Прототипы локальных функций
+//*************************************************************************************************
+static uint16_t RollKey( RollLevel level, DATE_TIME *date );
+static uint32_t RollAddr( RollLevel level, uint16_t key );
+static RollStat RollRead( RollLevel level, uint16_t key, ROLLUP *rollup );
+static void RollOpen( uint32_t *count );
+
+//*************************************************************************************************
+// Обновление итогов текущих суток/месяца/года по записи журнала: расход за период увеличивается
+// на разность значений счетчиков записи и предыдущего обновления, мин/макс давление - по
+// значениям RollupPress() и записи журнала. Вызывается после успешной записи в журнал.
+//-------------------------------------------------------------------------------------------------
+// WATER_LOG *wtr_log - указатель на запись журнала
+//*************************************************************************************************
+void RollupAdd( WATER_LOG *wtr_log ) {
+
+    uint8_t i, level;
+    uint16_t key, pmin[WATER_HOT+1], pmax[WATER_HOT+1];
+    uint32_t count[COUNT_FILTER+1], delta[COUNT_FILTER+1];
+    DATE_TIME date;
+    ROLLUP *rollup;
+
+    if ( !FramRollAddr() || wtr_log == NULL )
+        return;
+    count[COUNT_COLD] = wtr_log->count_cold;
+    count[COUNT_HOT] = wtr_log->count_hot;
+    count[COUNT_FILTER] = wtr_log->count_filter;
+    if ( roll_open == false )
+        RollOpen( count );
+    //расход с момента предыдущего обновления, при уменьшении значения счетчика (установка
+    //значения командой) расход не учитывается
+    for ( i = 0; i <= COUNT_FILTER; i++ )
+        delta[i] = count[i] >= roll_state.count[i] ? count[i] - roll_state.count[i] : 0;
+    //мин/макс давление с момента предыдущего обновления
+    RollupPress( wtr_log->pressr_cold, wtr_log->pressr_hot );
+    osKernelLock();
+    memcpy( pmin, press_min, sizeof( pmin ) );
+    memcpy( pmax, press_max, sizeof( pmax ) );
+    for ( i = 0; i <= WATER_HOT; i++ ) {
+        press_min[i] = ROLL_PRESS_NONE;
+        press_max[i] = 0;
+       }
+    osKernelUnlock();
+    date.day = wtr_log->day;
+    date.month = wtr_log->month;
+    date.year = wtr_log->year;
+    for ( level = ROLL_DAY; level < ROLL_LEVELS; level++ ) {
+        rollup = &roll_curr[level];
+        key = RollKey( (RollLevel)level, &date );
+        if ( rollup->type != ( ROLL_MAGIC | level ) || rollup->key != key ) {
+            //новый период или первое обновление после включения: итоги периода из FRAM,
+            //при ошибке чтения итоги уровня не обновляются (данные FRAM не перезаписываются)
+            switch ( RollRead( (RollLevel)level, key, rollup ) ) {
+                case ROLL_OK:
+                    break;
+                case ROLL_EMPTY:
+                    memset( (uint8_t *)rollup, 0x00, sizeof( ROLLUP ) );
+                    rollup->type = ROLL_MAGIC | level;
+                    rollup->key = key;
+                    break;
+                default:
+                    rollup->type = 0;
+                    continue;
+               }
+           }
+        for ( i = 0; i <= COUNT_FILTER; i++ )
+            rollup->volume[i] += delta[i];
+        for ( i = 0; i <= WATER_HOT; i++ ) {
+            if ( pmin[i] != ROLL_PRESS_NONE && ( !rollup->pressr_min[i] || pmin[i] < rollup->pressr_min[i] ) )
+                rollup->pressr_min[i] = pmin[i];
+            if ( pmax[i] > rollup->pressr_max[i] )
+                rollup->pressr_max[i] = pmax[i];
+           }
+        if ( FramSaveBlock( RollAddr( (RollLevel)level, key ), (uint8_t *)rollup, sizeof( ROLLUP ) ) != FRAM_OK )
+            rollup->type = 0; //при следующем обновлении итоги периода читаются из FRAM
+       }
+    //значения счетчиков текущего обновления
+    memcpy( roll_state.count, count, sizeof( roll_state.count ) );
+    FramSaveBlock( FramRollAddr(), (uint8_t *)&roll_state, sizeof( roll_state ) );
+ }
+
+//*************************************************************************************************
+// Учет текущих значений давления в мин/макс значениях итогов, вызывается при обновлении
+// значений давления. Значение "0" (за пределами калибровки) не учитывается.
+//-------------------------------------------------------------------------------------------------
+// uint16_t cold - давление холодной воды (атм * 100)
+// uint16_t hot  - давление горячей воды (атм * 100)
+//*************************************************************************************************
+void RollupPress( uint16_t cold, uint16_t hot ) {
+
+    uint8_t i;
+    uint16_t press[WATER_HOT+1];
+
+    press[WATER_COLD] = cold;
+    press[WATER_HOT] = hot;
+    osKernelLock();
+    for ( i = 0; i <= WATER_HOT; i++ ) {
+        if ( !press[i] )
+            continue;
+        if ( press[i] < press_min[i] )
+            press_min[i] = press[i];
+        if ( press[i] > press_max[i] )
+            press_max[i] = press[i];
+       }
+    osKernelUnlock();
+ }
+
+//*************************************************************************************************
+// Чтение итогов расхода воды за период, содержащий указанную дату
+//-------------------------------------------------------------------------------------------------
+// RollLevel level - уровень итогов (сутки/месяц/год)
+// DATE_TIME *date - дата периода: для месяца не учитывается день, для года - день и месяц
+// ROLLUP *rollup  - указатель на структуру для размещения итогов, при отсутствии данных
+//                   за период заполняется нулями
+// return RollStat - результат выборки
+//*************************************************************************************************
+RollStat RollupGet( RollLevel level, DATE_TIME *date, ROLLUP *rollup ) {
+
+    uint16_t key;
+    RollStat stat;
+
+    if ( level >= ROLL_LEVELS || date == NULL || rollup == NULL )
+        return ROLL_ERROR_PARAM;
+    memset( (uint8_t *)rollup, 0x00, sizeof( ROLLUP ) );
+    if ( !FramRollAddr() )
+        return ROLL_DISABLED;
+    if ( date->year < 2000 || date->year > 2099 || ( level != ROLL_YEAR && ( date->month < 1 || date->month > 12 ) ) ||
+         ( level == ROLL_DAY && ( date->day < 1 || date->day > 31 ) ) )
+        return ROLL_ERROR_PARAM;
+    key = RollKey( level, date );
+    stat = RollRead( level, key, rollup );
+    if ( stat != ROLL_OK )
+        memset( (uint8_t *)rollup, 0x00, sizeof( ROLLUP ) );
+    return stat;
+ }
+
+//*************************************************************************************************
+// Расшифровка результата выборки итогов
+//-------------------------------------------------------------------------------------------------
+// RollStat stat - результат выборки
+// return        - указатель на строку с расшифровкой
+//*************************************************************************************************
+char *RollupStatDesc( RollStat stat ) {
+
+    if ( stat >= sizeof( roll_desc ) / sizeof( roll_desc[0] ) )
+        return "";
+    return roll_desc[stat];
+ }
+
+//*************************************************************************************************
+// Ключ периода итогов по дате
+//-------------------------------------------------------------------------------------------------
+// RollLevel level - уровень итогов
+// DATE_TIME *date - дата
+// return          - ключ периода: сутки - кол-во суток от 01.01.1970, месяц - год * 12 + месяц - 1,
+//                   год - год
+//*************************************************************************************************
+static uint16_t RollKey( RollLevel level, DATE_TIME *date ) {
+
+    DATE_TIME day;
+
+    if ( level == ROLL_YEAR )
+        return date->year;
+    if ( level == ROLL_MONTH )
+        return date->year * 12 + date->month - 1;
+    memset( (uint8_t *)&day, 0x00, sizeof( day ) );
+    day.day = date->day;
+    day.month = date->month;
+    day.year = date->year;
+    return DtimeToSec( &day ) / 86400;
+ }
+
+//*************************************************************************************************
+// Адрес блока итогов периода в FRAM: номер блока в таблице уровня - остаток от деления ключа
+// периода на кол-во периодов таблицы
+//-------------------------------------------------------------------------------------------------
+// RollLevel level - уровень итогов
+// uint16_t key    - ключ периода
+// return          - адрес блока FRAM
+//*************************************************************************************************
+static uint32_t RollAddr( RollLevel level, uint16_t key ) {
+
+    return FramRollAddr() + ( roll_table[level].first + key % roll_table[level].depth ) * FRAM_BLOCK_SIZE;
+ }
+
+//*************************************************************************************************
+// Чтение блока итогов периода из FRAM, блок принадлежит периоду при совпадении уровня и ключа
+//-------------------------------------------------------------------------------------------------
+// RollLevel level - уровень итогов
+// uint16_t key    - ключ периода
+// ROLLUP *rollup  - указатель на структуру для размещения итогов
+// return RollStat - ROLL_OK, ROLL_EMPTY - блок свободен или содержит итоги другого периода,
+//                   ROLL_ERROR - ошибка чтения или КС
+//*************************************************************************************************
+static RollStat RollRead( RollLevel level, uint16_t key, ROLLUP *rollup ) {
+
+    FramStatus crc;
+    uint8_t data[FRAM_BLOCK_SIZE];
+    uint16_t blk_crc;
+
+    if ( FramReadBlocks( RollAddr( level, key ), 1, data, &crc ) != FRAM_OK )
+        return ROLL_ERROR;
+    if ( crc != FRAM_OK ) {
+        //КС свободного (очищенного) блока
+        memcpy( (uint8_t *)&blk_crc, data + FRAM_BLOCK_SIZE - sizeof( blk_crc ), sizeof( blk_crc ) );
+        return ( blk_crc == 0x0000 || blk_crc == 0xFFFF ) ? ROLL_EMPTY : ROLL_ERROR;
+       }
+    memcpy( (uint8_t *)rollup, data, sizeof( ROLLUP ) );
+    if ( rollup->type != ( ROLL_MAGIC | level ) || rollup->key != key )
+        return ROLL_EMPTY;
+    return ROLL_OK;
+ }
+
+//*************************************************************************************************
+// Чтение блока состояния итогов при первом обновлении после включения, при отсутствии
+// блока состояния отсчет расхода начинается с текущих значений счетчиков
+//-------------------------------------------------------------------------------------------------
+// uint32_t *count - текущие значения счетчиков
+//*************************************************************************************************
+static void RollOpen( uint32_t *count ) {
+
+    FramStatus crc;
+    uint8_t data[FRAM_BLOCK_SIZE];
+
+    if ( FramReadBlocks( FramRollAddr(), 1, data, &crc ) == FRAM_OK && crc == FRAM_OK &&
+         data[0] == ROLL_MAGIC_STATE )
+        memcpy( (uint8_t *)&roll_state, data, sizeof( roll_state ) );
+    else {
+        roll_state.type = ROLL_MAGIC_STATE;
+        memcpy( roll_state.count, count, sizeof( roll_state.count ) );
+       }
+    roll_open = true;
+ }
@@ -0,0 +1,50 @@
+
+#ifndef __ROLLUP_H
+#define __ROLLUP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "water.h"
+#include "xtime.h"
+
+//Уровень итогов расхода воды
+typedef enum {
+    ROLL_DAY,                               //итоги за сутки
+    ROLL_MONTH,                             //итоги за месяц
+    ROLL_YEAR,                              //итоги за год
+    ROLL_LEVELS                             //кол-во уровней итогов
+ } RollLevel;
+
+//Результат выборки итогов расхода воды
+typedef enum {
+    ROLL_OK,                                //итоги за период прочитаны
+    ROLL_EMPTY,                             //нет данных за период
+    ROLL_ERROR,                             //ошибка чтения FRAM или КС блока
+    ROLL_ERROR_PARAM,                       //ошибка в параметрах запроса
+    ROLL_DISABLED                           //итоги не хранятся (недостаточный размер FRAM)
+ } RollStat;
+
+#pragma pack( push, 1 )
+
+//Итоги расхода воды за период (сутки/месяц/год), один блок FRAM
+typedef struct {
+    uint8_t     type;                       //признак блока итогов + уровень итогов RollLevel
+    uint16_t    key;                        //ключ периода: сутки - кол-во суток от 01.01.1970,
+                                            //месяц - год * 12 + месяц - 1, год - год
+    uint32_t    volume[COUNT_FILTER+1];     //расход воды за период по счетчикам (литры)
+    uint16_t    pressr_min[WATER_HOT+1];    //мин. давление холодной/горячей воды (атм * 100)
+    uint16_t    pressr_max[WATER_HOT+1];    //макс. давление холодной/горячей воды (атм * 100)
+ } ROLLUP;
+
+#pragma pack( pop )
+
+//*************************************************************************************************
+// Функции управления
+//*************************************************************************************************
+void RollupAdd( WATER_LOG *wtr_log );
+void RollupPress( uint16_t cold, uint16_t hot );
+RollStat RollupGet( RollLevel level, DATE_TIME *date, ROLLUP *rollup );
+char *RollupStatDesc( RollStat stat );
+
+#endif
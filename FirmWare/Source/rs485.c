@@ -18,6 +18,7 @@
 #include "uart.h"
 #include "modbus.h"
 #include "events.h"
+#include "message.h"
 
 //*************************************************************************************************
 // Внешние переменные
@@ -29,19 +30,52 @@ extern UART_HandleTypeDef huart3;
 // Локальные константы
 //*************************************************************************************************
 #define BUFFER_SIZE             255                 //размер приемного и передающего буфера
+#define RING_SIZE               256                 //размер кольцевого буфера приема DMA (2^n)
+
+#define RECV_FRAMES             2                   //кол-во буферов принятых фреймов
+
+#define SEND_BITS               11                  //кол-во бит на один байт (старт, 8 бит, 
+                                                    //паритет или второй стоп, стоп)
+#define SEND_MARGIN             10                  //запас времени ожидания окончания передачи (ms)
 
 #define RS485_MODE_SEND         GPIO_PIN_SET
 #define RS485_MODE_RECV         GPIO_PIN_RESET
 
+//*************************************************************************************************
+// Локальные типы данных
+//*************************************************************************************************
+//Буфер принятого фрейма: заполняется в прерывании TIMER2, освобождается задачей "Modbus"
+typedef struct {
+    volatile uint8_t len;                   //длина фрейма, 0 - буфер свободен
+    uint32_t time;                          //метка времени окончания приема (такты DWT->CYCCNT)
+    uint8_t data[BUFFER_SIZE];              //данные фрейма
+ } RECV_FRAME;
+
 //*************************************************************************************************
 // Локальные переменные
 //*************************************************************************************************
 #if defined( DEBUG_MODBUS ) && defined( DEBUG_TARGET )
 char str[80];
 #endif
-static char recv;
-static uint8_t recv_ind = 0; 
-static uint8_t recv_buff[BUFFER_SIZE], send_buff[BUFFER_SIZE];
+static char * const rs485_desc[] = {
+    "Frames received",
+    "Bytes received",
+    "Receive interrupts",
+    "Receive errors (noise, framing, overrun)",
+    "Frames dropped (buffers busy)",
+    "Response time last (us)",
+    "Response time max (us)"
+ };
+
+static uint8_t send_buff[BUFFER_SIZE];
+static RECV_FRAME recv_frame[RECV_FRAMES];  //буферы принятых фреймов (поочередно)
+static uint8_t frame_fill;                  //индекс буфера для следующего принятого фрейма
+static uint8_t frame_proc;                  //индекс буфера следующего обрабатываемого фрейма
+static uint8_t recv_ring[RING_SIZE];        //кольцевой буфер приема DMA
+static uint16_t ring_pos;                   //позиция начала следующего фрейма
+static uint16_t ring_idle;                  //позиция приема DMA на момент признака IDLE
+static volatile bool send_busy;             //выполняется передача ответа
+static uint32_t rs485_stat[RS485_STAT_CNT];
 
 static osEventFlagsId_t modbus_event = NULL;
 
@@ -50,14 +84,18 @@ static osEventFlagsId_t modbus_event = NULL;
 //*************************************************************************************************
 static const osThreadAttr_t task_attr = {
     .name = "Modbus", 
-    .stack_size = 512,
+    .stack_size = 640,
     .priority = osPriorityNormal
  };
  
 //*************************************************************************************************
 // Прототипы локальных функций
 //*************************************************************************************************
-static void ClearRecv( void );
+static void ClearRecv( RECV_FRAME *frame );
+static void RecvStart( void );
+static void RespTime( uint32_t start );
+static void SendWait( uint8_t len );
+static uint16_t RingPos( void );
 static void TaskModbus( void *pvParameters );
 
 //*************************************************************************************************
@@ -84,6 +122,7 @@ static void TaskModbus( void *pvParameters ) {
     uint8_t len_send;
     ModBusError error;
     MBUS_REQ request;
+    RECV_FRAME *frame;
     
     //запускаем прием
     osEventFlagsSet( modbus_event, EVN_MODBUS_START );
@@ -91,50 +130,131 @@ static void TaskModbus( void *pvParameters ) {
         event = osEventFlagsWait( modbus_event, EVN_MODBUS_MASK, osFlagsWaitAny, osWaitForever );
         //стартуем прием данных
         if ( event & EVN_MODBUS_START ) {
-            ClearRecv();
             HAL_GPIO_WritePin( RS485_SEND_GPIO_Port, RS485_SEND_Pin, RS485_MODE_RECV );
-            HAL_UART_Receive_IT( &huart3, (uint8_t *)&recv, sizeof( recv ) );
+            RecvStart();
            }
-        //обработка принятого фрейма
-        if ( event & EVN_MODBUS_RECV ) {
-            error = CheckRequest( recv_buff, recv_ind, &request );
+        //обработка принятых фреймов в порядке приема, прием следующего фрейма
+        //выполняется в другой буфер во время обработки текущего
+        if ( !( event & EVN_MODBUS_RECV ) )
+            continue;
+        for ( frame = &recv_frame[frame_proc]; frame->len; frame = &recv_frame[frame_proc] ) {
+            error = CheckRequest( frame->data, frame->len, &request );
             IncError( error );
             #if defined( DEBUG_MODBUS ) && defined( DEBUG_TARGET )
             sprintf( str, "MODBUS: %s\r\n", ModBusErrDesc( error ) );
             UartSendStr( str );
             #endif
-            if ( error == MBUS_REQST_NOT_FOR_DEV || error == MBUS_REQST_CRC || error == MBUS_ERROR_PARAM )
-                ClearRecv(); //принятый фрейм не обрабатываем
-            else {
+            //принятый фрейм не для этого устройства или с ошибкой - не обрабатываем
+            if ( error != MBUS_REQST_NOT_FOR_DEV && error != MBUS_REQST_CRC && error != MBUS_ERROR_PARAM ) {
                 //подготовка ответа
                 len_send = CreateFrame( &request, error );
                 if ( len_send ) {
-                    //переход в режим передачи
+                    //переход в режим передачи, байты принятые до завершения передачи
+                    //отбрасываются в RS485SendComplt()
+                    send_busy = true;
+                    osEventFlagsClear( modbus_event, EVN_MODBUS_SENT );
                     HAL_GPIO_WritePin( RS485_SEND_GPIO_Port, RS485_SEND_Pin, RS485_MODE_SEND );
-                    HAL_UART_Transmit_IT( &huart3, (uint8_t *)&send_buff, len_send );
+                    if ( HAL_UART_Transmit_IT( &huart3, (uint8_t *)&send_buff, len_send ) == HAL_OK ) {
+                        //время от последнего байта запроса до начала передачи ответа
+                        RespTime( frame->time );
+                        //ответ на следующий фрейм формируется в send_buff после передачи
+                        SendWait( len_send );
+                       }
+                    else RS485SendComplt(); //передача не запущена, возврат в режим приема
                    }
-                ClearRecv();
                }
+            ClearRecv( frame );
+            frame_proc = ( frame_proc + 1 ) % RECV_FRAMES;
            }
       }
  }
 
 //*************************************************************************************************
-// Функция обратного вызова при приеме байта по UART3
+// Запуск приема по UART3: циклический прием DMA в кольцевой буфер, окончание фрейма 
+// определяется по признаку IDLE UART и паузе TIMER2, прерывания DMA по заполнению буфера
+// не используются. Вызывается при запуске и после ошибки приема. Прием DMA во время передачи
+// ответа не останавливается, позиция начала следующего фрейма синхронизируется после
+// передачи в RS485SendComplt().
+//*************************************************************************************************
+static void RecvStart( void ) {
+
+    //прием DMA продолжается во время передачи ответа - останавливаем для синхронизации позиций
+    if ( huart3.RxState != HAL_UART_STATE_READY )
+        HAL_UART_AbortReceive( &huart3 );
+    ring_pos = ring_idle = 0;
+    HAL_UART_Receive_DMA( &huart3, recv_ring, sizeof( recv_ring ) );
+    __HAL_DMA_DISABLE_IT( huart3.hdmarx, DMA_IT_HT | DMA_IT_TC );
+    __HAL_UART_CLEAR_IDLEFLAG( &huart3 );
+    __HAL_UART_ENABLE_IT( &huart3, UART_IT_IDLE );
+ }
+
+//*************************************************************************************************
+// Ожидание окончания передачи ответа, время ожидания рассчитывается по кол-ву байт и скорости
+// обмена. При превышении времени ожидания передача прерывается.
+//-------------------------------------------------------------------------------------------------
+// uint8_t len - кол-во передаваемых байт
 //*************************************************************************************************
-void RS485RecvComplt( void ) {
+static void SendWait( uint8_t len ) {
+
+    uint32_t wait;
 
-    //прием одного байта
-    if ( recv_ind < sizeof( recv_buff ) )
-        recv_buff[recv_ind++] = recv;
-    else ClearRecv(); //переполнение буфера
-    //продолжаем прием
-    HAL_UART_Receive_IT( &huart3, (uint8_t *)&recv, sizeof( recv ) );
-    //если таймер выключен - стартуем один раз
-    //при приеме каждого следующего байта - только сброс счетчика
-    if ( !( htim2.Instance->CR1 & TIM_CR1_CEN ) )
-        __HAL_TIM_ENABLE( &htim2 );
-    else __HAL_TIM_SetCounter( &htim2, 0 );
+    wait = SEND_MARGIN + ( len * SEND_BITS * 1000 ) / huart3.Init.BaudRate;
+    if ( osEventFlagsWait( modbus_event, EVN_MODBUS_SENT, osFlagsWaitAny, wait ) & osFlagsError ) {
+        HAL_UART_AbortTransmit( &huart3 );
+        RS485SendComplt();
+        osEventFlagsClear( modbus_event, EVN_MODBUS_SENT );
+       }
+ }
+
+//*************************************************************************************************
+// Расчет времени ответа от последнего байта запроса до начала передачи ответа: время от
+// обнаружения окончания фрейма плюс пауза окончания фрейма (IDLE + TIMER2)
+//-------------------------------------------------------------------------------------------------
+// uint32_t start - метка времени обнаружения окончания фрейма (такты DWT->CYCCNT)
+//*************************************************************************************************
+static void RespTime( uint32_t start ) {
+
+    uint32_t time;
+
+    time = ( DWT->CYCCNT - start ) / ( SystemCoreClock / 1000000 );
+    //пауза окончания фрейма 3.5 символа: 1 символ до признака IDLE + 2.5 символа TIMER2 (мкс)
+    time += ( __HAL_TIM_GET_AUTORELOAD( &htim2 ) * 7 ) / 5;
+    rs485_stat[RS485_STAT_RESP_LAST] = time;
+    if ( time > rs485_stat[RS485_STAT_RESP_MAX] )
+        rs485_stat[RS485_STAT_RESP_MAX] = time;
+ }
+
+//*************************************************************************************************
+// Возвращает текущую позицию приема DMA в кольцевом буфере
+//*************************************************************************************************
+static uint16_t RingPos( void ) {
+
+    return ( RING_SIZE - __HAL_DMA_GET_COUNTER( huart3.hdmarx ) ) & ( RING_SIZE - 1 );
+ }
+
+//*************************************************************************************************
+// Функция обратного вызова при паузе на линии приема UART3 (признак IDLE) - пауза в один
+// символ, запуск TIMER2 для отсчета оставшейся паузы окончания фрейма
+//*************************************************************************************************
+void RS485RecvIdle( void ) {
+
+    rs485_stat[RS485_STAT_IRQ]++;
+    ring_idle = RingPos();
+    __HAL_TIM_SetCounter( &htim2, 0 );
+    __HAL_TIM_ENABLE( &htim2 );
+ }
+
+//*************************************************************************************************
+// Функция обратного вызова при ошибке приема UART3, прием DMA остановлен HAL - перезапуск
+// приема, принятые данные текущего фрейма отбрасываются
+//*************************************************************************************************
+void RS485RecvError( void ) {
+
+    rs485_stat[RS485_STAT_IRQ]++;
+    rs485_stat[RS485_STAT_ERROR]++;
+    __HAL_TIM_DISABLE( &htim2 );
+    if ( huart3.RxState == HAL_UART_STATE_READY )
+        RecvStart();
  }
 
 //*************************************************************************************************
@@ -142,29 +262,94 @@ void RS485RecvComplt( void ) {
 //*************************************************************************************************
 void Rs485Callback( void ) {
 
+    uint8_t len;
+    uint16_t pos;
+    RECV_FRAME *frame;
+
     //выключаем таймер
     __HAL_TIM_DISABLE( &htim2 );
+    rs485_stat[RS485_STAT_IRQ]++;
+    //после признака IDLE принят следующий байт - пауза меньше 3.5 символов, 
+    //окончание фрейма определяется по следующему признаку IDLE
+    pos = RingPos();
+    if ( pos != ring_idle || pos == ring_pos )
+        return;
+    if ( send_busy == true ) {
+        //во время передачи ответа принимается только эхо передатчика - отбрасываем
+        ring_pos = pos;
+        return;
+       }
+    frame = &recv_frame[frame_fill];
+    if ( frame->len ) {
+        //оба буфера заняты - фрейм отбрасываем
+        rs485_stat[RS485_STAT_DROP]++;
+        ring_pos = pos;
+        return;
+       }
+    //копирование фрейма из кольцевого буфера, длина записывается последней - 
+    //после этого буфер передается задаче
+    for ( len = 0; ring_pos != pos && len < sizeof( frame->data ); ring_pos = ( ring_pos + 1 ) & ( RING_SIZE - 1 ) )
+        frame->data[len++] = recv_ring[ring_pos];
+    ring_pos = pos;
+    frame->time = DWT->CYCCNT;
+    frame->len = len;
+    frame_fill = ( frame_fill + 1 ) % RECV_FRAMES;
+    rs485_stat[RS485_STAT_FRAMES]++;
+    rs485_stat[RS485_STAT_BYTES] += len;
     //сообщим в задачу для дальнейшей обработки принятого фрейма
-    if ( recv_ind )
-        osEventFlagsSet( modbus_event, EVN_MODBUS_RECV );
+    osEventFlagsSet( modbus_event, EVN_MODBUS_RECV );
  }
 
 //*************************************************************************************************
-// Функция обратного вызова при завершении передачи фрейма по UART3
+// Функция обратного вызова при завершении передачи фрейма по UART3 (передан стоп-бит 
+// последнего байта). Прием DMA во время передачи продолжается: если приемник трансивера не
+// отключается выводом RS485_SEND, в кольцевой буфер принимается эхо ответа, кроме того
+// возможен прием помехи при переключении направления. Ведущий не передает запросы до
+// окончания ответа, поэтому все байты принятые во время передачи отбрасываются: начало
+// следующего фрейма синхронизируется с текущей позицией приема DMA.
 //*************************************************************************************************
 void RS485SendComplt( void ) {
 
     //переход в режим приема
     HAL_GPIO_WritePin( RS485_SEND_GPIO_Port, RS485_SEND_Pin, RS485_MODE_RECV );
+    //отсчет паузы по признаку IDLE от эха прекращаем
+    __HAL_TIM_DISABLE( &htim2 );
+    ring_pos = ring_idle = RingPos();
+    send_busy = false;
+    //send_buff свободен для следующего ответа
+    osEventFlagsSet( modbus_event, EVN_MODBUS_SENT );
+ }
+
+//*************************************************************************************************
+// Обнуление принятой части буфера фрейма и освобождение буфера для приема
+//-------------------------------------------------------------------------------------------------
+// RECV_FRAME *frame - указатель на буфер фрейма
+//*************************************************************************************************
+static void ClearRecv( RECV_FRAME *frame ) {
+
+    memset( frame->data, 0x00, frame->len );
+    frame->len = 0;
  }
 
 //*************************************************************************************************
-// Обнуление приемного буфера
+// Возвращает расшифровку и значения счетчиков статистики приема RS-485
+//-------------------------------------------------------------------------------------------------
+// RS485Stat index - индекс счетчика
+// char *str       - указатель для размещения результата
+// return          - указатель на строку с расшифровкой
 //*************************************************************************************************
-static void ClearRecv( void ) {
+char *RS485StatDesc( RS485Stat index, char *str ) {
+
+    char *ptr;
 
-    recv_ind = 0;
-    memset( (uint8_t *)recv_buff, 0x00, sizeof( recv_buff ) );
+    if ( index >= RS485_STAT_CNT )
+        return NULL;
+    ptr = str;
+    ptr += sprintf( ptr, "%s", rs485_desc[index] );
+    //дополним расшифровку справа знаком "." до 45 символов
+    ptr += AddDot( str, 45, 0 );
+    ptr += sprintf( ptr, "%6u ", rs485_stat[index] );
+    return str;
  }
 
 //*************************************************************************************************
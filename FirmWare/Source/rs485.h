@@ -6,14 +6,28 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+//Индексы счетчиков статистики приема RS-485
+typedef enum {
+    RS485_STAT_FRAMES,                      //кол-во принятых фреймов
+    RS485_STAT_BYTES,                       //кол-во принятых байт
+    RS485_STAT_IRQ,                         //кол-во прерываний приема (IDLE, таймер, ошибки)
+    RS485_STAT_ERROR,                       //кол-во ошибок приема UART (шум, кадр, переполнение)
+    RS485_STAT_DROP,                        //кол-во отброшенных фреймов (буферы фреймов заняты)
+    RS485_STAT_RESP_LAST,                   //время ответа на последний запрос (мкс)
+    RS485_STAT_RESP_MAX,                    //макс. время ответа на запрос (мкс)
+    RS485_STAT_CNT                          //кол-во счетчиков статистики
+ } RS485Stat;
+
 //*************************************************************************************************
 // Функции управления/статуса/состояния
 //*************************************************************************************************
 void Rs485Init( void );
 void Rs485Callback( void );
-void RS485RecvComplt( void );
+void RS485RecvIdle( void );
+void RS485RecvError( void );
 void RS485SendComplt( void );
 uint8_t *RS485SendBuff( void );
 void ClearSend( void );
+char *RS485StatDesc( RS485Stat index, char *str );
 
 #endif
@@ -0,0 +1,189 @@
+
+//*************************************************************************************************
+//
+// Фоновая проверка FRAM: КС блоков используемой области проверяются по одному блоку за
+// интервал SCRUB_PERIOD в задаче "Storage" при отсутствии запросов записи, поврежденные
+// блоки по возможности восстанавливаются, остальные отмечаются в карте поврежденных блоков
+//
+//*************************************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "cmsis_os2.h"
+
+#include "fram.h"
+#include "scrub.h"
+#include "storage.h"
+#include "message.h"
+
+//*************************************************************************************************
+// Локальные переменные
+//*************************************************************************************************
+static char * const scrub_desc[] = {
+    "Scrub passes completed",
+    "Blocks checked",
+    "Free blocks (last pass)",
+    "Transient CRC errors",
+    "Blocks repaired",
+    "Rollup blocks cleared",
+    "Bad blocks",
+    "FRAM read/write errors",
+    "Last pass time (sec)"
+ };
+
+static uint32_t scrub_addr;                 //адрес следующего проверяемого блока
+static uint32_t scrub_start;                //время начала текущего цикла (тики)
+static uint16_t scrub_free;                 //кол-во свободных блоков в текущем цикле
+static uint32_t scrub_stat[SCRUB_STAT_CNT];
+static uint8_t scrub_map[( SCRUB_BLOCKS_MAX + 7 ) / 8]; //карта поврежденных блоков (бит на блок)
+static uint16_t scrub_slot;                 //блок текущих параметров, ожидающий перезаписи
+
+//*************************************************************************************************
+// Прототипы локальных функций
+//*************************************************************************************************
+static void ScrubMark( uint16_t block, bool bad );
+static void ScrubSlotDone( FramStatus status );
+
+//*************************************************************************************************
+// Проверка одного блока FRAM, вызывается из задачи "Storage" при отсутствии запросов записи.
+// После проверки последнего блока используемой области цикл проверки начинается сначала.
+//*************************************************************************************************
+void ScrubStep( void ) {
+
+    uint16_t block;
+
+    if ( !scrub_addr )
+        scrub_start = osKernelGetTickCount();
+    block = scrub_addr / FRAM_BLOCK_SIZE;
+    switch ( FramScrubBlock( scrub_addr ) ) {
+        case FRAM_SCRUB_OK:
+            ScrubMark( block, false );
+            break;
+        case FRAM_SCRUB_FREE:
+            ScrubMark( block, false );
+            scrub_free++;
+            break;
+        case FRAM_SCRUB_TRANSIENT:
+            ScrubMark( block, false );
+            scrub_stat[SCRUB_STAT_TRANSIENT]++;
+            break;
+        case FRAM_SCRUB_SLOT:
+            //блок текущих параметров перезаписывается значениями из RAM, блок
+            //учитывается как восстановленный по результату записи
+            scrub_slot = block;
+            StorageFlush( ScrubSlotDone );
+            break;
+        case FRAM_SCRUB_REPAIRED:
+            ScrubMark( block, false );
+            scrub_stat[SCRUB_STAT_REPAIRED]++;
+            break;
+        case FRAM_SCRUB_CLEARED:
+            ScrubMark( block, false );
+            scrub_stat[SCRUB_STAT_CLEARED]++;
+            break;
+        case FRAM_SCRUB_BAD:
+            ScrubMark( block, true );
+            break;
+        default:
+            scrub_stat[SCRUB_STAT_ERROR]++;
+            break;
+       }
+    scrub_stat[SCRUB_STAT_BLOCKS]++;
+    scrub_addr += FRAM_BLOCK_SIZE;
+    if ( scrub_addr >= FramAreaEnd() ) {
+        //цикл проверки завершен
+        scrub_addr = 0;
+        scrub_stat[SCRUB_STAT_PASS]++;
+        scrub_stat[SCRUB_STAT_FREE] = scrub_free;
+        scrub_stat[SCRUB_STAT_TIME] = ( osKernelGetTickCount() - scrub_start ) / osKernelGetTickFreq();
+        scrub_free = 0;
+       }
+ }
+
+//*************************************************************************************************
+// Результат перезаписи блока текущих параметров, вызывается в контексте задачи "Storage"
+//-------------------------------------------------------------------------------------------------
+// FramStatus status - результат записи
+//*************************************************************************************************
+static void ScrubSlotDone( FramStatus status ) {
+
+    if ( status == FRAM_OK ) {
+        ScrubMark( scrub_slot, false );
+        scrub_stat[SCRUB_STAT_REPAIRED]++;
+       }
+    else {
+        ScrubMark( scrub_slot, true );
+        scrub_stat[SCRUB_STAT_ERROR]++;
+       }
+ }
+
+//*************************************************************************************************
+// Возвращает значение счетчика статистики фоновой проверки FRAM
+//-------------------------------------------------------------------------------------------------
+// ScrubStat index - индекс счетчика
+//*************************************************************************************************
+uint32_t ScrubStatValue( ScrubStat index ) {
+
+    if ( index >= SCRUB_STAT_CNT )
+        return 0;
+    return scrub_stat[index];
+ }
+
+//*************************************************************************************************
+// Состояние блока по карте поврежденных блоков
+//-------------------------------------------------------------------------------------------------
+// uint16_t block - номер блока FRAM (адрес / FRAM_BLOCK_SIZE)
+// return = true  - блок поврежден (по результату последней проверки)
+//*************************************************************************************************
+bool ScrubBlockBad( uint16_t block ) {
+
+    if ( block >= SCRUB_BLOCKS_MAX )
+        return false;
+    return ( scrub_map[block >> 3] & ( 1 << ( block & 0x07 ) ) ) != 0;
+ }
+
+//*************************************************************************************************
+// Возвращает расшифровку и значения счетчиков статистики фоновой проверки FRAM
+//-------------------------------------------------------------------------------------------------
+// ScrubStat index - индекс счетчика
+// char *str       - указатель для размещения результата
+// return          - указатель на строку с расшифровкой
+//*************************************************************************************************
+char *ScrubStatDesc( ScrubStat index, char *str ) {
+
+    char *ptr;
+
+    if ( index >= SCRUB_STAT_CNT )
+        return NULL;
+    ptr = str;
+    ptr += sprintf( ptr, "%s", scrub_desc[index] );
+    //дополним расшифровку справа знаком "." до 45 символов
+    ptr += AddDot( str, 45, 0 );
+    ptr += sprintf( ptr, "%6u ", scrub_stat[index] );
+    return str;
+ }
+
+//*************************************************************************************************
+// Отметка блока в карте поврежденных блоков, обновление кол-ва поврежденных блоков
+//-------------------------------------------------------------------------------------------------
+// uint16_t block - номер блока FRAM
+// bool bad       - true - блок поврежден
+//*************************************************************************************************
+static void ScrubMark( uint16_t block, bool bad ) {
+
+    uint8_t mask;
+
+    if ( block >= SCRUB_BLOCKS_MAX || ScrubBlockBad( block ) == bad )
+        return;
+    mask = 1 << ( block & 0x07 );
+    if ( bad == true ) {
+        scrub_map[block >> 3] |= mask;
+        scrub_stat[SCRUB_STAT_BAD]++;
+       }
+    else {
+        scrub_map[block >> 3] &= ~mask;
+        scrub_stat[SCRUB_STAT_BAD]--;
+       }
+ }
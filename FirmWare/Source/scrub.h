@@ -0,0 +1,37 @@
+
+#ifndef __SCRUB_H
+#define __SCRUB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "fram.h"
+
+#define SCRUB_PERIOD            100         //интервал проверки одного блока FRAM (ms)
+
+//Макс. кол-во проверяемых блоков: текущие параметры, журнал, итоги расхода
+#define SCRUB_BLOCKS_MAX        ( FRAM_ADDR_LOG / FRAM_BLOCK_SIZE + LOG_SEGMENTS_MAX * LOG_SEG_BLOCKS + ROLL_BLOCKS )
+
+//Индексы счетчиков статистики фоновой проверки FRAM
+typedef enum {
+    SCRUB_STAT_PASS,                        //кол-во завершенных циклов проверки
+    SCRUB_STAT_BLOCKS,                      //кол-во проверенных блоков
+    SCRUB_STAT_FREE,                        //кол-во свободных блоков в последнем цикле
+    SCRUB_STAT_TRANSIENT,                   //кол-во ошибок КС, не подтвержденных повторным чтением
+    SCRUB_STAT_REPAIRED,                    //кол-во восстановленных блоков
+    SCRUB_STAT_CLEARED,                     //кол-во очищенных блоков итогов расхода
+    SCRUB_STAT_BAD,                         //текущее кол-во поврежденных блоков
+    SCRUB_STAT_ERROR,                       //кол-во ошибок чтения/записи FRAM
+    SCRUB_STAT_TIME,                        //время последнего цикла проверки (сек)
+    SCRUB_STAT_CNT                          //кол-во счетчиков статистики
+ } ScrubStat;
+
+//*************************************************************************************************
+// Функции управления
+//*************************************************************************************************
+void ScrubStep( void );
+uint32_t ScrubStatValue( ScrubStat index );
+bool ScrubBlockBad( uint16_t block );
+char *ScrubStatDesc( ScrubStat index, char *str );
+
+#endif
@@ -1,7 +1,7 @@
-
 //*************************************************************************************************
 //
-// Сортировка данных в массиве
+// Индекс журнала событий в RAM: порядок сегментов журнала по номеру опорной записи, интервал
+// дата/время и типы записей каждого сегмента, выборка записей журнала за интервал дата/время
 //
 //*************************************************************************************************
 
@@ -17,90 +17,193 @@
 #include "sort.h"
 #include "parse.h"
 #include "uart.h"
+#include "water.h"
 
 //*************************************************************************************************
-// Локальные переменные
+// Локальные константы
 //*************************************************************************************************
-#pragma pack( push, 1 )
+#define LOG_IDX_ALARM       0x01                //сегмент содержит события утечки (EVENT_ALARM)
 
-//структура для сортировки данных
+//*************************************************************************************************
+// Локальные переменные
+//*************************************************************************************************
+//элемент индекса журнала: номер первой записи сегмента, интервал дата/время записей сегмента
 typedef struct {
-    uint16_t addr;
-    uint64_t value;
+    uint32_t seq;                               //порядковый номер опорной записи сегмента
+    uint32_t first;                             //минимальное значение дата/время записей (сек)
+    uint32_t last;                              //максимальное значение дата/время записей (сек)
+    uint8_t  cnt;                               //кол-во записей, "0" - сегмент не содержит записей
+    uint8_t  flags;                             //признаки LOG_IDX_*
  } DATA_SORT;
 
-//структура для преобразования DD.MM.YYYY HH:MM:SS в YYYYMMDDHHMMSS
+//параметры выборки записей сегмента журнала
 typedef struct {
-    uint64_t value;
-} DATA_DATE; 
+    uint32_t  from;                             //начало интервала (сек)
+    uint32_t  to;                               //окончание интервала (сек)
+    uint8_t   mask;                             //типы записей LOG_FIND_*
+    LogFindCb cb;                               //функция обработки записи, NULL - только подсчет
+    uint16_t  find;                             //кол-во выбранных записей
+    bool      stop;                             //выборка прекращена функцией обработки
+    WATER_LOG *wtr_log;                         //первая выбранная запись для LogNext()
+ } LOG_SELECT;
 
-#pragma pack( pop )
+static uint8_t cnt_reqst = 0, index;
+//индекс журнала в RAM, формируется один раз при включении SortInit(), 
+//при записи в журнал обновляется SortAdd()
+static DATA_SORT data_sort[LOG_SEGMENTS_MAX];   //данные сегментов журнала
+static uint8_t seq_sort[LOG_SEGMENTS_MAX];      //номера сегментов от новых записей к старым
+static uint8_t sort_cnt;                        //кол-во сегментов в индексе
+static bool sort_ready = false;                 //индекс сформирован
+//индекс формируется одной задачей, записи журнала, добавленные во время формирования индекса,
+//могут не попасть в индекс - индекс формируется повторно при следующей выборке
+static bool sort_build = false;                 //выполняется формирование индекса
+static bool sort_stale = false;                 //запись в журнал во время формирования индекса
 
 //*************************************************************************************************
-// Локальные переменные
+// Прототипы локальные функций
 //*************************************************************************************************
-static uint8_t cnt_reqst = 0, index;
-static DATA_SORT data_sort[FRAM_BLOCKS-1];
+static void SortInsert( uint8_t seg );
+static void SortRemove( uint8_t seg );
+static void SortRecord( DATA_SORT *item, WATER_LOG *wtr_log );
+static bool SortInitRec( uint16_t ref, WATER_LOG *wtr_log, void *arg );
+static bool LogSelect( uint16_t ref, WATER_LOG *wtr_log, void *arg );
+static bool SegMatch( DATA_SORT *item, LOG_SELECT *sel );
+static uint32_t LogTime( WATER_LOG *wtr_log );
 
 //*************************************************************************************************
-// Прототипы локальные функций
+// Формирование индекса журнала: однократное чтение всех сегментов журнала из FRAM, сегменты
+// упорядочиваются по номеру опорной записи. Вызывается из TaskWater() при включении. При ошибке
+// обмена с FRAM (кроме ошибки КС) индекс будет сформирован повторно при следующем вызове MakeSort().
+// Если индекс уже формируется другой задачей, повторное формирование не выполняется.
 //*************************************************************************************************
-static void Swap( uint8_t *el1, uint8_t *el2, uint8_t size );
+void SortInit( void ) {
+
+    uint8_t seg;
+    bool ready = true;
+    FramStatus status;
+    DATA_SORT item;
+
+    osKernelLock();
+    if ( sort_build == true ) {
+        osKernelUnlock();
+        return;
+       }
+    sort_build = true;
+    sort_stale = false;
+    osKernelUnlock();
+    SortClear();
+    for ( seg = 0; seg < FramLogSegments(); seg++ ) {
+        memset( (uint8_t *)&item, 0x00, sizeof( item ) );
+        status = FramReadSeg( seg, 0, SortInitRec, &item );
+        if ( status != FRAM_OK ) {
+            if ( status != FRAM_ERROR_CRC )
+                ready = false;
+            continue;
+           }
+        if ( !item.cnt )
+            continue;
+        osKernelLock();
+        //сегмент, начатый во время формирования индекса, уже добавлен SortAdd()
+        if ( !data_sort[seg].cnt ) {
+            data_sort[seg] = item;
+            SortInsert( seg );
+           }
+        osKernelUnlock();
+       }
+    osKernelLock();
+    sort_ready = ( ready == true && sort_stale == false );
+    sort_build = false;
+    osKernelUnlock();
+ }
 
 //*************************************************************************************************
-// Формирует массив данных в data_sort и выполняет сортировку по убыванию даты события в данных
+// Обновление индекса журнала после добавления записи в сегмент журнала, вызывается из FramSaveData()
+//-------------------------------------------------------------------------------------------------
+// uint16_t ref       - ссылка на запись журнала (см. LOG_REF)
+// WATER_LOG *wtr_log - указатель на записанные данные
+//*************************************************************************************************
+void SortAdd( uint16_t ref, WATER_LOG *wtr_log ) {
+
+    uint8_t seg;
+    DATA_SORT *item;
+
+    if ( ref < FRAM_ADDR_LOG || ( seg = LOG_REF_SEG( ref ) ) >= FramLogSegments() )
+        return;
+    item = &data_sort[seg];
+    osKernelLock();
+    if ( sort_build == true )
+        sort_stale = true;
+    if ( !LOG_REF_SLOT( ref ) ) {
+        //опорная запись: новый сегмент заменяет сегмент предыдущего цикла
+        if ( item->cnt )
+            SortRemove( seg );
+        memset( (uint8_t *)item, 0x00, sizeof( DATA_SORT ) );
+        SortRecord( item, wtr_log );
+        SortInsert( seg );
+       }
+    else if ( item->cnt )
+        SortRecord( item, wtr_log );
+    osKernelUnlock();
+ }
+
+//*************************************************************************************************
+// Очистка индекса журнала, вызывается при очистке журнала в FRAM
+//*************************************************************************************************
+void SortClear( void ) {
+
+    osKernelLock();
+    sort_cnt = 0;
+    memset( (uint8_t *)&data_sort, 0x00, sizeof( data_sort ) );
+    osKernelUnlock();
+ }
+
+//*************************************************************************************************
+// Подготовка выборки данных из индекса журнала, чтение FRAM не выполняется
 //-------------------------------------------------------------------------------------------------
 // uint8_t cnt_rec - кол-во запрашиваемых записей, если запрос индекса данных из отсортированного
 //                   массива будет выполняться без вызова GetIndex() - то необходимо указать "0"
-// return          - кол-во элементов в массиме загруженных и отсортированных
+// return          - кол-во записей в индексе (упорядоченных от новых записей к старым)
 //*************************************************************************************************
 uint16_t MakeSort( uint8_t cnt_rec ) {
 
-    uint16_t i, j, addr, cnt, min_index;
-    DATA_DATE data_date;
-    
+    uint8_t i;
+    uint16_t cnt = 0;
+
+    if ( sort_ready == false )
+        SortInit(); //индекс не сформирован при включении
     index = 0;
     cnt_reqst = cnt_rec;
-    //обнуление массива перед загрузкой данных
-    memset( (uint8_t *)&data_sort, 0x00, sizeof( data_sort ) );
-    for ( cnt = 0, addr = FRAM_ADDR_LOG; addr < FRAM_SIZE && cnt < SIZE_ARRAY( data_sort ); addr += FRAM_BLOCK_SIZE ) {
-        //чтение данных для сортировки
-        if ( FramReadData( addr, (uint8_t *)&data_date, sizeof( data_date ) ) == FRAM_OK ) {
-            //запись данных
-            data_sort[cnt].addr = addr;
-            memcpy( (uint8_t *)&data_sort[cnt].value, (uint8_t *)&data_date, sizeof( data_date ) );
-            cnt++;
-           }
-       }
-    //Cортировка выбором
-    //1. находим номер минимального значения в текущем списке
-    //2. обмен этого значения со значением первой неотсортированной позиции
-    //3. продолжаем сортироку, исключив из рассмотрения уже отсортированные элементы
-    for ( i = 0; i < cnt - 1; i++ ) {
-        min_index = i;
-        for ( j = i + 1; j < cnt; j++ ) {
-            if ( data_sort[j].value > data_sort[min_index].value )
-                min_index = j;
-           }
-        if ( min_index != i )
-            Swap( (uint8_t *)&data_sort[i], (uint8_t *)&data_sort[min_index], sizeof( DATA_SORT ) );
-       }
+    osKernelLock();
+    for ( i = 0; i < sort_cnt; i++ )
+        cnt += data_sort[seq_sort[i]].cnt;
+    osKernelUnlock();
     return cnt;
  }
 
 //*************************************************************************************************
-// Функция возвращает адрес блока данных в FRAM памяти по указанному индексу.
+// Функция возвращает ссылку на запись журнала в FRAM памяти по указанному индексу.
 //-------------------------------------------------------------------------------------------------
 // Данные предварительно должны быть отсортированы с помощью MakeSort()
 // uint16_t index - номер индекса, чем меньше индекс - тем новее данные
 // return == 0    - индекс указан неправильно
-//        != 0    - адрес блока данных в FRAM
+//        != 0    - ссылка на запись журнала для FramReadLog()
 //*************************************************************************************************
 uint16_t GetAddrSort( uint16_t index ) {
 
-    if ( index < SIZE_ARRAY( data_sort ) )
-        return data_sort[index].addr;
-    return 0;
+    uint8_t i, seg;
+    uint16_t ref = 0;
+
+    osKernelLock();
+    for ( i = 0; i < sort_cnt; i++ ) {
+        seg = seq_sort[i];
+        if ( index < data_sort[seg].cnt ) {
+            ref = LOG_REF( seg, data_sort[seg].cnt - 1 - index );
+            break;
+           }
+        index -= data_sort[seg].cnt;
+       }
+    osKernelUnlock();
+    return ref;
  }
 
 //*************************************************************************************************
@@ -120,19 +223,227 @@ uint8_t GetIndex( void ) {
  }
 
 //*************************************************************************************************
-// Перестановка данных местами между двумя массивами
+// Выборка записей журнала за интервал дата/время в порядке записи (от старых к новым), для каждой
+// записи прочитанной из FRAM вызывается функция обработки. Читаются только сегменты, интервал
+// дата/время и типы записей которых пересекаются с условием выборки.
+//-------------------------------------------------------------------------------------------------
+// DATE_TIME *from   - начало интервала (включительно)
+// DATE_TIME *to     - окончание интервала (включительно)
+// uint8_t type_mask - типы записей LOG_FIND_*
+// LogFindCb cb      - функция обработки записи, возврат "false" - прекращение выборки,
+//                     NULL - только подсчет кол-ва записей
+// return            - кол-во выбранных записей
+//*************************************************************************************************
+uint16_t LogFind( DATE_TIME *from, DATE_TIME *to, uint8_t type_mask, LogFindCb cb ) {
+
+    uint8_t i, seg;
+    bool match;
+    LOG_SELECT sel;
+
+    if ( sort_ready == false )
+        SortInit();
+    memset( (uint8_t *)&sel, 0x00, sizeof( sel ) );
+    sel.from = DtimeToSec( from );
+    sel.to = DtimeToSec( to );
+    sel.mask = type_mask;
+    sel.cb = cb;
+    for ( i = sort_cnt; i && sel.stop == false; i-- ) {
+        osKernelLock();
+        seg = seq_sort[i - 1];
+        match = ( i <= sort_cnt && SegMatch( &data_sort[seg], &sel ) );
+        osKernelUnlock();
+        if ( match == true )
+            FramReadSeg( seg, 0, LogSelect, &sel );
+       }
+    return sel.find;
+ }
+
+//*************************************************************************************************
+// Выборка следующей записи журнала за интервал дата/время: первая запись с порядковым номером
+// больше указанного. Сегмент, содержащий следующий номер, находится бинарным поиском по индексу.
+//-------------------------------------------------------------------------------------------------
+// DATE_TIME *from    - начало интервала (включительно)
+// DATE_TIME *to      - окончание интервала (включительно)
+// uint8_t type_mask  - типы записей LOG_FIND_*
+// uint32_t *seq      - номер предыдущей выбранной записи ("0" - с начала журнала), 
+//                      обновляется номером выбранной записи
+// WATER_LOG *wtr_log - указатель для размещения записи
+// return = true      - запись выбрана
+//*************************************************************************************************
+bool LogNext( DATE_TIME *from, DATE_TIME *to, uint8_t type_mask, uint32_t *seq, WATER_LOG *wtr_log ) {
+
+    uint8_t lo, hi, mid, seg;
+    uint32_t slot;
+    bool match;
+    LOG_SELECT sel;
+
+    if ( sort_ready == false )
+        SortInit();
+    memset( (uint8_t *)&sel, 0x00, sizeof( sel ) );
+    sel.from = DtimeToSec( from );
+    sel.to = DtimeToSec( to );
+    sel.mask = type_mask;
+    sel.wtr_log = wtr_log;
+    //поиск первого сегмента (по убыванию номеров) с опорной записью не новее *seq + 1
+    osKernelLock();
+    lo = 0;
+    hi = sort_cnt;
+    while ( lo < hi ) {
+        mid = ( lo + hi ) / 2;
+        if ( data_sort[seq_sort[mid]].seq > *seq + 1 )
+            lo = mid + 1;
+        else hi = mid;
+       }
+    osKernelUnlock();
+    //выборка от найденного сегмента к новым
+    if ( lo == sort_cnt && lo )
+        lo--; //номер меньше номера самой старой записи журнала
+    for ( lo++; lo && sel.find == 0; lo-- ) {
+        osKernelLock();
+        seg = seq_sort[lo - 1];
+        slot = 0;
+        if ( *seq >= data_sort[seg].seq )
+            slot = *seq + 1 - data_sort[seg].seq;
+        match = ( lo <= sort_cnt && slot < data_sort[seg].cnt && SegMatch( &data_sort[seg], &sel ) );
+        osKernelUnlock();
+        if ( match == true )
+            FramReadSeg( seg, (uint8_t)slot, LogSelect, &sel );
+       }
+    if ( !sel.find )
+        return false;
+    *seq = wtr_log->seq;
+    return true;
+ }
+
+//*************************************************************************************************
+// Добавление сегмента в порядок по номерам опорных записей, позиция вставки ищется с начала:
+// новый сегмент журнала добавляется в начало индекса. Сегмент, уже добавленный в индекс, и сегмент
+// сверх кол-ва сегментов журнала не добавляются. Вызывается при заблокированном планировщике.
 //-------------------------------------------------------------------------------------------------
-// uint8_t *el1 - указатель на первый массив
-// uint8_t *el2 - указатель на второй массив
-// uint8_t size - кол-во переставляемых байт
+// uint8_t seg - номер сегмента журнала
 //*************************************************************************************************
-static void Swap( uint8_t *el1, uint8_t *el2, uint8_t size ) {
+static void SortInsert( uint8_t seg ) {
+
+    uint8_t pos;
 
-    uint8_t swap[16];
-    
-    if ( size > sizeof( swap ) )
+    if ( seg >= FramLogSegments() || sort_cnt >= FramLogSegments() )
         return;
-    memcpy( swap, el1,  size );
-    memcpy( el1,  el2,  size );
-    memcpy( el2,  swap, size );
+    for ( pos = 0; pos < sort_cnt; pos++ ) {
+        if ( seq_sort[pos] == seg )
+            return;
+       }
+    for ( pos = 0; pos < sort_cnt && data_sort[seq_sort[pos]].seq > data_sort[seg].seq; pos++ );
+    memmove( &seq_sort[pos + 1], &seq_sort[pos], sort_cnt - pos );
+    seq_sort[pos] = seg;
+    sort_cnt++;
+ }
+
+//*************************************************************************************************
+// Удаление сегмента из порядка записей, вызывается при заблокированном планировщике
+//-------------------------------------------------------------------------------------------------
+// uint8_t seg - номер сегмента журнала
+//*************************************************************************************************
+static void SortRemove( uint8_t seg ) {
+
+    uint8_t i;
+
+    for ( i = 0; i < sort_cnt; i++ ) {
+        if ( seq_sort[i] != seg )
+            continue;
+        memmove( &seq_sort[i], &seq_sort[i + 1], sort_cnt - i - 1 );
+        sort_cnt--;
+        break;
+       }
+ }
+
+//*************************************************************************************************
+// Учет записи в элементе индекса: кол-во записей, интервал дата/время, тип записей
+//-------------------------------------------------------------------------------------------------
+// DATA_SORT *item    - элемент индекса сегмента
+// WATER_LOG *wtr_log - указатель на данные записи
+//*************************************************************************************************
+static void SortRecord( DATA_SORT *item, WATER_LOG *wtr_log ) {
+
+    uint32_t time;
+
+    time = LogTime( wtr_log );
+    if ( !item->cnt ) {
+        item->seq = wtr_log->seq;
+        item->first = item->last = time;
+       }
+    if ( time < item->first )
+        item->first = time;
+    if ( time > item->last )
+        item->last = time;
+    if ( wtr_log->type_event == EVENT_ALARM )
+        item->flags |= LOG_IDX_ALARM;
+    item->cnt++;
+ }
+
+//*************************************************************************************************
+// Учет прочитанной записи сегмента при формировании индекса, функция обработки для FramReadSeg()
+//*************************************************************************************************
+static bool SortInitRec( uint16_t ref, WATER_LOG *wtr_log, void *arg ) {
+
+    SortRecord( (DATA_SORT *)arg, wtr_log );
+    return true;
+ }
+
+//*************************************************************************************************
+// Отбор прочитанной записи сегмента по условию выборки, функция обработки для FramReadSeg()
+//*************************************************************************************************
+static bool LogSelect( uint16_t ref, WATER_LOG *wtr_log, void *arg ) {
+
+    uint32_t time;
+    LOG_SELECT *sel = (LOG_SELECT *)arg;
+
+    time = LogTime( wtr_log );
+    if ( time < sel->from || time > sel->to )
+        return true;
+    if ( !( sel->mask & ( wtr_log->type_event == EVENT_ALARM ? LOG_FIND_ALARM : LOG_FIND_DATA ) ) )
+        return true;
+    sel->find++;
+    if ( sel->wtr_log != NULL ) {
+        //LogNext(): выбрана одна запись
+        memcpy( (uint8_t *)sel->wtr_log, (uint8_t *)wtr_log, sizeof( WATER_LOG ) );
+        return false;
+       }
+    if ( sel->cb != NULL && sel->cb( ref, wtr_log ) == false ) {
+        sel->stop = true;
+        return false;
+       }
+    return true;
+ }
+
+//*************************************************************************************************
+// Проверка пересечения сегмента с условием выборки по интервалу дата/время и типам записей,
+// вызывается при заблокированном планировщике
+//-------------------------------------------------------------------------------------------------
+// DATA_SORT *item  - элемент индекса сегмента
+// LOG_SELECT *sel  - условие выборки
+// return = true    - сегмент может содержать записи выборки
+//*************************************************************************************************
+static bool SegMatch( DATA_SORT *item, LOG_SELECT *sel ) {
+
+    if ( !item->cnt || item->last < sel->from || item->first > sel->to )
+        return false;
+    if ( !( sel->mask & LOG_FIND_DATA ) && !( item->flags & LOG_IDX_ALARM ) )
+        return false;
+    return true;
+ }
+
+//*************************************************************************************************
+// Дата/время записи журнала в секундах от 01.01.1970
+//*************************************************************************************************
+static uint32_t LogTime( WATER_LOG *wtr_log ) {
+
+    DATE_TIME dtime;
+
+    dtime.day = wtr_log->day;
+    dtime.month = wtr_log->month;
+    dtime.year = wtr_log->year;
+    dtime.hour = wtr_log->hour;
+    dtime.min = wtr_log->min;
+    dtime.sec = wtr_log->sec;
+    return DtimeToSec( &dtime );
  }
@@ -5,12 +5,28 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "water.h"
+#include "xtime.h"
+
+//Типы записей журнала для выборки LogFind()/LogNext()
+#define LOG_FIND_DATA       0x01                //интервальные данные (EVENT_DATA)
+#define LOG_FIND_ALARM      0x02                //аварийные события (EVENT_ALARM)
+#define LOG_FIND_ALL        ( LOG_FIND_DATA | LOG_FIND_ALARM )
+
+//Функция обработки записи журнала при выборке LogFind(), возврат "false" - прекращение выборки
+typedef bool (*LogFindCb)( uint16_t ref, WATER_LOG *wtr_log );
+
 //*************************************************************************************************
 // Функции управления
 //*************************************************************************************************
+void SortInit( void );
+void SortClear( void );
+void SortAdd( uint16_t ref, WATER_LOG *wtr_log );
 uint8_t GetIndex( void );
 uint16_t MakeSort( uint8_t cnt_rec );
 uint16_t GetAddrSort( uint16_t index );
+uint16_t LogFind( DATE_TIME *from, DATE_TIME *to, uint8_t type_mask, LogFindCb cb );
+bool LogNext( DATE_TIME *from, DATE_TIME *to, uint8_t type_mask, uint32_t *seq, WATER_LOG *wtr_log );
 
 #endif
 
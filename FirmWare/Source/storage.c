@@ -0,0 +1,407 @@
+//*************************************************************************************************
+//
+// Очередь запросов записи в FRAM: записи журнала и текущие значения счетчиков выполняются
+// в отдельной задаче, задачи-источники данных не ожидают завершения обмена по I2C
+//
+//*************************************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "cmsis_os2.h"
+
+#include "fram.h"
+#include "water.h"
+#include "events.h"
+#include "scrub.h"
+#include "rollup.h"
+#include "message.h"
+#include "storage.h"
+
+//*************************************************************************************************
+// Внешние переменные
+//*************************************************************************************************
+extern CURR_DATA curr_data;
+
+//*************************************************************************************************
+// Локальные константы
+//*************************************************************************************************
+#define STORE_LOG_DEPTH         4           //кол-во мест в очереди записей журнала
+#define STORE_LAT_RING          32          //кол-во последних значений времени выполнения
+                                            //запросов для расчета процентилей
+#define STORE_WAIT_POLL         5           //интервал проверки завершения записи (ms)
+#define STORE_FLUSH_CB          2           //кол-во функций обработки результата объединенного
+                                            //запроса записи текущих значений счетчиков
+
+//Состояние места в очереди записей журнала
+typedef enum {
+    STORE_SLOT_FREE,                        //свободно
+    STORE_SLOT_WAIT,                        //запрос ожидает выполнения
+    STORE_SLOT_EXEC                         //запрос выполняется
+ } StoreSlot;
+
+//Запрос записи в журнал
+typedef struct {
+    WATER_LOG   wtr_log;                    //запись журнала
+    StoreDoneCb cb;                         //функция обработки результата записи
+    uint32_t    tick;                       //время постановки в очередь (тики)
+    uint32_t    order;                      //порядковый номер запроса
+    StorePrio   prio;                       //приоритет запроса
+    StoreSlot   state;                      //состояние места в очереди
+ } STORE_REQ;
+
+//*************************************************************************************************
+// Переменные с внешним доступом
+//*************************************************************************************************
+osEventFlagsId_t store_event = NULL;
+
+//*************************************************************************************************
+// Локальные переменные
+//*************************************************************************************************
+static char * const store_desc[] = {
+    "Write requests",
+    "Writes completed",
+    "Write errors",
+    "Requests rejected (queue full)",
+    "Queue depth",
+    "Max queue depth",
+    "Request latency p50 (ms)",
+    "Request latency p95 (ms)",
+    "Request latency max (ms)"
+ };
+
+//очередь записей журнала, запрос выбирается по приоритету, затем по порядку поступления
+static STORE_REQ log_req[STORE_LOG_DEPTH];
+static uint32_t req_order;                  //счетчик порядковых номеров запросов
+
+//запрос записи текущих значений счетчиков, повторные запросы до выполнения объединяются
+static bool flush_pend;                     //запрос ожидает выполнения
+static uint32_t flush_tick;                 //время постановки первого запроса в очередь (тики)
+static StoreDoneCb flush_cb[STORE_FLUSH_CB]; //функции обработки результата записи (по одной
+                                            //от каждого источника объединенных запросов)
+
+static bool store_exec;                     //выполняется запись в FRAM
+
+//статистика
+static uint32_t store_stat[STORE_STAT_CNT];
+static uint16_t lat_ring[STORE_LAT_RING];   //время выполнения последних запросов (ms)
+static uint8_t lat_idx, lat_cnt;
+
+//*************************************************************************************************
+// Прототипы локальных функций
+//*************************************************************************************************
+static void TaskStorage( void *pvParameters );
+static bool StorageNext( void );
+static uint8_t QueueDepth( void );
+static void StatQueue( void );
+static void StatDone( uint32_t tick, FramStatus status );
+static uint16_t Latency( uint8_t pct );
+
+//*************************************************************************************************
+// Атрибуты объектов RTOS
+//*************************************************************************************************
+static const osThreadAttr_t task_attr = {
+    .name = "Storage",
+    .stack_size = 576,
+    .priority = osPriorityAboveNormal
+ };
+
+static const osEventFlagsAttr_t evn_attr = { .name = "StoreEvents" };
+
+//*************************************************************************************************
+// Инициализация задачи и очереди запросов записи в FRAM
+//*************************************************************************************************
+void StorageInit( void ) {
+
+    store_event = osEventFlagsNew( &evn_attr );
+    osThreadNew( TaskStorage, NULL, &task_attr );
+ }
+
+//*************************************************************************************************
+// Задача выполнения запросов записи в FRAM
+// Приоритет задачи выше приоритета задач чтения журнала (Modbus, CAN, ZigBee), чтение журнала
+// выполняется блоками, поэтому запись ожидает не более одного блочного чтения. При отсутствии
+// запросов записи в течении SCRUB_PERIOD выполняется фоновая проверка одного блока FRAM.
+//*************************************************************************************************
+static void TaskStorage( void *pvParameters ) {
+
+    uint32_t event;
+
+    for ( ;; ) {
+        event = osEventFlagsWait( store_event, EVN_STORE_REQ, osFlagsWaitAny, SCRUB_PERIOD );
+        if ( event == osFlagsErrorTimeout ) {
+            ScrubStep();
+            continue;
+           }
+        while ( StorageNext() == true );
+       }
+ }
+
+//*************************************************************************************************
+// Постановка записи журнала в очередь. Принятые записи из очереди не удаляются: при заполненной
+// очереди выполняется ожидание освобождения места не более timeout, по истечении времени запрос 
+// (в том числе событие утечки) отклоняется. Все записи журнала выполняются задачей "Storage":
+// порядок номеров записей совпадает с порядком поступления (кроме событий утечки), итоги расхода
+// обновляются по каждой записи. Событие утечки выполняется раньше ожидающих записей интервальных
+// данных.
+//-------------------------------------------------------------------------------------------------
+// WATER_LOG *wtr_log - указатель на запись журнала, запись копируется в очередь
+// StoreDoneCb cb     - функция обработки результата записи, NULL - не требуется
+// uint32_t timeout   - макс. время ожидания места в очереди (ms)
+// return             - true - запрос принят, false - очередь заполнена
+//*************************************************************************************************
+bool StorageLog( WATER_LOG *wtr_log, StoreDoneCb cb, uint32_t timeout ) {
+
+    uint8_t slot;
+    uint32_t start;
+
+    start = osKernelGetTickCount();
+    osKernelLock();
+    store_stat[STORE_STAT_REQUEST]++;
+    for ( ;; ) {
+        for ( slot = 0; slot < STORE_LOG_DEPTH; slot++ ) {
+            if ( log_req[slot].state == STORE_SLOT_FREE )
+                break;
+           }
+        if ( slot < STORE_LOG_DEPTH )
+            break;
+        if ( ( osKernelGetTickCount() - start ) >= timeout ) {
+            store_stat[STORE_STAT_OVERFLOW]++;
+            osKernelUnlock();
+            return false;
+           }
+        osKernelUnlock();
+        osDelay( STORE_WAIT_POLL );
+        osKernelLock();
+       }
+    memcpy( (uint8_t *)&log_req[slot].wtr_log, (uint8_t *)wtr_log, sizeof( WATER_LOG ) );
+    log_req[slot].cb = cb;
+    log_req[slot].tick = osKernelGetTickCount();
+    log_req[slot].order = ++req_order;
+    log_req[slot].prio = wtr_log->type_event == EVENT_ALARM ? STORE_LOG_ALARM : STORE_LOG_DATA;
+    log_req[slot].state = STORE_SLOT_WAIT;
+    StatQueue();
+    osKernelUnlock();
+    osEventFlagsSet( store_event, EVN_STORE_REQ );
+    return true;
+ }
+
+//*************************************************************************************************
+// Запрос записи текущих значений счетчиков. Значения копируются из curr_data в момент
+// выполнения запроса, повторные запросы до выполнения объединяются в один. Результат
+// объединенного запроса передается функциям обработки всех запросов.
+//-------------------------------------------------------------------------------------------------
+// StoreDoneCb cb - функция обработки результата записи, NULL - не требуется
+//*************************************************************************************************
+void StorageFlush( StoreDoneCb cb ) {
+
+    uint8_t i;
+
+    osKernelLock();
+    store_stat[STORE_STAT_REQUEST]++;
+    if ( flush_pend == false ) {
+        flush_pend = true;
+        flush_tick = osKernelGetTickCount();
+        StatQueue();
+       }
+    for ( i = 0; cb != NULL && i < STORE_FLUSH_CB; i++ ) {
+        if ( flush_cb[i] == cb )
+            break; //функция уже ожидает результат
+        if ( flush_cb[i] == NULL ) {
+            flush_cb[i] = cb;
+            break;
+           }
+       }
+    osKernelUnlock();
+    osEventFlagsSet( store_event, EVN_STORE_REQ );
+ }
+
+//*************************************************************************************************
+// Ожидание выполнения всех запросов записи, используется перед перезапуском контроллера
+//-------------------------------------------------------------------------------------------------
+// uint32_t timeout - макс. время ожидания (ms)
+// return           - true - очередь пуста, false - вышло время ожидания
+//*************************************************************************************************
+bool StorageWait( uint32_t timeout ) {
+
+    uint32_t start;
+
+    start = osKernelGetTickCount();
+    while ( QueueDepth() || store_exec == true ) {
+        if ( ( osKernelGetTickCount() - start ) >= timeout )
+            return false;
+        osDelay( STORE_WAIT_POLL );
+       }
+    return true;
+ }
+
+//*************************************************************************************************
+// Выполнение одного запроса: записи журнала (событие утечки, затем интервальные данные
+// в порядке поступления), затем текущие значения счетчиков
+//-------------------------------------------------------------------------------------------------
+// return = true - запрос выполнен, false - очередь пуста
+//*************************************************************************************************
+static bool StorageNext( void ) {
+
+    uint8_t i, slot = STORE_LOG_DEPTH;
+    uint32_t tick;
+    StoreDoneCb cb[STORE_FLUSH_CB];
+    FramStatus status;
+    CURR_DATA data;
+
+    osKernelLock();
+    for ( i = 0; i < STORE_LOG_DEPTH; i++ ) {
+        if ( log_req[i].state != STORE_SLOT_WAIT )
+            continue;
+        if ( slot == STORE_LOG_DEPTH || log_req[i].prio < log_req[slot].prio ||
+             ( log_req[i].prio == log_req[slot].prio && log_req[i].order < log_req[slot].order ) )
+            slot = i;
+       }
+    if ( slot < STORE_LOG_DEPTH ) {
+        //запись журнала, место в очереди освобождается после записи
+        log_req[slot].state = STORE_SLOT_EXEC;
+        store_exec = true;
+        osKernelUnlock();
+        status = FramSaveData( WATER_DATA_LOG, (uint8_t *)&log_req[slot].wtr_log, sizeof( WATER_LOG ) );
+        //обновление итогов расхода по записанным значениям счетчиков
+        if ( status == FRAM_OK )
+            RollupAdd( &log_req[slot].wtr_log );
+        tick = log_req[slot].tick;
+        memset( cb, 0x00, sizeof( cb ) );
+        cb[0] = log_req[slot].cb;
+        osKernelLock();
+        log_req[slot].state = STORE_SLOT_FREE;
+       }
+    else if ( flush_pend == true ) {
+        //текущие значения счетчиков, копия формируется в момент записи
+        memcpy( (uint8_t *)&data, (uint8_t *)&curr_data, sizeof( data ) );
+        flush_pend = false;
+        tick = flush_tick;
+        memcpy( cb, flush_cb, sizeof( cb ) );
+        memset( flush_cb, 0x00, sizeof( flush_cb ) );
+        store_exec = true;
+        osKernelUnlock();
+        status = FramSaveData( CURRENT_DATA, (uint8_t *)&data, sizeof( data ) );
+        osKernelLock();
+       }
+    else {
+        osKernelUnlock();
+        return false;
+       }
+    StatDone( tick, status );
+    store_exec = false;
+    osKernelUnlock();
+    for ( i = 0; i < STORE_FLUSH_CB; i++ ) {
+        if ( cb[i] != NULL )
+            cb[i]( status );
+       }
+    return true;
+ }
+
+//*************************************************************************************************
+// Возвращает кол-во запросов ожидающих выполнения
+//*************************************************************************************************
+static uint8_t QueueDepth( void ) {
+
+    uint8_t i, cnt = 0;
+
+    for ( i = 0; i < STORE_LOG_DEPTH; i++ ) {
+        if ( log_req[i].state == STORE_SLOT_WAIT )
+            cnt++;
+       }
+    if ( flush_pend == true )
+        cnt++;
+    return cnt;
+ }
+
+//*************************************************************************************************
+// Обновление статистики глубины очереди, вызывается при заблокированном планировщике
+//*************************************************************************************************
+static void StatQueue( void ) {
+
+    store_stat[STORE_STAT_QUEUE] = QueueDepth();
+    if ( store_stat[STORE_STAT_QUEUE] > store_stat[STORE_STAT_QUEUE_MAX] )
+        store_stat[STORE_STAT_QUEUE_MAX] = store_stat[STORE_STAT_QUEUE];
+ }
+
+//*************************************************************************************************
+// Обновление статистики после выполнения запроса, вызывается при заблокированном планировщике
+//-------------------------------------------------------------------------------------------------
+// uint32_t tick     - время постановки запроса в очередь (тики)
+// FramStatus status - результат записи
+//*************************************************************************************************
+static void StatDone( uint32_t tick, FramStatus status ) {
+
+    uint32_t time;
+
+    if ( status == FRAM_OK )
+        store_stat[STORE_STAT_WRITE]++;
+    else store_stat[STORE_STAT_ERROR]++;
+    time = ( osKernelGetTickCount() - tick ) * 1000 / osKernelGetTickFreq();
+    if ( time > UINT16_MAX )
+        time = UINT16_MAX;
+    lat_ring[lat_idx] = (uint16_t)time;
+    lat_idx = ( lat_idx + 1 ) % STORE_LAT_RING;
+    if ( lat_cnt < STORE_LAT_RING )
+        lat_cnt++;
+    if ( time > store_stat[STORE_STAT_LAT_MAX] )
+        store_stat[STORE_STAT_LAT_MAX] = time;
+    store_stat[STORE_STAT_QUEUE] = QueueDepth();
+ }
+
+//*************************************************************************************************
+// Расчет процентиля времени выполнения по последним STORE_LAT_RING запросам
+//-------------------------------------------------------------------------------------------------
+// uint8_t pct - процентиль (1 ... 100)
+// return      - время выполнения (ms)
+//*************************************************************************************************
+static uint16_t Latency( uint8_t pct ) {
+
+    uint8_t i, j, cnt;
+    uint16_t value, sort[STORE_LAT_RING];
+
+    osKernelLock();
+    cnt = lat_cnt;
+    memcpy( (uint8_t *)sort, (uint8_t *)lat_ring, sizeof( sort ) );
+    osKernelUnlock();
+    if ( !cnt )
+        return 0;
+    //сортировка вставками
+    for ( i = 1; i < cnt; i++ ) {
+        value = sort[i];
+        for ( j = i; j && sort[j - 1] > value; j-- )
+            sort[j] = sort[j - 1];
+        sort[j] = value;
+       }
+    //ранг процентиля с округлением вверх
+    i = ( cnt * pct + 99 ) / 100;
+    return sort[i ? i - 1 : 0];
+ }
+
+//*************************************************************************************************
+// Возвращает расшифровку и значения счетчиков статистики очереди записи в FRAM
+//-------------------------------------------------------------------------------------------------
+// StoreStat index - индекс счетчика
+// char *str       - указатель для размещения результата
+// return          - указатель на строку с расшифровкой
+//*************************************************************************************************
+char *StorageStatDesc( StoreStat index, char *str ) {
+
+    char *ptr;
+    uint32_t value;
+
+    if ( index >= STORE_STAT_CNT )
+        return NULL;
+    if ( index == STORE_STAT_LAT_50 )
+        value = Latency( 50 );
+    else if ( index == STORE_STAT_LAT_95 )
+        value = Latency( 95 );
+    else value = store_stat[index];
+    ptr = str;
+    ptr += sprintf( ptr, "%s", store_desc[index] );
+    //дополним расшифровку справа знаком "." до 45 символов
+    ptr += AddDot( str, 45, 0 );
+    ptr += sprintf( ptr, "%6u ", value );
+    return str;
+ }
@@ -0,0 +1,44 @@
+
+#ifndef __STORAGE_H
+#define __STORAGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "fram.h"
+#include "water.h"
+
+//Приоритеты запросов записи в FRAM, меньшее значение - выше приоритет
+typedef enum {
+    STORE_LOG_ALARM,                        //запись события утечки в журнал
+    STORE_LOG_DATA,                         //запись интервальных данных в журнал
+    STORE_CURRENT                           //запись текущих значений счетчиков
+ } StorePrio;
+
+//Индексы счетчиков статистики очереди записи в FRAM
+typedef enum {
+    STORE_STAT_REQUEST,                     //кол-во запросов записи
+    STORE_STAT_WRITE,                       //кол-во выполненных записей
+    STORE_STAT_ERROR,                       //кол-во ошибок записи
+    STORE_STAT_OVERFLOW,                    //кол-во запросов не принятых в очередь
+    STORE_STAT_QUEUE,                       //текущая глубина очереди
+    STORE_STAT_QUEUE_MAX,                   //макс. глубина очереди
+    STORE_STAT_LAT_50,                      //медиана времени выполнения запроса (ms)
+    STORE_STAT_LAT_95,                      //95-й процентиль времени выполнения запроса (ms)
+    STORE_STAT_LAT_MAX,                     //макс. время выполнения запроса (ms)
+    STORE_STAT_CNT                          //кол-во счетчиков статистики
+ } StoreStat;
+
+//Функция обработки результата записи, вызывается в контексте задачи "Storage"
+typedef void (*StoreDoneCb)( FramStatus status );
+
+//*************************************************************************************************
+// Функции управления
+//*************************************************************************************************
+void StorageInit( void );
+bool StorageLog( WATER_LOG *wtr_log, StoreDoneCb cb, uint32_t timeout );
+void StorageFlush( StoreDoneCb cb );
+bool StorageWait( uint32_t timeout );
+char *StorageStatDesc( StoreStat index, char *str );
+
+#endif
@@ -31,6 +31,7 @@ extern UART_HandleTypeDef huart1;
 
 #define TIME_OUT_RECV       3               //кол-во символов при приеме для 
                                             //определения паузы между фреймами 
+#define TIME_OUT_IDLE       1               //кол-во символов паузы до установки признака IDLE UART
 
 //соответствие значений индексов скорости и значения скорости обмена, 
 //длительность передачи одного байта (мкс)
@@ -231,7 +232,9 @@ uint32_t UartGetSpeed( UARTSpeed speed ) {
  }
 
 //*************************************************************************************************
-// Возвращает длительность паузы для определения завершения передачи одного фрейма MODBUS
+// Возвращает длительность паузы для определения завершения передачи одного фрейма MODBUS.
+// Пауза отсчитывается от признака IDLE UART, который устанавливается после паузы в один символ,
+// поэтому общая длительность паузы окончания фрейма составляет 3.5 символа.
 //-------------------------------------------------------------------------------------------------
 // UARTSpeed speed - ID скорости обмена
 // return          - длительность паузы в мкс
@@ -242,7 +245,7 @@ uint16_t ModbusTimeOut( UARTSpeed speed ) {
     
     if ( speed < SIZE_ARRAY( uart_speed ) ) {
         val12 = (uint16_t)uart_speed[speed][2]/2;
-        return ( (uint16_t)uart_speed[speed][2] * TIME_OUT_RECV ) + val12;
+        return ( (uint16_t)uart_speed[speed][2] * ( TIME_OUT_RECV - TIME_OUT_IDLE ) ) + val12;
        }
     else return 0;
  }
@@ -18,6 +18,7 @@
 #include "uart.h"
 #include "valve.h"
 #include "events.h"
+#include "modbus.h"
 #include "parse.h"
 
 //#define DEBUG_VALVE                         //вывод отладочных событий
@@ -314,6 +315,8 @@ static void TaskValve( void *pvParameters ) {
             UartSendStr( str );
             #endif
            }
+        //публикация состояния электроприводов для MODBUS
+        ModBusLiveUpdate();
         }
  }
 
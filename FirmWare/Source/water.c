@@ -15,10 +15,16 @@
 #include "data.h"
 #include "main.h"
 #include "fram.h"
+#include "sort.h"
+#include "parse.h"
+#include "pulse.h"
 #include "uart.h"
 #include "water.h"
 #include "config.h"
 #include "events.h"
+#include "modbus.h"
+#include "rollup.h"
+#include "storage.h"
 #include "xtime.h"
 #include "message.h"
 
@@ -36,10 +42,69 @@ extern ADC_HandleTypeDef hadc1;
 // Локальные константы
 //*************************************************************************************************
 #define VREF_VOLTAGE            3.292                   //опорное напряжение
-#define ADC_MAX_VALUE           4096                    //максимальное значение АЦП
 #define CONV_3V3_5V             (4.961/VREF_VOLTAGE)    //коэффициент пересчета в 5 вольтовый диапазон
+#define ADC_FULL_SCALE_MV       ((uint32_t)( VREF_VOLTAGE * CONV_3V3_5V * 1000 + 0.5 )) //полная шкала АЦП (мВ)
 
-#define TIME_READ_PRESSURE      500                     //интервал чтения давления воды (msec)
+#define TIME_READ_PRESSURE      500                     //интервал обновления давления воды по умолчанию (msec)
+
+#define ADC_CHANNELS            2                       //кол-во каналов АЦП (холодная/горячая вода)
+#define ADC_OVERSAMPLE          64                      //кол-во выборок канала в половине буфера DMA
+#define ADC_OVERSAMPLE_SHIFT    3                       //сдвиг суммы 64 выборок 12 бит, результат 15 бит
+#define ADC_RESULT_BITS         15                      //разрядность результата передискретизации
+#define ADC_SAMPLE_BITS         12                      //разрядность выборки АЦП
+#define ADC_BUFF_PAIRS          ( 2 * ADC_OVERSAMPLE )  //кол-во пар выборок в буфере DMA
+#define ADC_MEDIAN_SIZE         3                       //размер окна медианного фильтра
+#define ADC_IIR_SHIFT           3                       //коэффициент IIR фильтра 1/8
+#define ADC_IIR_FRAC            4                       //кол-во дробных разрядов значения IIR фильтра
+#define PRESS_LUT_SHIFT         8                       //сдвиг значения АЦП для индекса таблицы пересчета
+                                                        //кол-во элементов таблицы пересчета АЦП -> давление
+#define PRESS_LUT_SIZE          ( ( 1 << ( ADC_RESULT_BITS - PRESS_LUT_SHIFT ) ) + 1 )
+
+#define ADC_PAIR_RATE           15873                   //частота выборок пары каналов (Гц):
+                                                        //8 MHz / ( 239.5 + 12.5 ) / ADC_CHANNELS
+#define HAMMER_DECIM            16                      //кол-во выборок АЦП на одну выборку захвата
+#define HAMMER_DECIM_SHIFT      1                       //сдвиг суммы 16 выборок 12 бит, результат 15 бит
+#define HAMMER_RATE             ( ADC_PAIR_RATE / HAMMER_DECIM ) //частота выборок захвата (~992 Гц)
+#define HAMMER_DIFF             4                       //интервал расчета скорости изменения давления
+                                                        //(выборок), делитель HAMMER_SAMPLES
+
+#define PRESS_AWD_MAX           ( ( 1 << ADC_RESULT_BITS ) - 1 ) //верхний порог АЦП "откл" (15 бит)
+#define PRESS_AWD_HYST          64                      //гистерезис возврата давления в допустимый 
+                                                        //диапазон (15 бит, ~10 мВ)
+
+#define LOG_PERIOD_DAY          1440                    //интервал записи в журнал по умолчанию (минут)
+#define LOG_STORE_WAIT          2000                    //макс. время ожидания места в очереди записи
+                                                        //журнала (msec)
+
+#define SEC_PER_DAY             86400                   //кол-во секунд в сутках
+#define LEAK_IDLE_DEF           120                     //интервал "покоя" по умолчанию (минут)
+#define LEAK_NIGHT_START        ( 2 * 3600 )            //начало ночного интервала (сек от 00:00:00)
+#define LEAK_NIGHT_END          ( 5 * 3600 )            //окончание ночного интервала (сек от 00:00:00)
+
+#define DATA_RECOVER_PERIOD     60                      //интервал повторного чтения текущих значений
+                                                        //после ошибки чтения при включении (сек)
+#define RESET_STORE_WAIT        1000                    //ожидание записи в FRAM перед перезапуском (ms)
+
+#define FLOW_TIMEOUT            60                      //макс. интервал между импульсами (сек), при 
+                                                        //превышении мгновенный расход равен "0", не более
+                                                        //периода переполнения DWT->CYCCNT (67 сек при 64 MHz),
+                                                        //интервал проверяется по меткам тиков RTOS
+
+//наименования счетчиков для FlowLeakDesc()
+static char * const leak_name[] = { "Cold", "Hot", "Filter" };
+
+//наименования признаков выхода давления за пороги для PressAlarmDesc(), порядок битов PRESS_ALARM_*
+static char * const alarm_name[] = { "COLD LOW", "HOT LOW", "COLD HIGH", "HOT HIGH" };
+
+//расшифровка счетчиков статистики кэширования текущих данных
+static char * const cache_desc[] = {
+    "Current data writes to FRAM",
+    "Changes kept in RAM only",
+    "I2C bytes saved",
+    "Water volume not saved (liters)",
+    "Max water volume not saved (liters)",
+    "Max time of unsaved changes (sec)"
+ };
 
 //*************************************************************************************************
 // Переменные с внешним доступом
@@ -47,6 +112,7 @@ extern ADC_HandleTypeDef hadc1;
 CURR_DATA curr_data;
 WATER_LOG water_log;
 uint16_t pressure_cold, pressure_hot;
+uint16_t flow_rate[COUNT_FILTER + 1];                   //мгновенный расход воды (л/мин * 100)
 osEventFlagsId_t water_event = NULL;
 
 //*************************************************************************************************
@@ -54,25 +120,110 @@ osEventFlagsId_t water_event = NULL;
 //*************************************************************************************************
 static char str[60];
 static CAN_DATA can_data;
-static uint16_t adc_data[2];
 static osTimerId_t timer1 = NULL;
 
+//буфер DMA АЦП (циклический режим), при ADCCLK = 8 MHz и времени выборки 239.5 такта
+//половина буфера заполняется за ~4 мсек, обработка в WaterAdcComplt() по половинам
+static uint16_t adc_buff[2][ADC_OVERSAMPLE][ADC_CHANNELS];
+static uint16_t adc_median[ADC_CHANNELS][ADC_MEDIAN_SIZE];  //окно медианного фильтра
+static uint8_t adc_median_idx;                              //индекс записи в окно медианного фильтра
+static volatile int32_t adc_iir[ADC_CHANNELS];              //значения IIR фильтра (15 бит + ADC_IIR_FRAC)
+static uint32_t adc_blocks;                                 //кол-во обработанных половин буфера DMA
+
+//таблица пересчета значений АЦП в давление, расчет в WaterPressCfg(): давление (атм * 100)
+//для значений АЦП кратных ( 1 << PRESS_LUT_SHIFT ), между ними - линейная интерполяция
+static uint16_t press_lut[PRESS_LUT_SIZE];
+static uint16_t press_adc_min;                  //минимальное допустимое значение АЦП (15 бит)
+static uint16_t press_adc_max;                  //максимальное допустимое значение АЦП (15 бит)
+static uint32_t press_period;                   //интервал обновления значений давления (msec)
+
+//захват переходных процессов давления: циклический буфер выборок АЦП (15 бит) с частотой
+//HAMMER_RATE, при превышении порога скорости изменения давления буфер дозаполняется
+//выборками после события и остается неизменным до вызова HammerClear()
+static uint16_t hammer_buff[HAMMER_SAMPLES][ADC_CHANNELS];
+static uint16_t hammer_hist[ADC_CHANNELS][HAMMER_DIFF]; //давление предыдущих выборок (атм * 100)
+static uint16_t hammer_idx;                     //индекс записи в буфер
+static uint16_t hammer_fill;                    //кол-во выборок записанных после запуска захвата
+static uint16_t hammer_post;                    //кол-во выборок до завершения записи снимка
+static uint16_t hammer_start;                   //индекс первой выборки снимка
+static uint16_t hammer_thr;                     //порог изменения давления за HAMMER_DIFF выборок (атм * 100)
+static uint16_t hammer_delta;                   //изменение давления в момент события (атм * 100)
+static Water hammer_chnl;                       //канал события
+static DATE_TIME hammer_dtime;                  //дата/время события
+static volatile HammerStat hammer_stat;         //состояние захвата
+
+//аварийный контроль давления: пороги аналогового сторожевого таймера АЦП (15 бит), после
+//срабатывания прерывание запрещено до возврата давления в допустимый диапазон, в это время
+//контроль выполняется в TaskWater() по событию EVN_WTR_SECOND
+static uint16_t press_awd_low;                  //нижний порог, "0" - откл
+static uint16_t press_awd_high;                 //верхний порог, PRESS_AWD_MAX - откл
+static bool press_awd_on;                       //сторожевой таймер включен
+static volatile bool press_awd_arm;             //прерывание сторожевого таймера разрешено
+static volatile uint32_t press_awd_tick;        //метка времени прерывания (такты DWT->CYCCNT)
+static uint32_t press_lat_last;                 //задержка обработки последнего события (мкс)
+static uint32_t press_lat_max;                  //макс. задержка обработки события (мкс)
+static uint8_t press_alarm;                     //признаки выхода давления за пороги PRESS_ALARM_*
+
+static uint32_t log_next;                       //время следующей записи интервальных данных в журнал
+                                                //(сек от 01.01.1970), конец интервала записи
+
+//состояние детектора непрерывного расхода (микро-утечки) по счетчику, время - сек от 01.01.1970
+typedef struct {
+    uint32_t    pulse_time;                     //время последнего импульса
+    uint32_t    flow_start;                     //начало расхода без интервалов "покоя"
+    uint32_t    gap_min;                        //мин. интервал между импульсами (мсек)
+    uint32_t    idle_max;                       //макс. интервал без импульсов за сутки idle_day (сек)
+    uint32_t    idle_prev;                      //макс. интервал без импульсов за предыдущие сутки (сек)
+    uint32_t    idle_day;                       //номер суток для idle_max
+    uint32_t    night_vol;                      //расход в ночном интервале суток night_day (литры)
+    uint32_t    night_base;                     //расход в предыдущем ночном интервале (литры)
+    uint32_t    night_day;                      //номер суток для night_vol
+    bool        alarm;                          //признак непрерывного расхода
+ } LEAK_DETECT;
+
+static LEAK_DETECT leak_det[COUNT_FILTER + 1];
+
+//кэширование текущих значений счетчиков: изменения накапливаются в curr_data и
+//записываются в FRAM при превышении config.cache_time или config.cache_volume
+static bool cache_dirty = false;                //признак наличия несохраненных изменений
+static uint32_t cache_tick;                     //время первого несохраненного изменения (тики)
+static uint32_t flush_risk;                     //объем воды (литры) на момент запроса записи в FRAM
+static uint16_t recover_time;                   //время (сек) до повторного чтения текущих значений
+static uint32_t cache_stat[CACHE_STAT_CNT];     //статистика кэширования
+
 //*************************************************************************************************
 // Прототипы локальных функций
 //*************************************************************************************************
-static void IncCount( CountType type );
+static void IncCount( void );
 static void WaterPressure( void );
 static void TaskWater( void *pvParameters );
 static void Timer1Callback( void *arg );
 static void ValueWater( void );
 static void SaveData( EventType type );
+static void LogSchedule( bool start );
+static bool LeakDetect( CountType type, uint32_t pulses, uint32_t cnt, uint16_t inc );
+static bool CacheExpired( void );
+static void FlushDone( FramStatus status );
+static void FlushResult( bool done );
+static void DataRecover( void );
+static void FlowRate( void );
+static uint16_t FlowCalc( uint32_t pulses, uint32_t time, uint16_t inc );
+static uint16_t Median3( uint16_t *val );
+static uint16_t PressValue( uint32_t value );
+static void HammerSample( uint32_t *sum );
+static void PressAlarm( bool awd );
+static void PressAlarmCfg( PRESS_CAL *cal, uint8_t cnt );
+static uint16_t PressVolt( PRESS_CAL *cal, uint8_t cnt, uint16_t pressure );
+static void AdcRecent( uint16_t *value );
+static uint8_t PressCalTable( PRESS_CAL *cal );
+static uint16_t PressCalc( PRESS_CAL *cal, uint8_t cnt, uint32_t volt );
 
 //*************************************************************************************************
 // Атрибуты объектов RTOS
 //*************************************************************************************************
 static const osThreadAttr_t task_attr = {
     .name = "Water", 
-    .stack_size = 512,
+    .stack_size = 640,
     .priority = osPriorityNormal
  };
 
@@ -88,6 +239,12 @@ void WaterInit( void ) {
     water_event = osEventFlagsNew( &evn_attr );
     //таймеры интервалов
     timer1 = osTimerNew( Timer1Callback, osTimerPeriodic, NULL, &timer_attr );
+    //параметры пересчета значений давления
+    WaterPressCfg();
+    //счетчик тактов ядра для меток времени импульсов счетчиков
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
     //создаем задачу
     osThreadNew( TaskWater, NULL, &task_attr );
     //калибровка АЦП
@@ -100,26 +257,27 @@ void WaterInit( void ) {
 static void TaskWater( void *pvParameters ) {
 
     int32_t event;
-    DATE_TIME date_time; 
 
-    //запуск таймера измерения давления
+    //запуск непрерывного измерения давления: АЦП + DMA в циклическом режиме
+    HAL_ADC_Start_DMA( &hadc1, (uint32_t *)adc_buff, sizeof( adc_buff ) / sizeof( uint16_t ) );
+    //запуск таймера обновления значений давления
     if ( timer1 != NULL )
-        osTimerStart( timer1, TIME_READ_PRESSURE );
+        osTimerStart( timer1, press_period );
     //вывод результата чтения текущих значений расхода воды из FRAM
     osEventFlagsSet( water_event, EVN_WTR_VALUE );
+    //индекс журнала событий в RAM
+    SortInit();
+    //время следующей записи в журнал, запись пропущенного интервала
+    LogSchedule( true );
     for ( ;; ) {
         event = osEventFlagsWait( water_event, EVN_WTR_MASK, osFlagsWaitAny, osWaitForever );
         //обработка событий
-        if ( event & EVN_WTR_CNT_COLD )
-            IncCount( COUNT_COLD ); //инкремет значения счетчика холодной воды
-        if ( event & EVN_WTR_CNT_HOT )
-            IncCount( COUNT_HOT );  //инкремет значения счетчика горячей воды
-        if ( event & EVN_WTR_CNT_FILTER )
-            IncCount( COUNT_FILTER ); //инкремет значения счетчика питьевой воды
-        if ( event & EVN_WTR_PRESSURE_START )
-            HAL_ADC_Start_DMA( &hadc1, (uint32_t *)&adc_data, 2 ); //запуска измерения давления воды
-        if ( event & EVN_WTR_PRESSURE_END )
+        if ( event & ( EVN_WTR_CNT_COLD | EVN_WTR_CNT_HOT | EVN_WTR_CNT_FILTER ) )
+            IncCount(); //увеличение значений счетчиков на кол-во накопленных импульсов
+        if ( event & EVN_WTR_PRESSURE )
             WaterPressure(); //расчет давления воды
+        if ( event & EVN_WTR_PRESS_ALARM )
+            PressAlarm( true ); //сработал сторожевой таймер АЦП
         if ( event & EVN_WTR_LEAK1 || event & EVN_WTR_LEAK2 ) {
             //события "утечка воды"
             SaveData( EVENT_ALARM );
@@ -132,14 +290,45 @@ static void TaskWater( void *pvParameters ) {
             //сообщение координатору сети о наличии утечки воды
             osEventFlagsSet( zb_ctrl, EVN_ZC_SEND_LEAKS );
            }
+        if ( event & ( EVN_WTR_CNT_COLD | EVN_WTR_CNT_HOT | EVN_WTR_CNT_FILTER | EVN_WTR_SECOND ) )
+            FlowRate(); //расчет мгновенного расхода при импульсах и каждую секунду
+        if ( event & EVN_WTR_SECOND ) {
+            //запись текущих данных по истечении интервала кэширования
+            if ( CacheExpired() == true )
+                WaterFlush();
+            //контроль давления при запрещенном прерывании сторожевого таймера АЦП
+            if ( press_awd_on == true && press_awd_arm == false )
+                PressAlarm( false );
+            //повторное чтение текущих значений после ошибки чтения при включении
+            if ( FramDataHold() == true && ++recover_time >= DATA_RECOVER_PERIOD ) {
+                recover_time = 0;
+                DataRecover();
+               }
+           }
+        if ( event & ( EVN_WTR_FLUSH_OK | EVN_WTR_FLUSH_ERR ) )
+            FlushResult( event & EVN_WTR_FLUSH_OK ? true : false ); //результат записи текущих значений
         if ( event & EVN_WTR_LOG ) {
-            //проверка текущего времени, сохранение данных в журнал
-            GetTimeDate( &date_time );
-            if ( date_time.hour == 23 && date_time.min == 59 && date_time.sec == 59 )
-                SaveData( EVENT_DATA ); //запись данных в 00:00:00
+            //сработал будильник RTC, сохранение данных в журнал
+            if ( GetTimeSec() >= log_next )
+                SaveData( EVENT_DATA );
+            LogSchedule( false );
            }
+        if ( event & EVN_WTR_SCHED )
+            LogSchedule( false ); //изменение времени или параметров
         if ( event & EVN_WTR_VALUE )
             ValueWater();
+        if ( event & EVN_WTR_RESET ) {
+            //перезапуск контроллера: запись текущих значений счетчиков (импульсы, накопленные
+            //до запроса, уже учтены), ожидание завершения всех запросов записи в FRAM
+            WaterFlush();
+            StorageWait( RESET_STORE_WAIT );
+            NVIC_SystemReset();
+           }
+        //публикация текущих значений для MODBUS: счетчики, давление, мгновенный расход,
+        //каждую секунду - состояние датчиков утечки и напряжения 12VDC
+        if ( event & ( EVN_WTR_CNT_COLD | EVN_WTR_CNT_HOT | EVN_WTR_CNT_FILTER | EVN_WTR_PRESSURE | \
+                       EVN_WTR_LEAK1 | EVN_WTR_LEAK2 | EVN_WTR_SECOND ) )
+            ModBusLiveUpdate();
        }
  }
 
@@ -155,13 +344,11 @@ static void ValueWater( void ) {
  }
 
 //*************************************************************************************************
-// Функция обратного вызова таймера, запуск измерения давления воды
+// Функция обратного вызова таймера, обновление значений давления воды
 //*************************************************************************************************
 static void Timer1Callback( void *arg ) {
 
-    adc_data[WATER_COLD] = 0;
-    adc_data[WATER_HOT] = 0;
-    osEventFlagsSet( water_event, EVN_WTR_PRESSURE_START );
+    osEventFlagsSet( water_event, EVN_WTR_PRESSURE );
  }
 
 //*************************************************************************************************
@@ -205,13 +392,42 @@ static void SaveData( EventType type ) {
     water_log.pressr_hot = pressure_hot;                        //давление горячей воды
     water_log.leak1 = LeakStatus( LEAK1 );                      //состояние датчика утечки #1
     water_log.leak2 = LeakStatus( LEAK2 );                      //состояние датчика утечки #2
+    water_log.flow_leak = FlowLeakStatus();                     //непрерывный расход воды (микро-утечка)
     water_log.dc12_chk = DC12VStatus();                         //контроль напряжения 12VDc для питания датчиков утечки
     water_log.type_event = type;
-    //сохранение данные в журнал
-    if ( FramSaveData( WATER_DATA_LOG, (uint8_t *)&water_log, sizeof( water_log ) ) == FRAM_OK ) {
-        //сохраним адрес размещения следующей записи в журнал
-        FramSaveData( CURRENT_DATA, (uint8_t *)&curr_data, sizeof( curr_data ) );
+    if ( type == EVENT_DATA )
+        curr_data.log_time = GetTimeSec();
+    //запись в журнал выполняется только в задаче "Storage" (порядок записей и итоги расхода),
+    //при заполненной очереди ожидание освобождения места
+    if ( StorageLog( &water_log, NULL, LOG_STORE_WAIT ) == false )
+        return;
+    //сохраним адрес размещения следующей записи в журнал и текущие значения счетчиков
+    WaterFlush();
+ }
+
+//*************************************************************************************************
+// Расчет времени следующей записи интервальных данных в журнал и установка будильника RTC.
+// Интервалы записи отсчитываются от 00:00:00, запись выполняется в последнюю секунду интервала,
+// для суточного интервала в 23:59:59. При включении, если последняя запись в журнал выполнена
+// раньше предыдущего интервала, выполняется одна запись за пропущенные интервалы.
+//-------------------------------------------------------------------------------------------------
+// bool start - true - вызов при включении контроллера
+//*************************************************************************************************
+static void LogSchedule( bool start ) {
+
+    uint32_t now, period;
+
+    period = config.log_period && !( LOG_PERIOD_DAY % config.log_period ) ? config.log_period : LOG_PERIOD_DAY;
+    period *= 60;
+    now = GetTimeSec();
+    log_next = ( ( now + 1 ) / period + 1 ) * period - 1;
+    if ( start == true && curr_data.log_time && log_next >= period && curr_data.log_time < log_next - period ) {
+        #if defined( DEBUG_WATER ) && defined( DEBUG_TARGET )
+        UartSendStr( "Log interval missed\r\n" );
+        #endif
+        SaveData( EVENT_DATA );
        }
+    SetAlarm( log_next );
  }
 
 //*************************************************************************************************
@@ -235,29 +451,391 @@ LeakStat LeakStatus( LeakType type ) {
  }
 
 //*************************************************************************************************
-// Увеличение значений счетчиков воды
+// Регистрация импульса от счетчика воды, вызывается из прерывания EXTI
 //-------------------------------------------------------------------------------------------------
 // CountType type - тип счетчика
 //*************************************************************************************************
-static void IncCount( CountType type ) {
+void WaterPulse( CountType type ) {
+
+    if ( type > COUNT_FILTER )
+        return;
+    PulseAdd( type );
+    osEventFlagsSet( water_event, EVN_WTR_CNT_COLD << type );
+ }
+
+//*************************************************************************************************
+// Увеличение значений счетчиков воды на кол-во импульсов, накопленных в прерывании с момента
+// предыдущего вызова. Флаги событий при повторных импульсах объединяются, поэтому значение
+// счетчика определяется не по кол-ву событий, а по кол-ву импульсов, накопленных в прерывании.
+//*************************************************************************************************
+static void IncCount( void ) {
 
-    bool change = false;
+    uint32_t volume, pending[COUNT_FILTER + 1];
+    uint16_t inc[COUNT_FILTER + 1];
+    uint8_t idx;
+    bool change = false, leak = false;
     
-    if ( type == COUNT_COLD ) {
-        change = true;
-        curr_data.count_cold += config.inc_cnt_cold;
+    for ( idx = 0; idx < SIZE_ARRAY( pending ); idx++ ) {
+        pending[idx] = PulseTake( (CountType)idx );
+        if ( pending[idx] )
+            change = true;
+       }
+    if ( change == false )
+        return;
+    volume = pending[COUNT_COLD] * config.inc_cnt_cold + pending[COUNT_HOT] * config.inc_cnt_hot + 
+             pending[COUNT_FILTER] * config.inc_cnt_filter;
+    curr_data.count_cold += pending[COUNT_COLD] * config.inc_cnt_cold;
+    curr_data.count_hot += pending[COUNT_HOT] * config.inc_cnt_hot;
+    curr_data.count_filter += pending[COUNT_FILTER] * config.inc_cnt_filter;
+    //изменения сохраняются в RAM, запись в FRAM только при превышении порогов
+    if ( cache_dirty == false ) {
+        cache_dirty = true;
+        cache_tick = osKernelGetTickCount();
+       }
+    cache_stat[CACHE_STAT_RISK] += volume;
+    if ( CacheExpired() == true )
+        WaterFlush();
+    else {
+        cache_stat[CACHE_STAT_SKIP]++;
+        cache_stat[CACHE_STAT_BYTES] += FRAM_BLOCK_SIZE;
+       }
+    //контроль непрерывного расхода по счетчикам
+    inc[COUNT_COLD] = config.inc_cnt_cold;
+    inc[COUNT_HOT] = config.inc_cnt_hot;
+    inc[COUNT_FILTER] = config.inc_cnt_filter;
+    for ( idx = 0; idx < SIZE_ARRAY( pending ); idx++ ) {
+        if ( pending[idx] && LeakDetect( (CountType)idx, pending[idx], PulseDone( (CountType)idx ), inc[idx] ) == true )
+            leak = true;
+       }
+    if ( leak == true ) {
+        //событие "непрерывный расход воды", сообщение координатору сети
+        SaveData( EVENT_ALARM );
+        osEventFlagsSet( zb_ctrl, EVN_ZC_SEND_LEAKS );
+       }
+ }
+
+//*************************************************************************************************
+// Детектор непрерывного расхода воды (микро-утечки), выполняется при поступлении импульсов 
+// счетчика. Интервал без импульсов не менее config.leak_idle минут считается интервалом
+// "покоя", при отсутствии интервалов "покоя" в течении config.leak_period часов формируется
+// событие. Дополнительно фиксируются: минимальный интервал между импульсами, максимальный 
+// интервал "покоя" за текущие и предыдущие сутки, расход в ночном интервале 02:00 - 05:00.
+//-------------------------------------------------------------------------------------------------
+// CountType type  - тип счетчика
+// uint32_t pulses - кол-во новых импульсов
+// uint32_t cnt    - общее кол-во обработанных импульсов счетчика, с учетом новых
+// uint16_t inc    - кол-во литров на один импульс
+// return = true   - обнаружен непрерывный расход воды
+//*************************************************************************************************
+static bool LeakDetect( CountType type, uint32_t pulses, uint32_t cnt, uint16_t inc ) {
+
+    uint32_t now, day, sec, idx, gap;
+    PULSE_SNAP snap;
+    LEAK_DETECT *leak = &leak_det[type];
+
+    now = GetTimeSec();
+    day = now / SEC_PER_DAY;
+    sec = now % SEC_PER_DAY;
+    //копия меток времени, согласованная с кол-вом импульсов
+    PulseSnap( type, &snap );
+    //минимальный интервал между импульсами по меткам DWT->CYCCNT, кроме меток, 
+    //перезаписанных новыми импульсами, и интервалов от FLOW_TIMEOUT (по меткам тиков RTOS), 
+    //разность меток DWT->CYCCNT которых может содержать переполнение
+    for ( idx = ( cnt - pulses ) ? cnt - pulses : 1; idx < cnt; idx++ ) {
+        if ( snap.cnt - ( idx - 1 ) > PULSE_RING_SIZE )
+            continue;
+        if ( snap.tick[idx % PULSE_RING_SIZE] - snap.tick[( idx - 1 ) % PULSE_RING_SIZE] >= FLOW_TIMEOUT * osKernelGetTickFreq() )
+            continue;
+        gap = snap.time[idx % PULSE_RING_SIZE] - snap.time[( idx - 1 ) % PULSE_RING_SIZE];
+        gap /= SystemCoreClock / 1000;
+        if ( !leak->gap_min || gap < leak->gap_min )
+            leak->gap_min = gap;
+       }
+    //макс. интервал без импульсов за сутки
+    if ( day != leak->idle_day ) {
+        leak->idle_prev = ( day == leak->idle_day + 1 ) ? leak->idle_max : 0;
+        leak->idle_max = 0;
+        leak->idle_day = day;
+       }
+    if ( leak->pulse_time && now - leak->pulse_time > leak->idle_max )
+        leak->idle_max = now - leak->pulse_time;
+    //расход в ночном интервале
+    if ( sec >= LEAK_NIGHT_START && sec < LEAK_NIGHT_END ) {
+        if ( day != leak->night_day ) {
+            leak->night_base = ( day == leak->night_day + 1 ) ? leak->night_vol : 0;
+            leak->night_vol = 0;
+            leak->night_day = day;
+           }
+        leak->night_vol += pulses * inc;
+       }
+    //интервал "покоя" перед импульсом, начало нового интервала расхода
+    if ( !leak->pulse_time || now - leak->pulse_time >= ( config.leak_idle ? config.leak_idle : LEAK_IDLE_DEF ) * 60 ) {
+        leak->flow_start = now;
+        leak->alarm = false;
+       }
+    leak->pulse_time = now;
+    if ( !config.leak_period || leak->alarm == true )
+        return false;
+    if ( now - leak->flow_start >= config.leak_period * 3600 ) {
+        leak->alarm = true;
+        #if defined( DEBUG_WATER ) && defined( DEBUG_TARGET )
+        sprintf( str, "Continuous flow: %s\r\n", leak_name[type] );
+        UartSendStr( str );
+        #endif
+        return true;
+       }
+    return false;
+ }
+
+//*************************************************************************************************
+// Возвращает маску счетчиков с непрерывным расходом воды (микро-утечкой), признак сбрасывается
+// при отсутствии импульсов счетчика в течении интервала "покоя"
+//-------------------------------------------------------------------------------------------------
+// return - маска FLOW_LEAK_COLD | FLOW_LEAK_HOT | FLOW_LEAK_FILTER
+//*************************************************************************************************
+uint8_t FlowLeakStatus( void ) {
+
+    uint8_t type, mask = 0;
+    uint32_t now, idle;
+
+    now = GetTimeSec();
+    idle = ( config.leak_idle ? config.leak_idle : LEAK_IDLE_DEF ) * 60;
+    for ( type = COUNT_COLD; type <= COUNT_FILTER; type++ ) {
+        if ( leak_det[type].alarm == true && now - leak_det[type].pulse_time < idle )
+            mask |= 1 << type;
+       }
+    return mask;
+ }
+
+//*************************************************************************************************
+// Возвращает расшифровку состояния детектора непрерывного расхода воды по счетчику
+//-------------------------------------------------------------------------------------------------
+// CountType type - тип счетчика
+// char *str      - указатель на буфер для размещения результата
+// return         - указатель на буфер с результатом
+//*************************************************************************************************
+char *FlowLeakDesc( CountType type, char *str ) {
+
+    char *ptr;
+    uint32_t now, day, sec, idle, night;
+    LEAK_DETECT *leak;
+
+    if ( type > COUNT_FILTER )
+        return NULL;
+    leak = &leak_det[type];
+    now = GetTimeSec();
+    day = now / SEC_PER_DAY;
+    sec = now % SEC_PER_DAY;
+    //макс. интервал "покоя" за последние сутки (текущие + предыдущие), с учетом текущего интервала
+    if ( day == leak->idle_day )
+        idle = leak->idle_max > leak->idle_prev ? leak->idle_max : leak->idle_prev;
+    else idle = ( day == leak->idle_day + 1 ) ? leak->idle_max : 0;
+    if ( leak->pulse_time && now - leak->pulse_time > idle )
+        idle = now - leak->pulse_time;
+    //расход в последнем завершенном ночном интервале
+    if ( day == leak->night_day )
+        night = ( sec >= LEAK_NIGHT_END ) ? leak->night_vol : leak->night_base;
+    else if ( sec >= LEAK_NIGHT_END )
+        night = 0;
+    else night = ( day == leak->night_day + 1 ) ? leak->night_vol : 0;
+    ptr = str;
+    ptr += sprintf( ptr, "%-7s gap min: %3u.%03u sec idle 24h: %4u min night: %4u l  %s", leak_name[type], 
+                    leak->gap_min / 1000, leak->gap_min % 1000, idle / 60, night, 
+                    FlowLeakStatus() & ( 1 << type ) ? "ALARM" : "OK" );
+    return str;
+ }
+
+//*************************************************************************************************
+// Проверка необходимости записи текущих значений счетчиков в FRAM
+// При нулевых значениях обоих порогов данные записываются при каждом изменении
+//-------------------------------------------------------------------------------------------------
+// return = true - данные требуется записать в FRAM
+//*************************************************************************************************
+static bool CacheExpired( void ) {
+
+    if ( cache_dirty == false )
+        return false;
+    if ( !config.cache_time && !config.cache_volume )
+        return true;
+    if ( config.cache_volume && cache_stat[CACHE_STAT_RISK] >= config.cache_volume )
+        return true;
+    if ( config.cache_time && ( osKernelGetTickCount() - cache_tick ) >= config.cache_time * osKernelGetTickFreq() )
+        return true;
+    return false;
+ }
+
+//*************************************************************************************************
+// Запрос записи текущих значений счетчиков в FRAM, сброс признака несохраненных изменений
+// Вызывается при записи в журнал, событиях утечки, по порогам кэширования и перед перезапуском,
+// запись выполняется в задаче "Storage", результат обрабатывается в FlushResult(). Объем воды
+// не сохраненный в FRAM уменьшается только после успешной записи.
+//*************************************************************************************************
+void WaterFlush( void ) {
+
+    uint32_t time;
+
+    StorageFlush( FlushDone );
+    if ( cache_dirty == true ) {
+        //статистика объема и времени хранения изменений только в RAM
+        time = ( osKernelGetTickCount() - cache_tick ) / osKernelGetTickFreq();
+        if ( time > cache_stat[CACHE_STAT_TIME_MAX] )
+            cache_stat[CACHE_STAT_TIME_MAX] = time;
+        if ( cache_stat[CACHE_STAT_RISK] > cache_stat[CACHE_STAT_RISK_MAX] )
+            cache_stat[CACHE_STAT_RISK_MAX] = cache_stat[CACHE_STAT_RISK];
+       }
+    cache_dirty = false;
+    flush_risk = cache_stat[CACHE_STAT_RISK];
+ }
+
+//*************************************************************************************************
+// Результат записи текущих значений счетчиков, вызывается в задаче "Storage"
+// Данные кэширования изменяются только в задаче TaskWater, результат передается событием
+//-------------------------------------------------------------------------------------------------
+// FramStatus status - результат записи
+//*************************************************************************************************
+static void FlushDone( FramStatus status ) {
+
+    osEventFlagsSet( water_event, status == FRAM_OK ? EVN_WTR_FLUSH_OK : EVN_WTR_FLUSH_ERR );
+ }
+
+//*************************************************************************************************
+// Обработка результата записи текущих значений счетчиков, выполняется в задаче TaskWater
+// При успешной записи объем воды не сохраненный в FRAM уменьшается на объем на момент запроса
+// (объединенные запросы учитываются один раз), при ошибке изменения снова считаются 
+// несохраненными, запись повторяется по порогам кэширования
+//-------------------------------------------------------------------------------------------------
+// bool done - true - запись выполнена, false - ошибка записи
+//*************************************************************************************************
+static void FlushResult( bool done ) {
+
+    if ( done == true ) {
+        cache_stat[CACHE_STAT_WRITE]++;
+        if ( flush_risk > cache_stat[CACHE_STAT_RISK] )
+            flush_risk = cache_stat[CACHE_STAT_RISK];
+        cache_stat[CACHE_STAT_RISK] -= flush_risk;
+        flush_risk = 0;
+        return;
        }
-    if ( type == COUNT_HOT ) {
-        change = true;
-        curr_data.count_hot += config.inc_cnt_hot;
+    flush_risk = 0;
+    if ( cache_dirty == false ) {
+        cache_dirty = true;
+        cache_tick = osKernelGetTickCount();
        }
-    if ( type == COUNT_FILTER ) {
-        change = true;
-        curr_data.count_filter += config.inc_cnt_filter;
+ }
+
+//*************************************************************************************************
+// Повторное чтение текущих значений счетчиков после ошибки чтения при включении. До успешного
+// чтения запись в FRAM не выполняется, значения счетчиков в RAM содержат расход с момента 
+// включения и при успешном чтении добавляются к сохраненным значениям.
+//*************************************************************************************************
+static void DataRecover( void ) {
+
+    CURR_DATA data;
+
+    if ( FramDataRecover( &data ) != FRAM_OK )
+        return;
+    //изменение значений согласовано с копированием curr_data в задаче "Storage"
+    osKernelLock();
+    curr_data.count_cold += data.count_cold;
+    curr_data.count_hot += data.count_hot;
+    curr_data.count_filter += data.count_filter;
+    if ( !curr_data.log_time )
+        curr_data.log_time = data.log_time;
+    osKernelUnlock();
+    UartSendStr( "Current water flow values restored from FRAM.\r\n" );
+    WaterFlush();
+ }
+
+//*************************************************************************************************
+// Возвращает расшифровку и значения счетчиков статистики кэширования текущих данных
+//-------------------------------------------------------------------------------------------------
+// CacheStat index - индекс счетчика
+// char *str       - указатель для размещения результата
+// return          - указатель на строку с расшифровкой
+//*************************************************************************************************
+char *WaterCacheDesc( CacheStat index, char *str ) {
+
+    char *ptr;
+    
+    if ( index >= CACHE_STAT_CNT )
+        return NULL;
+    ptr = str;
+    ptr += sprintf( ptr, "%s", cache_desc[index] );
+    //дополним расшифровку справа знаком "." до 45 символов
+    ptr += AddDot( str, 45, 0 );
+    ptr += sprintf( ptr, "%6u ", cache_stat[index] );
+    return str;
+ }
+
+//*************************************************************************************************
+// Расчет мгновенного расхода воды по меткам времени последних импульсов счетчиков.
+// Расход вычисляется по интервалу между первым и последним импульсом из PULSE_RING_SIZE
+// последних (интервалы более FLOW_TIMEOUT не учитываются). Если с момента последнего импульса
+// прошло больше среднего интервала, расход ограничивается значением для одного импульса за 
+// прошедшее время, т.е. после остановки потока плавно снижается до "0".
+//*************************************************************************************************
+static void FlowRate( void ) {
+
+    uint8_t type, idx;
+    uint16_t inc[COUNT_FILTER + 1];
+    uint32_t cnt, now, now_tick, since, span, timeout, prev;
+    uint32_t *time, *tick;
+    PULSE_SNAP snap;
+
+    inc[COUNT_COLD] = config.inc_cnt_cold;
+    inc[COUNT_HOT] = config.inc_cnt_hot;
+    inc[COUNT_FILTER] = config.inc_cnt_filter;
+    //интервалы сравниваются по тикам RTOS, переполнение которых наступает через 49 суток
+    timeout = FLOW_TIMEOUT * osKernelGetTickFreq();
+    for ( type = COUNT_COLD; type <= COUNT_FILTER; type++ ) {
+        //копия меток времени, согласованная с кол-вом импульсов
+        PulseSnap( (CountType)type, &snap );
+        cnt = snap.cnt;
+        now = snap.now;
+        now_tick = snap.now_tick;
+        time = snap.time;
+        tick = snap.tick;
+        flow_rate[type] = 0;
+        if ( !cnt )
+            continue;
+        if ( now_tick - tick[( cnt - 1 ) % PULSE_RING_SIZE] >= timeout )
+            continue; //поток остановлен
+        //прошло меньше FLOW_TIMEOUT - разность меток DWT->CYCCNT без переполнения
+        since = now - time[( cnt - 1 ) % PULSE_RING_SIZE];
+        //суммарная длительность последних интервалов между импульсами
+        for ( idx = 1, span = 0; idx < PULSE_RING_SIZE && idx < cnt; idx++ ) {
+            if ( tick[( cnt - idx ) % PULSE_RING_SIZE] - tick[( cnt - 1 - idx ) % PULSE_RING_SIZE] >= timeout )
+                break;
+            prev = time[( cnt - 1 - idx ) % PULSE_RING_SIZE];
+            span += time[( cnt - idx ) % PULSE_RING_SIZE] - prev;
+           }
+        if ( idx == 1 )
+            continue; //для расчета необходимо минимум два импульса
+        //снижение расхода при отсутствии импульсов дольше среднего интервала
+        if ( since > span / ( idx - 1 ) )
+            flow_rate[type] = FlowCalc( 1, since, inc[type] );
+        else flow_rate[type] = FlowCalc( idx - 1, span, inc[type] );
        }
-    //при изменении данных, запишем новые значения в FRAM
-    if ( change == true )
-        FramSaveData( CURRENT_DATA, (uint8_t *)&curr_data, sizeof( curr_data ) ); //запись данных в FRAM
+ }
+
+//*************************************************************************************************
+// Расчет расхода воды в л/мин * 100
+//-------------------------------------------------------------------------------------------------
+// uint32_t pulses - кол-во импульсов (интервалов)
+// uint32_t time   - длительность интервалов (такты ядра)
+// uint16_t inc    - кол-во литров на один импульс
+// return          - расход воды, значение ограничено 0xFFFF
+//*************************************************************************************************
+static uint16_t FlowCalc( uint32_t pulses, uint32_t time, uint16_t inc ) {
+
+    uint64_t rate;
+    
+    if ( !time )
+        return 0;
+    rate = ( (uint64_t)pulses * inc * 60 * 100 * SystemCoreClock ) / time;
+    if ( rate > 0xFFFF )
+        return 0xFFFF;
+    return (uint16_t)rate;
  }
 
 //*************************************************************************************************
@@ -271,44 +849,487 @@ DC12VStat DC12VStatus( void ) {
  }
 
 //*************************************************************************************************
-// Обработка результата измерений АЦП, результат измерений записывается 
-// в переменные: pressure_cold, pressure_hot с пересчетом в давление
-// Массив adc_data[], для хранения считанных данных АЦП, должен быть объявлен как uint16_t !
+// Расчет таблицы пересчета значений АЦП в давление по таблице калибровки датчиков, порогов
+// аварийного контроля и интервала обновления значений давления. Вызывается при инициализации
+// и изменении параметров конфигурации.
+//*************************************************************************************************
+void WaterPressCfg( void ) {
+
+    uint8_t cnt;
+    uint16_t idx;
+    PRESS_CAL cal[PRESS_CAL_POINTS];
+
+    cnt = PressCalTable( cal );
+    if ( cnt ) {
+        //допустимый диапазон значений АЦП в пределах таблицы калибровки
+        press_adc_min = ( ( (uint32_t)cal[0].volt << ADC_RESULT_BITS ) + ADC_FULL_SCALE_MV - 1 ) / ADC_FULL_SCALE_MV;
+        press_adc_max = ( (uint32_t)cal[cnt - 1].volt << ADC_RESULT_BITS ) / ADC_FULL_SCALE_MV;
+       }
+    else {
+        //нет данных для пересчета, давление всегда "0"
+        press_adc_min = 1;
+        press_adc_max = 0;
+       }
+    //давление на границах интервалов значений АЦП, напряжение в мВ * 16
+    for ( idx = 0; idx < PRESS_LUT_SIZE; idx++ )
+        press_lut[idx] = PressCalc( cal, cnt, ( ( (uint32_t)idx << PRESS_LUT_SHIFT ) * ADC_FULL_SCALE_MV ) >> ( ADC_RESULT_BITS - 4 ) );
+    //пороги аварийного контроля давления
+    PressAlarmCfg( cal, cnt );
+    press_period = config.press_time ? config.press_time : TIME_READ_PRESSURE;
+    //порог изменения давления за HAMMER_DIFF выборок для захвата переходных процессов
+    if ( config.hammer_dpdt ) {
+        hammer_thr = ( (uint32_t)config.hammer_dpdt * 100 * HAMMER_DIFF + HAMMER_RATE / 2 ) / HAMMER_RATE;
+        if ( !hammer_thr )
+            hammer_thr = 1;
+       }
+    else hammer_thr = 0;
+    //перезапуск захвата, сохраненный снимок не сбрасывается
+    if ( hammer_stat != HAMMER_READY )
+        HammerClear();
+    //перезапуск таймера с новым интервалом
+    if ( timer1 != NULL && osTimerIsRunning( timer1 ) )
+        osTimerStart( timer1, press_period );
+ }
+
+//*************************************************************************************************
+// Формирует таблицу калибровки датчиков давления из параметров конфигурации. Если таблица
+// калибровки не заполнена или значения напряжения не возрастают, таблица из двух точек
+// формируется по параметрам линейной характеристики: pressure_max, press_out_min, press_out_max.
+//-------------------------------------------------------------------------------------------------
+// PRESS_CAL *cal - указатель на таблицу калибровки (PRESS_CAL_POINTS точек)
+// return         - кол-во точек в таблице, "0" - параметры калибровки недопустимые
+//*************************************************************************************************
+static uint8_t PressCalTable( PRESS_CAL *cal ) {
+
+    uint8_t idx;
+
+    if ( config.press_points >= 2 && config.press_points <= PRESS_CAL_POINTS ) {
+        for ( idx = 1; idx < config.press_points; idx++ )
+            if ( config.press_cal[idx].volt <= config.press_cal[idx - 1].volt )
+                break;
+        if ( idx == config.press_points ) {
+            memcpy( cal, config.press_cal, sizeof( PRESS_CAL ) * idx );
+            return idx;
+           }
+       }
+    //линейная характеристика датчика
+    if ( config.press_out_min < 0 || config.press_out_max <= config.press_out_min || config.pressure_max <= 0 )
+        return 0;
+    cal[0].volt = (uint16_t)( config.press_out_min * 1000 );
+    cal[0].pressure = 0;
+    cal[1].volt = (uint16_t)( config.press_out_max * 1000 );
+    cal[1].pressure = (uint16_t)( config.pressure_max * 100 );
+    return 2;
+ }
+
+//*************************************************************************************************
+// Расчет давления по таблице калибровки, кусочно-линейная интерполяция между точками таблицы,
+// за пределами таблицы - значение давления крайней точки
+//-------------------------------------------------------------------------------------------------
+// PRESS_CAL *cal - указатель на таблицу калибровки
+// uint8_t cnt    - кол-во точек в таблице
+// uint32_t volt  - напряжение на выходе датчика (мВ * 16)
+// return         - давление (атм * 100)
+//*************************************************************************************************
+static uint16_t PressCalc( PRESS_CAL *cal, uint8_t cnt, uint32_t volt ) {
+
+    uint8_t idx;
+    int32_t delta;
+
+    if ( !cnt )
+        return 0;
+    if ( volt <= (uint32_t)cal[0].volt << 4 )
+        return cal[0].pressure;
+    for ( idx = 1; idx < cnt; idx++ ) {
+        if ( volt > (uint32_t)cal[idx].volt << 4 )
+            continue;
+        delta = (int32_t)cal[idx].pressure - cal[idx - 1].pressure;
+        delta = delta * (int32_t)( volt - ( (uint32_t)cal[idx - 1].volt << 4 ) ) / ( (int32_t)( cal[idx].volt - cal[idx - 1].volt ) << 4 );
+        return (uint16_t)( cal[idx - 1].pressure + delta );
+       }
+    return cal[cnt - 1].pressure;
+ }
+
+//*************************************************************************************************
+// Обработка заполненной половины буфера DMA АЦП, вызывается из прерывания DMA.
+// Передискретизация (сумма ADC_OVERSAMPLE выборок, результат 15 бит), медианный фильтр
+// по трем последним значениям и IIR фильтр первого порядка, только целочисленные вычисления.
+// Суммы по HAMMER_DECIM выборок передаются в захват переходных процессов давления.
+//-------------------------------------------------------------------------------------------------
+// uint8_t part - номер половины буфера: 0 - первая, 1 - вторая
+//*************************************************************************************************
+void WaterAdcComplt( uint8_t part ) {
+
+    uint8_t idx, blk, chnl;
+    uint16_t value, *ptr;
+    uint32_t sum[ADC_CHANNELS], sub[ADC_CHANNELS];
+
+    sum[WATER_COLD] = sum[WATER_HOT] = 0;
+    ptr = &adc_buff[part & 0x01][0][0];
+    for ( blk = 0; blk < ADC_OVERSAMPLE / HAMMER_DECIM; blk++ ) {
+        //частичные суммы - выборки захвата переходных процессов
+        sub[WATER_COLD] = sub[WATER_HOT] = 0;
+        for ( idx = 0; idx < HAMMER_DECIM; idx++ ) {
+            sub[WATER_COLD] += *ptr++;
+            sub[WATER_HOT] += *ptr++;
+           }
+        sum[WATER_COLD] += sub[WATER_COLD];
+        sum[WATER_HOT] += sub[WATER_HOT];
+        HammerSample( sub );
+       }
+    for ( chnl = 0; chnl < ADC_CHANNELS; chnl++ ) {
+        value = (uint16_t)( sum[chnl] >> ADC_OVERSAMPLE_SHIFT );
+        if ( !adc_blocks ) {
+            //первый блок, начальное заполнение фильтров
+            for ( idx = 0; idx < ADC_MEDIAN_SIZE; idx++ )
+                adc_median[chnl][idx] = value;
+            adc_iir[chnl] = (int32_t)value << ADC_IIR_FRAC;
+           }
+        adc_median[chnl][adc_median_idx] = value;
+        value = Median3( adc_median[chnl] );
+        adc_iir[chnl] += ( ( (int32_t)value << ADC_IIR_FRAC ) - adc_iir[chnl] ) >> ADC_IIR_SHIFT;
+       }
+    if ( ++adc_median_idx >= ADC_MEDIAN_SIZE )
+        adc_median_idx = 0;
+    adc_blocks++;
+ }
+
+//*************************************************************************************************
+// Возвращает медиану трех значений
+//-------------------------------------------------------------------------------------------------
+// uint16_t *val - указатель на массив из трех значений
+// return        - медиана
+//*************************************************************************************************
+static uint16_t Median3( uint16_t *val ) {
+
+    if ( val[0] > val[1] ) {
+        if ( val[1] > val[2] )
+            return val[1];
+        return val[0] > val[2] ? val[2] : val[0];
+       }
+    if ( val[0] > val[2] )
+        return val[0];
+    return val[1] > val[2] ? val[2] : val[1];
+ }
+
+//*************************************************************************************************
+// Пересчет отфильтрованных значений АЦП в давление по таблице press_lut[] с линейной
+// интерполяцией, результат записывается в переменные: pressure_cold, pressure_hot (атм * 100)
 //*************************************************************************************************
 static void WaterPressure( void ) {
 
-    float coef_volt_pres;
-    float prs_cold, prs_hot;
-    #if defined( DEBUG_PRESSURE ) && defined( DEBUG_TARGET )
-    float prs_cold1, prs_hot1;
-    #endif
-
-    //коэффициент коэффициента пересчета напряжения в давление
-    coef_volt_pres = config.pressure_max / ( config.press_out_max - config.press_out_min );
-    //пересчет значений АЦП в напряжение, диапазон 3.3 вольт
-    prs_cold = ( (float)adc_data[WATER_COLD] * VREF_VOLTAGE ) / ADC_MAX_VALUE; 
-    prs_hot  = ( (float)adc_data[WATER_HOT] * VREF_VOLTAGE ) / ADC_MAX_VALUE; 
-    #if defined( DEBUG_PRESSURE ) && defined( DEBUG_TARGET )
-    prs_cold1 = prs_cold;
-    prs_hot1  = prs_hot;
-    #endif
-    //пересчет в диапазон 5 вольт
-    prs_cold *= CONV_3V3_5V;
-    prs_hot  *= CONV_3V3_5V;
-    #if defined( DEBUG_PRESSURE ) && defined( DEBUG_TARGET )
-    sprintf( str, "ADC1: 0x%04X/%5.3f Vin: %5.3f\r\n", adc_data[WATER_COLD], prs_cold1, prs_cold );
-    UartSendStr( str );
-    sprintf( str, "ADC2: 0x%04X/%5.3f Vin: %5.3f\r\n\r\n", adc_data[WATER_HOT], prs_hot1, prs_hot );
-    UartSendStr( str );
-    #endif
+    uint8_t chnl;
+    uint32_t value;
+    uint16_t pressure[ADC_CHANNELS];
+
+    for ( chnl = 0; chnl < ADC_CHANNELS; chnl++ ) {
+        //значение АЦП 15 бит
+        value = (uint32_t)adc_iir[chnl] >> ADC_IIR_FRAC;
+        #if defined( DEBUG_PRESSURE ) && defined( DEBUG_TARGET )
+        sprintf( str, "ADC%u: 0x%04X Vin: %u mV\r\n", chnl + 1, value, ( value * ADC_FULL_SCALE_MV ) >> ADC_RESULT_BITS );
+        UartSendStr( str );
+        #endif
+        pressure[chnl] = PressValue( value );
+       }
+    pressure_cold = pressure[WATER_COLD];
+    pressure_hot = pressure[WATER_HOT];
+    //мин/макс давление для итогов расхода
+    RollupPress( pressure_cold, pressure_hot );
+ }
+
+//*************************************************************************************************
+// Пересчет значения АЦП в давление по таблице press_lut[] с линейной интерполяцией
+//-------------------------------------------------------------------------------------------------
+// uint32_t value - значение АЦП (15 бит)
+// return         - давление (атм * 100), "0" - значение за пределами таблицы калибровки
+//*************************************************************************************************
+static uint16_t PressValue( uint32_t value ) {
+
+    uint32_t idx;
+    int32_t delta;
+
     //проверка диапазона и пересчет в давление
-    if ( prs_cold < config.press_out_min || prs_cold > config.press_out_max )
-        prs_cold = 0;
-    else prs_cold = ( prs_cold - config.press_out_min ) * coef_volt_pres;
-    if ( prs_hot < config.press_out_min || prs_hot > config.press_out_max )
-        prs_hot = 0;
-    else prs_hot  = ( prs_hot - config.press_out_min ) * coef_volt_pres;
-    //пересчет значений давления в целое значение
-    pressure_cold = (uint16_t)( prs_cold * 100 );
-    pressure_hot = (uint16_t)( prs_hot * 100 );
+    if ( value < press_adc_min || value > press_adc_max )
+        return 0;
+    idx = value >> PRESS_LUT_SHIFT;
+    delta = (int32_t)press_lut[idx + 1] - press_lut[idx];
+    delta = ( delta * (int32_t)( value & ( ( 1 << PRESS_LUT_SHIFT ) - 1 ) ) ) >> PRESS_LUT_SHIFT;
+    return (uint16_t)( press_lut[idx] + delta );
+ }
+
+//*************************************************************************************************
+// Запись выборки в буфер захвата переходных процессов давления, вызывается из прерывания DMA.
+// Событие - изменение давления за HAMMER_DIFF выборок не менее порога hammer_thr, проверяется
+// после записи HAMMER_PRE_TRIG выборок. После события записывается ( HAMMER_SAMPLES -
+// HAMMER_PRE_TRIG ) выборок, снимок сохраняется до вызова HammerClear().
+//-------------------------------------------------------------------------------------------------
+// uint32_t *sum - суммы HAMMER_DECIM выборок АЦП по каналам
+//*************************************************************************************************
+static void HammerSample( uint32_t *sum ) {
+
+    uint8_t chnl, hist;
+    uint16_t value, press, delta;
+
+    if ( hammer_stat != HAMMER_WAIT && hammer_stat != HAMMER_CAPTURE )
+        return;
+    hist = hammer_idx % HAMMER_DIFF;
+    for ( chnl = 0; chnl < ADC_CHANNELS; chnl++ ) {
+        value = (uint16_t)( sum[chnl] >> HAMMER_DECIM_SHIFT );
+        hammer_buff[hammer_idx][chnl] = value;
+        if ( hammer_stat != HAMMER_WAIT )
+            continue;
+        //изменение давления относительно выборки HAMMER_DIFF интервалов назад
+        press = PressValue( value );
+        delta = press > hammer_hist[chnl][hist] ? press - hammer_hist[chnl][hist] : hammer_hist[chnl][hist] - press;
+        hammer_hist[chnl][hist] = press;
+        if ( hammer_fill < HAMMER_PRE_TRIG || delta < hammer_thr )
+            continue;
+        //событие, запись выборок после события
+        hammer_stat = HAMMER_CAPTURE;
+        hammer_post = HAMMER_SAMPLES - HAMMER_PRE_TRIG;
+        hammer_chnl = (Water)chnl;
+        hammer_delta = delta;
+        GetTimeDate( &hammer_dtime );
+       }
+    if ( ++hammer_idx >= HAMMER_SAMPLES )
+        hammer_idx = 0;
+    if ( hammer_stat == HAMMER_WAIT ) {
+        if ( hammer_fill < HAMMER_PRE_TRIG )
+            hammer_fill++;
+        return;
+       }
+    if ( !--hammer_post ) {
+        //снимок записан, первая выборка снимка - самая старая в буфере
+        hammer_start = hammer_idx;
+        hammer_stat = HAMMER_READY;
+       }
+ }
+
+//*************************************************************************************************
+// Сброс сохраненного снимка и запуск захвата переходных процессов давления,
+// если задан порог скорости изменения давления
+//*************************************************************************************************
+void HammerClear( void ) {
+
+    __disable_irq();
+    hammer_idx = 0;
+    hammer_fill = 0;
+    hammer_stat = hammer_thr ? HAMMER_WAIT : HAMMER_OFF;
+    __enable_irq();
+ }
+
+//*************************************************************************************************
+// Возвращает состояние захвата и параметры сохраненного снимка переходного процесса давления
+//-------------------------------------------------------------------------------------------------
+// HAMMER_INFO *info - указатель на структуру для размещения параметров снимка
+// return HammerStat - состояние захвата
+//*************************************************************************************************
+HammerStat HammerInfo( HAMMER_INFO *info ) {
+
+    info->stat = hammer_stat;
+    info->chnl = hammer_chnl;
+    info->dtime = hammer_dtime;
+    info->delta = hammer_delta;
+    info->delta_ms = ( HAMMER_DIFF * 1000 + HAMMER_RATE / 2 ) / HAMMER_RATE;
+    info->rate = HAMMER_RATE;
+    return info->stat;
+ }
+
+//*************************************************************************************************
+// Возвращает значение давления выборки сохраненного снимка переходного процесса
+//-------------------------------------------------------------------------------------------------
+// Water chnl   - канал: холодная/горячая вода
+// uint16_t idx - номер выборки снимка: 0 - первая, HAMMER_PRE_TRIG - выборка события
+// return       - давление (атм * 100), "0" - снимка нет или номер выборки за пределами снимка
+//*************************************************************************************************
+uint16_t HammerValue( Water chnl, uint16_t idx ) {
+
+    if ( hammer_stat != HAMMER_READY || idx >= HAMMER_SAMPLES || chnl >= ADC_CHANNELS )
+        return 0;
+    return PressValue( hammer_buff[( hammer_start + idx ) % HAMMER_SAMPLES][chnl] );
+ }
+
+//*************************************************************************************************
+// Обработка события сторожевого таймера АЦП, вызывается из прерывания АЦП. Прерывание
+// сторожевого таймера запрещается: при непрерывном преобразовании событие повторяется
+// для каждой выборки за пределами порогов. Разрешение прерывания выполняет PressAlarm().
+//*************************************************************************************************
+void WaterAdcAlarm( void ) {
+
+    __HAL_ADC_DISABLE_IT( &hadc1, ADC_IT_AWD );
+    press_awd_arm = false;
+    press_awd_tick = DWT->CYCCNT;
+    osEventFlagsSet( water_event, EVN_WTR_PRESS_ALARM );
+ }
+
+//*************************************************************************************************
+// Проверка выхода давления за аварийные пороги по последним выборкам АЦП (~1 мсек). При выходе
+// давления за пороги: запись события в журнал, при config.press_valve - закрытие крана.
+// При возврате давления в допустимый диапазон (с учетом гистерезиса) разрешается прерывание
+// сторожевого таймера АЦП. Одиночная выборка за порогами (импульсная помеха) событием не является.
+//-------------------------------------------------------------------------------------------------
+// bool awd - проверка по событию сторожевого таймера АЦП
+//*************************************************************************************************
+static void PressAlarm( bool awd ) {
+
+    uint8_t chnl, low, high, alarm = 0, fresh;
+    uint16_t value[ADC_CHANNELS];
+
+    if ( awd == true ) {
+        //задержка от прерывания АЦП до обработки события
+        press_lat_last = ( DWT->CYCCNT - press_awd_tick ) / ( SystemCoreClock / 1000000 );
+        if ( press_lat_last > press_lat_max )
+            press_lat_max = press_lat_last;
+       }
+    if ( press_awd_on == false )
+        return;
+    AdcRecent( value );
+    for ( chnl = 0; chnl < ADC_CHANNELS; chnl++ ) {
+        low = PRESS_ALARM_LOW_COLD << chnl;
+        high = PRESS_ALARM_HIGH_COLD << chnl;
+        if ( press_awd_low && value[chnl] < press_awd_low + ( press_alarm & low ? PRESS_AWD_HYST : 0 ) )
+            alarm |= low;
+        if ( press_awd_high < PRESS_AWD_MAX && value[chnl] + ( press_alarm & high ? PRESS_AWD_HYST : 0 ) > press_awd_high )
+            alarm |= high;
+       }
+    fresh = alarm & ~press_alarm;
+    press_alarm = alarm;
+    if ( fresh ) {
+        //новое событие
+        SaveData( EVENT_ALARM );
+        if ( config.press_valve ) {
+            if ( fresh & ( PRESS_ALARM_LOW_COLD | PRESS_ALARM_HIGH_COLD ) )
+                osEventFlagsSet( valve_event, EVN_VALVE_COLD_CLS );
+            if ( fresh & ( PRESS_ALARM_LOW_HOT | PRESS_ALARM_HIGH_HOT ) )
+                osEventFlagsSet( valve_event, EVN_VALVE_HOT_CLS );
+           }
+        #if defined( DEBUG_PRESSURE ) && defined( DEBUG_TARGET )
+        sprintf( str, "Pressure alarm: 0x%02X latency: %u us\r\n", fresh, press_lat_last );
+        UartSendStr( str );
+        #endif
+       }
+    if ( !alarm && press_awd_arm == false ) {
+        //давление в допустимом диапазоне, разрешение прерывания сторожевого таймера
+        press_awd_arm = true;
+        __HAL_ADC_CLEAR_FLAG( &hadc1, ADC_FLAG_AWD );
+        __HAL_ADC_ENABLE_IT( &hadc1, ADC_IT_AWD );
+       }
+ }
+
+//*************************************************************************************************
+// Расчет порогов и настройка аналогового сторожевого таймера АЦП. Пороги общие для обоих
+// каналов (сторожевой таймер контролирует все регулярные каналы).
+//-------------------------------------------------------------------------------------------------
+// PRESS_CAL *cal - указатель на таблицу калибровки
+// uint8_t cnt    - кол-во точек в таблице
+//*************************************************************************************************
+static void PressAlarmCfg( PRESS_CAL *cal, uint8_t cnt ) {
+
+    ADC_AnalogWDGConfTypeDef awd;
+
+    press_awd_low = 0;
+    press_awd_high = PRESS_AWD_MAX;
+    if ( cnt && config.press_low )
+        press_awd_low = ( (uint32_t)PressVolt( cal, cnt, config.press_low ) << ADC_RESULT_BITS ) / ADC_FULL_SCALE_MV;
+    if ( cnt && config.press_high )
+        press_awd_high = ( (uint32_t)PressVolt( cal, cnt, config.press_high ) << ADC_RESULT_BITS ) / ADC_FULL_SCALE_MV;
+    if ( press_awd_high > PRESS_AWD_MAX )
+        press_awd_high = PRESS_AWD_MAX;
+    press_awd_on = press_awd_low || press_awd_high < PRESS_AWD_MAX;
+    press_awd_arm = press_awd_on;
+    press_alarm = 0;
+    //настройка сторожевого таймера, пороги 12 бит
+    memset( &awd, 0x00, sizeof( awd ) );
+    awd.WatchdogMode = press_awd_on == true ? ADC_ANALOGWATCHDOG_ALL_REG : ADC_ANALOGWATCHDOG_NONE;
+    awd.ITMode = press_awd_on == true ? ENABLE : DISABLE;
+    awd.LowThreshold = press_awd_low >> ( ADC_RESULT_BITS - ADC_SAMPLE_BITS );
+    awd.HighThreshold = press_awd_high >> ( ADC_RESULT_BITS - ADC_SAMPLE_BITS );
+    __HAL_ADC_CLEAR_FLAG( &hadc1, ADC_FLAG_AWD );
+    HAL_ADC_AnalogWDGConfig( &hadc1, &awd );
+ }
+
+//*************************************************************************************************
+// Расчет напряжения датчика для заданного давления по таблице калибровки (обратный пересчет),
+// за пределами таблицы - напряжение крайней точки
+//-------------------------------------------------------------------------------------------------
+// PRESS_CAL *cal    - указатель на таблицу калибровки
+// uint8_t cnt       - кол-во точек в таблице
+// uint16_t pressure - давление (атм * 100)
+// return            - напряжение на выходе датчика (мВ)
+//*************************************************************************************************
+static uint16_t PressVolt( PRESS_CAL *cal, uint8_t cnt, uint16_t pressure ) {
+
+    uint8_t idx;
+    int32_t delta;
+
+    if ( pressure <= cal[0].pressure )
+        return cal[0].volt;
+    for ( idx = 1; idx < cnt; idx++ ) {
+        if ( pressure > cal[idx].pressure )
+            continue;
+        delta = (int32_t)( cal[idx].volt - cal[idx - 1].volt ) * ( pressure - cal[idx - 1].pressure );
+        delta /= (int32_t)( cal[idx].pressure - cal[idx - 1].pressure );
+        return (uint16_t)( cal[idx - 1].volt + delta );
+       }
+    return cal[cnt - 1].volt;
+ }
+
+//*************************************************************************************************
+// Значения АЦП по последним HAMMER_DECIM выборкам перед текущей позицией записи DMA
+//-------------------------------------------------------------------------------------------------
+// uint16_t *value - указатель на массив для размещения значений по каналам (15 бит)
+//*************************************************************************************************
+static void AdcRecent( uint16_t *value ) {
+
+    uint8_t chnl;
+    uint16_t idx, pos, pair, *ptr;
+    uint32_t sum[ADC_CHANNELS];
+
+    ptr = &adc_buff[0][0][0];
+    //номер пары выборок, которую записывает DMA
+    pos = ( sizeof( adc_buff ) / sizeof( uint16_t ) - __HAL_DMA_GET_COUNTER( hadc1.DMA_Handle ) ) / ADC_CHANNELS;
+    sum[WATER_COLD] = sum[WATER_HOT] = 0;
+    for ( idx = 1; idx <= HAMMER_DECIM; idx++ ) {
+        pair = ( pos + ADC_BUFF_PAIRS - idx ) % ADC_BUFF_PAIRS;
+        sum[WATER_COLD] += ptr[pair * ADC_CHANNELS + WATER_COLD];
+        sum[WATER_HOT] += ptr[pair * ADC_CHANNELS + WATER_HOT];
+       }
+    for ( chnl = 0; chnl < ADC_CHANNELS; chnl++ )
+        value[chnl] = (uint16_t)( sum[chnl] >> HAMMER_DECIM_SHIFT );
+ }
+
+//*************************************************************************************************
+// Возвращает признаки выхода давления за аварийные пороги
+//-------------------------------------------------------------------------------------------------
+// return - маска PRESS_ALARM_*
+//*************************************************************************************************
+uint8_t PressAlarmStatus( void ) {
+
+    return press_alarm;
+ }
+
+//*************************************************************************************************
+// Возвращает расшифровку состояния аварийного контроля давления
+//-------------------------------------------------------------------------------------------------
+// char *str - указатель на строку для размещения результата
+// return    - указатель на строку с результатом
+//*************************************************************************************************
+char *PressAlarmDesc( char *str ) {
+
+    char *ptr;
+    uint8_t idx;
+
+    ptr = str;
+    if ( press_awd_on == false ) {
+        sprintf( ptr, "OFF" );
+        return str;
+       }
+    if ( !press_alarm )
+        ptr += sprintf( ptr, "OK" );
+    for ( idx = 0; idx < 4; idx++ )
+        if ( press_alarm & ( 1 << idx ) )
+            ptr += sprintf( ptr, "%s%s", ptr != str ? " " : "", alarm_name[idx] );
+    if ( press_lat_max )
+        sprintf( ptr, " (latency %u/%u us)", press_lat_last, press_lat_max );
+    return str;
  }
@@ -7,6 +7,7 @@
 
 #include "water.h"
 #include "valve.h"
+#include "xtime.h"
 
 //Источник давления
 typedef enum {
@@ -40,12 +41,46 @@ typedef enum {
     LEAK2                                   //датчик 2
  } LeakType;
 
+//Маски признаков непрерывного расхода воды (микро-утечки) по счетчикам
+#define FLOW_LEAK_COLD          0x01        //холодная вода
+#define FLOW_LEAK_HOT           0x02        //горячая вода
+#define FLOW_LEAK_FILTER        0x04        //питьевая вода
+
+//Маски признаков выхода давления за аварийные пороги
+#define PRESS_ALARM_LOW_COLD    0x01        //низкое давление холодной воды
+#define PRESS_ALARM_LOW_HOT     0x02        //низкое давление горячей воды
+#define PRESS_ALARM_HIGH_COLD   0x04        //высокое давление холодной воды
+#define PRESS_ALARM_HIGH_HOT    0x08        //высокое давление горячей воды
+
+//Параметры захвата переходных процессов давления (гидроудар)
+#define HAMMER_SAMPLES          256         //кол-во выборок в снимке (по каждому каналу)
+#define HAMMER_PRE_TRIG         64          //кол-во выборок до события, индекс выборки события
+
+//Состояние захвата переходных процессов давления
+typedef enum {
+    HAMMER_OFF,                             //захват отключен
+    HAMMER_WAIT,                            //ожидание события
+    HAMMER_CAPTURE,                         //запись выборок после события
+    HAMMER_READY                            //снимок сохранен
+ } HammerStat;
+
 //Тип данных
 typedef enum {
     EVENT_DATA,                             //интервальные данные
     EVENT_ALARM                             //событие утечки
  } EventType;
 
+//Индексы счетчиков статистики кэширования текущих данных
+typedef enum {
+    CACHE_STAT_WRITE,                       //кол-во записей текущих данных в FRAM
+    CACHE_STAT_SKIP,                        //кол-во изменений данных без записи в FRAM
+    CACHE_STAT_BYTES,                       //кол-во байт не переданных по I2C
+    CACHE_STAT_RISK,                        //объем воды (литры) не сохраненный в FRAM
+    CACHE_STAT_RISK_MAX,                    //макс. объем воды (литры) не сохраненный в FRAM
+    CACHE_STAT_TIME_MAX,                    //макс. время (сек) хранения изменений только в RAM
+    CACHE_STAT_CNT                          //кол-во счетчиков статистики
+ } CacheStat;
+
 #pragma pack( push, 1 )
 
 //структура для хранения текущих значений счетчиков расхода воды
@@ -53,8 +88,8 @@ typedef struct {
     uint32_t    count_cold;                 //значения счетчика холодной воды
     uint32_t    count_hot;                  //значения счетчика горячей воды
     uint32_t    count_filter;               //значения счетчика питьевой воды
-    uint16_t    reserv;                     //резерв
-    uint16_t    next_addr;                  //адрес в FRAM для записи следующего события в журнал
+    uint16_t    seq;                        //порядковый номер записи, выбор актуального блока из двух
+    uint16_t    next_addr;                  //адрес в FRAM текущего блока журнала
     //источник сброса и дата/время включения контроллера
     uint8_t     res_src;                    //источник сброса
     uint8_t     day;                        //день
@@ -63,6 +98,8 @@ typedef struct {
     uint8_t     hour;                       //часы
     uint8_t     min;                        //минуты
     uint8_t	    sec;                        //секунды
+    uint32_t    log_time;                   //время последней записи интервальных данных в журнал
+                                            //(сек от 01.01.1970), "0" - нет данных
  } CURR_DATA;
 
 //структура для хранения интервальных значений: счетчиков, давления, датчиков утечки
@@ -88,18 +125,44 @@ typedef struct {
     uint16_t    pressr_hot;                 //давление горячей воды
     LeakStat    leak1 : 1;                  //состояние датчика утечки #1
     LeakStat    leak2 : 1;                  //состояние датчика утечки #2
-    unsigned    reserv : 4;                 //резерв
+    unsigned    flow_leak : 3;              //непрерывный расход (микро-утечка) по счетчикам, маска FLOW_LEAK_*
+    unsigned    reserv : 1;                 //резерв
     EventType   type_event : 1;             //признак данных: данные/событие
     DC12VStat   dc12_chk : 1;               //контроль напряжения 12VDС для питания датчиков утечки
+    uint32_t    seq;                        //порядковый номер записи журнала, присваивается при записи
+                                            //в FRAM, "0" - запись без номера (до введения номеров)
  } WATER_LOG;
 
 #pragma pack( pop )
 
+//параметры снимка переходного процесса давления
+typedef struct {
+    HammerStat  stat;                       //состояние захвата
+    Water       chnl;                       //канал, по которому сработал захват
+    DATE_TIME   dtime;                      //дата/время события
+    uint16_t    delta;                      //изменение давления за интервал расчета (атм * 100)
+    uint16_t    delta_ms;                   //интервал расчета изменения давления (мсек)
+    uint16_t    rate;                       //частота выборок (Гц)
+ } HAMMER_INFO;
+
 //*************************************************************************************************
 // Функции управления
 //*************************************************************************************************
 void WaterInit( void );
 LeakStat LeakStatus( LeakType type );
 DC12VStat DC12VStatus( void );
+void WaterPulse( CountType type );
+void WaterFlush( void );
+char *WaterCacheDesc( CacheStat index, char *str );
+void WaterPressCfg( void );
+void WaterAdcComplt( uint8_t part );
+void WaterAdcAlarm( void );
+uint8_t PressAlarmStatus( void );
+char *PressAlarmDesc( char *str );
+uint8_t FlowLeakStatus( void );
+char *FlowLeakDesc( CountType type, char *str );
+HammerStat HammerInfo( HAMMER_INFO *info );
+uint16_t HammerValue( Water chnl, uint16_t idx );
+void HammerClear( void );
 
 #endif 
@@ -15,6 +15,7 @@
 
 #include "main.h"
 #include "xtime.h"
+#include "events.h"
 
 #include <stm32f1xx_hal_rtc.h>
 
@@ -45,9 +46,6 @@ static char * const dows_short[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "
 //*************************************************************************************************
 // Прототипы локальных функций
 //*************************************************************************************************
-static void SecToDtime( uint32_t secsarg, DATE_TIME *ptr );
-static uint32_t DtimeToSec( DATE_TIME *ptr );
-
 static ErrorStatus RTC_EnterInitMode( RTC_HandleTypeDef *hrtc ); 
 static ErrorStatus RTC_ExitInitMode( RTC_HandleTypeDef *hrtc );
 
@@ -66,6 +64,49 @@ void GetTimeDate( DATE_TIME *ptr ) {
     SecToDtime( secsarg, ptr );
  }
 
+//*************************************************************************************************
+// Возвращает текущее значение счетчика RTC без преобразования в дата/время
+//-------------------------------------------------------------------------------------------------
+// return - кол-во секунд прошедших от 01.01.1970
+//*************************************************************************************************
+uint32_t GetTimeSec( void ) {
+
+    uint32_t high, low;
+
+    do {
+        high = READ_REG( hrtc.Instance->CNTH & RTC_CNTH_RTC_CNT );
+        low = READ_REG( hrtc.Instance->CNTL & RTC_CNTL_RTC_CNT );
+       } while ( high != READ_REG( hrtc.Instance->CNTH & RTC_CNTH_RTC_CNT ) );
+    return ( high << 16 ) | low;
+ }
+
+//*************************************************************************************************
+// Установка будильника RTC, при совпадении счетчика RTC со значением будильника
+// вызывается HAL_RTC_AlarmAEventCallback()
+//-------------------------------------------------------------------------------------------------
+// uint32_t secs    - значение счетчика RTC (кол-во секунд прошедших от 01.01.1970)
+// return = SUCCESS - будильник установлен
+//          ERROR   - ошибка инициализации RTC
+//*************************************************************************************************
+ErrorStatus SetAlarm( uint32_t secs ) {
+
+    ErrorStatus status = SUCCESS;
+
+    __HAL_RTC_ALARM_DISABLE_IT( &hrtc, RTC_IT_ALRA );
+    if ( RTC_EnterInitMode( &hrtc ) != SUCCESS ) 
+        status = ERROR;
+    else {
+        WRITE_REG( hrtc.Instance->ALRH, ( secs >> 16 ) );
+        WRITE_REG( hrtc.Instance->ALRL, ( secs & RTC_ALRL_RTC_ALR ) );
+        if ( RTC_ExitInitMode( &hrtc ) != SUCCESS )
+            status = ERROR;
+       }
+    //прерывание от будильника обрабатывается в общем прерывании RTC (RTC_IRQHandler)
+    __HAL_RTC_ALARM_CLEAR_FLAG( &hrtc, RTC_FLAG_ALRAF );
+    __HAL_RTC_ALARM_ENABLE_IT( &hrtc, RTC_IT_ALRA );
+    return status;
+ }
+
 //*************************************************************************************************
 // Устанавливает новое значение дата/время
 //-------------------------------------------------------------------------------------------------
@@ -93,6 +134,9 @@ ErrorStatus SetTimeDate( DATE_TIME *ptr ) {
         if ( RTC_ExitInitMode( &hrtc ) != HAL_OK )
             status = ERROR;
        }
+    //пересчет времени следующей записи в журнал
+    if ( status == SUCCESS )
+        osEventFlagsSet( water_event, EVN_WTR_SCHED );
     return status;
     
  }
@@ -103,7 +147,7 @@ ErrorStatus SetTimeDate( DATE_TIME *ptr ) {
 // uint32_t secsarg - кол-во секунд прошедших от TBIAS_YEAR года
 // struct tm *ptr   - указатель на структуру содежащую значение дата/время после расчета 
 //*************************************************************************************************
-static void SecToDtime( uint32_t secsarg, DATE_TIME *ptr ) {
+void SecToDtime( uint32_t secsarg, DATE_TIME *ptr ) {
 
     uint32_t i, secs, days, mon, year;
     const uint16_t *pm;
@@ -135,7 +179,7 @@ static void SecToDtime( uint32_t secsarg, DATE_TIME *ptr ) {
 // struct timedate *ptr - структура содежащая текущее значение время-дата
 // return               - значение кол-ва секунд
 //*************************************************************************************************
-static uint32_t DtimeToSec( DATE_TIME *ptr ) {
+uint32_t DtimeToSec( DATE_TIME *ptr ) {
 
     uint32_t days, secs, mon, year;
  
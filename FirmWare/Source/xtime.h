@@ -32,6 +32,10 @@ typedef struct {
 // Функции управления
 //*************************************************************************************************
 void GetTimeDate( DATE_TIME *ptr );
+uint32_t GetTimeSec( void );
+uint32_t DtimeToSec( DATE_TIME *ptr );
+void SecToDtime( uint32_t secsarg, DATE_TIME *ptr );
+ErrorStatus SetAlarm( uint32_t secs );
 ErrorStatus SetTimeDate( DATE_TIME *ptr );
 uint8_t DayOfWeek( uint8_t day, uint8_t month, uint16_t year );
 ErrorStatus TimeSet( char *time );
@@ -132,7 +132,9 @@ static char * const desc_pack[] = {
     "PACK_REQ_VALVE",
     "PACK_REQ_DATA",
     "PACK_CTRL_VALVE",
-    "PACK_ACK"
+    "PACK_ACK",
+    "PACK_REQ_ROLL",
+    "PACK_ROLL"
  };
 
 #endif
@@ -316,6 +318,13 @@ static void TaskZBCtrl( void *pvParameters ) {
                 UartSendStr( str );
                 osEventFlagsSet( cmnd_event, EVN_CMND_PROMPT );
                }
+            //мгновенный расход воды - отдельный пакет, формат ZB_PACK_DATA не изменяется
+            data = CreatePack( ZB_PACK_FLOW, &len, NULL );
+            if ( data != NULL ) {
+                state = ZBSendPack( data, len, TIME_NOWAIT_ACK );
+                sprintf( str, "Send flow rate: %s\r\n", ZBErrDesc( state ) );
+                UartSendStr( str );
+               }
            }
         if ( event & EVN_ZC_SEND_WLOG ) {
             //журнальные данные расхода/давления/утечки воды
@@ -357,6 +366,16 @@ static void TaskZBCtrl( void *pvParameters ) {
                 osEventFlagsSet( cmnd_event, EVN_CMND_PROMPT );
                }
            }
+        if ( event & EVN_ZC_SEND_ROLL ) {
+            //итоги расхода воды за период
+            data = CreatePack( ZB_PACK_ROLL, &len, NULL );
+            if ( data != NULL ) {
+                state = ZBSendPack( data, len, TIME_NOWAIT_ACK );
+                sprintf( str, "Send rollup: %s\r\n", ZBErrDesc( state ) );
+                UartSendStr( str );
+                osEventFlagsSet( cmnd_event, EVN_CMND_PROMPT );
+               }
+           }
         if ( event & EVN_ZC_SYNC_DTIME ) {
             //синхронизация даты/времени
             ptr_dtime = GetAddrDtime();
@@ -0,0 +1,38 @@
+//*************************************************************************************************
+//
+// Заглушка заголовка CMSIS-RTOS2 для сборки тестов на host (только типы и функции, используемые
+// тестируемыми модулями, функции реализуются в тестах)
+//
+//*************************************************************************************************
+
+#ifndef __CMSIS_OS2_H
+#define __CMSIS_OS2_H
+
+#include <stdint.h>
+
+#define osWaitForever       0xFFFFFFFFU
+
+typedef void *osSemaphoreId_t;
+
+typedef enum {
+    osOK                    =  0,
+    osError                 = -1,
+    osErrorTimeout          = -2,
+    osErrorResource         = -3,
+    osErrorParameter        = -4
+ } osStatus_t;
+
+typedef struct {
+    const char *name;
+    uint32_t attr_bits;
+    void *cb_mem;
+    uint32_t cb_size;
+ } osSemaphoreAttr_t;
+
+osSemaphoreId_t osSemaphoreNew( uint32_t max_count, uint32_t initial_count, const osSemaphoreAttr_t *attr );
+osStatus_t osSemaphoreAcquire( osSemaphoreId_t semaphore_id, uint32_t timeout );
+osStatus_t osSemaphoreRelease( osSemaphoreId_t semaphore_id );
+osStatus_t osDelay( uint32_t ticks );
+uint32_t osKernelGetTickCount( void );
+
+#endif
@@ -0,0 +1,41 @@
+//*************************************************************************************************
+//
+// Заглушка заголовка CMSIS для сборки тестов на host (только типы, используемые модулями)
+//
+//*************************************************************************************************
+
+#ifndef __STM32F1XX_H
+#define __STM32F1XX_H
+
+#include <stdint.h>
+
+typedef enum { RESET = 0, SET = !RESET } FlagStatus, ITStatus;
+typedef enum { SUCCESS = 0, ERROR = !SUCCESS } ErrorStatus;
+
+//Счетчик тактов ядра: значение CYCCNT формирует тест при каждом обращении к DWT (HostDWT())
+typedef struct {
+    volatile uint32_t CTRL;
+    volatile uint32_t CYCCNT;
+ } DWT_Type;
+
+typedef struct {
+    volatile uint32_t DEMCR;
+ } CoreDebug_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk          0x00000001U
+#define CoreDebug_DEMCR_TRCENA_Msk      0x01000000U
+
+#define DWT                             HostDWT()
+#define CoreDebug                       ( &host_core_debug )
+
+//Запрет/разрешение прерываний: HostIrqDisable()/HostIrqEnable() реализуются в тесте
+#define __disable_irq()                 HostIrqDisable()
+#define __enable_irq()                  HostIrqEnable()
+
+DWT_Type *HostDWT( void );
+void HostIrqDisable( void );
+void HostIrqEnable( void );
+extern CoreDebug_Type host_core_debug;
+extern uint32_t SystemCoreClock;
+
+#endif
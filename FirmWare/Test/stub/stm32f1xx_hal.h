@@ -0,0 +1,97 @@
+//*************************************************************************************************
+//
+// Заглушка заголовка HAL для сборки тестов на host (только типы, константы и функции,
+// используемые тестируемыми модулями, функции реализуются в тестах)
+//
+//*************************************************************************************************
+
+#ifndef __STM32F1XX_HAL_H
+#define __STM32F1XX_HAL_H
+
+#include "stm32f1xx.h"
+
+typedef enum {
+    HAL_OK                      = 0x00U,
+    HAL_ERROR                   = 0x01U,
+    HAL_BUSY                    = 0x02U,
+    HAL_TIMEOUT                 = 0x03U
+ } HAL_StatusTypeDef;
+
+//GPIO
+typedef struct {
+    volatile uint32_t ODR;
+ } GPIO_TypeDef;
+
+typedef enum {
+    GPIO_PIN_RESET = 0,
+    GPIO_PIN_SET
+ } GPIO_PinState;
+
+typedef struct {
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+ } GPIO_InitTypeDef;
+
+#define GPIO_PIN_0                      ( (uint16_t)0x0001 )
+#define GPIO_PIN_1                      ( (uint16_t)0x0002 )
+#define GPIO_PIN_2                      ( (uint16_t)0x0004 )
+#define GPIO_PIN_3                      ( (uint16_t)0x0008 )
+#define GPIO_PIN_4                      ( (uint16_t)0x0010 )
+#define GPIO_PIN_5                      ( (uint16_t)0x0020 )
+#define GPIO_PIN_6                      ( (uint16_t)0x0040 )
+#define GPIO_PIN_7                      ( (uint16_t)0x0080 )
+
+#define GPIO_MODE_OUTPUT_OD             0x00000011U
+#define GPIO_NOPULL                     0x00000000U
+#define GPIO_SPEED_FREQ_HIGH            0x00000003U
+
+#define GPIOA                           ( &host_gpio[0] )
+#define GPIOB                           ( &host_gpio[1] )
+#define GPIOC                           ( &host_gpio[2] )
+
+extern GPIO_TypeDef host_gpio[3];
+
+void HAL_GPIO_Init( GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init );
+GPIO_PinState HAL_GPIO_ReadPin( GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin );
+void HAL_GPIO_WritePin( GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState );
+
+//I2C
+typedef struct {
+    volatile uint32_t CR1;
+ } I2C_TypeDef;
+
+typedef struct {
+    I2C_TypeDef *Instance;
+    volatile uint32_t ErrorCode;
+ } I2C_HandleTypeDef;
+
+#define HAL_I2C_ERROR_NONE              0x00000000U
+#define HAL_I2C_ERROR_BERR              0x00000001U
+#define HAL_I2C_ERROR_ARLO              0x00000002U
+#define HAL_I2C_ERROR_AF                0x00000004U
+#define HAL_I2C_ERROR_OVR               0x00000008U
+#define HAL_I2C_ERROR_DMA               0x00000010U
+#define HAL_I2C_ERROR_TIMEOUT           0x00000020U
+#define HAL_I2C_ERROR_SIZE              0x00000040U
+#define HAL_I2C_ERROR_DMA_PARAM         0x00000080U
+#define HAL_I2C_WRONG_START             0x00000200U
+
+#define I2C_MEMADD_SIZE_16BIT           0x00000010U
+#define I2C_CR1_SWRST                   0x00008000U
+
+#define __HAL_RCC_I2C1_CLK_ENABLE()     do { } while ( 0 )
+
+HAL_StatusTypeDef HAL_I2C_Init( I2C_HandleTypeDef *hi2c );
+HAL_StatusTypeDef HAL_I2C_DeInit( I2C_HandleTypeDef *hi2c );
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA( I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                        uint16_t MemAddSize, uint8_t *pData, uint16_t Size );
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA( I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                         uint16_t MemAddSize, uint8_t *pData, uint16_t Size );
+void HAL_I2C_MemTxCpltCallback( I2C_HandleTypeDef *hi2c );
+void HAL_I2C_MemRxCpltCallback( I2C_HandleTypeDef *hi2c );
+void HAL_I2C_ErrorCallback( I2C_HandleTypeDef *hi2c );
+void HAL_I2C_AbortCpltCallback( I2C_HandleTypeDef *hi2c );
+
+#endif
@@ -0,0 +1,512 @@
+//*************************************************************************************************
+//
+// Тест обмена с FRAM по шине I2C (i2cbus.c) с имитацией неисправного ведомого устройства:
+// нет подтверждения, ошибка шины, занятая периферия, нет ответа, запоздавшее завершение
+// операции, удержание SDA ведомым устройством
+//
+//*************************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cmsis_os2.h"
+
+#include "main.h"
+#include "i2cbus.h"
+
+//*************************************************************************************************
+// Локальные константы
+//*************************************************************************************************
+#define TEST_DEV_ADDR       0xA0                //адрес микросхемы
+#define TEST_MEM_SIZE       0x10000             //размер памяти ведомого устройства
+#define TEST_FAULT_MAX      16                  //макс. кол-во операций сценария
+#define TEST_DELAY_MAX      16                  //макс. кол-во пауз между повторами
+
+#define I2C_SCL_PIN         GPIO_PIN_6          //вывод SCL (как в i2cbus.c)
+#define I2C_SDA_PIN         GPIO_PIN_7          //вывод SDA (как в i2cbus.c)
+
+#define CHECK( cond )       do { if ( !( cond ) ) { printf( "FAIL %s:%d: %s\r\n", __FILE__, __LINE__, #cond ); fails++; } } while ( 0 )
+
+//Поведение ведомого устройства при выполнении операции
+typedef enum {
+    FAULT_NONE,                                 //операция выполняется
+    FAULT_NACK,                                 //нет подтверждения адреса
+    FAULT_BUSY,                                 //периферия I2C занята (флаг BUSY)
+    FAULT_BERR,                                 //ошибка шины во время передачи данных
+    FAULT_SILENT,                               //операция не завершается
+    FAULT_LATE                                  //операция не завершается, завершение
+                                                //прерывания приходит при сбросе I2C
+ } Fault;
+
+//*************************************************************************************************
+// Переменные, используемые i2cbus.c
+//*************************************************************************************************
+I2C_HandleTypeDef hi2c1;
+GPIO_TypeDef host_gpio[3];
+CoreDebug_Type host_core_debug;
+uint32_t SystemCoreClock = 72000000;
+
+//*************************************************************************************************
+// Локальные переменные
+//*************************************************************************************************
+static uint32_t fails;
+static I2C_TypeDef i2c_regs;
+static DWT_Type dwt;
+
+static uint8_t memory[TEST_MEM_SIZE];       //память ведомого устройства
+static Fault fault[TEST_FAULT_MAX];         //сценарий: поведение для каждой следующей операции
+static uint8_t fault_cnt, fault_pos;
+static uint32_t sem_cnt;                    //семафор завершения операции
+static bool late;                           //ожидается запоздавшее завершение операции
+static uint32_t delay[TEST_DELAY_MAX];      //паузы между повторами (ms)
+static uint8_t delay_cnt;
+static uint32_t wait_ms;                    //суммарное время ожидания завершения операций
+static uint32_t sda_hold;                   //кол-во тактов SCL удержания SDA ведомым устройством
+static bool scl, sda;                       //уровни SCL, SDA, формируемые контроллером
+static uint32_t clocks, stops, inits, uart_msg;
+
+//*************************************************************************************************
+// Прототипы локальные функций
+//*************************************************************************************************
+static HAL_StatusTypeDef Transfer( bool read, uint16_t addr, uint8_t *data, uint16_t len );
+static void Scenario( Fault f0, Fault f1, Fault f2, Fault f3 );
+static uint32_t Stat( I2CStat index );
+static void StatSave( uint32_t *stat );
+static uint32_t StatDiff( uint32_t *stat, I2CStat index );
+static void TestNormal( void );
+static void TestNack( void );
+static void TestBusError( void );
+static void TestBusy( void );
+static void TestTimeout( void );
+static void TestLate( void );
+static void TestStuckSda( void );
+
+//*************************************************************************************************
+// Выполнение тестов, код возврата - кол-во ошибок
+//*************************************************************************************************
+int main( void ) {
+
+    uint32_t i;
+
+    for ( i = 0; i < TEST_MEM_SIZE; i++ )
+        memory[i] = (uint8_t)( i * 7 + 3 );
+    hi2c1.Instance = &i2c_regs;
+    scl = sda = true;
+    I2CBusInit();
+    CHECK( Stat( I2C_STAT_RECOVERY ) == 0 );
+    TestNormal();
+    TestNack();
+    TestBusError();
+    TestBusy();
+    TestTimeout();
+    TestLate();
+    TestStuckSda();
+    printf( "i2cbus: %s (%u errors)\r\n", fails ? "FAIL" : "OK", fails );
+    return fails ? 1 : 0;
+ }
+
+//*************************************************************************************************
+// Исправное устройство: запись и чтение без повторов и восстановления шины
+//*************************************************************************************************
+static void TestNormal( void ) {
+
+    uint8_t wr[64], rd[64];
+    uint32_t stat[I2C_STAT_CNT];
+
+    memset( wr, 0x5A, sizeof( wr ) );
+    StatSave( stat );
+    Scenario( FAULT_NONE, FAULT_NONE, FAULT_NONE, FAULT_NONE );
+    CHECK( I2CWrite( TEST_DEV_ADDR, 0x0100, wr, sizeof( wr ) ) == FRAM_OK );
+    CHECK( I2CRead( TEST_DEV_ADDR, 0x0100, rd, sizeof( rd ) ) == FRAM_OK );
+    CHECK( !memcmp( wr, rd, sizeof( wr ) ) );
+    CHECK( StatDiff( stat, I2C_STAT_WRITE ) == 1 );
+    CHECK( StatDiff( stat, I2C_STAT_READ ) == 1 );
+    CHECK( StatDiff( stat, I2C_STAT_RETRY ) == 0 );
+    CHECK( StatDiff( stat, I2C_STAT_RECOVERY ) == 0 );
+    CHECK( delay_cnt == 0 && uart_msg == 0 );
+ }
+
+//*************************************************************************************************
+// Нет подтверждения: повторы с паузой 1, 2 ms и успешное чтение, после 3 повторов (паузы 1, 2,
+// 4 ms) - ошибка с выводом расшифровки, восстановление шины не выполняется
+//*************************************************************************************************
+static void TestNack( void ) {
+
+    uint8_t rd[16];
+    uint32_t stat[I2C_STAT_CNT];
+
+    StatSave( stat );
+    Scenario( FAULT_NACK, FAULT_NACK, FAULT_NONE, FAULT_NONE );
+    CHECK( I2CRead( TEST_DEV_ADDR, 0x0200, rd, sizeof( rd ) ) == FRAM_OK );
+    CHECK( !memcmp( rd, memory + 0x0200, sizeof( rd ) ) );
+    CHECK( StatDiff( stat, I2C_STAT_NACK ) == 2 );
+    CHECK( StatDiff( stat, I2C_STAT_RETRY ) == 2 );
+    CHECK( StatDiff( stat, I2C_STAT_RECOVERY ) == 0 );
+    CHECK( delay_cnt == 2 && delay[0] == 1 && delay[1] == 2 );
+
+    StatSave( stat );
+    Scenario( FAULT_NACK, FAULT_NACK, FAULT_NACK, FAULT_NACK );
+    CHECK( I2CRead( TEST_DEV_ADDR, 0x0200, rd, sizeof( rd ) ) == FRAM_ERROR );
+    CHECK( fault_pos == I2C_RETRY_MAX + 1 );
+    CHECK( StatDiff( stat, I2C_STAT_NACK ) == I2C_RETRY_MAX + 1 );
+    CHECK( StatDiff( stat, I2C_STAT_FAIL ) == 1 );
+    CHECK( StatDiff( stat, I2C_STAT_RECOVERY ) == 0 );
+    CHECK( delay_cnt == 3 && delay[0] == 1 && delay[1] == 2 && delay[2] == 4 );
+    CHECK( uart_msg == 1 );
+ }
+
+//*************************************************************************************************
+// Ошибка шины во время записи (записана часть данных): восстановление шины и повтор записи
+//*************************************************************************************************
+static void TestBusError( void ) {
+
+    uint8_t wr[32];
+    uint32_t stat[I2C_STAT_CNT], i;
+
+    for ( i = 0; i < sizeof( wr ); i++ )
+        wr[i] = (uint8_t)~i;
+    StatSave( stat );
+    Scenario( FAULT_BERR, FAULT_NONE, FAULT_NONE, FAULT_NONE );
+    CHECK( I2CWrite( TEST_DEV_ADDR, 0x0300, wr, sizeof( wr ) ) == FRAM_OK );
+    CHECK( !memcmp( wr, memory + 0x0300, sizeof( wr ) ) );
+    CHECK( StatDiff( stat, I2C_STAT_BUS ) == 1 );
+    CHECK( StatDiff( stat, I2C_STAT_RECOVERY ) == 1 );
+    CHECK( StatDiff( stat, I2C_STAT_FAIL ) == 0 );
+    CHECK( inits == 1 );
+ }
+
+//*************************************************************************************************
+// Периферия I2C занята (флаг BUSY не сбрасывается): восстановление шины и повтор операции
+//*************************************************************************************************
+static void TestBusy( void ) {
+
+    uint8_t rd[8];
+    uint32_t stat[I2C_STAT_CNT];
+
+    StatSave( stat );
+    Scenario( FAULT_BUSY, FAULT_NONE, FAULT_NONE, FAULT_NONE );
+    CHECK( I2CRead( TEST_DEV_ADDR, 0x0400, rd, sizeof( rd ) ) == FRAM_OK );
+    CHECK( StatDiff( stat, I2C_STAT_RECOVERY ) == 1 );
+    CHECK( StatDiff( stat, I2C_STAT_RETRY ) == 1 );
+ }
+
+//*************************************************************************************************
+// Нет ответа: ожидание ограничено временем передачи, шина восстанавливается один раз (в
+// I2CExec()), данные в буфер не передаются
+//*************************************************************************************************
+static void TestTimeout( void ) {
+
+    uint8_t rd[128];
+    uint32_t stat[I2C_STAT_CNT];
+
+    StatSave( stat );
+    Scenario( FAULT_SILENT, FAULT_NONE, FAULT_NONE, FAULT_NONE );
+    CHECK( I2CRead( TEST_DEV_ADDR, 0x0500, rd, sizeof( rd ) ) == FRAM_OK );
+    CHECK( !memcmp( rd, memory + 0x0500, sizeof( rd ) ) );
+    CHECK( StatDiff( stat, I2C_STAT_TIMEOUT ) == 1 );
+    CHECK( StatDiff( stat, I2C_STAT_RECOVERY ) == 1 );
+    //время ожидания: 5 ms + ( 128 + 4 ) * 9 тактов на 400 кГц
+    CHECK( wait_ms == 5 + ( 132 * 9 * 1000 ) / I2C_SPEED );
+    //время выполнения с учетом повтора
+    CHECK( Stat( I2C_STAT_RD_LAST ) >= ( wait_ms + 1 ) * 1000 );
+
+    //устройство не отвечает: ошибка после всех повторов
+    StatSave( stat );
+    Scenario( FAULT_SILENT, FAULT_SILENT, FAULT_SILENT, FAULT_SILENT );
+    memset( rd, 0xEE, sizeof( rd ) );
+    CHECK( I2CRead( TEST_DEV_ADDR, 0x0500, rd, sizeof( rd ) ) == FRAM_TIMEOUT );
+    CHECK( rd[0] == 0xEE && rd[sizeof( rd ) - 1] == 0xEE );
+    CHECK( StatDiff( stat, I2C_STAT_TIMEOUT ) == I2C_RETRY_MAX + 1 );
+    CHECK( StatDiff( stat, I2C_STAT_RECOVERY ) == I2C_RETRY_MAX + 1 );
+    CHECK( StatDiff( stat, I2C_STAT_FAIL ) == 1 );
+    CHECK( uart_msg == 1 );
+ }
+
+//*************************************************************************************************
+// Завершение прерванной операции приходит после превышения времени ожидания: семафор
+// сбрасывается перед следующей операцией, завершение не принимается за выполнение повтора
+//*************************************************************************************************
+static void TestLate( void ) {
+
+    uint8_t rd[8];
+    uint32_t stat[I2C_STAT_CNT];
+
+    StatSave( stat );
+    Scenario( FAULT_LATE, FAULT_SILENT, FAULT_NONE, FAULT_NONE );
+    CHECK( I2CRead( TEST_DEV_ADDR, 0x0600, rd, sizeof( rd ) ) == FRAM_OK );
+    CHECK( fault_pos == 3 );
+    CHECK( StatDiff( stat, I2C_STAT_TIMEOUT ) == 2 );
+ }
+
+//*************************************************************************************************
+// Ведомое устройство удерживает SDA (сброс контроллера во время чтения): при инициализации
+// SCL формируется до освобождения SDA, затем условие STOP; не более 9 тактов, если SDA не
+// освобождается; нет ответа во время чтения с удержанием SDA - восстановление и повтор
+//*************************************************************************************************
+static void TestStuckSda( void ) {
+
+    uint8_t rd[8];
+    uint32_t stat[I2C_STAT_CNT];
+
+    StatSave( stat );
+    sda_hold = 5;
+    clocks = stops = inits = 0;
+    I2CBusInit();
+    CHECK( clocks == 5 && sda_hold == 0 );
+    CHECK( stops == 1 && inits == 1 );
+    CHECK( StatDiff( stat, I2C_STAT_RECOVERY ) == 1 );
+    CHECK( !( i2c_regs.CR1 & I2C_CR1_SWRST ) );
+
+    sda_hold = 100;
+    clocks = 0;
+    I2CBusClear();
+    CHECK( clocks == 9 );
+    sda_hold = 0;
+
+    StatSave( stat );
+    Scenario( FAULT_SILENT, FAULT_NONE, FAULT_NONE, FAULT_NONE );
+    sda_hold = 3;
+    clocks = 0;
+    CHECK( I2CRead( TEST_DEV_ADDR, 0x0700, rd, sizeof( rd ) ) == FRAM_OK );
+    CHECK( !memcmp( rd, memory + 0x0700, sizeof( rd ) ) );
+    CHECK( clocks == 3 && sda_hold == 0 );
+    CHECK( StatDiff( stat, I2C_STAT_RECOVERY ) == 1 );
+ }
+
+//*************************************************************************************************
+// Установка сценария поведения ведомого устройства для следующих операций, сброс счетчиков
+//*************************************************************************************************
+static void Scenario( Fault f0, Fault f1, Fault f2, Fault f3 ) {
+
+    fault[0] = f0;
+    fault[1] = f1;
+    fault[2] = f2;
+    fault[3] = f3;
+    fault_cnt = 4;
+    fault_pos = 0;
+    delay_cnt = 0;
+    wait_ms = 0;
+    uart_msg = 0;
+    inits = 0;
+ }
+
+//*************************************************************************************************
+// Значение счетчика статистики обмена из расшифровки I2CStatDesc()
+//*************************************************************************************************
+static uint32_t Stat( I2CStat index ) {
+
+    char str[80], *ptr;
+
+    memset( str, 0x00, sizeof( str ) );
+    I2CStatDesc( index, str );
+    ptr = str + strlen( str );
+    while ( ptr > str && *( ptr - 1 ) == ' ' )
+        ptr--;
+    while ( ptr > str && *( ptr - 1 ) >= '0' && *( ptr - 1 ) <= '9' )
+        ptr--;
+    return strtoul( ptr, NULL, 10 );
+ }
+
+//*************************************************************************************************
+// Сохранение значений счетчиков статистики
+//*************************************************************************************************
+static void StatSave( uint32_t *stat ) {
+
+    uint8_t i;
+
+    for ( i = 0; i < I2C_STAT_CNT; i++ )
+        stat[i] = Stat( (I2CStat)i );
+ }
+
+//*************************************************************************************************
+// Изменение счетчика статистики с момента сохранения
+//*************************************************************************************************
+static uint32_t StatDiff( uint32_t *stat, I2CStat index ) {
+
+    return Stat( index ) - stat[index];
+ }
+
+//*************************************************************************************************
+// Выполнение операции ведомым устройством по сценарию
+//-------------------------------------------------------------------------------------------------
+// bool read     - чтение/запись
+// uint16_t addr - адрес в памяти
+// uint8_t *data - данные
+// uint16_t len  - кол-во байт
+//*************************************************************************************************
+static HAL_StatusTypeDef Transfer( bool read, uint16_t addr, uint8_t *data, uint16_t len ) {
+
+    Fault f;
+
+    CHECK( fault_pos < fault_cnt );
+    f = fault_pos < fault_cnt ? fault[fault_pos] : FAULT_NONE;
+    fault_pos++;
+    switch ( f ) {
+        case FAULT_NACK:
+            hi2c1.ErrorCode = HAL_I2C_ERROR_AF;
+            return HAL_ERROR;
+        case FAULT_BUSY:
+            hi2c1.ErrorCode = HAL_I2C_ERROR_NONE;
+            return HAL_BUSY;
+        case FAULT_BERR:
+            //передана часть данных
+            if ( !read )
+                memcpy( memory + addr, data, len / 2 );
+            hi2c1.ErrorCode = HAL_I2C_ERROR_BERR;
+            HAL_I2C_ErrorCallback( &hi2c1 );
+            return HAL_OK;
+        case FAULT_LATE:
+            late = true;
+            return HAL_OK;
+        case FAULT_SILENT:
+            return HAL_OK;
+        default:
+            hi2c1.ErrorCode = HAL_I2C_ERROR_NONE;
+            if ( read ) {
+                memcpy( data, memory + addr, len );
+                HAL_I2C_MemRxCpltCallback( &hi2c1 );
+               }
+            else {
+                memcpy( memory + addr, data, len );
+                HAL_I2C_MemTxCpltCallback( &hi2c1 );
+               }
+            return HAL_OK;
+       }
+ }
+
+//*************************************************************************************************
+// HAL: операции I2C
+//*************************************************************************************************
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA( I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                        uint16_t MemAddSize, uint8_t *pData, uint16_t Size ) {
+
+    CHECK( DevAddress == TEST_DEV_ADDR && MemAddSize == I2C_MEMADD_SIZE_16BIT );
+    return Transfer( true, MemAddress, pData, Size );
+ }
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA( I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                         uint16_t MemAddSize, uint8_t *pData, uint16_t Size ) {
+
+    CHECK( DevAddress == TEST_DEV_ADDR && MemAddSize == I2C_MEMADD_SIZE_16BIT );
+    return Transfer( false, MemAddress, pData, Size );
+ }
+
+HAL_StatusTypeDef HAL_I2C_DeInit( I2C_HandleTypeDef *hi2c ) {
+
+    //прерывание незавершенной операции
+    if ( late ) {
+        late = false;
+        hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+        HAL_I2C_AbortCpltCallback( hi2c );
+       }
+    return HAL_OK;
+ }
+
+HAL_StatusTypeDef HAL_I2C_Init( I2C_HandleTypeDef *hi2c ) {
+
+    inits++;
+    return HAL_OK;
+ }
+
+//*************************************************************************************************
+// HAL: выводы SCL, SDA; ведомое устройство освобождает SDA по фронту SCL
+//*************************************************************************************************
+void HAL_GPIO_Init( GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init ) {
+
+ }
+
+GPIO_PinState HAL_GPIO_ReadPin( GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin ) {
+
+    if ( GPIOx == GPIOB && GPIO_Pin == I2C_SDA_PIN )
+        return ( sda && !sda_hold ) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+    return GPIO_PIN_SET;
+ }
+
+void HAL_GPIO_WritePin( GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState ) {
+
+    bool level = ( PinState == GPIO_PIN_SET );
+
+    if ( GPIOx != GPIOB )
+        return;
+    if ( GPIO_Pin & I2C_SCL_PIN ) {
+        //такты освобождения шины формируются при SDA = "1" (при условии STOP SDA = "0")
+        if ( !scl && level && sda ) {
+            clocks++;
+            if ( sda_hold )
+                sda_hold--;
+           }
+        scl = level;
+       }
+    if ( GPIO_Pin & I2C_SDA_PIN ) {
+        //условие STOP: переход SDA из "0" в "1" при SCL = "1"
+        if ( !sda && level && scl && !sda_hold )
+            stops++;
+        sda = level;
+       }
+ }
+
+//*************************************************************************************************
+// CMSIS: счетчик тактов ядра увеличивается на 1 мкс при каждом чтении
+//*************************************************************************************************
+DWT_Type *HostDWT( void ) {
+
+    dwt.CYCCNT += SystemCoreClock / 1000000;
+    return &dwt;
+ }
+
+//*************************************************************************************************
+// RTOS: семафор завершения операции (завершение выполняется в функциях HAL до ожидания),
+// паузы учитываются в счетчике тактов
+//*************************************************************************************************
+static uint32_t sem_handle;
+
+osSemaphoreId_t osSemaphoreNew( uint32_t max_count, uint32_t initial_count, const osSemaphoreAttr_t *attr ) {
+
+    sem_cnt = initial_count;
+    return &sem_handle;
+ }
+
+osStatus_t osSemaphoreAcquire( osSemaphoreId_t semaphore_id, uint32_t timeout ) {
+
+    if ( sem_cnt ) {
+        sem_cnt--;
+        return osOK;
+       }
+    if ( !timeout )
+        return osErrorResource;
+    wait_ms += timeout;
+    dwt.CYCCNT += timeout * ( SystemCoreClock / 1000 );
+    return osErrorTimeout;
+ }
+
+osStatus_t osSemaphoreRelease( osSemaphoreId_t semaphore_id ) {
+
+    if ( sem_cnt )
+        return osErrorResource;
+    sem_cnt++;
+    return osOK;
+ }
+
+osStatus_t osDelay( uint32_t ticks ) {
+
+    if ( delay_cnt < TEST_DELAY_MAX )
+        delay[delay_cnt++] = ticks;
+    dwt.CYCCNT += ticks * ( SystemCoreClock / 1000 );
+    return osOK;
+ }
+
+//*************************************************************************************************
+// Вывод сообщения об ошибке (uart.c), расшифровка ошибки FRAM (fram.c)
+//*************************************************************************************************
+void UartSendStr( char *str ) {
+
+    uart_msg++;
+ }
+
+char *FramErrorDesc( FramStatus error ) {
+
+    return "FRAM error";
+ }
@@ -0,0 +1,321 @@
+//*************************************************************************************************
+//
+// Тест упаковки записей журнала (logpack.c): упаковка - распаковка опорных и разностных записей,
+// размер записей, ошибки формата, преобразование WATER_LOG <-> LOG_PACK
+//
+//*************************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "logpack.h"
+#include "xtime.h"
+
+//*************************************************************************************************
+// Локальные константы
+//*************************************************************************************************
+#define TEST_RECORDS        20000               //кол-во записей случайной последовательности
+#define TEST_SEG_DATA       28                  //размер данных блока сегмента (без заголовка)
+
+#define CHECK( cond )       do { if ( !( cond ) ) { printf( "FAIL %s:%d: %s\r\n", __FILE__, __LINE__, #cond ); fails++; } } while ( 0 )
+
+//*************************************************************************************************
+// Локальные переменные
+//*************************************************************************************************
+static uint32_t fails;
+static uint32_t rnd = 12345;
+
+//*************************************************************************************************
+// Прототипы локальные функций
+//*************************************************************************************************
+static uint32_t Random( void );
+static bool PackEqual( LOG_PACK *a, LOG_PACK *b );
+static void NextRecord( LOG_PACK *prev, LOG_PACK *rec, uint8_t mode );
+static void TestSequence( uint8_t mode );
+static void TestSize( void );
+static void TestFormat( void );
+static void TestConvert( void );
+
+//*************************************************************************************************
+// Дата/время в секундах от 01.01.1970 (в прошивке - xtime.c, использует RTC)
+//*************************************************************************************************
+uint32_t DtimeToSec( DATE_TIME *dtime ) {
+
+    struct tm tm;
+
+    memset( &tm, 0x00, sizeof( tm ) );
+    tm.tm_year = dtime->year - 1900;
+    tm.tm_mon = dtime->month - 1;
+    tm.tm_mday = dtime->day;
+    tm.tm_hour = dtime->hour;
+    tm.tm_min = dtime->min;
+    tm.tm_sec = dtime->sec;
+    return (uint32_t)timegm( &tm );
+ }
+
+//*************************************************************************************************
+// Преобразование секунд от 01.01.1970 в дату/время (в прошивке - xtime.c, использует RTC)
+//*************************************************************************************************
+void SecToDtime( uint32_t sec, DATE_TIME *dtime ) {
+
+    struct tm tm;
+    time_t time = sec;
+
+    gmtime_r( &time, &tm );
+    dtime->year = tm.tm_year + 1900;
+    dtime->month = tm.tm_mon + 1;
+    dtime->day = tm.tm_mday;
+    dtime->hour = tm.tm_hour;
+    dtime->min = tm.tm_min;
+    dtime->sec = tm.tm_sec;
+ }
+
+//*************************************************************************************************
+// Выполнение тестов, код возврата - кол-во ошибок
+//*************************************************************************************************
+int main( void ) {
+
+    uint8_t mode;
+
+    for ( mode = 0; mode < 4; mode++ )
+        TestSequence( mode );
+    TestSize();
+    TestFormat();
+    TestConvert();
+    printf( "logpack: %s (%u errors)\r\n", fails ? "FAIL" : "OK", fails );
+    return fails ? 1 : 0;
+ }
+
+//*************************************************************************************************
+// Последовательность записей упаковывается в сегменты по правилам LogSave() (блоки по 28 байт
+// данных, опорная запись в начале сегмента, запись не переходит в следующий блок), сегменты
+// распаковываются и сравниваются с исходными записями
+//-------------------------------------------------------------------------------------------------
+// uint8_t mode - характер изменений значений (см. NextRecord())
+//*************************************************************************************************
+static void TestSequence( uint8_t mode ) {
+
+    LOG_PACK prev, dec, *src;
+    uint8_t buff[4][TEST_SEG_DATA], cnt[4], blk, len, pos, size, i;
+    uint32_t idx, first, total, segs;
+    static LOG_PACK list[TEST_RECORDS];
+
+    memset( &prev, 0x00, sizeof( prev ) );
+    prev.seq = 1;
+    prev.time = 1700000000;
+    prev.count[0] = 123456;
+    prev.count[1] = 65432;
+    prev.count[2] = 1000;
+    prev.pressr[0] = 350;
+    prev.pressr[1] = 340;
+    list[0] = prev;
+    for ( idx = 1; idx < TEST_RECORDS; idx++ ) {
+        NextRecord( &list[idx - 1], &list[idx], mode );
+        list[idx].seq = list[idx - 1].seq + 1;
+       }
+    for ( idx = 0, total = 0, segs = 0; idx < TEST_RECORDS; segs++ ) {
+        //упаковка сегмента
+        memset( buff, 0x00, sizeof( buff ) );
+        memset( cnt, 0x00, sizeof( cnt ) );
+        first = idx;
+        blk = 0;
+        memcpy( buff[0], &list[idx], LOG_PACK_KEY_SIZE );
+        pos = LOG_PACK_KEY_SIZE;
+        cnt[0] = 1;
+        for ( idx++; idx < TEST_RECORDS && idx - first < 32; idx++ ) {
+            uint8_t dlt[LOG_PACK_MAX_SIZE];
+            len = LogPackDelta( &list[idx - 1], &list[idx], dlt );
+            CHECK( len >= 2 && len <= LOG_PACK_MAX_SIZE );
+            if ( pos + len > TEST_SEG_DATA ) {
+                if ( blk + 1 >= 4 || len > TEST_SEG_DATA )
+                    break;
+                blk++;
+                pos = 0;
+               }
+            memcpy( buff[blk] + pos, dlt, len );
+            pos += len;
+            cnt[blk]++;
+           }
+        //распаковка сегмента
+        src = &list[first];
+        memset( &dec, 0x00, sizeof( dec ) );
+        for ( blk = 0; blk < 4 && cnt[blk]; blk++ ) {
+            for ( i = 0, pos = 0; i < cnt[blk]; i++, pos += size ) {
+                size = LogUnpack( buff[blk] + pos, TEST_SEG_DATA - pos, !blk && !i, &dec );
+                CHECK( size != 0 );
+                if ( !size )
+                    return;
+                CHECK( PackEqual( &dec, src ) );
+                src++;
+                total++;
+               }
+           }
+        CHECK( src == &list[idx] );
+       }
+    CHECK( total == TEST_RECORDS );
+    printf( "sequence mode %u: %u records, %.1f records/segment\r\n", mode, total, (double)total / segs );
+ }
+
+//*************************************************************************************************
+// Размер разностных записей: запись без изменений, экстремальные приращения
+//*************************************************************************************************
+static void TestSize( void ) {
+
+    LOG_PACK prev, rec, dec;
+    uint8_t buff[LOG_PACK_MAX_SIZE], len;
+
+    memset( &prev, 0x00, sizeof( prev ) );
+    prev.time = 1700000000;
+    rec = prev;
+    rec.time += 3600;
+    //без изменений показаний: заголовок + приращение времени в минутах (1 байт)
+    len = LogPackDelta( &prev, &rec, buff );
+    CHECK( len == 2 );
+    //приращение времени не кратно минуте
+    rec.time = prev.time + 1;
+    len = LogPackDelta( &prev, &rec, buff );
+    CHECK( len == 2 );
+    //макс. размер: все поля изменены на предельные значения
+    rec.time = prev.time + 0x7FFFFFF1;
+    rec.count[0] = 0x80000000;
+    rec.count[1] = 0x7FFFFFFF;
+    rec.count[2] = 0xFFFFFFFF;
+    rec.pressr[0] = 0xFFFF;
+    rec.pressr[1] = 0x8000;
+    rec.valve = 0xFF;
+    rec.flags = 0x7F;
+    len = LogPackDelta( &prev, &rec, buff );
+    CHECK( len <= LOG_PACK_MAX_SIZE );
+    dec = prev;
+    CHECK( LogUnpack( buff, len, false, &dec ) == len );
+    rec.seq = prev.seq + 1;
+    CHECK( PackEqual( &dec, &rec ) );
+ }
+
+//*************************************************************************************************
+// Ошибки формата: неполная опорная запись, неполная разностная запись, пустой буфер
+//*************************************************************************************************
+static void TestFormat( void ) {
+
+    LOG_PACK prev, rec, dec;
+    uint8_t buff[LOG_PACK_MAX_SIZE], len, i;
+
+    memset( &prev, 0x00, sizeof( prev ) );
+    rec = prev;
+    rec.time = 600;
+    rec.count[0] = 100000;
+    rec.pressr[1] = 5;
+    rec.flags = 1;
+    len = LogPackDelta( &prev, &rec, buff );
+    //любая неполная запись - ошибка формата
+    for ( i = 0; i < len; i++ ) {
+        dec = prev;
+        CHECK( LogUnpack( buff, i, false, &dec ) == 0 );
+       }
+    CHECK( LogUnpack( buff, LOG_PACK_KEY_SIZE - 1, true, &dec ) == 0 );
+    //число переменной длины более 5 байт
+    memset( buff, 0xFF, sizeof( buff ) );
+    buff[0] = 0x00;
+    dec = prev;
+    CHECK( LogUnpack( buff, sizeof( buff ), false, &dec ) == 0 );
+ }
+
+//*************************************************************************************************
+// Преобразование записи журнала в упакованный формат и обратно
+//*************************************************************************************************
+static void TestConvert( void ) {
+
+    WATER_LOG src, dst;
+    LOG_PACK pack;
+
+    memset( &src, 0x00, sizeof( src ) );
+    src.day = 29;
+    src.month = 2;
+    src.year = 2024;
+    src.hour = 23;
+    src.min = 59;
+    src.sec = 59;
+    src.stat_valve_cold = (ValveStat)2;
+    src.error_valve_cold = (ValveError)1;
+    src.stat_valve_hot = (ValveStat)1;
+    src.error_valve_hot = (ValveError)3;
+    src.count_cold = 0xFFFFFFF0;
+    src.count_hot = 12345;
+    src.count_filter = 1;
+    src.pressr_cold = 1234;
+    src.pressr_hot = 0;
+    src.leak1 = (LeakStat)1;
+    src.leak2 = (LeakStat)0;
+    src.flow_leak = 5;
+    src.type_event = (EventType)1;
+    src.dc12_chk = (DC12VStat)1;
+    src.seq = 77;
+    LogPackGet( &src, &pack );
+    LogPackPut( &pack, &dst );
+    CHECK( !memcmp( &src, &dst, sizeof( src ) ) );
+ }
+
+//*************************************************************************************************
+// Следующая запись последовательности
+//-------------------------------------------------------------------------------------------------
+// LOG_PACK *prev - предыдущая запись
+// LOG_PACK *rec  - формируемая запись
+// uint8_t mode   - 0 - ежечасные записи с небольшим расходом, 1 - ежесуточные записи,
+//                  2 - события в произвольное время, 3 - произвольные значения всех полей
+//*************************************************************************************************
+static void NextRecord( LOG_PACK *prev, LOG_PACK *rec, uint8_t mode ) {
+
+    uint8_t i;
+
+    *rec = *prev;
+    switch ( mode ) {
+        case 0:
+        case 1:
+            rec->time += mode ? 86400 : 3600;
+            for ( i = 0; i < 3; i++ )
+                rec->count[i] += Random() % ( mode ? 500 : 30 );
+            for ( i = 0; i < 2; i++ )
+                rec->pressr[i] += (int16_t)( Random() % 11 ) - 5;
+            if ( !( Random() % 50 ) )
+                rec->valve ^= 0x11;
+            break;
+        case 2:
+            rec->time += Random() % 100000;
+            rec->count[Random() % 3] += Random() % 3;
+            if ( !( Random() % 5 ) )
+                rec->flags ^= 0x20;
+            break;
+        default:
+            rec->time = Random();
+            for ( i = 0; i < 3; i++ )
+                rec->count[i] = Random();
+            for ( i = 0; i < 2; i++ )
+                rec->pressr[i] = Random();
+            rec->valve = Random();
+            rec->flags = Random() & 0x7F;
+            break;
+       }
+ }
+
+//*************************************************************************************************
+// Сравнение упакованных записей
+//*************************************************************************************************
+static bool PackEqual( LOG_PACK *a, LOG_PACK *b ) {
+
+    return !memcmp( a, b, sizeof( LOG_PACK ) );
+ }
+
+//*************************************************************************************************
+// Псевдослучайное число (xorshift32), последовательность повторяется при каждом запуске
+//*************************************************************************************************
+static uint32_t Random( void ) {
+
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 17;
+    rnd ^= rnd << 5;
+    return rnd;
+ }
@@ -0,0 +1,200 @@
+//*************************************************************************************************
+//
+// Нагрузочный тест счетчиков импульсов (pulse.c): прерывание EXTI имитируется сигналом таймера
+// (SIGALRM, частота 10 кГц, пачки по 1 - 3 импульса по каждому каналу), выборка накопленных
+// импульсов выполняется в основном цикле с паузами (имитация медленной записи в FRAM).
+// Проверяется, что сумма выбранных импульсов точно совпадает с кол-вом импульсов в прерывании,
+// копия меток времени согласована с кол-вом импульсов.
+//
+//*************************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "cmsis_os2.h"
+
+#include "main.h"
+#include "pulse.h"
+
+//*************************************************************************************************
+// Локальные константы
+//*************************************************************************************************
+#define TEST_PERIOD         100                 //период прерываний (мкс)
+#define TEST_TIME           2                   //длительность теста (сек)
+#define TEST_BURST          3                   //макс. кол-во импульсов в пачке
+#define TEST_SLOW_EVERY     64                  //каждый N-й цикл выборки - медленный
+#define TEST_SLOW_TIME      2000000             //длительность медленного цикла (нс)
+
+#define CHECK( cond )       do { if ( !( cond ) ) { printf( "FAIL %s:%d: %s\r\n", __FILE__, __LINE__, #cond ); fails++; } } while ( 0 )
+
+//*************************************************************************************************
+// Переменные, используемые pulse.c
+//*************************************************************************************************
+uint32_t SystemCoreClock = 72000000;
+
+//*************************************************************************************************
+// Локальные переменные
+//*************************************************************************************************
+static uint32_t fails;
+static DWT_Type dwt;
+static volatile uint32_t stamp;             //метка текущего импульса (номер импульса канала)
+static volatile uint32_t isr_cnt[COUNT_FILTER + 1];
+static volatile uint32_t isr_calls;
+static sigset_t irq_mask;
+
+static const uint16_t inc[COUNT_FILTER + 1] = { 1, 10, 100 };
+
+//*************************************************************************************************
+// Прототипы локальные функций
+//*************************************************************************************************
+static void Exti( int sig );
+static void Spin( uint32_t nsec );
+static void CheckSnap( CountType type );
+
+//*************************************************************************************************
+// Выполнение теста, код возврата - кол-во ошибок
+//*************************************************************************************************
+int main( void ) {
+
+    uint8_t type;
+    uint32_t loop, pending, max_pending, took[COUNT_FILTER + 1];
+    uint64_t count[COUNT_FILTER + 1];
+    struct sigaction sa;
+    struct itimerval timer;
+    struct timespec start, now;
+
+    sigemptyset( &irq_mask );
+    sigaddset( &irq_mask, SIGALRM );
+    memset( &sa, 0x00, sizeof( sa ) );
+    sa.sa_handler = Exti;
+    sigemptyset( &sa.sa_mask );
+    sigaction( SIGALRM, &sa, NULL );
+    memset( count, 0x00, sizeof( count ) );
+    memset( took, 0x00, sizeof( took ) );
+    //запуск прерываний
+    memset( &timer, 0x00, sizeof( timer ) );
+    timer.it_interval.tv_usec = TEST_PERIOD;
+    timer.it_value.tv_usec = TEST_PERIOD;
+    setitimer( ITIMER_REAL, &timer, NULL );
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    for ( loop = 0, max_pending = 0; ; loop++ ) {
+        for ( type = COUNT_COLD; type <= COUNT_FILTER; type++ ) {
+            pending = PulseTake( (CountType)type );
+            took[type] += pending;
+            count[type] += (uint64_t)pending * inc[type];
+            if ( pending > max_pending )
+                max_pending = pending;
+            CheckSnap( (CountType)type );
+           }
+        //медленная обработка: импульсы накапливаются между выборками
+        if ( !( loop % TEST_SLOW_EVERY ) )
+            Spin( TEST_SLOW_TIME );
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        if ( now.tv_sec - start.tv_sec >= TEST_TIME )
+            break;
+       }
+    //остановка прерываний, выборка оставшихся импульсов
+    memset( &timer, 0x00, sizeof( timer ) );
+    setitimer( ITIMER_REAL, &timer, NULL );
+    sigprocmask( SIG_BLOCK, &irq_mask, NULL );
+    for ( type = COUNT_COLD; type <= COUNT_FILTER; type++ ) {
+        pending = PulseTake( (CountType)type );
+        took[type] += pending;
+        count[type] += (uint64_t)pending * inc[type];
+        CHECK( PulseTake( (CountType)type ) == 0 );
+        CHECK( took[type] == isr_cnt[type] );
+        CHECK( PulseDone( (CountType)type ) == isr_cnt[type] );
+        CHECK( count[type] == (uint64_t)isr_cnt[type] * inc[type] );
+        printf( "channel %u: %u pulses, %llu liters\r\n", type, isr_cnt[type], (unsigned long long)count[type] );
+       }
+    printf( "interrupts: %u, take loops: %u, max pulses per take: %u\r\n", isr_calls, loop, max_pending );
+    //импульсы накапливались между выборками
+    CHECK( isr_calls > 1000 && max_pending > 1 );
+    //недопустимый тип счетчика
+    CHECK( PulseTake( (CountType)( COUNT_FILTER + 1 ) ) == 0 );
+    printf( "pulse: %s (%u errors)\r\n", fails ? "FAIL" : "OK", fails );
+    return fails ? 1 : 0;
+ }
+
+//*************************************************************************************************
+// Прерывание EXTI: пачка импульсов по каждому каналу, метка времени импульса - номер импульса
+// канала (проверяется в CheckSnap())
+//*************************************************************************************************
+static void Exti( int sig ) {
+
+    uint8_t type, cnt;
+
+    isr_calls++;
+    for ( type = COUNT_COLD; type <= COUNT_FILTER; type++ ) {
+        for ( cnt = 0; cnt < 1 + ( isr_calls + type ) % TEST_BURST; cnt++ ) {
+            stamp = isr_cnt[type];
+            PulseAdd( (CountType)type );
+            isr_cnt[type]++;
+           }
+       }
+ }
+
+//*************************************************************************************************
+// Копия меток времени должна быть согласована с кол-вом импульсов: метки последних импульсов
+// равны номерам импульсов
+//*************************************************************************************************
+static void CheckSnap( CountType type ) {
+
+    uint32_t idx, first;
+    PULSE_SNAP snap;
+
+    PulseSnap( type, &snap );
+    first = snap.cnt > PULSE_RING_SIZE ? snap.cnt - PULSE_RING_SIZE : 0;
+    for ( idx = first; idx < snap.cnt; idx++ ) {
+        if ( snap.time[idx % PULSE_RING_SIZE] != idx || snap.tick[idx % PULSE_RING_SIZE] != idx ) {
+            CHECK( snap.time[idx % PULSE_RING_SIZE] == idx && snap.tick[idx % PULSE_RING_SIZE] == idx );
+            break;
+           }
+       }
+ }
+
+//*************************************************************************************************
+// Пауза без освобождения процессора (прерывания продолжают поступать)
+//*************************************************************************************************
+static void Spin( uint32_t nsec ) {
+
+    struct timespec start, now;
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    do {
+        clock_gettime( CLOCK_MONOTONIC, &now );
+       } while ( ( now.tv_sec - start.tv_sec ) * 1000000000L + ( now.tv_nsec - start.tv_nsec ) < nsec );
+ }
+
+//*************************************************************************************************
+// CMSIS: счетчик тактов ядра и тики RTOS - метка текущего импульса
+//*************************************************************************************************
+DWT_Type *HostDWT( void ) {
+
+    dwt.CYCCNT = stamp;
+    return &dwt;
+ }
+
+uint32_t osKernelGetTickCount( void ) {
+
+    return stamp;
+ }
+
+//*************************************************************************************************
+// Запрет/разрешение прерываний - блокировка сигнала таймера
+//*************************************************************************************************
+void HostIrqDisable( void ) {
+
+    sigprocmask( SIG_BLOCK, &irq_mask, NULL );
+ }
+
+void HostIrqEnable( void ) {
+
+    sigprocmask( SIG_UNBLOCK, &irq_mask, NULL );
+ }